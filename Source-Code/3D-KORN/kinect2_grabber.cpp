@@ -2,15 +2,15 @@
 #include "QDebug"
 using namespace pcl;
 
-const float Kinect2Grabber::cx = 254.878f;
-const float Kinect2Grabber::cy = 205.395f;
-const float Kinect2Grabber::fx = 365.456f;
-const float Kinect2Grabber::fy = 365.456f;
-const float Kinect2Grabber::k1 = 0.0905474f;
-const float Kinect2Grabber::k2 = -0.26819f;
-const float Kinect2Grabber::k3 = 0.0950862f;
-const float Kinect2Grabber::p1 = 0.0f;
-const float Kinect2Grabber::p2 = 0.0f;
+const float Kinect2Grabber::cx = TDK_KinectV2Intrinsics::cx;
+const float Kinect2Grabber::cy = TDK_KinectV2Intrinsics::cy;
+const float Kinect2Grabber::fx = TDK_KinectV2Intrinsics::fx;
+const float Kinect2Grabber::fy = TDK_KinectV2Intrinsics::fy;
+const float Kinect2Grabber::k1 = TDK_KinectV2Intrinsics::k1;
+const float Kinect2Grabber::k2 = TDK_KinectV2Intrinsics::k2;
+const float Kinect2Grabber::k3 = TDK_KinectV2Intrinsics::k3;
+const float Kinect2Grabber::p1 = TDK_KinectV2Intrinsics::p1;
+const float Kinect2Grabber::p2 = TDK_KinectV2Intrinsics::p2;
 
 Kinect2Grabber::Kinect2Grabber()
     : sensor( nullptr )
@@ -25,8 +25,8 @@ Kinect2Grabber::Kinect2Grabber()
     , colorWidth( 1920 )
     , colorHeight( 1080 )
     , colorBuffer()
-    , depthWidth( 512 )
-    , depthHeight( 424 )
+    , depthWidth( TDK_KinectV2Intrinsics::depthWidth )
+    , depthHeight( TDK_KinectV2Intrinsics::depthHeight )
     , depthBuffer()
     , infraredWidth( 512 )
     , infraredHeight( 424 )
@@ -38,6 +38,7 @@ Kinect2Grabber::Kinect2Grabber()
     , signal_PointXYZI( nullptr )
     , signal_PointXYZRGB( nullptr )
     , signal_PointXYZRGBA( nullptr )
+    , mv_FlagSmoothDepth( false )
 {
     // Create Sensor Instance
     result = GetDefaultKinectSensor( &sensor );
@@ -118,6 +119,9 @@ Kinect2Grabber::Kinect2Grabber()
 
     // To Reserve Depth Frame Buffer
     depthBuffer.resize( depthWidth * depthHeight );
+    depthColorPoints.resize( depthWidth * depthHeight );
+    depthLuminanceBuffer.resize( depthWidth * depthHeight );
+    smoothedDepthBuffer.resize( depthWidth * depthHeight );
 
     // Retrieved Infrared Frame Size
     IFrameDescription* infraredDescription;
@@ -327,22 +331,60 @@ void Kinect2Grabber::threadFunction()
 
         lock.unlock();
 
+        UINT16* depth = mv_FlagSmoothDepth ? mf_SmoothDepth() : &depthBuffer[0];
+        if( depth == nullptr ){
+            continue;
+        }
+
         if( signal_PointXYZ->num_slots() > 0 ){
-            signal_PointXYZ->operator()( convertDepthToPointXYZ( &depthBuffer[0] ) );
+            signal_PointXYZ->operator()( convertDepthToPointXYZ( depth ) );
         }
 
         if( signal_PointXYZI->num_slots() > 0 ){
-            signal_PointXYZI->operator()( convertInfraredDepthToPointXYZI( &infraredBuffer[0], &depthBuffer[0] ) );
+            signal_PointXYZI->operator()( convertInfraredDepthToPointXYZI( &infraredBuffer[0], depth ) );
         }
 
         if( signal_PointXYZRGB->num_slots() > 0 ){
-            signal_PointXYZRGB->operator()( convertRGBDepthToPointXYZRGB( &colorBuffer[0], &depthBuffer[0] ) );
+            signal_PointXYZRGB->operator()( convertRGBDepthToPointXYZRGB( &colorBuffer[0], depth ) );
         }
 
         if( signal_PointXYZRGBA->num_slots() > 0 ){
-            signal_PointXYZRGBA->operator()( convertRGBADepthToPointXYZRGBA( &colorBuffer[0], &depthBuffer[0] ) );
+            signal_PointXYZRGBA->operator()( convertRGBADepthToPointXYZRGBA( &colorBuffer[0], depth ) );
+        }
+    }
+}
+
+/*!
+ * \brief Kinect2Grabber::mf_SmoothDepth
+ * \return depth frame smoothed by the bilateral filter, guided by the luminance of the color
+ * every depth pixel maps to. nullptr when the coordinate mapper fails, the frame is then skipped
+ *
+ * The depth frame is mapped to the color frame in one call of the coordinate mapper. Pixels whose
+ * color is outside of the color frame are filtered on depth alone against each other.
+ */
+UINT16* Kinect2Grabber::mf_SmoothDepth()
+{
+    const int numberOfPixels = depthWidth * depthHeight;
+    const HRESULT mapped = mapper->MapDepthFrameToColorSpace( numberOfPixels, &depthBuffer[0], numberOfPixels, &depthColorPoints[0] );
+    if( FAILED( mapped ) ){
+        qWarning() << "Kinect2Grabber: ICoordinateMapper::MapDepthFrameToColorSpace() failed, frame skipped";
+        return nullptr;
+    }
+
+#pragma omp parallel for
+    for( int i = 0; i < numberOfPixels; i++ ){
+        const int colorX = static_cast<int>( std::floor( depthColorPoints[i].X + 0.5f ) );
+        const int colorY = static_cast<int>( std::floor( depthColorPoints[i].Y + 0.5f ) );
+        uint8_t luminance = 0;
+        if( ( 0 <= colorX ) && ( colorX < colorWidth ) && ( 0 <= colorY ) && ( colorY < colorHeight ) ){
+            const RGBQUAD &color = colorBuffer[colorY * colorWidth + colorX];
+            luminance = static_cast<uint8_t>( ( 77 * color.rgbRed + 150 * color.rgbGreen + 29 * color.rgbBlue ) >> 8 );
         }
+        depthLuminanceBuffer[i] = luminance;
     }
+
+    mv_DepthFilter.mf_Filter( &depthBuffer[0], &smoothedDepthBuffer[0], depthWidth, depthHeight, &depthLuminanceBuffer[0] );
+    return &smoothedDepthBuffer[0];
 }
 
 pcl::PointCloud<pcl::PointXYZ>::Ptr Kinect2Grabber::convertDepthToPointXYZ( UINT16* depthBuffer )
@@ -547,6 +589,11 @@ void Kinect2Grabber::mf_SetMvFlagFilterPoints(bool value)
     mv_FlagFilterPoints = value;
 }
 
+void Kinect2Grabber::mf_SetMvFlagSmoothDepth(bool value)
+{
+    mv_FlagSmoothDepth = value;
+}
+
 void Kinect2Grabber::mf_SetFilterBox(float xmin, float xmax, float ymin, float ymax, float zmin, float zmax)
 {
     mv_XMin = xmin;
@@ -16,6 +16,9 @@
 #include <opencv2/features2d.hpp>
 #include <math.h>
 
+#include "tdk_depthbilateralfilter.h"
+#include "tdk_kinectv2intrinsics.h"
+
 
 namespace pcl
 {
@@ -48,6 +51,7 @@ namespace pcl
 
             void mf_SetMvFlagFilterPoints(bool value);
             void mf_SetFilterBox(float xmin, float xmax, float ymin, float ymax, float zmin, float zmax);
+            void mf_SetMvFlagSmoothDepth(bool value);
 
             void convertCameraPointToColorPoint(const pcl::PointXYZI &inP, ColorSpacePoint &outP);
             void convertCameraPointToColorPoint(const pcl::PointXYZRGB &inP, ColorSpacePoint &outP);
@@ -56,6 +60,17 @@ namespace pcl
             int getDepthWidth();
             int getDepthHeight();
 
+            //camera properties for coordinates transformation
+            static const float cx;
+            static const float cy;
+            static const float fx;
+            static const float fy;
+            static const float k1;
+            static const float k2;
+            static const float k3;
+            static const float p1;
+            static const float p2;
+
             typedef void ( signal_Kinect2_PointXYZ )( const boost::shared_ptr<const pcl::PointCloud<pcl::PointXYZ>>& );
             typedef void ( signal_Kinect2_PointXYZI )( const boost::shared_ptr<const pcl::PointCloud<pcl::PointXYZI>>& );
             typedef void ( signal_Kinect2_PointXYZRGB )( const boost::shared_ptr<const pcl::PointCloud<pcl::PointXYZRGB>>& );
@@ -76,6 +91,7 @@ namespace pcl
             mutable boost::mutex mutex;
 
             void threadFunction();
+            UINT16* mf_SmoothDepth();
 
             bool quit;
             bool running;
@@ -103,21 +119,17 @@ namespace pcl
             int infraredHeight;
             std::vector<UINT16> infraredBuffer;
 
+            //Bilateral filter of the depth frame guided by the color, before the points are generated
+            bool mv_FlagSmoothDepth;
+            TDK_DepthBilateralFilter mv_DepthFilter;
+            std::vector<ColorSpacePoint> depthColorPoints;
+            std::vector<uint8_t> depthLuminanceBuffer;
+            std::vector<UINT16> smoothedDepthBuffer;
+
             bool mv_FlagFilterPoints;
             float mv_XMin, mv_XMax;
             float mv_YMin, mv_YMax;
             float mv_ZMin, mv_ZMax;
-
-            //camera properties for coordinates transformation
-            static const float cx;
-            static const float cy;
-            static const float fx;
-            static const float fy;
-            static const float k1;
-            static const float k2;
-            static const float k3;
-            static const float p1;
-            static const float p2;
     };
 
 
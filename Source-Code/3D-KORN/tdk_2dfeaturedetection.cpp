@@ -1,6 +1,16 @@
 #include "tdk_2dfeaturedetection.h"
 #include "tdk_scanregistration.h"
 
+namespace {
+//Pixel of a camera point in the depth image, same projection as Kinect2Grabber::convertCameraPointToColorPoint
+template <typename PointT>
+cv::Point2f projectToDepthImage(const PointT &p)
+{
+    return cv::Point2f(floor(TDK_KinectV2Intrinsics::cx + ((TDK_KinectV2Intrinsics::fx * p.x)/p.z)),
+                       floor(TDK_KinectV2Intrinsics::cy + ((TDK_KinectV2Intrinsics::fy * p.y)/p.z)));
+}
+}
+
 TDK_2DFeatureDetection::TDK_2DFeatureDetection()
 {
 }
@@ -33,6 +43,17 @@ void TDK_2DFeatureDetection::setInputPointCloud(pcl::PointCloud<pcl::PointXYZRGB
     mv_TrainPointCloudPtr= boost::make_shared<pcl::PointCloud<pcl::PointXYZRGB>>(inPointCloud);
 }
 
+/*!
+ * \brief TDK_2DFeatureDetection::setShowMatches
+ * \param show true to open the 2D match window in getMatchedFeatures
+ *
+ * Off by default, the window blocks and must not be opened from a worker thread
+ */
+void TDK_2DFeatureDetection::setShowMatches(bool show)
+{
+    showMatches = show;
+}
+
 /*!
  * \brief TDK_2DFeatureDetection::getMatchedFeatures
  * \param queryPc pointer for a query point cloud to find mathced features
@@ -48,8 +69,8 @@ void TDK_2DFeatureDetection::getMatchedFeatures(const pcl::PointCloud<pcl::Point
 {
 
     cv::Mat trainImg, queryImg;
-    cv::Mat_<CameraSpacePoint> trainImgCameraSpaceMap, queryImgCameraSpaceMap;
-    ColorSpacePoint maxTrainImgColorCoords,
+    cv::Mat_<cv::Point3f> trainImgCameraSpaceMap, queryImgCameraSpaceMap;
+    cv::Point2f maxTrainImgColorCoords,
                     minTrainImgColorCoords,
                     maxQueryImgColorCoords,
                     minQueryImgColorCoords;
@@ -67,10 +88,10 @@ void TDK_2DFeatureDetection::getMatchedFeatures(const pcl::PointCloud<pcl::Point
     int maxVerticalShiftPxls = INT_MAX;
     //calculating maximum possible vertical shift, images should be approximately on the same level
 
-    if ((abs(maxTrainImgColorCoords.Y - maxQueryImgColorCoords.Y) / maxTrainImgColorCoords.Y) < maxVerticalShift)
+    if ((abs(maxTrainImgColorCoords.y - maxQueryImgColorCoords.y) / maxTrainImgColorCoords.y) < maxVerticalShift)
     {
-        int trainImgHeight = maxTrainImgColorCoords.Y - minTrainImgColorCoords.Y;
-        int queryImgHeight = maxQueryImgColorCoords.Y - minQueryImgColorCoords.Y;
+        int trainImgHeight = maxTrainImgColorCoords.y - minTrainImgColorCoords.y;
+        int queryImgHeight = maxQueryImgColorCoords.y - minQueryImgColorCoords.y;
 
         maxVerticalShiftPxls = round(maxVerticalShift * std::max(trainImgHeight, queryImgHeight));
     }
@@ -91,11 +112,15 @@ void TDK_2DFeatureDetection::getMatchedFeatures(const pcl::PointCloud<pcl::Point
                   matchesRobust,
                   maxVerticalShiftPxls);
 
-    showMatchedFeatures2D(trainImg,
-                          keyPtsRobustTrain,
-                          queryImg,
-                          keyPtsRobustQuery,
-                          matchesRobust);
+#ifndef TDK_HEADLESS
+    //Blocks until the match window is closed, only enabled from the GUI thread
+    if(showMatches)
+        showMatchedFeatures2D(trainImg,
+                              keyPtsRobustTrain,
+                              queryImg,
+                              keyPtsRobustQuery,
+                              matchesRobust);
+#endif
     //we should have at least 4 matches in order to calculate transformation matrix
     if (matchesRobust.size() >= 4)
     {
@@ -110,18 +135,18 @@ void TDK_2DFeatureDetection::getMatchedFeatures(const pcl::PointCloud<pcl::Point
 //            cv::KeyPoint tempKeyPointTrain = keyPtsRobustTrain[tempMatch.trainIdx];
 //            cv::KeyPoint tempKeyPointQuery = keyPtsRobustQuery[tempMatch.queryIdx];
 
-            CameraSpacePoint tempSpacePointTrain = trainImgCameraSpaceMap.at<CameraSpacePoint>(
+            cv::Point3f tempSpacePointTrain = trainImgCameraSpaceMap.at<cv::Point3f>(
                         static_cast<int>(tempKeyPointTrain.pt.y),
                         static_cast<int>(tempKeyPointTrain.pt.x)
                         );
 
-            CameraSpacePoint tempSpacePointTarget = queryImgCameraSpaceMap.at<CameraSpacePoint>(
+            cv::Point3f tempSpacePointTarget = queryImgCameraSpaceMap.at<cv::Point3f>(
                         static_cast<int>(tempKeyPointQuery.pt.y),
                         static_cast<int>(tempKeyPointQuery.pt.x)
                         );
 
-            pcl::PointXYZ tempPointXYZIn(tempSpacePointTrain.X, tempSpacePointTrain.Y, tempSpacePointTrain.Z);
-            pcl::PointXYZ tempPointXYZTarget(tempSpacePointTarget.X, tempSpacePointTarget.Y, tempSpacePointTarget.Z);
+            pcl::PointXYZ tempPointXYZIn(tempSpacePointTrain.x, tempSpacePointTrain.y, tempSpacePointTrain.z);
+            pcl::PointXYZ tempPointXYZTarget(tempSpacePointTarget.x, tempSpacePointTarget.y, tempSpacePointTarget.z);
             outKeyPointsTrain->push_back(tempPointXYZIn);
             outKeyPointsQuery->push_back(tempPointXYZTarget);
         }
@@ -144,18 +169,18 @@ void TDK_2DFeatureDetection::getMatchedFeatures(const pcl::PointCloud<pcl::Point
                 cv::KeyPoint tempKeyPointQuery = keyPtsQuery[tempMatch.trainIdx];
 
 
-                CameraSpacePoint tempSpacePointTrain = trainImgCameraSpaceMap.at<CameraSpacePoint>(
+                cv::Point3f tempSpacePointTrain = trainImgCameraSpaceMap.at<cv::Point3f>(
                             static_cast<int>(tempKeyPointTrain.pt.y),
                             static_cast<int>(tempKeyPointTrain.pt.x)
                             );
 
-                CameraSpacePoint tempSpacePointTarget = queryImgCameraSpaceMap.at<CameraSpacePoint>(
+                cv::Point3f tempSpacePointTarget = queryImgCameraSpaceMap.at<cv::Point3f>(
                             static_cast<int>(tempKeyPointQuery.pt.y),
                             static_cast<int>(tempKeyPointQuery.pt.x)
                             );
 
-                pcl::PointXYZ tempPointXYZIn(tempSpacePointTrain.X, tempSpacePointTrain.Y, tempSpacePointTrain.Z);
-                pcl::PointXYZ tempPointXYZTarget(tempSpacePointTarget.X, tempSpacePointTarget.Y, tempSpacePointTarget.Z);
+                pcl::PointXYZ tempPointXYZIn(tempSpacePointTrain.x, tempSpacePointTrain.y, tempSpacePointTrain.z);
+                pcl::PointXYZ tempPointXYZTarget(tempSpacePointTarget.x, tempSpacePointTarget.y, tempSpacePointTarget.z);
                 outKeyPointsTrain->push_back(tempPointXYZIn);
                 outKeyPointsQuery->push_back(tempPointXYZTarget);
             }
@@ -261,7 +286,7 @@ void TDK_2DFeatureDetection::showMatchedFeatures3D(const pcl::PointCloud<pcl::Po
  */
 void TDK_2DFeatureDetection::getIntensityImage(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &inPointCloud,
                                                cv::Mat &outIntensityImage,
-                                               cv::Mat_<CameraSpacePoint> &outCameraSpaceMap)
+                                               cv::Mat_<cv::Point3f> &outCameraSpaceMap)
 {
     pcl::PointCloud<pcl::PointXYZI>::Ptr pointCloudXYZI(new pcl::PointCloud<pcl::PointXYZI>);
 
@@ -269,32 +294,32 @@ void TDK_2DFeatureDetection::getIntensityImage(const pcl::PointCloud<pcl::PointX
 
     //We will work with depth image rgb image ovelaping only, so we will take into consideration only
     //size of depth image, since it is smaller that the one of rgb image
-    outIntensityImage = cv::Mat::zeros(mv_Kinect2Grabber.getDepthWidth(),
-                                       mv_Kinect2Grabber.getDepthHeight(),
+    outIntensityImage = cv::Mat::zeros(TDK_KinectV2Intrinsics::depthWidth,
+                                       TDK_KinectV2Intrinsics::depthHeight,
                                        CV_8UC1);
 
-    outCameraSpaceMap = cv::Mat_<CameraSpacePoint>(mv_Kinect2Grabber.getDepthWidth(),
-                                             mv_Kinect2Grabber.getDepthHeight());
+    outCameraSpaceMap = cv::Mat_<cv::Point3f>(TDK_KinectV2Intrinsics::depthWidth,
+                                             TDK_KinectV2Intrinsics::depthHeight);
 
     for (auto it = pointCloudXYZI->begin(); it != pointCloudXYZI->end(); it++)
     {
         pcl::PointXYZI tempPointXYZI = *it;
-        ColorSpacePoint tempColorCoords;
-        CameraSpacePoint tempCameraCoords;
+        cv::Point2f tempColorCoords;
+        cv::Point3f tempCameraCoords;
 
-        mv_Kinect2Grabber.convertCameraPointToColorPoint(tempPointXYZI, tempColorCoords);
+        tempColorCoords = projectToDepthImage(tempPointXYZI);
 
-        tempCameraCoords.X = tempPointXYZI.x;
-        tempCameraCoords.Y = tempPointXYZI.y;
-        tempCameraCoords.Z = tempPointXYZI.z;
+        tempCameraCoords.x = tempPointXYZI.x;
+        tempCameraCoords.y = tempPointXYZI.y;
+        tempCameraCoords.z = tempPointXYZI.z;
 
-        if ((tempColorCoords.X >= 0 && tempColorCoords.X <= mv_Kinect2Grabber.getDepthWidth()) &&
-            (tempColorCoords.Y >= 0 && tempColorCoords.Y <= mv_Kinect2Grabber.getDepthHeight()))
+        if ((tempColorCoords.x >= 0 && tempColorCoords.x <= TDK_KinectV2Intrinsics::depthWidth) &&
+            (tempColorCoords.y >= 0 && tempColorCoords.y <= TDK_KinectV2Intrinsics::depthHeight))
         {
-            outIntensityImage.at<uchar>(tempColorCoords.Y, tempColorCoords.X) =
+            outIntensityImage.at<uchar>(tempColorCoords.y, tempColorCoords.x) =
                     static_cast<uchar>(tempPointXYZI.intensity);
 
-            outCameraSpaceMap.at<CameraSpacePoint>(tempColorCoords.Y, tempColorCoords.X) =
+            outCameraSpaceMap.at<cv::Point3f>(tempColorCoords.y, tempColorCoords.x) =
                     tempCameraCoords;
         }
     }
@@ -469,30 +494,30 @@ boost::shared_ptr<pcl::visualization::PCLVisualizer> TDK_2DFeatureDetection::rgb
  */
 void TDK_2DFeatureDetection::getImageBoundaries(
         const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &inPointCloud,
-        ColorSpacePoint &maxColorCoords,
-        ColorSpacePoint &minColorCoords)
+        cv::Point2f &maxColorCoords,
+        cv::Point2f &minColorCoords)
 {
-    maxColorCoords.X = 0;
-    maxColorCoords.Y = 0;
-    minColorCoords.X = INT_MAX;
-    minColorCoords.Y = INT_MAX;
+    maxColorCoords.x = 0;
+    maxColorCoords.y = 0;
+    minColorCoords.x = INT_MAX;
+    minColorCoords.y = INT_MAX;
 
     qDebug() << "Looking for image boundaries...";
 
     for (auto it = inPointCloud->begin(); it != inPointCloud->end(); it++)
     {
         pcl::PointXYZRGB tempPointXYZRGB = *it;
-        ColorSpacePoint tempColorCoords;
+        cv::Point2f tempColorCoords;
 
-        mv_Kinect2Grabber.convertCameraPointToColorPoint(tempPointXYZRGB, tempColorCoords);
+        tempColorCoords = projectToDepthImage(tempPointXYZRGB);
 
-        if ((tempColorCoords.X >= 0 && tempColorCoords.X <= mv_Kinect2Grabber.getDepthWidth()) &&
-            (tempColorCoords.Y >= 0 && tempColorCoords.Y <= mv_Kinect2Grabber.getDepthHeight()))
+        if ((tempColorCoords.x >= 0 && tempColorCoords.x <= TDK_KinectV2Intrinsics::depthWidth) &&
+            (tempColorCoords.y >= 0 && tempColorCoords.y <= TDK_KinectV2Intrinsics::depthHeight))
         {
-            maxColorCoords.X = std::max(maxColorCoords.X, tempColorCoords.X);
-            maxColorCoords.Y = std::max(maxColorCoords.Y, tempColorCoords.Y);
-            minColorCoords.X = std::min(minColorCoords.X, tempColorCoords.X);
-            minColorCoords.Y = std::min(minColorCoords.Y, tempColorCoords.Y);
+            maxColorCoords.x = std::max(maxColorCoords.x, tempColorCoords.x);
+            maxColorCoords.y = std::max(maxColorCoords.y, tempColorCoords.y);
+            minColorCoords.x = std::min(minColorCoords.x, tempColorCoords.x);
+            minColorCoords.y = std::min(minColorCoords.y, tempColorCoords.y);
         }
     }
 }
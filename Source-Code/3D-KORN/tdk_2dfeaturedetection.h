@@ -1,9 +1,10 @@
 #ifndef TDK_2DFEATUREDETECTION_H
 #define TDK_2DFEATUREDETECTION_H
 
-#include "kinect2_grabber.h"
+#include "tdk_kinectv2intrinsics.h"
 
 #include <algorithm>
+#include <climits>
 #include <math.h>
 
 #include <opencv/highgui.h>
@@ -52,6 +53,7 @@ public:
                      pcl::PointCloud<pcl::PointXYZ>::Ptr &outKeyPointsQuery);
     void setInputPointCloud(pcl::PointCloud<pcl::PointXYZRGB>::Ptr &inPointCloudPtr);
     void setInputPointCloud(pcl::PointCloud<pcl::PointXYZRGB> &inPointCloud);
+    void setShowMatches(bool show);
 
     void showKeyPoints(const cv::Mat &rgbImg, const std::vector<cv::KeyPoint> &keyPts);
     void showMatchedFeatures2D(const cv::Mat &rgb_1,
@@ -65,13 +67,13 @@ public:
 
 private:
     float maxVerticalShift = 0.3;
+    bool showMatches = false;
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr mv_TrainPointCloudPtr;
-    pcl::Kinect2Grabber mv_Kinect2Grabber;
 
     void detectFeatures(const cv::Mat &rgbImg, std::vector<cv::KeyPoint> &keyPts);
     void getIntensityImage(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &inPointCloud,
                            cv::Mat &outIntensityImage,
-                           cv::Mat_<CameraSpacePoint> &outCameraSpaceMap);
+                           cv::Mat_<cv::Point3f> &outCameraSpaceMap);
     void matchFeatures(const cv::Mat &rgb_1,
                        std::vector<cv::KeyPoint> &keyPts_1,
                        const cv::Mat &rgb_2,
@@ -79,8 +81,8 @@ private:
                        std::vector<cv::DMatch> &matches,
                        const int maxVertShiftPxls = INT_MAX);
     void getImageBoundaries(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &inPointCloud,
-                            ColorSpacePoint &maxColorCoords,
-                            ColorSpacePoint &minColorCoords);
+                            cv::Point2f &maxColorCoords,
+                            cv::Point2f &minColorCoords);
 
     boost::shared_ptr<pcl::visualization::PCLVisualizer> rgbVis(
             const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud,
@@ -0,0 +1,304 @@
+#include "tdk_batchprocessor.h"
+#include "tdk_filters.h"
+#include "tdk_meshing.h"
+#include "tdk_scanregistration.h"
+
+#include <pcl/filters/filter.h>
+#include <pcl/io/obj_io.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+#include <pcl/io/vtk_io.h>
+#include <pcl/io/vtk_lib_io.h>
+
+#include <QCollator>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <algorithm>
+
+TDK_BatchProcessor::TDK_BatchProcessor() :
+    mv_RegistrationMethod("ICPNormal"),
+    mv_GlobalPreAlignment(false),
+    mv_FeatureMatching2D(false),
+    mv_ModelVoxelSize(0.002),
+    mv_TurntableStepDeg(0.0),
+    mv_ScannerCenterSet(false),
+    mv_OutlierRemoval(true),
+    mv_OutlierThreshold(2.5),
+    mv_OutlierMaxDecisionError(-1.0),
+    mv_VoxelSize(0.0),
+    mv_FilterStagesSet(false),
+    mv_MeshingMethod("Poisson"),
+    mv_TSDFVoxelSize(0.002),
+    mv_TSDFTruncation(0.01)
+{
+    std::fill(mv_ScannerCenter, mv_ScannerCenter + 4, 0.0f);
+}
+
+TDK_BatchProcessor::~TDK_BatchProcessor()
+{
+
+}
+
+QStringList TDK_BatchProcessor::mf_AvailableRegistrationMethods()
+{
+    return QStringList() << "ICP" << "ICPNormal" << "ICPProjective" << "GICP" << "ColoredICP";
+}
+
+QStringList TDK_BatchProcessor::mf_AvailableMeshingMethods()
+{
+    return QStringList() << "Poisson" << "Greedy" << "GridProjection" << "MarchingCubes" << "TSDF" << "None";
+}
+
+/*!
+ * \brief TDK_BatchProcessor::mf_LoadConfig
+ * \param fileName JSON configuration
+ * \return false when the file cannot be read or names an unknown method
+ */
+bool TDK_BatchProcessor::mf_LoadConfig(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        qWarning() << "BatchProcessor: Could not read" << fileName;
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if(error.error != QJsonParseError::NoError || !document.isObject()){
+        qWarning() << "BatchProcessor: Invalid configuration" << fileName << error.errorString();
+        return false;
+    }
+
+    const QJsonObject registration = document.object().value("registration").toObject();
+    mv_RegistrationMethod = registration.value("method").toString(mv_RegistrationMethod);
+    mv_GlobalPreAlignment = registration.value("globalPreAlignment").toBool(mv_GlobalPreAlignment);
+    mv_FeatureMatching2D = registration.value("featureMatching2D").toBool(mv_FeatureMatching2D);
+    mv_ModelVoxelSize = registration.value("modelVoxelSize").toDouble(mv_ModelVoxelSize);
+    mv_TurntableStepDeg = registration.value("turntableStepDeg").toDouble(mv_TurntableStepDeg);
+    if(registration.contains("scannerCenter")){
+        const QJsonObject center = registration.value("scannerCenter").toObject();
+        mv_ScannerCenter[0] = center.value("x").toDouble();
+        mv_ScannerCenter[1] = center.value("y").toDouble();
+        mv_ScannerCenter[2] = center.value("z").toDouble();
+        mv_ScannerCenter[3] = center.value("inclinationDeg").toDouble();
+        mv_ScannerCenterSet = true;
+    }
+
+    const QJsonObject filters = document.object().value("filters").toObject();
+    mv_OutlierRemoval = filters.value("outlierRemoval").toBool(mv_OutlierRemoval);
+    mv_OutlierThreshold = filters.value("outlierThreshold").toDouble(mv_OutlierThreshold);
+    mv_OutlierMaxDecisionError = filters.value("outlierMaxDecisionError").toDouble(mv_OutlierMaxDecisionError);
+    mv_VoxelSize = filters.value("voxelSize").toDouble(mv_VoxelSize);
+    //Stages of a previously loaded configuration do not carry over, the fixed filters apply again
+    mv_FilterPipeline.mf_Clear();
+    mv_FilterStagesSet = false;
+    if(filters.contains("stages")){
+        if(!mv_FilterPipeline.mf_SetStages(filters.value("stages").toArray()))
+            return false;
+        mv_FilterStagesSet = true;
+    }
+
+    const QJsonObject meshing = document.object().value("meshing").toObject();
+    mv_MeshingMethod = meshing.value("method").toString(mv_MeshingMethod);
+    mv_TSDFVoxelSize = meshing.value("tsdfVoxelSize").toDouble(mv_TSDFVoxelSize);
+    mv_TSDFTruncation = meshing.value("tsdfTruncation").toDouble(mv_TSDFTruncation);
+
+    if(!mf_AvailableRegistrationMethods().contains(mv_RegistrationMethod)){
+        qWarning() << "BatchProcessor: Unknown registration method" << mv_RegistrationMethod;
+        return false;
+    }
+    if(!mf_AvailableMeshingMethods().contains(mv_MeshingMethod)){
+        qWarning() << "BatchProcessor: Unknown meshing method" << mv_MeshingMethod;
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * \brief TDK_BatchProcessor::mf_LoadScans
+ * \param directory folder with the PLY/PCD scans, registered in the numeric order of their names
+ * \return false when the folder does not hold at least two readable scans
+ */
+bool TDK_BatchProcessor::mf_LoadScans(const QString &directory)
+{
+    QDir dir(directory);
+    if(!dir.exists()){
+        qWarning() << "BatchProcessor: Scan folder" << directory << "does not exist";
+        return false;
+    }
+
+    QStringList files = dir.entryList(QStringList() << "*.pcd" << "*.ply", QDir::Files);
+    QCollator collator;
+    collator.setNumericMode(true);
+    std::sort(files.begin(), files.end(), collator);
+
+    mv_ScanNames.clear();
+    mv_Scans.clear();
+
+    for(int i = 0; i < files.size(); i++){
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>);
+        const std::string path = dir.filePath(files[i]).toStdString();
+        const int status = files[i].endsWith(".pcd", Qt::CaseInsensitive) ?
+                    pcl::io::loadPCDFile(path, *cloud) : pcl::io::loadPLYFile(path, *cloud);
+        if(status < 0 || cloud->empty()){
+            qWarning() << "BatchProcessor: Could not read" << files[i];
+            continue;
+        }
+
+        std::vector<int> indices;
+        cloud->is_dense = false;
+        pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
+        mv_ScanNames << files[i];
+        mv_Scans.push_back(cloud);
+    }
+
+    qDebug() << "BatchProcessor: Loaded" << mv_Scans.size() << "scans from" << directory;
+
+    return mv_Scans.size() > 1;
+}
+
+/*!
+ * \brief TDK_BatchProcessor::mf_Run
+ * \param cloudFileName merged cloud, PLY or PCD, not written when empty
+ * \param meshFileName mesh, PLY, OBJ, STL or VTK, not written when empty or when meshing is "None"
+ * \return false when the registration or writing an output failed
+ */
+bool TDK_BatchProcessor::mf_Run(const QString &cloudFileName, const QString &meshFileName)
+{
+    mv_Report = QJsonObject();
+    mv_Report["scans"] = QJsonArray::fromStringList(mv_ScanNames);
+    mv_Report["registrationMethod"] = mv_RegistrationMethod;
+    mv_Report["meshingMethod"] = mv_MeshingMethod;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    //Registration, configured like the central widget configures it
+    TDK_ScanRegistration registration;
+    registration.setRegisterInRealTime(false);
+    if(mv_ScannerCenterSet){
+        pcl::PointWithViewpoint scannerCenter;
+        scannerCenter.x = mv_ScannerCenter[0];
+        scannerCenter.y = mv_ScannerCenter[1];
+        scannerCenter.z = mv_ScannerCenter[2];
+        scannerCenter.vp_x = mv_ScannerCenter[3];
+        scannerCenter.vp_y = 0.0;
+        scannerCenter.vp_z = 0.0;
+        registration.setScannerRotationAxis(scannerCenter);
+    }
+    registration.set_modelVoxelSize(mv_ModelVoxelSize);
+    registration.mv_use2DFeatureDetection = mv_FeatureMatching2D;
+    registration.mv_globalPreAlignment = mv_GlobalPreAlignment;
+    registration.mv_ICP_Normals = (mv_RegistrationMethod != "ICP");
+    registration.mv_ICP_Projective = (mv_RegistrationMethod == "ICPProjective");
+    registration.mv_ICP_Generalized = (mv_RegistrationMethod == "GICP");
+    registration.mv_ICP_Colored = (mv_RegistrationMethod == "ColoredICP");
+
+    //The turntable rotates by the same step between two captures
+    for(size_t i = 0; i < mv_Scans.size(); i++)
+        registration.addNextPointCloud(mv_Scans[i], mv_TurntableStepDeg);
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr registeredPointCloud = registration.Process_and_getAlignedPC();
+    mv_Report["registrationMs"] = timer.nsecsElapsed() / 1e6;
+    mv_Report["telemetry"] = registration.getSessionTelemetry();
+    if(!registeredPointCloud || registeredPointCloud->empty()){
+        qWarning() << "BatchProcessor: Registration failed";
+        return false;
+    }
+
+    //Filters of the merged cloud
+    timer.restart();
+    if(!mv_FilterStagesSet){
+        mv_FilterPipeline.mf_Clear();
+        if(mv_OutlierRemoval)
+            mv_FilterPipeline.mf_AddOutlierRemoval(mv_OutlierThreshold, mv_OutlierMaxDecisionError, 8);
+        if(mv_VoxelSize > 0.0)
+            mv_FilterPipeline.mf_AddVoxelGrid(mv_VoxelSize);
+    }
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr filteredPointCloud (new pcl::PointCloud<pcl::PointXYZRGB>);
+    mv_FilterPipeline.mf_Process(registeredPointCloud, filteredPointCloud);
+
+    const QJsonArray filterStages = mv_FilterPipeline.mf_GetReport().value("stages").toArray();
+    for(int s = 0; s < filterStages.size(); s++)
+        if(filterStages[s].toObject().contains("decisionError"))
+            mv_Report["outlierDecisionError"] = filterStages[s].toObject().value("decisionError");
+    mv_Report["filterStages"] = filterStages;
+    mv_Report["filterMs"] = timer.nsecsElapsed() / 1e6;
+    mv_Report["registeredPoints"] = static_cast<int>(registeredPointCloud->size());
+    mv_Report["filteredPoints"] = static_cast<int>(filteredPointCloud->size());
+
+    if(!cloudFileName.isEmpty() && !mf_SavePointCloud(cloudFileName, *filteredPointCloud))
+        return false;
+
+    if(meshFileName.isEmpty() || mv_MeshingMethod == "None")
+        return true;
+
+    //Meshing, TSDF fuses the posed views instead of the merged cloud
+    timer.restart();
+    pcl::PolygonMesh::Ptr meshPtr ( new PolygonMesh );
+    if(mv_MeshingMethod == "TSDF"){
+        if(!TDK_Meshing::mf_TSDF_Fusion(*registration.getRoughlyAlignedPCs(), *registration.getRegisteredPoses(),
+                                        meshPtr, mv_TSDFVoxelSize, mv_TSDFTruncation)){
+            qWarning() << "BatchProcessor: TSDF fusion gave no mesh";
+            return false;
+        }
+    }
+    else{
+        pcl::PointCloud<pcl::PointXYZ>::Ptr pointcloud ( new pcl::PointCloud<pcl::PointXYZ> ());
+        TDK_Meshing::mf_ConvertFromXYZRGBtoXYZ(filteredPointCloud, pointcloud);
+
+        if(mv_MeshingMethod == "Poisson"){TDK_Meshing::mf_Poisson(pointcloud, meshPtr);}
+        else if(mv_MeshingMethod == "Greedy"){TDK_Meshing::mf_Greedy_Projection_Triangulation(pointcloud, meshPtr);}
+        else if(mv_MeshingMethod == "GridProjection"){TDK_Meshing::mf_Grid_Projection(pointcloud, meshPtr);}
+        else if(mv_MeshingMethod == "MarchingCubes"){TDK_Meshing::mf_Marching_Cubes(pointcloud, meshPtr);}
+    }
+    mv_Report["meshingMs"] = timer.nsecsElapsed() / 1e6;
+    mv_Report["meshPolygons"] = static_cast<int>(meshPtr->polygons.size());
+
+    return mf_SaveMesh(meshFileName, *meshPtr);
+}
+
+bool TDK_BatchProcessor::mf_SavePointCloud(const QString &fileName, const pcl::PointCloud<pcl::PointXYZRGB> &cloud)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    int status = -1;
+    if(suffix == "pcd")
+        status = pcl::io::savePCDFileBinary(fileName.toStdString(), cloud);
+    else if(suffix == "ply")
+        status = pcl::io::savePLYFileBinary(fileName.toStdString(), cloud);
+    else
+        qWarning() << "BatchProcessor: Point clouds are written as PLY or PCD, not" << suffix;
+
+    if(status < 0){
+        qWarning() << "BatchProcessor: Could not write" << fileName;
+        return false;
+    }
+    return true;
+}
+
+bool TDK_BatchProcessor::mf_SaveMesh(const QString &fileName, const pcl::PolygonMesh &mesh)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    bool saved = false;
+    if(suffix == "ply")
+        saved = pcl::io::savePLYFile(fileName.toStdString(), mesh) >= 0;
+    else if(suffix == "obj")
+        saved = pcl::io::saveOBJFile(fileName.toStdString(), mesh) >= 0;
+    else if(suffix == "stl")
+        saved = pcl::io::savePolygonFileSTL(fileName.toStdString(), mesh);
+    else if(suffix == "vtk")
+        saved = pcl::io::saveVTKFile(fileName.toStdString(), mesh) >= 0;
+    else
+        qWarning() << "BatchProcessor: Meshes are written as PLY, OBJ, STL or VTK, not" << suffix;
+
+    if(!saved)
+        qWarning() << "BatchProcessor: Could not write" << fileName;
+    return saved;
+}
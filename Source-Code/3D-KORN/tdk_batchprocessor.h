@@ -0,0 +1,81 @@
+#ifndef TDK_BATCHPROCESSOR_H
+#define TDK_BATCHPROCESSOR_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PolygonMesh.h>
+#include <vector>
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include "tdk_filterpipeline.h"
+
+/*!
+ * \brief The TDK_BatchProcessor class
+ *
+ * Registers a directory of PLY/PCD scans, cleans the merged cloud and meshes it without any
+ * window, the same steps the central widget runs on selected point clouds. Views are sorted
+ * by name and registered in that order, as they were captured by the scan window.
+ *
+ * The configuration is a JSON file with the optional objects "registration", "filters" and
+ * "meshing", see BatchProcessing/batch_config_example.json. Missing values keep the defaults of the GUI.
+ *
+ * Use example
+ * TDK_BatchProcessor processor;
+ * processor.mf_LoadConfig("config.json");
+ * processor.mf_LoadScans("scans");
+ * processor.mf_Run("merged.ply", "mesh.ply");
+ */
+class TDK_BatchProcessor
+{
+public:
+    TDK_BatchProcessor();
+    ~TDK_BatchProcessor();
+
+    static QStringList  mf_AvailableRegistrationMethods ();
+    static QStringList  mf_AvailableMeshingMethods      ();
+
+    bool    mf_LoadConfig                       (const QString &fileName);
+    bool    mf_LoadScans                        (const QString &directory);
+
+    int     mf_GetNumberOfScans                 () const    {   return static_cast<int>(mv_Scans.size());   }
+
+    bool    mf_Run                              (const QString &cloudFileName, const QString &meshFileName);
+
+    //Stage times, sizes and the registration telemetry of the last run
+    QJsonObject mf_GetReport                    () const    {   return mv_Report;   }
+
+private:
+    //Registration
+    QString     mv_RegistrationMethod;
+    bool        mv_GlobalPreAlignment;
+    bool        mv_FeatureMatching2D;
+    float       mv_ModelVoxelSize;
+    float       mv_TurntableStepDeg;
+    bool        mv_ScannerCenterSet;
+    float       mv_ScannerCenter[4];            //x, y, z in meters and inclination in degrees
+
+    //Filters of the merged cloud, "filters.stages" replaces the four values when present
+    bool        mv_OutlierRemoval;
+    float       mv_OutlierThreshold;
+    float       mv_OutlierMaxDecisionError;     //approximate outlier removal when >= 0, exact otherwise
+    float       mv_VoxelSize;                   //0 keeps every point
+    bool        mv_FilterStagesSet;
+    TDK_FilterPipeline  mv_FilterPipeline;
+
+    //Meshing
+    QString     mv_MeshingMethod;
+    float       mv_TSDFVoxelSize;
+    float       mv_TSDFTruncation;
+
+    QStringList                                         mv_ScanNames;
+    std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> mv_Scans;
+    QJsonObject                                         mv_Report;
+
+    static bool mf_SavePointCloud               (const QString &fileName, const pcl::PointCloud<pcl::PointXYZRGB> &cloud);
+    static bool mf_SaveMesh                     (const QString &fileName, const pcl::PolygonMesh &mesh);
+};
+
+#endif // TDK_BATCHPROCESSOR_H
@@ -13,14 +13,18 @@ TDK_CentralWidget::TDK_CentralWidget(QWidget *parent) : QWidget(parent),
     mv_GenerateMeshPushButton       (new QPushButton(QString("GENERATE MESH")))         ,
     mv_RegistrationComboBox         (new QComboBox)                                     ,
     mv_RegistrationPushButton       (new QPushButton(QString("REGISTER POINT CLOUDS"))) ,
+    mv_CancelRegistrationPushButton (new QPushButton(QString("CANCEL")))                ,
     mv_PointCloudExplorerTabWidget  (new QTabWidget)                                    ,
     mv_PointCloudListTab            (new QListWidget)                                   ,
     mv_RegisteredPointCloudListTab  (new QListWidget)                                   ,
     mv_MeshListTab                  (new QListWidget)                                   ,
     mv_ScanRegistration             (new TDK_ScanRegistration)                          ,
+    mv_RegistrationJob              (new TDK_RegistrationJob(mv_ScanRegistration, this)),
     mv_numberOfPointCloudsSelected  (0)                                                 ,
     mv_numberOfMeshesSelected       (0)                                                 ,
-    mv_2DFeatureDetectionCheckBox(new QCheckBox)
+    mv_2DFeatureDetectionCheckBox(new QCheckBox)                                        ,
+    mv_GlobalPreAlignmentCheckBox(new QCheckBox)                                        ,
+    mv_TSDFFusionCheckBox(new QCheckBox)
 {
     mf_setupUI();
 
@@ -29,6 +33,22 @@ TDK_CentralWidget::TDK_CentralWidget(QWidget *parent) : QWidget(parent),
             this                            , SLOT(mf_SlotRegisterPointCloud()));
     connect(mv_GenerateMeshPushButton       , SIGNAL(clicked(bool)),
             this                            , SLOT(mf_SlotGenerateMesh()));
+    connect(mv_CancelRegistrationPushButton , SIGNAL(clicked(bool)),
+            mv_RegistrationJob              , SLOT(mf_Cancel()));
+
+    //Connections for the registration running in the background
+    connect(mv_RegistrationJob              , SIGNAL(mf_SignalProgress(double)),
+            this                            , SLOT(mf_SlotRegistrationProgress(double)));
+    connect(mv_RegistrationJob              , SIGNAL(mf_SignalFinished(pcl::PointCloud<pcl::PointXYZRGB>::Ptr)),
+            this                            , SLOT(mf_SlotRegistrationFinished(pcl::PointCloud<pcl::PointXYZRGB>::Ptr)),
+            Qt::QueuedConnection);
+    connect(mv_RegistrationJob              , SIGNAL(mf_SignalCancelled()),
+            this                            , SLOT(mf_SlotRegistrationCancelled()));
+    connect(mv_RegistrationJob              , SIGNAL(mf_SignalFusionProgress(double)),
+            this                            , SLOT(mf_SlotFusionProgress(double)));
+    connect(mv_RegistrationJob              , SIGNAL(mf_SignalMeshFinished(pcl::PolygonMesh::Ptr)),
+            this                            , SLOT(mf_SlotFusionFinished(pcl::PolygonMesh::Ptr)),
+            Qt::QueuedConnection);
 
     //Connections for updating registered pointcloud and mesh tabs
     connect(this                            , SIGNAL(mf_SignalRegisteredPointCloudListUpdated()),
@@ -141,10 +161,16 @@ void TDK_CentralWidget::mf_SetupPointCloudOperationsWidget()
 
     mv_RegistrationComboBox->addItem("ICP with normals", "ICP with normals");
     mv_RegistrationComboBox->addItem("ICP", "ICP");
+    mv_RegistrationComboBox->addItem("Projective ICP", "Projective ICP");
+    mv_RegistrationComboBox->addItem("Generalized ICP", "Generalized ICP");
+    mv_RegistrationComboBox->addItem("Colored ICP", "Colored ICP");
 
     mv_RegistrationPushButton->setFixedHeight(22);
     mv_RegistrationPushButton->setMinimumWidth(300);
 
+    mv_CancelRegistrationPushButton->setFixedHeight(22);
+    mv_CancelRegistrationPushButton->setEnabled(false);
+
     QFrame* myFrame = new QFrame();
     myFrame->setFrameShape(QFrame::HLine);
 
@@ -161,14 +187,25 @@ void TDK_CentralWidget::mf_SetupPointCloudOperationsWidget()
     mv_2DFeatureDetectionCheckBox->setMinimumWidth(300);
     mv_2DFeatureDetectionCheckBox->setText("Use 2D feature matching");
 
+    mv_GlobalPreAlignmentCheckBox->setFixedHeight(22);
+    mv_GlobalPreAlignmentCheckBox->setMinimumWidth(300);
+    mv_GlobalPreAlignmentCheckBox->setText("Use FPFH global pre-alignment");
+
+    mv_TSDFFusionCheckBox->setFixedHeight(22);
+    mv_TSDFFusionCheckBox->setMinimumWidth(300);
+    mv_TSDFFusionCheckBox->setText("Mesh registered views with TSDF fusion");
+
     gridLayout->addWidget(new QLabel("Select registration algorithm : "), 0, 0, 1, 2);
     gridLayout->addWidget(mv_RegistrationComboBox, 0, 2, 1, 2);
-    gridLayout->addWidget(mv_RegistrationPushButton, 1, 0, 1, 4);
+    gridLayout->addWidget(mv_RegistrationPushButton, 1, 0, 1, 3);
+    gridLayout->addWidget(mv_CancelRegistrationPushButton, 1, 3, 1, 1);
     gridLayout->addWidget(mv_2DFeatureDetectionCheckBox, 2, 0, 1, 4);
-    gridLayout->addWidget(myFrame, 3, 0, 1, 4);
-    gridLayout->addWidget(new QLabel("Select mesh algorithm : "), 4, 0, 1, 2);
-    gridLayout->addWidget(mv_MeshAlgorithmComboBox, 4, 2, 1, 2);
-    gridLayout->addWidget(mv_GenerateMeshPushButton, 5, 0, 1, 4);
+    gridLayout->addWidget(mv_GlobalPreAlignmentCheckBox, 3, 0, 1, 4);
+    gridLayout->addWidget(mv_TSDFFusionCheckBox, 4, 0, 1, 4);
+    gridLayout->addWidget(myFrame, 5, 0, 1, 4);
+    gridLayout->addWidget(new QLabel("Select mesh algorithm : "), 6, 0, 1, 2);
+    gridLayout->addWidget(mv_MeshAlgorithmComboBox, 6, 2, 1, 2);
+    gridLayout->addWidget(mv_GenerateMeshPushButton, 7, 0, 1, 4);
 
     gridLayout->setRowMinimumHeight(0, 30);
     gridLayout->setHorizontalSpacing(10);
@@ -192,6 +229,18 @@ void TDK_CentralWidget::mf_SlotRegisterPointCloud()
 {
     qDebug() << "Check if at least two point clouds selected and run registration";
     if(mv_numberOfPointCloudsSelected > 1){
+        //Settings first, views added in real time are aligned as they are added
+        if (mv_2DFeatureDetectionCheckBox->checkState() == Qt::Checked)
+           mv_ScanRegistration->mv_use2DFeatureDetection = true;
+        else
+            mv_ScanRegistration->mv_use2DFeatureDetection = false;
+
+        mv_ScanRegistration->mv_globalPreAlignment = (mv_GlobalPreAlignmentCheckBox->checkState() == Qt::Checked);
+        mv_ScanRegistration->mv_ICP_Normals = (mv_RegistrationComboBox->currentText() != "ICP");
+        mv_ScanRegistration->mv_ICP_Projective = (mv_RegistrationComboBox->currentText() == "Projective ICP");
+        mv_ScanRegistration->mv_ICP_Generalized = (mv_RegistrationComboBox->currentText() == "Generalized ICP");
+        mv_ScanRegistration->mv_ICP_Colored = (mv_RegistrationComboBox->currentText() == "Colored ICP");
+
         for (int i=0, len = mv_PointCloudListTab->count(); i < len; i++){
             if(mv_PointCloudListTab->item(i)->checkState() == Qt::Checked){
                 mv_ScanRegistration->addNextPointCloud(TDK_Database::mv_PointCloudsVector[i], 0);
@@ -203,17 +252,14 @@ void TDK_CentralWidget::mf_SlotRegisterPointCloud()
             }
         }
 
-        if (mv_2DFeatureDetectionCheckBox->checkState() == Qt::Checked)
-           mv_ScanRegistration->mv_use2DFeatureDetection = true;
-        else
-            mv_ScanRegistration->mv_use2DFeatureDetection = false;
-
-        if (mv_RegistrationComboBox->currentText() == "ICP")
-            mv_ScanRegistration->mv_ICP_Normals = false;
-
+        //Fuse the posed views directly into a mesh instead of meshing the merged cloud
+        mv_RegistrationJob->mf_SetFuseViews(mv_TSDFFusionCheckBox->checkState() == Qt::Checked);
 
-        TDK_Database::mf_StaticAddRegisteredPointCloud(mv_ScanRegistration->Process_and_getAlignedPC()->makeShared());
-        emit mf_SignalRegisteredPointCloudListUpdated();
+        //The result is stored in mf_SlotRegistrationFinished
+        if(mv_RegistrationJob->mf_Start()){
+            mv_RegistrationPushButton->setEnabled(false);
+            mv_CancelRegistrationPushButton->setEnabled(true);
+        }
     }
     else
     {
@@ -221,6 +267,83 @@ void TDK_CentralWidget::mf_SlotRegisterPointCloud()
     }
 }
 
+/***************************************************************************
+ * Input argument(s) : double fraction - Fraction of the pairs aligned
+ * Return type       : void
+ * Functionality     : Slot function to show the registration progress.
+ *
+ **************************************************************************/
+void TDK_CentralWidget::mf_SlotRegistrationProgress(double fraction)
+{
+    mf_SlotUpdateStatusBar(tr("Registering... %1%").arg(qRound(fraction * 100)), QColor(Qt::red));
+}
+
+/***************************************************************************
+ * Input argument(s) : pcl::PointCloud<pcl::PointXYZRGB>::Ptr registeredPointCloud
+ *                     - Merged cloud of the registration job
+ * Return type       : void
+ * Functionality     : Slot function to store the registered pointcloud. The
+ *                     job goes on fusing the registered views when TSDF
+ *                     fusion was checked.
+ *
+ **************************************************************************/
+void TDK_CentralWidget::mf_SlotRegistrationFinished(pcl::PointCloud<pcl::PointXYZRGB>::Ptr registeredPointCloud)
+{
+    mv_CancelRegistrationPushButton->setEnabled(false);
+
+    TDK_Database::mf_StaticAddRegisteredPointCloud(registeredPointCloud);
+    emit mf_SignalRegisteredPointCloudListUpdated();
+
+    if(mv_RegistrationJob->mf_IsRunning())
+        mf_SlotUpdateStatusBar(tr("Meshing started..."), QColor(Qt::red));
+    else
+        mv_RegistrationPushButton->setEnabled(true);
+}
+
+/***************************************************************************
+ * Input argument(s) : double fraction - Fraction of the views fused
+ * Return type       : void
+ * Functionality     : Slot function to show the TSDF fusion progress.
+ *
+ **************************************************************************/
+void TDK_CentralWidget::mf_SlotFusionProgress(double fraction)
+{
+    mf_SlotUpdateStatusBar(tr("Meshing... %1%").arg(qRound(fraction * 100)), QColor(Qt::red));
+}
+
+/***************************************************************************
+ * Input argument(s) : pcl::PolygonMesh::Ptr mesh - Mesh of the fused views,
+ *                     none when the fusion failed
+ * Return type       : void
+ * Functionality     : Slot function to store the mesh of the TSDF fusion.
+ *
+ **************************************************************************/
+void TDK_CentralWidget::mf_SlotFusionFinished(pcl::PolygonMesh::Ptr mesh)
+{
+    mv_RegistrationPushButton->setEnabled(true);
+
+    if(mesh){
+        TDK_Database::mf_StaticAddMesh(mesh);
+        emit mf_SignalMeshListUpdated();
+        mf_SlotUpdateStatusBar(tr("Meshing finished"), QColor(Qt::darkGreen));
+    }
+    else
+        mf_SlotUpdateStatusBar(tr("Meshing failed"), QColor(Qt::red));
+}
+
+/***************************************************************************
+ * Input argument(s) : void
+ * Return type       : void
+ * Functionality     : Slot function to restore the ui after a cancelled
+ *                     registration.
+ *
+ **************************************************************************/
+void TDK_CentralWidget::mf_SlotRegistrationCancelled()
+{
+    mv_RegistrationPushButton->setEnabled(true);
+    mv_CancelRegistrationPushButton->setEnabled(false);
+}
+
 /***************************************************************************
  * Input argument(s) : void
  * Return type       : void
@@ -31,6 +31,7 @@
 //Include custom classes
 #include "tdk_database.h"
 #include "tdk_scanregistration.h"
+#include "tdk_registrationjob.h"
 #include "tdk_meshing.h"
 #include "tdk_filters.h"
 
@@ -50,8 +51,12 @@ public:
     QPushButton          *mv_GenerateMeshPushButton;
     QComboBox            *mv_RegistrationComboBox;
     QPushButton          *mv_RegistrationPushButton;
+    QPushButton          *mv_CancelRegistrationPushButton;
     QCheckBox            *mv_2DFeatureDetectionCheckBox;
+    QCheckBox            *mv_GlobalPreAlignmentCheckBox;
+    QCheckBox            *mv_TSDFFusionCheckBox;
     TDK_ScanRegistration *mv_ScanRegistration;
+    TDK_RegistrationJob  *mv_RegistrationJob;
 
     //Explorer widget
     QTabWidget           *mv_PointCloudExplorerTabWidget;
@@ -79,6 +84,13 @@ public slots:
     void    mf_SlotRegisterPointCloud               ();
     void    mf_SlotGenerateMesh                     ();
 
+    //Slots to follow the registration job
+    void    mf_SlotRegistrationProgress             (double fraction);
+    void    mf_SlotRegistrationFinished             (pcl::PointCloud<pcl::PointXYZRGB>::Ptr registeredPointCloud);
+    void    mf_SlotRegistrationCancelled            ();
+    void    mf_SlotFusionProgress                   (double fraction);
+    void    mf_SlotFusionFinished                   (pcl::PolygonMesh::Ptr mesh);
+
     //Slots to update pointcloud and mesh list tab
     void    mf_SlotUpdatePointCloudListTab          ();
     void    mf_SlotUpdateRegisteredPointCloudListTab();
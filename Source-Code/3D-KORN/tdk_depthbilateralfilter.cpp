@@ -0,0 +1,203 @@
+#include "tdk_depthbilateralfilter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+//Entries of the range weights per depth sigma, the table ends at three sigmas
+const int RangeStepsPerSigma = 64;
+const int RangeSigmas = 3;
+}
+
+TDK_DepthBilateralFilter::TDK_DepthBilateralFilter() :
+    mv_SpatialSigma(1.5),
+    mv_DepthSigma(0.01),
+    mv_ColorSigma(12.0),
+    mv_Radius(3),
+    mv_Separable(true)
+{
+    mf_SetSpatialSigma(mv_SpatialSigma);
+    mf_SetDepthSigma(mv_DepthSigma);
+    mf_SetColorSigma(mv_ColorSigma);
+}
+
+TDK_DepthBilateralFilter::~TDK_DepthBilateralFilter()
+{
+
+}
+
+void TDK_DepthBilateralFilter::mf_SetSpatialSigma(const float sigma)
+{
+    mv_SpatialSigma = std::max(sigma, 0.1f);
+    mv_Radius = std::max(1, static_cast<int>(std::ceil(2.0f * mv_SpatialSigma)));
+    mv_SpatialWeights.resize(2 * mv_Radius + 1);
+    for(int k = -mv_Radius; k <= mv_Radius; k++)
+        mv_SpatialWeights[k + mv_Radius] = std::exp(-0.5f * k * k / (mv_SpatialSigma * mv_SpatialSigma));
+}
+
+void TDK_DepthBilateralFilter::mf_SetDepthSigma(const float sigma)
+{
+    mv_DepthSigma = std::max(sigma, 1e-4f);
+    mv_RangeWeights.resize(RangeSigmas * RangeStepsPerSigma);
+    for(size_t i = 0; i < mv_RangeWeights.size(); i++){
+        const float t = (i + 0.5f) / RangeStepsPerSigma;
+        mv_RangeWeights[i] = std::exp(-0.5f * t * t);
+    }
+}
+
+void TDK_DepthBilateralFilter::mf_SetColorSigma(const float sigma)
+{
+    mv_ColorSigma = std::max(sigma, 0.1f);
+    mv_ColorWeights.resize(256);
+    for(int i = 0; i < 256; i++)
+        mv_ColorWeights[i] = std::exp(-0.5f * i * i / (mv_ColorSigma * mv_ColorSigma));
+}
+
+/*!
+ * \brief TDK_DepthBilateralFilter::mf_Filter
+ * \param depth frame in millimeters, 0 where there is no depth
+ * \param filtered smoothed frame of the same size
+ * \param width height size of the frame
+ * \param guide luminance of every depth pixel, neighbours of another color get less weight,
+ * nullptr filters on depth alone
+ */
+void TDK_DepthBilateralFilter::mf_Filter(const uint16_t *depth, uint16_t *filtered, const int width, const int height,
+                                         const uint8_t *guide)
+{
+    if(width <= 0 || height <= 0)
+        return;
+
+    if(!mv_Separable){
+        mf_Full(depth, filtered, width, height, guide);
+        return;
+    }
+
+    mv_Horizontal.resize(static_cast<size_t>(width) * height);
+    mf_Horizontal(depth, width, height, guide);
+    mf_Vertical(filtered, width, height, guide);
+}
+
+//Weight of a depth difference, inverseSigma is one over the depth sigma of the center pixel
+inline float TDK_DepthBilateralFilter::mf_RangeWeight(const float difference, const float inverseSigma) const
+{
+    const int index = static_cast<int>(std::abs(difference) * inverseSigma * RangeStepsPerSigma);
+    return index < static_cast<int>(mv_RangeWeights.size()) ? mv_RangeWeights[index] : 0.0f;
+}
+
+void TDK_DepthBilateralFilter::mf_Horizontal(const uint16_t *depth, const int width, const int height, const uint8_t *guide)
+{
+    const int radius = mv_Radius;
+
+#pragma omp parallel for
+    for(int y = 0; y < height; y++){
+        const uint16_t *row = depth + static_cast<size_t>(y) * width;
+        const uint8_t *guideRow = guide ? guide + static_cast<size_t>(y) * width : nullptr;
+        float *output = &mv_Horizontal[static_cast<size_t>(y) * width];
+
+        for(int x = 0; x < width; x++){
+            const float center = row[x];
+            if(row[x] == 0){
+                output[x] = 0.0f;
+                continue;
+            }
+
+            const float inverseSigma = 1.0f / (mv_DepthSigma * center);
+            float sum = 0.0f, weights = 0.0f;
+            const int first = std::max(0, x - radius), last = std::min(width - 1, x + radius);
+            //Pixels without depth are more than three sigmas away and get no weight
+            for(int q = first; q <= last; q++){
+                float weight = mv_SpatialWeights[q - x + radius] * mf_RangeWeight(row[q] - center, inverseSigma);
+                if(guideRow)
+                    weight *= mv_ColorWeights[std::abs(guideRow[q] - guideRow[x])];
+                sum += weight * row[q];
+                weights += weight;
+            }
+            //The center always weighs in
+            output[x] = sum / weights;
+        }
+    }
+}
+
+/*
+ * The rows around an output row are added one after the other, every output row reads whole
+ * input rows instead of columns.
+ */
+void TDK_DepthBilateralFilter::mf_Vertical(uint16_t *filtered, const int width, const int height, const uint8_t *guide) const
+{
+    const int radius = mv_Radius;
+
+#pragma omp parallel
+    {
+        std::vector<float> sums(width), weights(width), inverseSigmas(width);
+
+#pragma omp for
+        for(int y = 0; y < height; y++){
+            const float *centerRow = &mv_Horizontal[static_cast<size_t>(y) * width];
+            const uint8_t *guideCenter = guide ? guide + static_cast<size_t>(y) * width : nullptr;
+            std::fill(sums.begin(), sums.end(), 0.0f);
+            std::fill(weights.begin(), weights.end(), 0.0f);
+            for(int x = 0; x < width; x++)
+                inverseSigmas[x] = centerRow[x] > 0.0f ? 1.0f / (mv_DepthSigma * centerRow[x]) : 0.0f;
+            //inverseSigmas of 0 give pixels without depth a weight, their sums are dropped
+
+            const int first = std::max(0, y - radius), last = std::min(height - 1, y + radius);
+            for(int q = first; q <= last; q++){
+                const float *row = &mv_Horizontal[static_cast<size_t>(q) * width];
+                const uint8_t *guideRow = guide ? guide + static_cast<size_t>(q) * width : nullptr;
+                const float spatialWeight = mv_SpatialWeights[q - y + radius];
+
+                for(int x = 0; x < width; x++){
+                    float weight = spatialWeight * mf_RangeWeight(row[x] - centerRow[x], inverseSigmas[x]);
+                    if(guideRow)
+                        weight *= mv_ColorWeights[std::abs(guideRow[x] - guideCenter[x])];
+                    sums[x] += weight * row[x];
+                    weights[x] += weight;
+                }
+            }
+
+            uint16_t *output = filtered + static_cast<size_t>(y) * width;
+            for(int x = 0; x < width; x++)
+                output[x] = centerRow[x] > 0.0f ? static_cast<uint16_t>(sums[x] / weights[x] + 0.5f) : 0;
+        }
+    }
+}
+
+//Full (2 * radius + 1)^2 kernel, the exact bilateral filter
+void TDK_DepthBilateralFilter::mf_Full(const uint16_t *depth, uint16_t *filtered, const int width, const int height,
+                                       const uint8_t *guide) const
+{
+    const int radius = mv_Radius;
+
+#pragma omp parallel for
+    for(int y = 0; y < height; y++){
+        for(int x = 0; x < width; x++){
+            const size_t index = static_cast<size_t>(y) * width + x;
+            if(depth[index] == 0){
+                filtered[index] = 0;
+                continue;
+            }
+
+            const float center = depth[index];
+            const float inverseSigma = 1.0f / (mv_DepthSigma * center);
+            float sum = 0.0f, weights = 0.0f;
+            for(int v = std::max(0, y - radius); v <= std::min(height - 1, y + radius); v++)
+                for(int u = std::max(0, x - radius); u <= std::min(width - 1, x + radius); u++){
+                    const size_t neighbour = static_cast<size_t>(v) * width + u;
+                    if(depth[neighbour] == 0)
+                        continue;
+                    float weight = mv_SpatialWeights[u - x + radius] * mv_SpatialWeights[v - y + radius] *
+                            mf_RangeWeight(depth[neighbour] - center, inverseSigma);
+                    if(guide)
+                        weight *= mv_ColorWeights[std::abs(guide[neighbour] - guide[index])];
+                    sum += weight * depth[neighbour];
+                    weights += weight;
+                }
+            filtered[index] = static_cast<uint16_t>(sum / weights + 0.5f);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef TDK_DEPTHBILATERALFILTER_H
+#define TDK_DEPTHBILATERALFILTER_H
+
+#include <cstdint>
+#include <vector>
+
+/*!
+ * \brief The TDK_DepthBilateralFilter class
+ *
+ * Edge preserving smoothing of an organized depth frame in millimeters, run on the 512x424 frame
+ * of the Kinect V2 before its points are generated. A neighbour is weighted by its distance in
+ * pixels, by its depth difference relative to the depth of the pixel and, with a guide image, by
+ * its difference in luminance. Neighbours further than three depth sigmas get no weight, the
+ * depths of a foreground and the background behind it are never averaged into flying pixels.
+ * Pixels without depth stay without depth and are never used as neighbours.
+ *
+ * The separable filter runs a horizontal and a vertical pass with 2 * radius + 1 taps each instead
+ * of the (2 * radius + 1)^2 taps of the full kernel, a few milliseconds per frame. The full kernel
+ * is kept as reference.
+ *
+ * Use example
+ * TDK_DepthBilateralFilter filter;
+ * filter.mf_SetDepthSigma(0.01);
+ * filter.mf_Filter(&depth[0], &smoothed[0], 512, 424, &luminance[0]);
+ */
+class TDK_DepthBilateralFilter
+{
+public:
+    TDK_DepthBilateralFilter();
+    ~TDK_DepthBilateralFilter();
+
+    //Pixels, the kernel radius is twice the sigma
+    void    mf_SetSpatialSigma              (const float sigma);
+    //Part of the depth of a pixel, the noise of time of flight depth grows with the depth
+    void    mf_SetDepthSigma                (const float sigma);
+    //Luminance levels of the guide image
+    void    mf_SetColorSigma                (const float sigma);
+    void    mf_SetSeparable                 (const bool separable)     {   mv_Separable = separable;   }
+
+    float   mf_GetSpatialSigma              () const    {   return mv_SpatialSigma; }
+    float   mf_GetDepthSigma                () const    {   return mv_DepthSigma;   }
+    float   mf_GetColorSigma                () const    {   return mv_ColorSigma;   }
+    int     mf_GetRadius                    () const    {   return mv_Radius;       }
+    bool    mf_IsSeparable                  () const    {   return mv_Separable;    }
+
+    //filtered may not be depth, guide is a luminance per depth pixel or nullptr
+    void    mf_Filter                       (const uint16_t *depth, uint16_t *filtered, const int width, const int height,
+                                             const uint8_t *guide = nullptr);
+
+private:
+    float               mv_SpatialSigma;
+    float               mv_DepthSigma;
+    float               mv_ColorSigma;
+    int                 mv_Radius;
+    bool                mv_Separable;
+
+    std::vector<float>  mv_SpatialWeights;  //per offset, -radius to radius
+    std::vector<float>  mv_RangeWeights;    //per depth difference in sigmas, cut at three sigmas
+    std::vector<float>  mv_ColorWeights;    //per luminance difference
+    std::vector<float>  mv_Horizontal;      //result of the horizontal pass
+
+    void    mf_Horizontal                   (const uint16_t *depth, const int width, const int height, const uint8_t *guide);
+    void    mf_Vertical                     (uint16_t *filtered, const int width, const int height, const uint8_t *guide) const;
+    void    mf_Full                         (const uint16_t *depth, uint16_t *filtered, const int width, const int height,
+                                             const uint8_t *guide) const;
+    inline float    mf_RangeWeight          (const float difference, const float inverseSigma) const;
+};
+
+#endif // TDK_DEPTHBILATERALFILTER_H
@@ -0,0 +1,398 @@
+#include "tdk_filterpipeline.h"
+#include "tdk_filters.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+const char *stageNames[] = { "Transform", "CropBox", "OutlierRemoval", "RadiusOutlierRemoval", "VoxelGrid", "MLSSmoothing" };
+const int NumberOfStageTypes = sizeof(stageNames) / sizeof(stageNames[0]);
+
+//Clouds from this size on are run through fused stages by all threads
+const int ParallelFusedPoints = 1 << 18;
+
+inline bool isPointWise(const TDK_FilterPipeline::Stage &stage)
+{
+    return stage.type == TDK_FilterPipeline::Stage::Transform || stage.type == TDK_FilterPipeline::Stage::CropBox;
+}
+
+inline int defaultOutlierMeanK(const pcl::PointXYZ &)      {   return 50;  }
+inline int defaultOutlierMeanK(const pcl::PointXYZRGB &)   {   return 8;   }
+
+//MLS gives no colors, colored clouds keep their points
+inline bool smoothMLS(const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud, pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud_smoothed, const float radius)
+{
+    TDK_Filters::mf_FilterMLSSmoothing(cloud, cloud_smoothed, radius);
+    return true;
+}
+
+inline bool smoothMLS(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &, pcl::PointCloud<pcl::PointXYZRGB>::Ptr &, const float)
+{
+    return false;
+}
+
+/*
+ * Stages first to last of a group of transforms and crop boxes in one pass. Every range of points
+ * keeps its points at its own start in the output, the ranges are moved together afterwards.
+ */
+template<typename PointT>
+void runFused(const pcl::PointCloud<PointT> &input, pcl::PointCloud<PointT> &output,
+              const std::vector<TDK_FilterPipeline::Stage> &stages, const size_t first, const size_t last)
+{
+    const int numberOfPoints = static_cast<int>(input.size());
+
+    int numberOfRanges = 1;
+#ifdef _OPENMP
+    if(numberOfPoints >= ParallelFusedPoints)
+        numberOfRanges = omp_get_max_threads();
+#endif
+    const int rangeSize = (numberOfPoints + numberOfRanges - 1) / numberOfRanges;
+    std::vector<int> kept(numberOfRanges, 0);
+
+    output.header = input.header;
+    output.sensor_origin_ = input.sensor_origin_;
+    output.sensor_orientation_ = input.sensor_orientation_;
+    output.points.resize(numberOfPoints);
+
+#pragma omp parallel for num_threads(numberOfRanges)
+    for(int r = 0; r < numberOfRanges; r++){
+        const int end = std::min(numberOfPoints, (r + 1) * rangeSize);
+        int next = r * rangeSize;
+        for(int i = r * rangeSize; i < end; i++){
+            float x = input.points[i].x, y = input.points[i].y, z = input.points[i].z;
+            bool inside = true;
+            for(size_t s = first; inside && s < last; s++){
+                const TDK_FilterPipeline::Stage &stage = stages[s];
+                if(stage.type == TDK_FilterPipeline::Stage::Transform){
+                    const float *m = stage.transform;
+                    const float tx = m[0] * x + m[1] * y + m[2] * z + m[3];
+                    const float ty = m[4] * x + m[5] * y + m[6] * z + m[7];
+                    const float tz = m[8] * x + m[9] * y + m[10] * z + m[11];
+                    x = tx; y = ty; z = tz;
+                }
+                else
+                    //NaN coordinates fail every comparison
+                    inside = x >= stage.bounds[0] && x <= stage.bounds[1] &&
+                             y >= stage.bounds[2] && y <= stage.bounds[3] &&
+                             z >= stage.bounds[4] && z <= stage.bounds[5];
+            }
+            if(inside){
+                PointT &point = output.points[next++];
+                point = input.points[i];
+                point.x = x;
+                point.y = y;
+                point.z = z;
+            }
+        }
+        kept[r] = next - r * rangeSize;
+    }
+
+    int size = kept[0];
+    for(int r = 1; r < numberOfRanges; r++){
+        std::copy(output.points.begin() + r * rangeSize, output.points.begin() + r * rangeSize + kept[r], output.points.begin() + size);
+        size += kept[r];
+    }
+    output.points.resize(size);
+    output.width = static_cast<uint32_t>(size);
+    output.height = 1;
+    output.is_dense = input.is_dense;
+}
+}
+
+TDK_FilterPipeline::TDK_FilterPipeline()
+{
+    for(int b = 0; b < 2; b++){
+        mv_BuffersXYZ[b].reset(new pcl::PointCloud<pcl::PointXYZ>);
+        mv_BuffersXYZRGB[b].reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+    }
+}
+
+TDK_FilterPipeline::~TDK_FilterPipeline()
+{
+
+}
+
+QStringList TDK_FilterPipeline::mf_AvailableStages()
+{
+    QStringList stages;
+    for(int i = 0; i < NumberOfStageTypes; i++)
+        stages << stageNames[i];
+    return stages;
+}
+
+/*!
+ * \brief TDK_FilterPipeline::mf_LoadConfig
+ * \param fileName JSON file with a "stages" array
+ * \return false when the file cannot be read or a stage is unknown, the stages are unchanged then
+ */
+bool TDK_FilterPipeline::mf_LoadConfig(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        qWarning() << "FilterPipeline: Could not read" << fileName;
+        return false;
+    }
+
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+    if(!document.isObject()){
+        qWarning() << "FilterPipeline: Invalid configuration" << fileName;
+        return false;
+    }
+    return mf_SetStages(document.object().value("stages").toArray());
+}
+
+/*!
+ * \brief TDK_FilterPipeline::mf_SetStages
+ * \param stages stage objects with a "type" and the parameters of the stage, missing parameters
+ * take the defaults of the mf_Add functions
+ * \return false when a stage is unknown, the stages are unchanged then
+ */
+bool TDK_FilterPipeline::mf_SetStages(const QJsonArray &stages)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    std::vector<Stage> previous;
+    previous.swap(mv_Stages);
+
+    for(int i = 0; i < stages.size(); i++){
+        const QJsonObject stage = stages[i].toObject();
+        const QString type = stage.value("type").toString();
+
+        if(type == "Transform"){
+            const QJsonArray matrix = stage.value("matrix").toArray();
+            if(matrix.size() != 16){
+                qWarning() << "FilterPipeline: Transform needs a row major matrix of 16 values";
+                mv_Stages.swap(previous);
+                return false;
+            }
+            Eigen::Matrix4f transform;
+            for(int k = 0; k < 16; k++)
+                transform(k / 4, k % 4) = matrix[k].toDouble();
+            mf_AddTransform(transform);
+        }
+        else if(type == "CropBox")
+            mf_AddCropBox(stage.value("x1").toDouble(-infinity), stage.value("x2").toDouble(infinity),
+                          stage.value("y1").toDouble(-infinity), stage.value("y2").toDouble(infinity),
+                          stage.value("z1").toDouble(-infinity), stage.value("z2").toDouble(infinity));
+        else if(type == "OutlierRemoval")
+            mf_AddOutlierRemoval(stage.value("threshold").toDouble(2.5), stage.value("maxDecisionError").toDouble(-1.0),
+                                 stage.value("meanK").toInt(0));
+        else if(type == "RadiusOutlierRemoval")
+            mf_AddRadiusOutlierRemoval(stage.value("radius").toDouble(), stage.value("minNeighbors").toInt(5),
+                                       stage.value("exact").toBool(true));
+        else if(type == "VoxelGrid")
+            mf_AddVoxelGrid(stage.value("leafSize").toDouble(), stage.value("nearestToCentroid").toBool(false));
+        else if(type == "MLSSmoothing")
+            mf_AddMLSSmoothing(stage.value("radius").toDouble(0.07));
+        else{
+            qWarning() << "FilterPipeline: Unknown stage" << type;
+            mv_Stages.swap(previous);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void TDK_FilterPipeline::mf_AddTransform(const Eigen::Matrix4f &transform)
+{
+    Stage stage;
+    stage.type = Stage::Transform;
+    for(int k = 0; k < 16; k++)
+        stage.transform[k] = transform(k / 4, k % 4);
+    mv_Stages.push_back(stage);
+}
+
+/*!
+ * \brief TDK_FilterPipeline::mf_AddCropBox
+ * \param x1 x2 y1 y2 z1 z2 inclusive limits, the points of TDK_Filters::mf_FilterCropBox are kept
+ */
+void TDK_FilterPipeline::mf_AddCropBox(double x1, double x2, double y1, double y2, double z1, double z2)
+{
+    Stage stage;
+    stage.type = Stage::CropBox;
+    //Rounded to the nearest float as TDK_Filters::mf_FilterCropBox does
+    stage.bounds[0] = static_cast<float>(x1); stage.bounds[1] = static_cast<float>(x2);
+    stage.bounds[2] = static_cast<float>(y1); stage.bounds[3] = static_cast<float>(y2);
+    stage.bounds[4] = static_cast<float>(z1); stage.bounds[5] = static_cast<float>(z2);
+    mv_Stages.push_back(stage);
+}
+
+/*!
+ * \brief TDK_FilterPipeline::mf_AddOutlierRemoval
+ * \param threshold standard deviation multiplier
+ * \param maxDecisionError runs TDK_Filters::mf_FilterApproximateStatisticalOutlierRemoval with
+ * this error when >= 0, TDK_Filters::mf_FilterStatisticalOutlierRemoval otherwise
+ * \param meanK neighbours of the approximate filter, 0 for its default
+ */
+void TDK_FilterPipeline::mf_AddOutlierRemoval(float threshold, float maxDecisionError, int meanK)
+{
+    Stage stage;
+    stage.type = Stage::OutlierRemoval;
+    stage.threshold = threshold;
+    stage.maxDecisionError = maxDecisionError;
+    stage.meanK = meanK;
+    mv_Stages.push_back(stage);
+}
+
+/*!
+ * \brief TDK_FilterPipeline::mf_AddRadiusOutlierRemoval
+ * \param radius points need minNeighbors other points within it
+ * \param exact false decides from the occupancy of the cells around a point, see
+ * TDK_Filters::mf_FilterRadiusOutlierRemoval
+ */
+void TDK_FilterPipeline::mf_AddRadiusOutlierRemoval(float radius, int minNeighbors, bool exact)
+{
+    Stage stage;
+    stage.type = Stage::RadiusOutlierRemoval;
+    stage.radius = radius;
+    stage.minNeighbors = minNeighbors;
+    stage.exact = exact;
+    mv_Stages.push_back(stage);
+}
+
+void TDK_FilterPipeline::mf_AddVoxelGrid(float leafSize, bool nearestToCentroid)
+{
+    Stage stage;
+    stage.type = Stage::VoxelGrid;
+    stage.leafSize = leafSize;
+    stage.nearestToCentroid = nearestToCentroid;
+    mv_Stages.push_back(stage);
+}
+
+void TDK_FilterPipeline::mf_AddMLSSmoothing(float radius)
+{
+    Stage stage;
+    stage.type = Stage::MLSSmoothing;
+    stage.radius = radius;
+    mv_Stages.push_back(stage);
+}
+
+bool TDK_FilterPipeline::mf_Process(const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud, pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud_filtered)
+{
+    return mf_Run<pcl::PointXYZ>(cloud, cloud_filtered, mv_BuffersXYZ);
+}
+
+bool TDK_FilterPipeline::mf_Process(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud, pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_filtered)
+{
+    return mf_Run<pcl::PointXYZRGB>(cloud, cloud_filtered, mv_BuffersXYZRGB);
+}
+
+/*!
+ * \brief TDK_FilterPipeline::mf_Run
+ * \param cloud input, never written
+ * \param cloud_filtered output, created when null
+ * \param buffers ping-pong buffers of the point type, every stage writes to the one it does not read
+ * \return false when a stage was skipped
+ */
+template<typename PointT>
+bool TDK_FilterPipeline::mf_Run(const typename pcl::PointCloud<PointT>::Ptr &cloud,
+                                typename pcl::PointCloud<PointT>::Ptr &cloud_filtered,
+                                typename pcl::PointCloud<PointT>::Ptr buffers[2])
+{
+    QElapsedTimer total;
+    total.start();
+
+    bool success = true;
+    const int inputSize = static_cast<int>(cloud->size());
+    typename pcl::PointCloud<PointT>::Ptr current = cloud;
+    int next = 0;
+    QJsonArray stageReports;
+
+    for(size_t first = 0; first < mv_Stages.size(); ){
+        size_t last = first + 1;
+        if(isPointWise(mv_Stages[first]))
+            while(last < mv_Stages.size() && isPointWise(mv_Stages[last]))
+                last++;
+
+        QString name = stageNames[mv_Stages[first].type];
+        for(size_t s = first + 1; s < last; s++)
+            name += QString("+") + stageNames[mv_Stages[s].type];
+
+        QElapsedTimer timer;
+        timer.start();
+        const int inputPoints = static_cast<int>(current->size());
+        typename pcl::PointCloud<PointT>::Ptr &target = buffers[next];
+        const Stage &stage = mv_Stages[first];
+        bool skipped = false;
+        TDK_Filters::ApproximateOutlierStats outlierStats;
+        double decisionError = -1.0;
+
+        bool onlyCropBoxes = isPointWise(stage);
+        for(size_t s = first; s < last; s++)
+            onlyCropBoxes = onlyCropBoxes && mv_Stages[s].type == Stage::CropBox;
+
+        if(onlyCropBoxes){
+            //Boxes in the same frame are one box
+            float bounds[6] = { -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+                                -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+                                -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() };
+            for(size_t s = first; s < last; s++)
+                for(int a = 0; a < 3; a++){
+                    bounds[2 * a] = std::max(bounds[2 * a], mv_Stages[s].bounds[2 * a]);
+                    bounds[2 * a + 1] = std::min(bounds[2 * a + 1], mv_Stages[s].bounds[2 * a + 1]);
+                }
+            TDK_Filters::mf_FilterCropBox(current, target, bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+        }
+        else if(isPointWise(stage))
+            runFused(*current, *target, mv_Stages, first, last);
+        else if(stage.type == Stage::OutlierRemoval){
+            if(stage.maxDecisionError >= 0.0){
+                TDK_Filters::mf_FilterApproximateStatisticalOutlierRemoval(current, target,
+                                                                           stage.meanK > 0 ? stage.meanK : defaultOutlierMeanK(PointT()),
+                                                                           stage.threshold, stage.maxDecisionError, &outlierStats);
+                decisionError = outlierStats.decisionError;
+            }
+            else
+                TDK_Filters::mf_FilterStatisticalOutlierRemoval(current, target, stage.threshold);
+        }
+        else if(stage.type == Stage::RadiusOutlierRemoval)
+            TDK_Filters::mf_FilterRadiusOutlierRemoval(current, target, stage.radius, stage.minNeighbors, stage.exact);
+        else if(stage.type == Stage::VoxelGrid)
+            TDK_Filters::mf_FilterVoxelGridDownsample(current, target, stage.leafSize, stage.nearestToCentroid);
+        else if(stage.type == Stage::MLSSmoothing && !smoothMLS(current, target, stage.radius)){
+            qWarning() << "FilterPipeline: MLS smoothing runs on PointXYZ clouds only, stage skipped";
+            skipped = true;
+            success = false;
+        }
+
+        if(!skipped){
+            current = target;
+            next = 1 - next;
+        }
+
+        QJsonObject report;
+        report["stage"] = name;
+        report["ms"] = timer.nsecsElapsed() / 1e6;
+        report["inputPoints"] = inputPoints;
+        report["outputPoints"] = static_cast<int>(current->size());
+        if(decisionError >= 0.0)
+            report["decisionError"] = decisionError;
+        if(skipped)
+            report["skipped"] = true;
+        stageReports.append(report);
+
+        first = last;
+    }
+
+    if(!cloud_filtered)
+        cloud_filtered.reset(new pcl::PointCloud<PointT>);
+    if(current != cloud_filtered)
+        *cloud_filtered = *current;
+
+    mv_Report = QJsonObject();
+    mv_Report["stages"] = stageReports;
+    mv_Report["inputPoints"] = inputSize;
+    mv_Report["outputPoints"] = static_cast<int>(cloud_filtered->size());
+    mv_Report["totalMs"] = total.nsecsElapsed() / 1e6;
+    return success;
+}
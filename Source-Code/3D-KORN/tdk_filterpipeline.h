@@ -0,0 +1,110 @@
+#ifndef TDK_FILTERPIPELINE_H
+#define TDK_FILTERPIPELINE_H
+
+#include <Eigen/Core>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <vector>
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+/*!
+ * \brief The TDK_FilterPipeline class
+ *
+ * Ordered chain of TDK_Filters stages run on one cloud. The stages read from and write to two
+ * buffers owned by the pipeline in turn, so running the pipeline again on clouds of a similar
+ * size allocates nothing.
+ *
+ * Adjacent point-wise stages, transforms and crop boxes, are fused into one pass over the
+ * points. Every point is transformed and tested against all boxes of the group at once, the
+ * kept points are written once. Outlier removals, voxel grid and MLS smoothing run as they are.
+ *
+ * The stages come from code or from the "stages" array of a JSON configuration:
+ * { "stages": [ { "type": "CropBox", "x1": -0.4, "x2": 0.4, "y1": -0.85, "y2": 1.2, "z1": 0.1, "z2": 2.0 },
+ *               { "type": "OutlierRemoval", "threshold": 2.5, "maxDecisionError": 0.01 },
+ *               { "type": "RadiusOutlierRemoval", "radius": 0.01, "minNeighbors": 5 },
+ *               { "type": "VoxelGrid", "leafSize": 0.002 },
+ *               { "type": "MLSSmoothing", "radius": 0.07 } ] }
+ *
+ * MLS smoothing gives positions without colors, it only runs on PointXYZ clouds and is
+ * skipped with a warning on colored clouds.
+ *
+ * Use example
+ * TDK_FilterPipeline pipeline;
+ * pipeline.mf_AddOutlierRemoval(5.0);
+ * pipeline.mf_AddMLSSmoothing(0.07);
+ * pipeline.mf_Process(cloud, smoothed);
+ * QJsonObject report = pipeline.mf_GetReport();
+ */
+class TDK_FilterPipeline
+{
+public:
+    struct Stage
+    {
+        enum Type
+        {
+            Transform,
+            CropBox,
+            OutlierRemoval,
+            RadiusOutlierRemoval,
+            VoxelGrid,
+            MLSSmoothing
+        };
+
+        Type    type = CropBox;
+        float   transform[16];              //row major, Transform
+        float   bounds[6];                  //x1, x2, y1, y2, z1, z2 of CropBox
+        float   threshold = 2.5;            //OutlierRemoval
+        float   maxDecisionError = -1.0;    //approximate OutlierRemoval when >= 0, exact otherwise
+        int     meanK = 0;                  //neighbours of the approximate OutlierRemoval, 0 for its default
+        float   leafSize = 0.0;             //VoxelGrid
+        bool    nearestToCentroid = false;  //VoxelGrid
+        float   radius = 0.0;               //MLSSmoothing, RadiusOutlierRemoval
+        int     minNeighbors = 5;           //RadiusOutlierRemoval
+        bool    exact = true;               //RadiusOutlierRemoval
+    };
+
+    TDK_FilterPipeline();
+    ~TDK_FilterPipeline();
+
+    static QStringList  mf_AvailableStages  ();
+
+    bool    mf_LoadConfig                   (const QString &fileName);
+    bool    mf_SetStages                    (const QJsonArray &stages);
+
+    void    mf_AddTransform                 (const Eigen::Matrix4f &transform);
+    void    mf_AddCropBox                   (double x1, double x2, double y1, double y2, double z1, double z2);
+    void    mf_AddOutlierRemoval            (float threshold = 2.5, float maxDecisionError = -1.0, int meanK = 0);
+    void    mf_AddRadiusOutlierRemoval      (float radius, int minNeighbors = 5, bool exact = true);
+    void    mf_AddVoxelGrid                 (float leafSize, bool nearestToCentroid = false);
+    void    mf_AddMLSSmoothing              (float radius);
+    void    mf_Clear                        ()          {   mv_Stages.clear();  }
+
+    const std::vector<Stage>&   mf_GetStages    () const    {   return mv_Stages;   }
+
+    //cloud_filtered may be cloud itself
+    bool    mf_Process                      (const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud,
+                                             pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud_filtered);
+    bool    mf_Process                      (const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud,
+                                             pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_filtered);
+
+    //Time and points of every stage of the last run, fused stages share one entry. Approximate
+    //outlier removal stages add their decisionError
+    QJsonObject mf_GetReport                () const    {   return mv_Report;   }
+
+private:
+    std::vector<Stage>                      mv_Stages;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr     mv_BuffersXYZ[2];
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr  mv_BuffersXYZRGB[2];
+    QJsonObject                             mv_Report;
+
+    template<typename PointT>
+    bool    mf_Run                          (const typename pcl::PointCloud<PointT>::Ptr &cloud,
+                                             typename pcl::PointCloud<PointT>::Ptr &cloud_filtered,
+                                             typename pcl::PointCloud<PointT>::Ptr buffers[2]);
+};
+
+#endif // TDK_FILTERPIPELINE_H
@@ -1,8 +1,909 @@
 
 #include "tdk_filters.h"
 
+#include <pcl/common/common.h>
+#include <pcl/common/io.h>
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//Crop box test in one SSE comparison per point on x86, MSVC targets x64 or /arch:SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TDK_CROPBOX_SSE
+#include <xmmintrin.h>
+#endif
+
 using namespace pcl;
 
+namespace
+{
+//Voxel grid with the points of every occupied cell stored contiguously, cells are found by a
+//hash of their 64 bit key. Built in O(n).
+struct OccupancyGrid
+{
+    float cellSize;
+    std::unordered_map<uint64_t, int> cells;
+    std::vector<int> cellStart;             //first entry of every cell in points, one extra entry at the end
+    std::vector<int> points;                //point indices ordered by cell
+    std::vector<int> cellOfPoint;           //-1 for points that are not finite
+    std::vector<Eigen::Vector3i> cellCoordinates;
+};
+
+const int GridCoordinateBits = 21;
+const int GridCoordinateOffset = 1 << (GridCoordinateBits - 1);
+
+inline bool gridKey(const Eigen::Vector3i &cell, uint64_t &key)
+{
+    const uint64_t mask = (uint64_t(1) << GridCoordinateBits) - 1;
+    for(int i = 0; i < 3; i++)
+        if(cell[i] < -GridCoordinateOffset || cell[i] >= GridCoordinateOffset)
+            return false;
+    key = (uint64_t(cell[0] + GridCoordinateOffset) & mask) << (2 * GridCoordinateBits) |
+          (uint64_t(cell[1] + GridCoordinateOffset) & mask) << GridCoordinateBits |
+          (uint64_t(cell[2] + GridCoordinateOffset) & mask);
+    return true;
+}
+
+template<typename PointT>
+inline Eigen::Vector3i gridCell(const PointT &point, const float cellSize)
+{
+    return Eigen::Vector3i(static_cast<int>(std::floor(point.x / cellSize)),
+                           static_cast<int>(std::floor(point.y / cellSize)),
+                           static_cast<int>(std::floor(point.z / cellSize)));
+}
+
+//Cell size at which occupied cells hold about targetPointsPerCell points. Scans are surfaces,
+//the points per cell grow with the square of the cell size.
+template<typename PointT>
+float chooseCellSize(const pcl::PointCloud<PointT> &cloud, const int targetPointsPerCell)
+{
+    Eigen::Vector4f minPoint, maxPoint;
+    pcl::getMinMax3D(cloud, minPoint, maxPoint);
+    const float extent = std::max((maxPoint - minPoint).head<3>().maxCoeff(), 1e-6f);
+    const float minimumCellSize = extent / (1 << (GridCoordinateBits - 2));
+
+    float cellSize = extent / 100;
+    std::unordered_set<uint64_t> occupied;
+    for(int iteration = 0; iteration < 3; iteration++){
+        occupied.clear();
+        occupied.reserve(cloud.size() / std::max(1, targetPointsPerCell) + 1);
+        int finitePoints = 0;
+        for(size_t i = 0; i < cloud.size(); i++){
+            uint64_t key;
+            if(pcl::isFinite(cloud.points[i]) && gridKey(gridCell(cloud.points[i], cellSize), key)){
+                occupied.insert(key);
+                finitePoints++;
+            }
+        }
+        if(occupied.empty())
+            break;
+
+        const float pointsPerCell = static_cast<float>(finitePoints) / occupied.size();
+        const float factor = std::min(4.0f, std::max(0.25f, std::sqrt(targetPointsPerCell / pointsPerCell)));
+        cellSize = std::max(minimumCellSize, cellSize * factor);
+        if(std::abs(factor - 1.0f) < 0.1f)
+            break;
+    }
+    return cellSize;
+}
+
+template<typename PointT>
+void buildOccupancyGrid(const pcl::PointCloud<PointT> &cloud, const float cellSize, OccupancyGrid &grid)
+{
+    const int numberOfPoints = static_cast<int>(cloud.size());
+    grid.cellSize = cellSize;
+    grid.cells.clear();
+    grid.cells.reserve(numberOfPoints / 8 + 1);
+    grid.cellOfPoint.assign(numberOfPoints, -1);
+    grid.cellCoordinates.clear();
+
+    std::vector<int> cellSizes;
+    for(int i = 0; i < numberOfPoints; i++){
+        if(!pcl::isFinite(cloud.points[i]))
+            continue;
+        const Eigen::Vector3i cell = gridCell(cloud.points[i], cellSize);
+        uint64_t key;
+        if(!gridKey(cell, key))
+            continue;
+
+        std::unordered_map<uint64_t, int>::iterator it = grid.cells.find(key);
+        if(it == grid.cells.end()){
+            it = grid.cells.insert(std::make_pair(key, static_cast<int>(cellSizes.size()))).first;
+            cellSizes.push_back(0);
+            grid.cellCoordinates.push_back(cell);
+        }
+        grid.cellOfPoint[i] = it->second;
+        cellSizes[it->second]++;
+    }
+
+    //Counting sort of the points by cell
+    grid.cellStart.assign(cellSizes.size() + 1, 0);
+    for(size_t c = 0; c < cellSizes.size(); c++)
+        grid.cellStart[c + 1] = grid.cellStart[c] + cellSizes[c];
+    std::vector<int> fill(grid.cellStart.begin(), grid.cellStart.end() - 1);
+    grid.points.resize(grid.cellStart.back());
+    for(int i = 0; i < numberOfPoints; i++)
+        if(grid.cellOfPoint[i] >= 0)
+            grid.points[fill[grid.cellOfPoint[i]]++] = i;
+}
+
+inline int findCell(const OccupancyGrid &grid, const Eigen::Vector3i &cell)
+{
+    uint64_t key;
+    if(!gridKey(cell, key))
+        return -1;
+    std::unordered_map<uint64_t, int>::const_iterator it = grid.cells.find(key);
+    return it == grid.cells.end() ? -1 : it->second;
+}
+
+//Keeps the k smallest squared distances in a max-heap
+inline void keepNearest(std::vector<float> &heap, const int k, const float squaredDistance)
+{
+    if(static_cast<int>(heap.size()) < k){
+        heap.push_back(squaredDistance);
+        std::push_heap(heap.begin(), heap.end());
+    }
+    else if(squaredDistance < heap.front()){
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = squaredDistance;
+        std::push_heap(heap.begin(), heap.end());
+    }
+}
+
+//Mean distance to the k nearest neighbours of a point, as computed by pcl::StatisticalOutlierRemoval.
+//Cells are searched in rings around the cell of the point until the k-th neighbour is closer than
+//the searched block. Isolated points whose rings would hold more cells than the grid fall back to
+//all points.
+template<typename PointT>
+float exactMeanKnnDistance(const pcl::PointCloud<PointT> &cloud, const OccupancyGrid &grid,
+                           const int index, const int k)
+{
+    const PointT &point = cloud.points[index];
+    const Eigen::Vector3i center = grid.cellCoordinates[grid.cellOfPoint[index]];
+    const int numberOfCells = static_cast<int>(grid.cellCoordinates.size());
+    std::vector<float> heap;                //max-heap of the k smallest squared distances
+    heap.reserve(k + 1);
+
+    for(int ring = 0; ; ring++){
+        const double ringCells = std::pow(2.0 * ring + 1.0, 3) - std::pow(2.0 * ring - 1.0, 3);
+        if(ring > 1 && ringCells > numberOfCells){
+            heap.clear();
+            for(size_t j = 0; j < grid.points.size(); j++)
+                if(grid.points[j] != index)
+                    keepNearest(heap, k, (cloud.points[grid.points[j]].getVector3fMap() - point.getVector3fMap()).squaredNorm());
+            break;
+        }
+
+        for(int dx = -ring; dx <= ring; dx++)
+            for(int dy = -ring; dy <= ring; dy++)
+                for(int dz = -ring; dz <= ring; dz++){
+                    if(std::max(std::abs(dx), std::max(std::abs(dy), std::abs(dz))) != ring)
+                        continue;
+                    const int cell = findCell(grid, center + Eigen::Vector3i(dx, dy, dz));
+                    if(cell < 0)
+                        continue;
+                    for(int j = grid.cellStart[cell]; j < grid.cellStart[cell + 1]; j++)
+                        if(grid.points[j] != index)
+                            keepNearest(heap, k, (cloud.points[grid.points[j]].getVector3fMap() - point.getVector3fMap()).squaredNorm());
+                }
+
+        //Everything closer than ring cells has been seen
+        const float searched = ring * grid.cellSize;
+        if(ring > 0 && static_cast<int>(heap.size()) == k && heap.front() <= searched * searched)
+            break;
+    }
+
+    double sum = 0.0;
+    for(size_t j = 0; j < heap.size(); j++)
+        sum += std::sqrt(heap[j]);
+    return heap.empty() ? 0.0f : static_cast<float>(sum / heap.size());
+}
+
+//Mean and standard deviation as in pcl::StatisticalOutlierRemoval
+void distanceStatistics(const std::vector<float> &distances, double &mean, double &stddev)
+{
+    double sum = 0.0, squaredSum = 0.0;
+    for(size_t i = 0; i < distances.size(); i++){
+        sum += distances[i];
+        squaredSum += distances[i] * distances[i];
+    }
+    const double valid = static_cast<double>(distances.size());
+    mean = valid > 0 ? sum / valid : 0.0;
+    stddev = valid > 1 ? std::sqrt(std::max(0.0, (squaredSum - sum * sum / valid) / (valid - 1))) : 0.0;
+}
+
+/*
+ * Approximate statistical outlier removal.
+ * The threshold of the exact filter, mean plus a multiple of the standard deviation of the mean
+ * kNN distances, is estimated from a sample of points whose exact distance is computed on the grid.
+ * The distance of every other point is estimated from the number of points in the 27 cells around
+ * its cell, on a surface it falls with the square root of that count, with the constant fitted on
+ * the sample. The sample also shows how close to the threshold the estimate still decides wrongly:
+ * points within the band that leaves at most maxDecisionError of the sample wrongly decided get
+ * their exact distance. The reported error is measured on a second, held-out sample.
+ */
+template<typename PointT>
+void approximateStatisticalOutlierRemoval(const pcl::PointCloud<PointT> &cloud, pcl::PointCloud<PointT> &output,
+                                          const int meanK, const float threshold, const float maxDecisionError,
+                                          TDK_Filters::ApproximateOutlierStats &stats)
+{
+    const int numberOfPoints = static_cast<int>(cloud.size());
+    stats = TDK_Filters::ApproximateOutlierStats();
+    output.clear();
+    if(numberOfPoints <= meanK)
+        return;
+
+    //Most k-th neighbours then lie inside the 27 cells around a point
+    OccupancyGrid grid;
+    buildOccupancyGrid(cloud, chooseCellSize(cloud, meanK), grid);
+    stats.cellSize = grid.cellSize;
+
+    //Occupancy of the 27 cells around every cell, parallel over cells
+    const int numberOfCells = static_cast<int>(grid.cellCoordinates.size());
+    std::vector<float> cellEstimate(numberOfCells);
+#pragma omp parallel for schedule(dynamic, 256)
+    for(int c = 0; c < numberOfCells; c++){
+        int count = 0;
+        for(int dx = -1; dx <= 1; dx++)
+            for(int dy = -1; dy <= 1; dy++)
+                for(int dz = -1; dz <= 1; dz++){
+                    const int neighbour = findCell(grid, grid.cellCoordinates[c] + Eigen::Vector3i(dx, dy, dz));
+                    if(neighbour >= 0)
+                        count += grid.cellStart[neighbour + 1] - grid.cellStart[neighbour];
+                }
+        //The point itself is not its own neighbour
+        cellEstimate[c] = grid.cellSize / std::sqrt(std::max(1.0f, static_cast<float>(count - 1)));
+    }
+
+    //Two interleaved samples of one percent of the points spread over the cloud, at least 2000 each.
+    //The first sets the threshold and the band, the held-out one measures the decision error.
+    const int numberOfValid = static_cast<int>(grid.points.size());
+    const int sampleStride = std::max(1, numberOfValid / (2 * std::max(2000, numberOfValid / 100)));
+    std::vector<int> sample, heldOut;
+    for(int j = 0; j < numberOfValid; j += sampleStride)
+        ((j / sampleStride) % 2 == 0 ? sample : heldOut).push_back(grid.points[j]);
+    const int numberOfSamples = static_cast<int>(sample.size());
+    const int numberOfHeldOut = static_cast<int>(heldOut.size());
+    stats.sampled = numberOfSamples;
+    stats.heldOut = numberOfHeldOut;
+
+    std::vector<float> sampleExact(numberOfSamples), heldOutExact(numberOfHeldOut);
+#pragma omp parallel for schedule(dynamic, 16)
+    for(int j = 0; j < numberOfSamples + numberOfHeldOut; j++){
+        if(j < numberOfSamples)
+            sampleExact[j] = exactMeanKnnDistance(cloud, grid, sample[j], meanK);
+        else
+            heldOutExact[j - numberOfSamples] = exactMeanKnnDistance(cloud, grid, heldOut[j - numberOfSamples], meanK);
+    }
+
+    double mean, stddev;
+    distanceStatistics(sampleExact, mean, stddev);
+    const float distanceThreshold = static_cast<float>(mean + threshold * stddev);
+    stats.meanDistance = mean;
+    stats.stddev = stddev;
+
+    std::vector<float> ratios(numberOfSamples);
+    for(int j = 0; j < numberOfSamples; j++)
+        ratios[j] = sampleExact[j] / cellEstimate[grid.cellOfPoint[sample[j]]];
+    std::nth_element(ratios.begin(), ratios.begin() + numberOfSamples / 2, ratios.end());
+    const float scale = numberOfSamples > 0 ? ratios[numberOfSamples / 2] : 1.0f;
+
+    //Band around the threshold in which the estimate can still be on the wrong side
+    float band = -1.0f;
+    if(maxDecisionError >= 0.0f){
+        std::vector<float> gaps;
+        for(int j = 0; j < numberOfSamples; j++){
+            const float estimate = scale * cellEstimate[grid.cellOfPoint[sample[j]]];
+            if((estimate <= distanceThreshold) != (sampleExact[j] <= distanceThreshold))
+                gaps.push_back(std::abs(estimate - distanceThreshold));
+        }
+        std::sort(gaps.begin(), gaps.end());
+        const int tolerated = static_cast<int>(maxDecisionError * numberOfSamples);
+        band = static_cast<int>(gaps.size()) > tolerated ? gaps[gaps.size() - tolerated - 1] : -1.0f;
+    }
+
+    //Cells entirely out of the band are decided from the estimate, points of the others on their own
+    std::vector<char> keep(numberOfPoints, 0);
+    std::vector<int> refine;
+    for(int i = 0; i < numberOfPoints; i++){
+        if(grid.cellOfPoint[i] < 0)
+            continue;
+        const float estimate = scale * cellEstimate[grid.cellOfPoint[i]];
+        if(std::abs(estimate - distanceThreshold) <= band)
+            refine.push_back(i);
+        else
+            keep[i] = estimate <= distanceThreshold;
+    }
+    const int numberOfRefined = static_cast<int>(refine.size());
+    stats.refined = numberOfRefined;
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for(int r = 0; r < numberOfRefined; r++)
+        keep[refine[r]] = exactMeanKnnDistance(cloud, grid, refine[r], meanK) <= distanceThreshold;
+
+    //Error measured on the held-out sample, with the decision the filter takes for such a point,
+    //the sample that chose the band would understate it
+    int wrongDecisions = 0;
+    for(int j = 0; j < numberOfHeldOut; j++){
+        const float estimate = scale * cellEstimate[grid.cellOfPoint[heldOut[j]]];
+        const float used = std::abs(estimate - distanceThreshold) <= band ? heldOutExact[j] : estimate;
+        if((used <= distanceThreshold) != (heldOutExact[j] <= distanceThreshold))
+            wrongDecisions++;
+    }
+    stats.decisionError = numberOfHeldOut > 0 ? static_cast<double>(wrongDecisions) / numberOfHeldOut : 0.0;
+
+    output.header = cloud.header;
+    output.points.reserve(numberOfPoints);
+    for(int i = 0; i < numberOfPoints; i++)
+        if(keep[i])
+            output.points.push_back(cloud.points[i]);
+    output.width = static_cast<uint32_t>(output.points.size());
+    output.height = 1;
+    output.is_dense = true;
+    stats.removed = numberOfPoints - static_cast<int>(output.size());
+}
+
+/*
+ * Radius outlier removal on a voxel grid with cells of the radius, every neighbour within the
+ * radius of a point lies in the 27 cells around its cell. Cells are handled in parallel, the 27
+ * cells are looked up once per cell. When the 27 cells hold too few points every point of the cell
+ * is removed without a distance, otherwise the neighbours of each point are counted until
+ * minNeighbors are found. Not exact keeps every point of such a cell instead, it removes only
+ * points the exact filter removes too.
+ */
+template<typename PointT>
+void radiusOutlierRemoval(const pcl::PointCloud<PointT> &cloud, pcl::PointCloud<PointT> &output,
+                          const float radius, const int minNeighbors, const bool exact,
+                          TDK_Filters::RadiusOutlierStats &stats)
+{
+    const int numberOfPoints = static_cast<int>(cloud.size());
+    stats = TDK_Filters::RadiusOutlierStats();
+    output.clear();
+    if(numberOfPoints == 0 || !(radius > 0.0f))
+        return;
+
+    OccupancyGrid grid;
+    buildOccupancyGrid(cloud, radius, grid);
+
+    //Positions in the order of the grid, the points of a cell are read contiguously
+    const int numberOfGridPoints = static_cast<int>(grid.points.size());
+    std::vector<Eigen::Vector3f> positions(numberOfGridPoints);
+#pragma omp parallel for
+    for(int j = 0; j < numberOfGridPoints; j++)
+        positions[j] = cloud.points[grid.points[j]].getVector3fMap();
+
+    const int numberOfCells = static_cast<int>(grid.cellCoordinates.size());
+    const float squaredRadius = radius * radius;
+    std::vector<char> keep(numberOfPoints, 0);
+    int decidedByCells = 0;
+
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:decidedByCells)
+    for(int c = 0; c < numberOfCells; c++){
+        //The own cell first, it holds the nearest points
+        int neighbourCells[27];
+        int numberOfNeighbourCells = 1;
+        neighbourCells[0] = c;
+        int occupancy = grid.cellStart[c + 1] - grid.cellStart[c];
+        for(int dx = -1; dx <= 1; dx++)
+            for(int dy = -1; dy <= 1; dy++)
+                for(int dz = -1; dz <= 1; dz++){
+                    if(dx == 0 && dy == 0 && dz == 0)
+                        continue;
+                    const int cell = findCell(grid, grid.cellCoordinates[c] + Eigen::Vector3i(dx, dy, dz));
+                    if(cell < 0)
+                        continue;
+                    neighbourCells[numberOfNeighbourCells++] = cell;
+                    occupancy += grid.cellStart[cell + 1] - grid.cellStart[cell];
+                }
+
+        const int first = grid.cellStart[c], last = grid.cellStart[c + 1];
+        if(occupancy - 1 < minNeighbors || !exact){
+            for(int j = first; j < last; j++)
+                keep[grid.points[j]] = occupancy - 1 >= minNeighbors;
+            decidedByCells += last - first;
+            continue;
+        }
+
+        for(int j = first; j < last; j++){
+            const Eigen::Vector3f &point = positions[j];
+            int neighbours = 0;
+            for(int n = 0; n < numberOfNeighbourCells && neighbours < minNeighbors; n++){
+                const int end = grid.cellStart[neighbourCells[n] + 1];
+                //Strictly within the radius, as the FLANN radius search of pcl::RadiusOutlierRemoval
+                for(int k = grid.cellStart[neighbourCells[n]]; k < end && neighbours < minNeighbors; k++)
+                    if(k != j && (positions[k] - point).squaredNorm() < squaredRadius)
+                        neighbours++;
+            }
+            keep[grid.points[j]] = neighbours >= minNeighbors;
+        }
+    }
+
+    output.header = cloud.header;
+    output.points.reserve(numberOfPoints);
+    for(int i = 0; i < numberOfPoints; i++)
+        if(keep[i])
+            output.points.push_back(cloud.points[i]);
+    output.width = static_cast<uint32_t>(output.points.size());
+    output.height = 1;
+    output.is_dense = true;
+    stats.removed = numberOfPoints - static_cast<int>(output.size());
+    stats.decidedByCells = decidedByCells;
+}
+
+//Clouds from this size on are cropped by all threads
+const int ParallelCropBoxPoints = 1 << 18;
+
+//Bounds of an axis aligned box, the fourth lane accepts any value of the padding of the points
+struct CropBounds
+{
+#ifdef TDK_CROPBOX_SSE
+    __m128 minimum;
+    __m128 maximum;
+#else
+    float minimum[3];
+    float maximum[3];
+#endif
+
+    //Double limits are rounded to the nearest float, as pcl::PassThrough stores them
+    CropBounds(const double x1, const double x2, const double y1, const double y2, const double z1, const double z2)
+    {
+        const float lower[3] = { static_cast<float>(x1), static_cast<float>(y1), static_cast<float>(z1) };
+        const float upper[3] = { static_cast<float>(x2), static_cast<float>(y2), static_cast<float>(z2) };
+#ifdef TDK_CROPBOX_SSE
+        minimum = _mm_setr_ps(lower[0], lower[1], lower[2], -std::numeric_limits<float>::infinity());
+        maximum = _mm_setr_ps(upper[0], upper[1], upper[2], std::numeric_limits<float>::infinity());
+#else
+        std::copy(lower, lower + 3, minimum);
+        std::copy(upper, upper + 3, maximum);
+#endif
+    }
+
+    //Points with a NaN coordinate are outside, as in pcl::PassThrough
+    template<typename PointT>
+    inline bool mf_Contains(const PointT &point) const
+    {
+#ifdef TDK_CROPBOX_SSE
+        const __m128 coordinates = _mm_load_ps(point.data);
+        const __m128 inside = _mm_and_ps(_mm_cmpge_ps(coordinates, minimum), _mm_cmple_ps(coordinates, maximum));
+        return (_mm_movemask_ps(inside) & 0x7) == 0x7;
+#else
+        return point.x >= minimum[0] && point.x <= maximum[0] &&
+               point.y >= minimum[1] && point.y <= maximum[1] &&
+               point.z >= minimum[2] && point.z <= maximum[2];
+#endif
+    }
+};
+
+/*
+ * Keeps the points inside the box in their order, the same points three pcl::PassThrough passes keep.
+ * With output being the input the cloud is compacted in place. Large clouds are split in one range
+ * per thread, every range is counted first and then copied to its offset in the output.
+ */
+template<typename PointT>
+void cropBox(const pcl::PointCloud<PointT> &input, pcl::PointCloud<PointT> &output, const CropBounds &bounds)
+{
+    const int numberOfPoints = static_cast<int>(input.size());
+
+    if(&input == &output){
+        int kept = 0;
+        for(int i = 0; i < numberOfPoints; i++)
+            if(bounds.mf_Contains(output.points[i])){
+                if(kept != i)
+                    output.points[kept] = output.points[i];
+                kept++;
+            }
+        output.points.resize(kept);
+    }
+    else{
+        int numberOfRanges = 1;
+#ifdef _OPENMP
+        if(numberOfPoints >= ParallelCropBoxPoints)
+            numberOfRanges = omp_get_max_threads();
+#endif
+        const int rangeSize = (numberOfPoints + numberOfRanges - 1) / numberOfRanges;
+        std::vector<int> offsets(numberOfRanges + 1, 0);
+
+#pragma omp parallel for num_threads(numberOfRanges)
+        for(int r = 0; r < numberOfRanges; r++){
+            const int end = std::min(numberOfPoints, (r + 1) * rangeSize);
+            int kept = 0;
+            for(int i = r * rangeSize; i < end; i++)
+                kept += bounds.mf_Contains(input.points[i]);
+            offsets[r + 1] = kept;
+        }
+        for(int r = 0; r < numberOfRanges; r++)
+            offsets[r + 1] += offsets[r];
+
+        output.header = input.header;
+        output.sensor_origin_ = input.sensor_origin_;
+        output.sensor_orientation_ = input.sensor_orientation_;
+        output.points.resize(offsets[numberOfRanges]);
+
+#pragma omp parallel for num_threads(numberOfRanges)
+        for(int r = 0; r < numberOfRanges; r++){
+            const int end = std::min(numberOfPoints, (r + 1) * rangeSize);
+            int next = offsets[r];
+            for(int i = r * rangeSize; i < end; i++)
+                if(bounds.mf_Contains(input.points[i]))
+                    output.points[next++] = input.points[i];
+        }
+        output.is_dense = input.is_dense;
+    }
+
+    output.width = static_cast<uint32_t>(output.points.size());
+    output.height = 1;
+}
+
+//Clouds from this size on are downsampled by all threads
+const int ParallelVoxelGridPoints = 1 << 16;
+
+//Running sums of the points of a voxel, colors are only used for colored points
+struct VoxelCentroid
+{
+    double x, y, z;
+    float r, g, b;
+    int count;
+    int output;                             //index of the voxel in the output cloud
+};
+
+typedef std::unordered_map<uint64_t, VoxelCentroid> VoxelMap;
+
+inline void addColor(const pcl::PointXYZ &, VoxelCentroid &) {}
+inline void addColor(const pcl::PointXYZRGB &point, VoxelCentroid &voxel)
+{
+    voxel.r += point.r;
+    voxel.g += point.g;
+    voxel.b += point.b;
+}
+
+inline void setColor(pcl::PointXYZ &, const VoxelCentroid &) {}
+inline void setColor(pcl::PointXYZRGB &point, const VoxelCentroid &voxel)
+{
+    point.r = static_cast<uint8_t>(voxel.r / voxel.count);
+    point.g = static_cast<uint8_t>(voxel.g / voxel.count);
+    point.b = static_cast<uint8_t>(voxel.b / voxel.count);
+    point.a = 255;
+}
+
+//Voxel of a point as pcl::VoxelGrid computes it
+template<typename PointT>
+inline Eigen::Vector3i voxelCell(const PointT &point, const float inverseLeafSize)
+{
+    return Eigen::Vector3i(static_cast<int>(std::floor(point.x * inverseLeafSize)),
+                           static_cast<int>(std::floor(point.y * inverseLeafSize)),
+                           static_cast<int>(std::floor(point.z * inverseLeafSize)));
+}
+
+//Shard of a voxel key, the bits are mixed as neighboring keys differ in the lowest ones
+inline int voxelShard(const uint64_t key, const int numberOfShards)
+{
+    return static_cast<int>(((key * 0x9E3779B97F4A7C15ull) >> 32) % static_cast<uint64_t>(numberOfShards));
+}
+
+/*
+ * Voxel grid on a hash of the 64 bit voxel keys, so the extent of the cloud never overflows an index
+ * as the 32 bit voxel indices of pcl::VoxelGrid do. Every thread sums the points of its range into its
+ * own map, the partial maps are merged by shards of keys in parallel. The voxels are output in the
+ * order of their keys. With nearestToCentroid every voxel gives its input point closest to the
+ * centroid, the closest points are found in a second parallel pass.
+ */
+template<typename PointT>
+void voxelGridDownsample(const pcl::PointCloud<PointT> &input, pcl::PointCloud<PointT> &output,
+                         const float leafSize, const bool nearestToCentroid)
+{
+    if(&input == &output){
+        pcl::PointCloud<PointT> downsampled;
+        voxelGridDownsample(input, downsampled, leafSize, nearestToCentroid);
+        output = downsampled;
+        return;
+    }
+
+    const int numberOfPoints = static_cast<int>(input.size());
+    const float inverseLeafSize = 1.0f / leafSize;
+
+    int numberOfThreads = 1;
+#ifdef _OPENMP
+    if(numberOfPoints >= ParallelVoxelGridPoints)
+        numberOfThreads = omp_get_max_threads();
+#endif
+    const int rangeSize = (numberOfPoints + numberOfThreads - 1) / numberOfThreads;
+    const uint64_t invalidKey = std::numeric_limits<uint64_t>::max();
+
+    std::vector<VoxelMap> partial(numberOfThreads);
+    std::vector<uint64_t> keys(nearestToCentroid ? numberOfPoints : 0, invalidKey);
+    int outOfRange = 0;
+
+#pragma omp parallel for num_threads(numberOfThreads) reduction(+:outOfRange)
+    for(int r = 0; r < numberOfThreads; r++){
+        VoxelMap &voxels = partial[r];
+        voxels.reserve(rangeSize / 4 + 1);
+        const int end = std::min(numberOfPoints, (r + 1) * rangeSize);
+        for(int i = r * rangeSize; i < end; i++){
+            const PointT &point = input.points[i];
+            if(!pcl::isFinite(point))
+                continue;
+            uint64_t key;
+            if(!gridKey(voxelCell(point, inverseLeafSize), key)){
+                outOfRange++;
+                continue;
+            }
+
+            VoxelCentroid &voxel = voxels[key];
+            voxel.x += point.x;
+            voxel.y += point.y;
+            voxel.z += point.z;
+            addColor(point, voxel);
+            voxel.count++;
+            if(nearestToCentroid)
+                keys[i] = key;
+        }
+    }
+
+    if(outOfRange > 0)
+        qWarning() << "VoxelGrid:" << outOfRange << "points are too far from the origin for the leaf size and are dropped";
+
+    //Every thread merges the keys of its shard from all partial maps
+    std::vector<VoxelMap> merged;
+    if(numberOfThreads == 1)
+        merged.swap(partial);
+    else{
+        merged.resize(numberOfThreads);
+#pragma omp parallel for num_threads(numberOfThreads)
+        for(int s = 0; s < numberOfThreads; s++){
+            VoxelMap &shard = merged[s];
+            for(int r = 0; r < numberOfThreads; r++)
+                for(VoxelMap::const_iterator it = partial[r].begin(); it != partial[r].end(); ++it){
+                    if(voxelShard(it->first, numberOfThreads) != s)
+                        continue;
+                    VoxelCentroid &voxel = shard[it->first];
+                    voxel.x += it->second.x;
+                    voxel.y += it->second.y;
+                    voxel.z += it->second.z;
+                    voxel.r += it->second.r;
+                    voxel.g += it->second.g;
+                    voxel.b += it->second.b;
+                    voxel.count += it->second.count;
+                }
+        }
+        std::vector<VoxelMap>().swap(partial);
+    }
+
+    std::vector<std::pair<uint64_t, VoxelCentroid*> > ordered;
+    for(size_t s = 0; s < merged.size(); s++)
+        for(VoxelMap::iterator it = merged[s].begin(); it != merged[s].end(); ++it)
+            ordered.push_back(std::make_pair(it->first, &it->second));
+    std::sort(ordered.begin(), ordered.end());
+    const int numberOfVoxels = static_cast<int>(ordered.size());
+
+    output.header = input.header;
+    output.sensor_origin_ = input.sensor_origin_;
+    output.sensor_orientation_ = input.sensor_orientation_;
+    output.points.resize(numberOfVoxels);
+
+#pragma omp parallel for num_threads(numberOfThreads)
+    for(int v = 0; v < numberOfVoxels; v++){
+        VoxelCentroid &voxel = *ordered[v].second;
+        voxel.output = v;
+        PointT &point = output.points[v];
+        point = PointT();
+        point.x = static_cast<float>(voxel.x / voxel.count);
+        point.y = static_cast<float>(voxel.y / voxel.count);
+        point.z = static_cast<float>(voxel.z / voxel.count);
+        setColor(point, voxel);
+    }
+
+    if(nearestToCentroid){
+        //Squared distance in the high half and point index in the low half, the smallest value wins
+        std::vector<std::atomic<uint64_t> > nearest(numberOfVoxels);
+        for(int v = 0; v < numberOfVoxels; v++)
+            nearest[v].store(invalidKey, std::memory_order_relaxed);
+
+#pragma omp parallel for num_threads(numberOfThreads)
+        for(int i = 0; i < numberOfPoints; i++){
+            if(keys[i] == invalidKey)
+                continue;
+            const int v = merged[voxelShard(keys[i], static_cast<int>(merged.size()))].find(keys[i])->second.output;
+            const PointT &centroid = output.points[v];
+            const float dx = input.points[i].x - centroid.x;
+            const float dy = input.points[i].y - centroid.y;
+            const float dz = input.points[i].z - centroid.z;
+            const float distance = dx * dx + dy * dy + dz * dz;
+            uint32_t distanceBits;
+            std::memcpy(&distanceBits, &distance, sizeof(distanceBits));
+            const uint64_t candidate = uint64_t(distanceBits) << 32 | uint32_t(i);
+
+            uint64_t current = nearest[v].load(std::memory_order_relaxed);
+            while(candidate < current && !nearest[v].compare_exchange_weak(current, candidate, std::memory_order_relaxed));
+        }
+
+#pragma omp parallel for num_threads(numberOfThreads)
+        for(int v = 0; v < numberOfVoxels; v++)
+            output.points[v] = input.points[static_cast<uint32_t>(nearest[v].load(std::memory_order_relaxed))];
+    }
+
+    output.width = static_cast<uint32_t>(output.points.size());
+    output.height = 1;
+    output.is_dense = true;
+}
+
+//kd-tree built once with the MLS tiling. pcl::MovingLeastSquares sets its input on the search
+//method before every run, the tree of the same cloud is kept instead of being built again.
+class PrebuiltKdTree : public pcl::search::KdTree<pcl::PointXYZ>
+{
+public:
+    explicit PrebuiltKdTree(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr &cloud)
+    {
+        pcl::search::KdTree<pcl::PointXYZ>::setInputCloud(cloud);
+    }
+
+    virtual void setInputCloud(const PointCloudConstPtr &cloud, const IndicesConstPtr &indices = IndicesConstPtr())
+    {
+        if(cloud == input_ && !indices && !indices_)
+            return;
+        pcl::search::KdTree<pcl::PointXYZ>::setInputCloud(cloud, indices);
+    }
+};
+
+//Meshes from this number of vertices on are smoothed by all threads
+const int ParallelSmoothingVertices = 1 << 14;
+
+typedef std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f> > VertexPositions;
+
+//Neighbors every vertex is smoothed towards in compressed sparse rows, fixed vertices have none
+struct SmoothingAdjacency
+{
+    std::vector<int> offsets;               //one extra entry at the end
+    std::vector<int> neighbors;
+};
+
+//Newell normal, also for polygons with more than three vertices
+inline Eigen::Vector3f polygonNormal(const VertexPositions &positions, const pcl::Vertices &polygon)
+{
+    Eigen::Vector3f normal = Eigen::Vector3f::Zero();
+    const size_t n = polygon.vertices.size();
+    for(size_t i = 0; i < n; i++){
+        const Eigen::Vector3f a = positions[polygon.vertices[i]].head<3>();
+        const Eigen::Vector3f b = positions[polygon.vertices[(i + 1) % n]].head<3>();
+        normal += Eigen::Vector3f((a.y() - b.y()) * (a.z() + b.z()),
+                                  (a.z() - b.z()) * (a.x() + b.x()),
+                                  (a.x() - b.x()) * (a.y() + b.y()));
+    }
+    const float norm = normal.norm();
+    return norm > 0.0f ? Eigen::Vector3f(normal / norm) : normal;
+}
+
+/*
+ * Classifies the vertices as vtkSmoothPolyDataFilter does. Edges of one polygon are boundary edges,
+ * edges of more than two are non-manifold and edges whose polygons meet at more than the feature angle
+ * are feature edges. A vertex without such edges moves towards all its neighbors, a vertex with two
+ * moves along them unless they turn by more than the edge angle, any other vertex is fixed.
+ */
+void buildSmoothingAdjacency(const VertexPositions &positions, const std::vector<pcl::Vertices> &polygons,
+                             const TDK_Filters::MeshSmoothingParameters &parameters,
+                             SmoothingAdjacency &adjacency, TDK_Filters::MeshSmoothingStats &stats)
+{
+    const int numberOfVertices = static_cast<int>(positions.size());
+
+    //Every edge once per polygon, smaller vertex in the high half of the key
+    std::vector<std::pair<uint64_t, int> > edges;
+    for(size_t p = 0; p < polygons.size(); p++){
+        const std::vector<uint32_t> &vertices = polygons[p].vertices;
+        for(size_t i = 0; i < vertices.size(); i++){
+            const uint32_t a = vertices[i], b = vertices[(i + 1) % vertices.size()];
+            if(a == b || a >= static_cast<uint32_t>(numberOfVertices) || b >= static_cast<uint32_t>(numberOfVertices))
+                continue;
+            edges.push_back(std::make_pair(uint64_t(std::min(a, b)) << 32 | std::max(a, b), static_cast<int>(p)));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    const float featureCosine = std::cos(parameters.featureAngle);
+    const float edgeCosine = std::cos(parameters.edgeAngle);
+    std::vector<std::vector<int> > allNeighbors(numberOfVertices), edgeNeighbors(numberOfVertices);
+    std::vector<bool> onBoundary(numberOfVertices, false);
+
+    for(size_t first = 0; first < edges.size(); ){
+        size_t last = first + 1;
+        while(last < edges.size() && edges[last].first == edges[first].first)
+            last++;
+        const int a = static_cast<int>(edges[first].first >> 32);
+        const int b = static_cast<int>(edges[first].first & 0xffffffffu);
+        const size_t faces = last - first;
+
+        bool special = faces != 2;
+        if(faces == 2 && parameters.featureEdgeSmoothing)
+            special = polygonNormal(positions, polygons[edges[first].second]).dot(
+                        polygonNormal(positions, polygons[edges[first + 1].second])) < featureCosine;
+
+        allNeighbors[a].push_back(b);
+        allNeighbors[b].push_back(a);
+        if(special){
+            edgeNeighbors[a].push_back(b);
+            edgeNeighbors[b].push_back(a);
+            if(faces == 1)
+                onBoundary[a] = onBoundary[b] = true;
+        }
+        first = last;
+    }
+
+    adjacency.offsets.assign(numberOfVertices + 1, 0);
+    adjacency.neighbors.clear();
+    stats.fixedVertices = stats.edgeVertices = 0;
+    for(int v = 0; v < numberOfVertices; v++){
+        const std::vector<int> *neighbors = &allNeighbors[v];
+        if(!edgeNeighbors[v].empty()){
+            neighbors = nullptr;
+            if(edgeNeighbors[v].size() == 2 && (parameters.boundarySmoothing || !onBoundary[v])){
+                const Eigen::Vector3f in = (positions[v] - positions[edgeNeighbors[v][0]]).head<3>().normalized();
+                const Eigen::Vector3f out = (positions[edgeNeighbors[v][1]] - positions[v]).head<3>().normalized();
+                if(in.dot(out) >= edgeCosine){
+                    neighbors = &edgeNeighbors[v];
+                    stats.edgeVertices++;
+                }
+            }
+        }
+        if(neighbors == nullptr || neighbors->empty())
+            stats.fixedVertices++;
+        else
+            adjacency.neighbors.insert(adjacency.neighbors.end(), neighbors->begin(), neighbors->end());
+        adjacency.offsets[v + 1] = static_cast<int>(adjacency.neighbors.size());
+    }
+}
+
+/*
+ * One smoothing step from positions to smoothed, every vertex moves factor of the way to the mean of
+ * its neighbors. Vertices are split in one range per thread, the four lanes of a position are updated
+ * in one SSE operation by Eigen. Returns the largest squared displacement.
+ */
+float smoothingStep(const VertexPositions &positions, VertexPositions &smoothed,
+                    const SmoothingAdjacency &adjacency, const float factor)
+{
+    const int numberOfVertices = static_cast<int>(positions.size());
+
+    int numberOfRanges = 1;
+#ifdef _OPENMP
+    if(numberOfVertices >= ParallelSmoothingVertices)
+        numberOfRanges = omp_get_max_threads();
+#endif
+    const int rangeSize = (numberOfVertices + numberOfRanges - 1) / numberOfRanges;
+    std::vector<float> maxDisplacement(numberOfRanges, 0.0f);
+
+#pragma omp parallel for num_threads(numberOfRanges)
+    for(int r = 0; r < numberOfRanges; r++){
+        const int end = std::min(numberOfVertices, (r + 1) * rangeSize);
+        float rangeMax = 0.0f;
+        for(int v = r * rangeSize; v < end; v++){
+            const int first = adjacency.offsets[v], last = adjacency.offsets[v + 1];
+            if(first == last){
+                smoothed[v] = positions[v];
+                continue;
+            }
+            Eigen::Vector4f sum = Eigen::Vector4f::Zero();
+            for(int k = first; k < last; k++)
+                sum += positions[adjacency.neighbors[k]];
+            const Eigen::Vector4f displacement = factor * (sum / static_cast<float>(last - first) - positions[v]);
+            smoothed[v] = positions[v] + displacement;
+            rangeMax = std::max(rangeMax, displacement.squaredNorm());
+        }
+        maxDisplacement[r] = rangeMax;
+    }
+    return *std::max_element(maxDisplacement.begin(), maxDisplacement.end());
+}
+}
+
 TDK_Filters::TDK_Filters()
 {
 
@@ -26,35 +927,14 @@ void TDK_Filters::FilterPCPassthrough(const double &ci, const double &minx, cons
 
     zremapplus  =  maxz - zi*(maxz-minz)/255;
     zremapminus =  zi*(maxz-minz)/255+minz;
-    PassThrough<PointXYZ> pass (true);
 
+    //One pass over the six bounds instead of a pass per axis, the else branch crops the
+    //previous result in place
     if (ci == 1){
-        pass.setFilterFieldName ("z");
-        pass.setFilterLimits (zremapplus, maxz);
-        pass.setInputCloud (cloud);
-        pass.filter (*cloud_filtered);
-        pass.setFilterFieldName ("y");
-        pass.setFilterLimits (yremapplus, maxy);
-        pass.setInputCloud (cloud_filtered);
-        pass.filter (*cloud_filtered);
-        pass.setFilterFieldName ("x");
-        pass.setFilterLimits (xremapplus, maxx); //maxx
-        pass.setInputCloud (cloud_filtered);
-        pass.filter (*cloud_filtered);
+        mf_FilterCropBox(cloud, cloud_filtered, xremapplus, maxx, yremapplus, maxy, zremapplus, maxz);
     }
     else{
-        pass.setFilterFieldName ("z");
-        pass.setFilterLimits (minz,zremapminus);
-        pass.setInputCloud (cloud_filtered);
-        pass.filter (*cloud_filtered);
-        pass.setFilterFieldName ("y");
-        pass.setFilterLimits (miny,yremapminus);
-        pass.setInputCloud (cloud_filtered);
-        pass.filter (*cloud_filtered);
-        pass.setFilterFieldName ("x");
-        pass.setFilterLimits (minx,xremapminus);
-        pass.setInputCloud (cloud_filtered);
-        pass.filter (*cloud_filtered);
+        mf_FilterCropBox(cloud_filtered, cloud_filtered, minx, xremapminus, miny, yremapminus, minz, zremapminus);
     }
 }
 
@@ -63,32 +943,30 @@ void TDK_Filters::FilterPCPassthrough(const double &ci, const double &minx, cons
 //Output: void
 void TDK_Filters::mf_FilterPassthroughBri(const  pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud,  pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_filtered, float x1, float x2, float y1, float y2, float z1, float z2){
 
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_filteredz (new  pcl::PointCloud<pcl::PointXYZRGB>);
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_filteredy (new  pcl::PointCloud<pcl::PointXYZRGB>);
-
-    // Create the passthrough filtering object
-    pcl::PassThrough<PointXYZRGB> pass;
-
     qDebug()<<"inside pass through";
 
-    pass.setInputCloud (cloud);  // passing the input cloud pointer
-    pass.setFilterFieldName ("z"); // defining the dimension to be filtered
-    pass.setFilterLimits (z1,z2);  // setting the limits
-    pass.filter (*cloud_filteredz); // filter and put the output in a point cloud variable
+    //z, y and x limits in one pass, no intermediate clouds
+    mf_FilterCropBox(cloud, cloud_filtered, x1, x2, y1, y2, z1, z2);
 
-    qDebug()<<"z filtered";
+    qDebug()<<"x, y and z filtered";
+}
+
+//Crop box:
+//Input: PointCloud, PointCloud(filtered, may be the input), x,y,z minimum and maximum
+//Output: void, the points inside the box in their order, as three pcl::PassThrough passes give them
+void TDK_Filters::mf_FilterCropBox(const pcl::PointCloud<PointXYZ>::Ptr &cloud, const pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered,
+                                   double x1, double x2, double y1, double y2, double z1, double z2){
 
-    pass.setInputCloud (cloud_filteredz); // passing the input cloud pointer
-    pass.setFilterFieldName ("y"); // defining the dimension to be filtered
-    pass.setFilterLimits (y1,y2);  // setting the limits
-    pass.filter (*cloud_filteredy); // filter and put the output in a point cloud variable
+    cropBox(*cloud, *cloud_filtered, CropBounds(x1, x2, y1, y2, z1, z2));
+}
 
-    pass.setInputCloud (cloud_filteredy); // passing the input cloud pointer
-    pass.setFilterFieldName ("x"); // defining the dimension to be filtered
-    pass.setFilterLimits (x1, x2); // setting the limits
-    pass.filter (*cloud_filtered); // filter and put the output in a point cloud variable
+//Crop box:
+//Input: RGBPointCloud, RGBPointCloud(filtered, may be the input), x,y,z minimum and maximum
+//Output: void, the points inside the box in their order, as three pcl::PassThrough passes give them
+void TDK_Filters::mf_FilterCropBox(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud, const pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered,
+                                   double x1, double x2, double y1, double y2, double z1, double z2){
 
-    qDebug()<<"x and y filtered";
+    cropBox(*cloud, *cloud_filtered, CropBounds(x1, x2, y1, y2, z1, z2));
 }
 
 //Statistical outlier removal:
@@ -118,67 +996,275 @@ void TDK_Filters::mf_FilterStatisticalOutlierRemoval(const pcl::PointCloud<Point
     sor.filter (*cloud_filtered);
 }
 
+//Approximate statistical outlier removal:
+//Input: PointCloud, PointCloud(filtered), neighbours of the mean distance, standard deviation threshold,
+//       tolerated fraction of decisions that differ from the exact filter (negative for estimates only)
+//Output: void, the measured error and the refined points in stats
+void TDK_Filters::mf_FilterApproximateStatisticalOutlierRemoval(const pcl::PointCloud<PointXYZ>::Ptr &cloud,
+                                                                const pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered,
+                                                                int meanK, float threshold, float maxDecisionError,
+                                                                ApproximateOutlierStats *stats){
+
+    ApproximateOutlierStats outlierStats;
+    pcl::PointCloud<PointXYZ> output;
+    approximateStatisticalOutlierRemoval(*cloud, output, meanK, threshold, maxDecisionError, outlierStats);
+    cloud_filtered->swap(output);
+    qDebug()<<"approximate outlier removal removed"<<outlierStats.removed<<"points, refined"<<outlierStats.refined
+            <<", measured decision error"<<outlierStats.decisionError;
+    if(stats)
+        *stats = outlierStats;
+}
+
+//Approximate statistical outlier removal:
+//Input: RGBPointCloud, RGBPointCloud(filtered), neighbours of the mean distance, standard deviation threshold,
+//       tolerated fraction of decisions that differ from the exact filter (negative for estimates only)
+//Output: void, the measured error and the refined points in stats
+void TDK_Filters::mf_FilterApproximateStatisticalOutlierRemoval(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud,
+                                                                const pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered,
+                                                                int meanK, float threshold, float maxDecisionError,
+                                                                ApproximateOutlierStats *stats){
+
+    ApproximateOutlierStats outlierStats;
+    pcl::PointCloud<PointXYZRGB> output;
+    approximateStatisticalOutlierRemoval(*cloud, output, meanK, threshold, maxDecisionError, outlierStats);
+    cloud_filtered->swap(output);
+    qDebug()<<"approximate outlier removal removed"<<outlierStats.removed<<"points, refined"<<outlierStats.refined
+            <<", measured decision error"<<outlierStats.decisionError;
+    if(stats)
+        *stats = outlierStats;
+}
+
+
+
+//Radius outlier removal:
+//Input: PointCloud, PointCloud(filtered), radius, other points needed within the radius,
+//       exact distances or only the occupancy of the cells around a point
+//Output: void, the removed points and the points decided from the cells alone in stats
+void TDK_Filters::mf_FilterRadiusOutlierRemoval(const pcl::PointCloud<PointXYZ>::Ptr &cloud,
+                                                const pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered,
+                                                float radius, int minNeighbors, bool exact,
+                                                RadiusOutlierStats *stats){
+
+    RadiusOutlierStats outlierStats;
+    pcl::PointCloud<PointXYZ> output;
+    radiusOutlierRemoval(*cloud, output, radius, minNeighbors, exact, outlierStats);
+    cloud_filtered->swap(output);
+    qDebug()<<"radius outlier removal removed"<<outlierStats.removed<<"points,"<<outlierStats.decidedByCells
+            <<"decided from the cells";
+    if(stats)
+        *stats = outlierStats;
+}
+
+//Radius outlier removal:
+//Input: RGBPointCloud, RGBPointCloud(filtered), radius, other points needed within the radius,
+//       exact distances or only the occupancy of the cells around a point
+//Output: void, the removed points and the points decided from the cells alone in stats
+void TDK_Filters::mf_FilterRadiusOutlierRemoval(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud,
+                                                const pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered,
+                                                float radius, int minNeighbors, bool exact,
+                                                RadiusOutlierStats *stats){
 
+    RadiusOutlierStats outlierStats;
+    pcl::PointCloud<PointXYZRGB> output;
+    radiusOutlierRemoval(*cloud, output, radius, minNeighbors, exact, outlierStats);
+    cloud_filtered->swap(output);
+    qDebug()<<"radius outlier removal removed"<<outlierStats.removed<<"points,"<<outlierStats.decidedByCells
+            <<"decided from the cells";
+    if(stats)
+        *stats = outlierStats;
+}
 
 //Voxel grid downsample:
-//Input: PointCloud, PointCloud(filtered), leafsize (size of cubic voxel)
+//Input: PointCloud, PointCloud(filtered), leafsize (size of cubic voxel), nearestToCentroid (input point closest to the centroid of a voxel instead of the centroid)
 //Output: void
-void TDK_Filters::mf_FilterVoxelGridDownsample(const pcl::PointCloud<PointXYZ>::Ptr &cloud, pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered, const float &leafsize){
+void TDK_Filters::mf_FilterVoxelGridDownsample(const pcl::PointCloud<PointXYZ>::Ptr &cloud, pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered, const float &leafsize, const bool nearestToCentroid){
 
-      pcl::VoxelGrid<PointXYZ> sor; // Create the filtering object
-      qDebug()<<"inside voxelgrid";
-      sor.setInputCloud (cloud);
-      sor.setLeafSize (leafsize,leafsize, leafsize); //Cubic voxel
-      sor.filter (*cloud_filtered);
+    voxelGridDownsample(*cloud, *cloud_filtered, leafsize, nearestToCentroid);
 }
 
 //Voxel grid downsample:
-//Input: PointCloud, PointCloud(filtered), leafsize (size of cubic voxel)
+//Input: PointCloud, PointCloud(filtered), leafsize (size of cubic voxel), nearestToCentroid (input point closest to the centroid of a voxel instead of the centroid)
 //Output: void
-void TDK_Filters::mf_FilterVoxelGridDownsample(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud, pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered, const float &leafsize){
-    
-    pcl::VoxelGrid<PointXYZRGB> sor; // Create the filtering object
-    qDebug()<<"inside voxelgrid";
-    sor.setInputCloud (cloud);
-    sor.setLeafSize (leafsize,leafsize, leafsize); //Cubic voxel
-    sor.filter (*cloud_filtered);
+void TDK_Filters::mf_FilterVoxelGridDownsample(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud, pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered, const float &leafsize, const bool nearestToCentroid){
+
+    voxelGridDownsample(*cloud, *cloud_filtered, leafsize, nearestToCentroid);
+}
+
+//MLS tiling:
+//Input: PointCloud, tiling (output), pointsPerTile (points of a tile, about)
+//Output: void
+void TDK_Filters::mf_BuildMLSTiling(const pcl::PointCloud<PointXYZ>::Ptr &cloud, MLSTiling &tiling, int pointsPerTile){
+
+    tiling.cloud = cloud;
+    tiling.numberOfPoints = cloud->size();
+    tiling.tiles.clear();
+    tiling.tree.reset();
+    if(cloud->empty())
+        return;
+
+    //The same tree as the single pcl::MovingLeastSquares, a point finds its neighbors in the same order
+    tiling.tree.reset(new PrebuiltKdTree(cloud));
+
+    tiling.tileSize = chooseCellSize(*cloud, pointsPerTile);
+    OccupancyGrid grid;
+    buildOccupancyGrid(*cloud, tiling.tileSize, grid);
+    const int numberOfTiles = static_cast<int>(grid.cellStart.size()) - 1;
+    tiling.tiles.resize(numberOfTiles);
+    for(int t = 0; t < numberOfTiles; t++)
+        tiling.tiles[t].reset(new std::vector<int>(grid.points.begin() + grid.cellStart[t], grid.points.begin() + grid.cellStart[t + 1]));
 }
 
 //MLS Filter Smoothing:
-//Input: PointCloud, PointCloud(smoothed), searchradius (sphere radius used for k-space nearest neighbors)
+//Input: PointCloud, PointCloud(smoothed), searchradius (sphere radius used for k-space nearest neighbors),
+//tiling (tiles of the cloud, nullptr to build them), tileTimings (time of every tile, may be nullptr)
 //Output: void
-void TDK_Filters::mf_FilterMLSSmoothing(const pcl::PointCloud<PointXYZ>::Ptr &cloud, pcl::PointCloud<PointXYZ>::Ptr &cloud_smoothed, float searchradius){
+void TDK_Filters::mf_FilterMLSSmoothing(const pcl::PointCloud<PointXYZ>::Ptr &cloud, pcl::PointCloud<PointXYZ>::Ptr &cloud_smoothed, float searchradius,
+                                        const MLSTiling *tiling, std::vector<MLSTileTiming> *tileTimings){
 
-    // Start MLS
-    // Create a KD-Tree
-    pcl::search::KdTree<PointXYZ>::Ptr tree (new pcl::search::KdTree<PointXYZ>);
-    pcl::PointCloud<pcl::PointNormal> mls_points;
-    pcl::MovingLeastSquares<PointXYZ, pcl::PointNormal> mls;
+    MLSTiling localTiling;
+    if(tiling == nullptr || tiling->cloud != cloud || tiling->numberOfPoints != cloud->size()){
+        if(tiling != nullptr)
+            qWarning()<<"MLS tiling of another cloud or size, tiles are built again";
+        mf_BuildMLSTiling(cloud, localTiling);
+        tiling = &localTiling;
+    }
+
+    //Every tile smooths its points on the whole cloud with the shared tree, a point gets the
+    //neighbors and the fit it gets from one pcl::MovingLeastSquares on the whole cloud
+    const int numberOfTiles = static_cast<int>(tiling->tiles.size());
+    std::vector<pcl::PointCloud<pcl::PointNormal> > tilePoints(numberOfTiles);
+    std::vector<std::vector<int> > tileInputIndices(numberOfTiles);
+    std::vector<MLSTileTiming> timings(numberOfTiles);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int t = 0; t < numberOfTiles; t++){
+        QElapsedTimer timer;
+        timer.start();
+
+        pcl::MovingLeastSquares<PointXYZ, pcl::PointNormal> mls;
+        mls.setComputeNormals(true);
+        mls.setInputCloud(cloud);
+        mls.setIndices(tiling->tiles[t]);
+        mls.setPolynomialFit(true);
+        mls.setSearchMethod(tiling->tree); //Kdtree of the whole cloud, built with the tiling
+        mls.setSearchRadius(searchradius); //Set sphere radius used for k-space nearest neighbors
+        mls.process(tilePoints[t]);
+
+        //Points with too few neighbors give no output
+        tileInputIndices[t] = mls.getCorrespondingIndices()->indices;
+
+        timings[t].points = static_cast<int>(tiling->tiles[t]->size());
+        timings[t].ms = timer.nsecsElapsed() / 1e6;
+    }
 
-    mls.setComputeNormals(true);
-    mls.setInputCloud(cloud);
-    mls.setPolynomialFit(true);
-    mls.setSearchMethod(tree); //Kdtree search method
-    mls.setSearchRadius(searchradius); //Set sphere radius used for k-space nearest neighbors
-    mls.process(mls_points);
-    pcl::copyPointCloud(mls_points, *cloud_smoothed); //convert from XYZNormals to XYZ
-    qDebug()<<"finished MLS Smoothing";
+    //Back in the order of the input points
+    const int numberOfPoints = static_cast<int>(cloud->size());
+    std::vector<int> outputTile(numberOfPoints, -1), outputPosition(numberOfPoints, -1);
+    for(int t = 0; t < numberOfTiles; t++)
+        for(size_t k = 0; k < tileInputIndices[t].size(); k++){
+            outputTile[tileInputIndices[t][k]] = t;
+            outputPosition[tileInputIndices[t][k]] = static_cast<int>(k);
+        }
+
+    pcl::PointCloud<PointXYZ> smoothed;
+    smoothed.header = cloud->header;
+    smoothed.points.reserve(numberOfPoints);
+    for(int i = 0; i < numberOfPoints; i++)
+        if(outputTile[i] >= 0){
+            const pcl::PointNormal &point = tilePoints[outputTile[i]].points[outputPosition[i]];
+            smoothed.points.push_back(PointXYZ(point.x, point.y, point.z));
+        }
+    smoothed.width = static_cast<uint32_t>(smoothed.points.size());
+    smoothed.height = 1;
+    smoothed.is_dense = true;
+    *cloud_smoothed = smoothed;
+
+    double slowestMs = 0.0, totalMs = 0.0;
+    for(int t = 0; t < numberOfTiles; t++){
+        slowestMs = std::max(slowestMs, timings[t].ms);
+        totalMs += timings[t].ms;
+    }
+    if(tileTimings != nullptr)
+        tileTimings->swap(timings);
+
+    qDebug()<<"finished MLS Smoothing,"<<numberOfTiles<<"tiles,"<<totalMs<<"ms of tiles, slowest"<<slowestMs<<"ms";
 }
 
-//Laplacian Filter Smoothing:
+//Laplacian Filter Smoothing with the default parameters, those of the former VTK smoothing:
 //Input: Mesh, Mesh(smoothed)
 //Output: void
 void TDK_Filters::mf_FilterLaplacianSmoothing(const boost::shared_ptr<pcl::PolygonMesh> &triangles, pcl::PolygonMesh::Ptr &mv_MeshesOutput1){
 
-    pcl::MeshSmoothingLaplacianVTK laplacian;
-    laplacian.setInputMesh(triangles);
-    laplacian.setNumIter(20000);
-    laplacian.setConvergence(0.0001);
-    laplacian.setRelaxationFactor(0.0001);
-    laplacian.setFeatureEdgeSmoothing(true);
-    laplacian.setFeatureAngle(M_PI/5);
-    laplacian.setBoundarySmoothing(true);
-    laplacian.process(*mv_MeshesOutput1);
-    qDebug()<<"Laplacian smoothing Finished";
+    mf_FilterLaplacianSmoothing(triangles, mv_MeshesOutput1, MeshSmoothingParameters());
+}
+
+//Laplacian Filter Smoothing:
+//Input: Mesh, Mesh(smoothed), parameters (iterations, lambda, Taubin mu, convergence, feature edges and boundary), stats (may be nullptr)
+//Output: void, the polygons and the point fields other than x, y and z are kept
+void TDK_Filters::mf_FilterLaplacianSmoothing(const boost::shared_ptr<pcl::PolygonMesh> &triangles, pcl::PolygonMesh::Ptr &mv_MeshesOutput1,
+                                              const MeshSmoothingParameters &parameters, MeshSmoothingStats *stats){
+
+    MeshSmoothingStats smoothingStats;
+    pcl::PolygonMesh smoothedMesh = *triangles;
+    pcl::PCLPointCloud2 &blob = smoothedMesh.cloud;
+    const int numberOfVertices = static_cast<int>(blob.width * blob.height);
+
+    int offsets[3] = { -1, -1, -1 };
+    const char *names[3] = { "x", "y", "z" };
+    for(size_t f = 0; f < blob.fields.size(); f++)
+        for(int a = 0; a < 3; a++)
+            if(blob.fields[f].name == names[a] && blob.fields[f].datatype == pcl::PCLPointField::FLOAT32)
+                offsets[a] = static_cast<int>(blob.fields[f].offset);
+    if(offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0 || numberOfVertices == 0){
+        qWarning()<<"Laplacian smoothing needs float x, y and z vertices, mesh copied";
+        *mv_MeshesOutput1 = smoothedMesh;
+        if(stats != nullptr)
+            *stats = smoothingStats;
+        return;
+    }
+
+    VertexPositions positions(numberOfVertices), smoothed(numberOfVertices);
+    Eigen::Vector4f minimum = Eigen::Vector4f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector4f maximum = -minimum;
+    for(int v = 0; v < numberOfVertices; v++){
+        const uint8_t *point = &blob.data[(v / blob.width) * blob.row_step + (v % blob.width) * blob.point_step];
+        positions[v] = Eigen::Vector4f::Zero();
+        for(int a = 0; a < 3; a++)
+            std::memcpy(&positions[v][a], point + offsets[a], sizeof(float));
+        minimum = minimum.cwiseMin(positions[v]);
+        maximum = maximum.cwiseMax(positions[v]);
+    }
+
+    SmoothingAdjacency adjacency;
+    buildSmoothingAdjacency(positions, smoothedMesh.polygons, parameters, adjacency, smoothingStats);
+
+    const float convergence = parameters.convergence * (maximum - minimum).norm();
+    const float lambda = parameters.relaxationFactor;
+    const float mu = parameters.taubin ? 1.0f / (parameters.passBand - 1.0f / lambda) : 0.0f;
+
+    for(int i = 0; i < parameters.iterations; i++){
+        float maxDisplacement = smoothingStep(positions, smoothed, adjacency, lambda);
+        positions.swap(smoothed);
+        //The mu step inflates back what the lambda step shrank
+        if(parameters.taubin){
+            maxDisplacement = std::max(maxDisplacement, smoothingStep(positions, smoothed, adjacency, mu));
+            positions.swap(smoothed);
+        }
+        smoothingStats.iterations = i + 1;
+        smoothingStats.maxDisplacement = std::sqrt(maxDisplacement);
+        if(smoothingStats.maxDisplacement <= convergence)
+            break;
+    }
+
+    for(int v = 0; v < numberOfVertices; v++){
+        uint8_t *point = &blob.data[(v / blob.width) * blob.row_step + (v % blob.width) * blob.point_step];
+        for(int a = 0; a < 3; a++)
+            std::memcpy(point + offsets[a], &positions[v][a], sizeof(float));
+    }
+
+    *mv_MeshesOutput1 = smoothedMesh;
+    if(stats != nullptr)
+        *stats = smoothingStats;
+    qDebug()<<"Laplacian smoothing Finished,"<<smoothingStats.iterations<<"iterations, last displacement"<<smoothingStats.maxDisplacement;
 }
 
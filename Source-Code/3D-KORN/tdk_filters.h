@@ -39,6 +39,7 @@
 using namespace pcl;
 
 #include <string>
+#include <vector>
 
 class TDK_Filters
 {
@@ -59,25 +60,143 @@ public:
                                         pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered,
                                         float x1 = -0.4, float x2 = 0.4, float y1 = -0.85, float y2 = 1.2, float z1 = 0.1, float z2 = 2.0);
 
+    //Function for cropping to an axis aligned box in one pass, cloud_filtered may be cloud itself.
+    //The limits are inclusive and rounded to the nearest float, as pcl::PassThrough takes them
+    static void mf_FilterCropBox(const pcl::PointCloud<PointXYZ>::Ptr &cloud,
+                                 const pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered,
+                                 double x1, double x2, double y1, double y2, double z1, double z2);
+    static void mf_FilterCropBox(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud,
+                                 const pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered,
+                                 double x1, double x2, double y1, double y2, double z1, double z2);
+
     //Function for filtering outliers
     static void mf_FilterStatisticalOutlierRemoval(const pcl::PointCloud<PointXYZ>::Ptr &cloud,
                                                    const pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered, float threshold = 2.5);
     static void mf_FilterStatisticalOutlierRemoval(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud,
                                                    const pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered, float threshold = 2.5);
 
-    //Function for downsampling using voxel grid
+    //Outcome of the approximate statistical outlier removal
+    struct ApproximateOutlierStats
+    {
+        int removed = 0;
+        int refined = 0;                    //points near the threshold decided from their exact kNN distance
+        int sampled = 0;                    //points with exact distance that set the threshold and the band
+        int heldOut = 0;                    //further points with exact distance that measure the error
+        double decisionError = 0.0;         //fraction of the held-out sample kept or removed otherwise than by its exact distance
+        double meanDistance = 0.0;          //of the exact mean kNN distances of the sample
+        double stddev = 0.0;
+        double cellSize = 0.0;
+    };
+
+    //Function for filtering outliers from voxel grid occupancy instead of a kNN search per point,
+    //a maxDecisionError >= 0 refines the points near the threshold until that error is met
+    static void mf_FilterApproximateStatisticalOutlierRemoval(const pcl::PointCloud<PointXYZ>::Ptr &cloud,
+                                                              const pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered,
+                                                              int meanK = 50, float threshold = 2.5,
+                                                              float maxDecisionError = -1.0,
+                                                              ApproximateOutlierStats *stats = nullptr);
+    static void mf_FilterApproximateStatisticalOutlierRemoval(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud,
+                                                              const pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered,
+                                                              int meanK = 8, float threshold = 2.5,
+                                                              float maxDecisionError = -1.0,
+                                                              ApproximateOutlierStats *stats = nullptr);
+
+    //Outcome of the radius outlier removal
+    struct RadiusOutlierStats
+    {
+        int removed = 0;
+        int decidedByCells = 0;             //points kept or removed from the occupancy of their 27 cells, without a distance
+    };
+
+    //Function for filtering points with fewer than minNeighbors other points within the radius, the
+    //neighbours are counted on a voxel grid of the radius in the 27 cells around a point, multithreaded.
+    //Exact gives the points of pcl::RadiusOutlierRemoval, otherwise only isolated cells are removed
+    static void mf_FilterRadiusOutlierRemoval(const pcl::PointCloud<PointXYZ>::Ptr &cloud,
+                                              const pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered,
+                                              float radius, int minNeighbors = 5, bool exact = true,
+                                              RadiusOutlierStats *stats = nullptr);
+    static void mf_FilterRadiusOutlierRemoval(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud,
+                                              const pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered,
+                                              float radius, int minNeighbors = 5, bool exact = true,
+                                              RadiusOutlierStats *stats = nullptr);
+
+    //Function for downsampling using voxel grid, multithreaded on a hash of 64 bit voxel keys
     static void mf_FilterVoxelGridDownsample(const pcl::PointCloud<PointXYZ>::Ptr &cloud,
-                                             pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered, const float &leafsize);
+                                             pcl::PointCloud<PointXYZ>::Ptr &cloud_filtered, const float &leafsize,
+                                             const bool nearestToCentroid = false);
     static void mf_FilterVoxelGridDownsample(const pcl::PointCloud<PointXYZRGB>::Ptr &cloud,
-                                             pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered, const float &leafsize);
+                                             pcl::PointCloud<PointXYZRGB>::Ptr &cloud_filtered, const float &leafsize,
+                                             const bool nearestToCentroid = false);
+
+    //Tiles of a cloud for the MLS smoothing, every tile holds the indices of the points of a cell
+    //of a grid. All tiles search the neighbors of their points in one kd-tree on the whole cloud
+    struct MLSTiling
+    {
+        pcl::PointCloud<PointXYZ>::ConstPtr cloud;
+        pcl::search::KdTree<PointXYZ>::Ptr tree;
+        size_t numberOfPoints = 0;          //size of the cloud when the tiles were built
+        float tileSize = 0.0;
+        std::vector<pcl::IndicesPtr> tiles; //index in the cloud of every point of a tile
 
-    //Function for smoothing using MLS
+        //Drops the tiles, to be called when the points of the cloud change in place
+        void mf_Reset()
+        {
+            cloud.reset();
+            tree.reset();
+            numberOfPoints = 0;
+            tileSize = 0.0;
+            tiles.clear();
+        }
+    };
+
+    //Time spent on a tile of the MLS smoothing
+    struct MLSTileTiming
+    {
+        int points = 0;
+        double ms = 0.0;
+    };
+
+    static void mf_BuildMLSTiling(const pcl::PointCloud<PointXYZ>::Ptr &cloud, MLSTiling &tiling,
+                                  int pointsPerTile = 20000);
+
+    //Function for smoothing using MLS, tiles run in parallel with the result of a single pcl::MovingLeastSquares.
+    //A tiling built for the same cloud and size is reused, with its kd-tree. Points moved in place
+    //are not detected, MLSTiling::mf_Reset drops the tiles then
     static void mf_FilterMLSSmoothing(const pcl::PointCloud<PointXYZ>::Ptr &cloud,
-                                   pcl::PointCloud<PointXYZ>::Ptr &cloud_smoothed, float searchradius);
+                                   pcl::PointCloud<PointXYZ>::Ptr &cloud_smoothed, float searchradius,
+                                   const MLSTiling *tiling = nullptr, std::vector<MLSTileTiming> *tileTimings = nullptr);
 
-    //Function for Laplacian Smoothing
+    //Settings of the mesh smoothing, the defaults are those of the former VTK smoothing
+    struct MeshSmoothingParameters
+    {
+        int iterations = 20000;
+        float relaxationFactor = 0.0001;    //lambda, part of the way to the mean of the neighbors per step
+        float convergence = 0.0001;         //stops when no vertex moves more than this part of the bounding box diagonal
+        bool taubin = false;                //alternates lambda with a negative mu step, the mesh does not shrink
+        float passBand = 0.1;               //Taubin pass-band frequency, mu = 1 / (passBand - 1 / lambda)
+        bool featureEdgeSmoothing = true;   //vertices of sharp edges only move along them
+        float featureAngle = M_PI/5;
+        float edgeAngle = M_PI/12;          //vertices where their two edges turn by more are fixed
+        bool boundarySmoothing = true;      //boundary vertices move along the boundary, fixed otherwise
+    };
+
+    //Outcome of the mesh smoothing
+    struct MeshSmoothingStats
+    {
+        int iterations = 0;
+        double maxDisplacement = 0.0;       //of the last iteration
+        int fixedVertices = 0;
+        int edgeVertices = 0;               //vertices smoothed along a feature edge or the boundary
+    };
+
+    //Function for Laplacian or Taubin Smoothing on the vertex adjacency, multithreaded. The overload
+    //without parameters uses the defaults, a default argument of the nested struct does not build with GCC
     static void mf_FilterLaplacianSmoothing(const boost::shared_ptr<pcl::PolygonMesh> &triangles,
                                                   pcl::PolygonMesh::Ptr &mv_MeshesOutput1);
+    static void mf_FilterLaplacianSmoothing(const boost::shared_ptr<pcl::PolygonMesh> &triangles,
+                                                  pcl::PolygonMesh::Ptr &mv_MeshesOutput1,
+                                                  const MeshSmoothingParameters &parameters,
+                                                  MeshSmoothingStats *stats = nullptr);
 };
 
 #endif // TDK_FILTERS_H
@@ -0,0 +1,225 @@
+#include "tdk_incrementalpassthrough.h"
+
+#include <pcl/common/point_tests.h>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+TDK_IncrementalPassthrough::TDK_IncrementalPassthrough() :
+    mv_FilteredCloud(new pcl::PointCloud<pcl::PointXYZRGB>),
+    mv_NumberOfChangedPoints(0)
+{
+    for(int a = 0; a < 3; a++){
+        mv_Axes[a].lower = mv_Axes[a].upper = 0;
+        mv_Axes[a].minimum = -std::numeric_limits<float>::infinity();
+        mv_Axes[a].maximum = std::numeric_limits<float>::infinity();
+        mv_RangeMinimum[a] = mv_RangeMaximum[a] = 0.0;
+    }
+}
+
+TDK_IncrementalPassthrough::~TDK_IncrementalPassthrough()
+{
+
+}
+
+/*!
+ * \brief TDK_IncrementalPassthrough::mf_SetInputCloud
+ * \param cloud cloud to crop, points with a non finite coordinate are never in the box
+ *
+ * Sorts the three axes in parallel, O(n log n) once per cloud
+ */
+void TDK_IncrementalPassthrough::mf_SetInputCloud(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud)
+{
+    mv_Cloud = cloud;
+    const int numberOfPoints = static_cast<int>(cloud->size());
+
+    mv_Outside.assign(numberOfPoints, 0);
+    mv_SelectedPosition.assign(numberOfPoints, -1);
+    mv_Selected.clear();
+    mv_Selected.reserve(numberOfPoints);
+
+    mv_FilteredCloud.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+    mv_FilteredCloud->header = cloud->header;
+    mv_FilteredCloud->sensor_origin_ = cloud->sensor_origin_;
+    mv_FilteredCloud->sensor_orientation_ = cloud->sensor_orientation_;
+    mv_FilteredCloud->points.reserve(numberOfPoints);
+
+    for(int i = 0; i < numberOfPoints; i++){
+        if(!pcl::isFinite(cloud->points[i])){
+            //Outside for good, no axis holds the point
+            mv_Outside[i] = 1;
+            continue;
+        }
+        mf_Select(i);
+    }
+
+    #pragma omp parallel for
+    for(int a = 0; a < 3; a++){
+        std::vector<std::pair<float, int> > sorted;
+        sorted.reserve(mv_Selected.size());
+        for(size_t s = 0; s < mv_Selected.size(); s++)
+            sorted.push_back(std::make_pair(cloud->points[mv_Selected[s]].data[a], mv_Selected[s]));
+        std::sort(sorted.begin(), sorted.end());
+
+        Axis &axis = mv_Axes[a];
+        axis.values.resize(sorted.size());
+        axis.indices.resize(sorted.size());
+        for(size_t s = 0; s < sorted.size(); s++){
+            axis.values[s] = sorted[s].first;
+            axis.indices[s] = sorted[s].second;
+        }
+        axis.lower = 0;
+        axis.upper = static_cast<int>(sorted.size());
+        axis.minimum = -std::numeric_limits<float>::infinity();
+        axis.maximum = std::numeric_limits<float>::infinity();
+    }
+
+    mv_FilteredCloud->width = static_cast<uint32_t>(mv_FilteredCloud->size());
+    mv_FilteredCloud->height = 1;
+    mv_FilteredCloud->is_dense = true;
+    mv_NumberOfChangedPoints = static_cast<int>(mv_Selected.size());
+}
+
+/*!
+ * \brief TDK_IncrementalPassthrough::mf_SetBounds
+ * \param x1 x2 y1 y2 z1 z2 inclusive limits of the box, as pcl::PassThrough uses them
+ *
+ * Visits only the points between the old and the new position of every bound that changed
+ */
+void TDK_IncrementalPassthrough::mf_SetBounds(float x1, float x2, float y1, float y2, float z1, float z2)
+{
+    const float minimum[3] = { x1, y1, z1 };
+    const float maximum[3] = { x2, y2, z2 };
+
+    mv_NumberOfChangedPoints = 0;
+    for(int a = 0; a < 3; a++){
+        Axis &axis = mv_Axes[a];
+        if(minimum[a] != axis.minimum){
+            const int position = static_cast<int>(std::lower_bound(axis.values.begin(), axis.values.end(), minimum[a]) - axis.values.begin());
+            mf_MoveBound(axis, axis.lower, position, true);
+            axis.minimum = minimum[a];
+        }
+        if(maximum[a] != axis.maximum){
+            const int position = static_cast<int>(std::upper_bound(axis.values.begin(), axis.values.end(), maximum[a]) - axis.values.begin());
+            mf_MoveBound(axis, axis.upper, position, false);
+            axis.maximum = maximum[a];
+        }
+    }
+
+    mv_FilteredCloud->width = static_cast<uint32_t>(mv_FilteredCloud->size());
+    mv_FilteredCloud->height = 1;
+}
+
+/*!
+ * \brief TDK_IncrementalPassthrough::mf_SetSliderRange
+ * \param minx maxx miny maxy minz maxz extent the sliders map to, the bounds are reset to it
+ */
+void TDK_IncrementalPassthrough::mf_SetSliderRange(const double &minx, const double &maxx, const double &miny,
+                                                   const double &maxy, const double &minz, const double &maxz)
+{
+    mv_RangeMinimum[0] = minx;  mv_RangeMaximum[0] = maxx;
+    mv_RangeMinimum[1] = miny;  mv_RangeMaximum[1] = maxy;
+    mv_RangeMinimum[2] = minz;  mv_RangeMaximum[2] = maxz;
+
+    mf_SetBounds(static_cast<float>(minx), static_cast<float>(maxx), static_cast<float>(miny),
+                 static_cast<float>(maxy), static_cast<float>(minz), static_cast<float>(maxz));
+}
+
+/*!
+ * \brief TDK_IncrementalPassthrough::mf_SetSliderPositions
+ * \param lowerBounds true to move the minimums, the ci == 1 branch of FilterPCPassthrough
+ * \param xi yi zi slider positions, 0 to 255
+ */
+void TDK_IncrementalPassthrough::mf_SetSliderPositions(const bool lowerBounds, const unsigned int xi, const unsigned int yi, const unsigned int zi)
+{
+    const unsigned int positions[3] = { xi, yi, zi };
+    float minimum[3], maximum[3];
+
+    for(int a = 0; a < 3; a++){
+        const double step = positions[a]*(mv_RangeMaximum[a]-mv_RangeMinimum[a])/255;
+        //Rounded to the nearest float as pcl::PassThrough does with the limits of FilterPCPassthrough
+        minimum[a] = lowerBounds ? static_cast<float>(mv_RangeMaximum[a] - step) : mv_Axes[a].minimum;
+        maximum[a] = lowerBounds ? mv_Axes[a].maximum : static_cast<float>(step + mv_RangeMinimum[a]);
+    }
+
+    mf_SetBounds(minimum[0], maximum[0], minimum[1], maximum[1], minimum[2], maximum[2]);
+}
+
+/*!
+ * \brief TDK_IncrementalPassthrough::mf_ExtractFilteredCloud
+ * \param cloud_filtered the points in the box in the input order, the same points
+ * TDK_Filters::mf_FilterCropBox gives for the current bounds
+ */
+void TDK_IncrementalPassthrough::mf_ExtractFilteredCloud(pcl::PointCloud<pcl::PointXYZRGB> &cloud_filtered) const
+{
+    cloud_filtered.points.clear();
+    cloud_filtered.points.reserve(mv_Selected.size());
+    for(size_t i = 0; i < mv_Outside.size(); i++)
+        if(mv_Outside[i] == 0)
+            cloud_filtered.points.push_back(mv_Cloud->points[i]);
+
+    cloud_filtered.header = mv_Cloud->header;
+    cloud_filtered.sensor_origin_ = mv_Cloud->sensor_origin_;
+    cloud_filtered.sensor_orientation_ = mv_Cloud->sensor_orientation_;
+    cloud_filtered.width = static_cast<uint32_t>(cloud_filtered.points.size());
+    cloud_filtered.height = 1;
+    cloud_filtered.is_dense = true;
+}
+
+/*!
+ * \brief TDK_IncrementalPassthrough::mf_MoveBound
+ * \param axis sorted axis of the bound
+ * \param position current position of the bound in the axis, set to newPosition
+ * \param newPosition position of the new bound
+ * \param lower true for the minimum, positions below it are outside. For the maximum the
+ * positions from it on are outside
+ */
+void TDK_IncrementalPassthrough::mf_MoveBound(Axis &axis, int &position, const int newPosition, const bool lower)
+{
+    const int first = std::min(position, newPosition);
+    const int last = std::max(position, newPosition);
+    const bool leaving = lower ? newPosition > position : newPosition < position;
+
+    for(int p = first; p < last; p++){
+        const int index = axis.indices[p];
+        if(leaving){
+            if(mv_Outside[index]++ == 0){
+                mf_Deselect(index);
+                mv_NumberOfChangedPoints++;
+            }
+        }
+        else if(--mv_Outside[index] == 0){
+            mf_Select(index);
+            mv_NumberOfChangedPoints++;
+        }
+    }
+
+    position = newPosition;
+}
+
+void TDK_IncrementalPassthrough::mf_Select(const int index)
+{
+    mv_SelectedPosition[index] = static_cast<int>(mv_Selected.size());
+    mv_Selected.push_back(index);
+    mv_FilteredCloud->points.push_back(mv_Cloud->points[index]);
+}
+
+//The last point takes the place of the removed one
+void TDK_IncrementalPassthrough::mf_Deselect(const int index)
+{
+    const int position = mv_SelectedPosition[index];
+    const int last = mv_Selected.back();
+
+    mv_Selected[position] = last;
+    mv_SelectedPosition[last] = position;
+    mv_FilteredCloud->points[position] = mv_FilteredCloud->points.back();
+
+    mv_Selected.pop_back();
+    mv_FilteredCloud->points.pop_back();
+    mv_SelectedPosition[index] = -1;
+}
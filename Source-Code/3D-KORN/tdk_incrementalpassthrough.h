@@ -0,0 +1,85 @@
+#ifndef TDK_INCREMENTALPASSTHROUGH_H
+#define TDK_INCREMENTALPASSTHROUGH_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * \brief The TDK_IncrementalPassthrough class
+ *
+ * Passthrough box for slider driven cropping. The points are sorted once per axis when the
+ * cloud is set, after that a bound change only visits the points between the old and the new
+ * bound in the order of that axis, instead of filtering the whole cloud again. Moving a slider
+ * by one step of 255 costs a few thousand points on a multi-million point cloud.
+ *
+ * Every point counts the bounds it is outside of, it is in the box when the count is 0. The
+ * points in the box are kept in a list and in a cloud that are updated with the points that
+ * enter or leave the box, their order is not the order of the input. mf_ExtractFilteredCloud
+ * gives the points in the input order, as TDK_Filters::mf_FilterCropBox does, but visits the
+ * whole cloud.
+ *
+ * The slider functions map the 0-255 positions like TDK_Filters::FilterPCPassthrough. Positions
+ * with lowerBounds set move the minimum of each axis from the maximum of the range down to its
+ * minimum, the others move the maximum from the minimum of the range up to its maximum.
+ *
+ * Use example
+ * TDK_IncrementalPassthrough passthrough;
+ * passthrough.mf_SetInputCloud(registeredCloud);
+ * passthrough.mf_SetSliderRange(minx, maxx, miny, maxy, minz, maxz);
+ * passthrough.mf_SetSliderPositions(true, xi, yi, zi);
+ * viewer->updatePointCloud(passthrough.mf_GetFilteredCloud(), "cropped");
+ */
+class TDK_IncrementalPassthrough
+{
+public:
+    TDK_IncrementalPassthrough();
+    ~TDK_IncrementalPassthrough();
+
+    //Sorts the points per axis, all finite points are in the box until bounds are set
+    void    mf_SetInputCloud                (const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud);
+
+    void    mf_SetBounds                    (float x1, float x2, float y1, float y2, float z1, float z2);
+
+    void    mf_SetSliderRange               (const double &minx, const double &maxx, const double &miny,
+                                             const double &maxy, const double &minz, const double &maxz);
+    void    mf_SetSliderPositions           (const bool lowerBounds, const unsigned int xi, const unsigned int yi, const unsigned int zi);
+
+    int     mf_GetNumberOfFilteredPoints    () const    {   return static_cast<int>(mv_Selected.size());    }
+    //Points that entered or left the box with the last bound change
+    int     mf_GetNumberOfChangedPoints     () const    {   return mv_NumberOfChangedPoints;    }
+
+    //Indices of the input points in the box, in the order of mf_GetFilteredCloud
+    const std::vector<int>&                 mf_GetFilteredIndices   () const    {   return mv_Selected; }
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr  mf_GetFilteredCloud     () const    {   return mv_FilteredCloud;    }
+
+    void    mf_ExtractFilteredCloud         (pcl::PointCloud<pcl::PointXYZRGB> &cloud_filtered) const;
+
+private:
+    struct Axis
+    {
+        std::vector<float>  values;         //finite coordinates, ascending
+        std::vector<int>    indices;        //input index of every value
+        int                 lower;          //first position not below the minimum
+        int                 upper;          //first position above the maximum
+        float               minimum;
+        float               maximum;
+    };
+
+    pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr mv_Cloud;
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr  mv_FilteredCloud;
+    Axis                                    mv_Axes[3];
+    std::vector<uint8_t>                    mv_Outside;         //bounds every point is outside of
+    std::vector<int>                        mv_Selected;
+    std::vector<int>                        mv_SelectedPosition;    //position in mv_Selected, -1 outside the box
+    int                                     mv_NumberOfChangedPoints;
+    double                                  mv_RangeMinimum[3];
+    double                                  mv_RangeMaximum[3];
+
+    void    mf_MoveBound                    (Axis &axis, int &position, const int newPosition, const bool lower);
+    void    mf_Select                       (const int index);
+    void    mf_Deselect                     (const int index);
+};
+
+#endif // TDK_INCREMENTALPASSTHROUGH_H
@@ -0,0 +1,31 @@
+#ifndef TDK_KINECTV2INTRINSICS_H
+#define TDK_KINECTV2INTRINSICS_H
+
+/*!
+ * \brief Depth camera intrinsics of the Kinect V2
+ *
+ * Kept apart from kinect2_grabber.h, code that only projects recorded views (registration,
+ * TSDF fusion, 2D feature matching) then builds without the Kinect SDK.
+ *
+ * Use example
+ * int u = static_cast<int>(std::lround(TDK_KinectV2Intrinsics::fx * p.x / p.z + TDK_KinectV2Intrinsics::cx));
+ */
+namespace TDK_KinectV2Intrinsics
+{
+    //Depth frame size in pixels
+    const int depthWidth = 512;
+    const int depthHeight = 424;
+
+    //Camera properties for coordinates transformation
+    const float cx = 254.878f;
+    const float cy = 205.395f;
+    const float fx = 365.456f;
+    const float fy = 365.456f;
+    const float k1 = 0.0905474f;
+    const float k2 = -0.26819f;
+    const float k3 = 0.0950862f;
+    const float p1 = 0.0f;
+    const float p2 = 0.0f;
+}
+
+#endif // TDK_KINECTV2INTRINSICS_H
@@ -8,6 +8,7 @@ TDK_KinectV2Sensor::TDK_KinectV2Sensor() : TDK_Sensor()
     mf_SetupSensor();
     connect(this, SIGNAL(mf_SignalFlagFilterUpdated()), this, SLOT(mf_SlotUpdateFlagFilter()));
     connect(this, SIGNAL(mf_SignalFilterBoxUpdated()), this, SLOT(mf_SlotUpdateFilterBox()));
+    connect(this, SIGNAL(mf_SignalFlagSmoothDepthUpdated()), this, SLOT(mf_SlotUpdateFlagSmoothDepth()));
 }
 
 TDK_KinectV2Sensor::~TDK_KinectV2Sensor()
@@ -62,3 +63,8 @@ void TDK_KinectV2Sensor::mf_SlotUpdateFilterBox()
 {
     mv_Grabber->mf_SetFilterBox(mv_XMin, mv_XMax, mv_YMin, mv_YMax, mv_ZMin, mv_ZMax);
 }
+
+void TDK_KinectV2Sensor::mf_SlotUpdateFlagSmoothDepth()
+{
+    mv_Grabber->mf_SetMvFlagSmoothDepth(mf_GetMvFlagSmoothDepth());
+}
@@ -33,6 +33,7 @@ protected:
 public slots:
     void    mf_SlotUpdateFlagFilter();
     void    mf_SlotUpdateFilterBox();
+    void    mf_SlotUpdateFlagSmoothDepth();
 
 };
 
@@ -1,7 +1,14 @@
 
 #include "tdk_meshing.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace pcl;
 
+QThreadStorage<TDK_FilterPipeline*> TDK_Meshing::mv_PreparePipelines;
+
 TDK_Meshing::TDK_Meshing()
 {
 
@@ -22,7 +29,12 @@ void TDK_Meshing::mf_NormalEstimation(PointCloud<PointXYZ>::Ptr &mv_PointCloudIn
     cout << "begin normal estimation" << endl;
     NormalEstimationOMP<PointXYZ, Normal> mv_Normal;
 
-    mv_Normal.setNumberOfThreads(8);
+    //Follows the OpenMP budget of the calling thread, the processing queue limits it per session
+#ifdef _OPENMP
+    mv_Normal.setNumberOfThreads(omp_get_max_threads());
+#else
+    mv_Normal.setNumberOfThreads(1);
+#endif
     mv_Normal.setSearchMethod(mv_Tree);
     mv_Normal.setInputCloud(mv_PointCloudInput);
     mv_Normal.setRadiusSearch(0.3);
@@ -53,16 +65,31 @@ void TDK_Meshing::mf_ConvertFromXYZRGBtoXYZ(const PointCloud<pcl::PointXYZRGB>::
 }
 
 
+//Cleans the cloud before the normal estimation of every meshing function
+void TDK_Meshing::mf_PrepareCloud(const PointCloud<PointXYZ>::Ptr &mv_PointCloudInput,
+                                  PointCloud<PointXYZ>::Ptr &mv_PointCloudOutput){
+
+    mf_PreparePipeline().mf_Process(mv_PointCloudInput, mv_PointCloudOutput);
+}
+
+TDK_FilterPipeline& TDK_Meshing::mf_PreparePipeline(){
+
+    if(!mv_PreparePipelines.hasLocalData()){
+        TDK_FilterPipeline *mv_Pipeline = new TDK_FilterPipeline;
+        mv_Pipeline->mf_AddOutlierRemoval(5);
+        mv_Pipeline->mf_AddMLSSmoothing(0.07);
+        mv_PreparePipelines.setLocalData(mv_Pipeline);
+    }
+    return *mv_PreparePipelines.localData();
+}
+
+
 void TDK_Meshing::mf_Poisson(const PointCloud<PointXYZ>::Ptr &mv_PointCloudInput,
                                    pcl::PolygonMesh::Ptr &mv_MeshesOutput1){
     
-    //Perform statistical outlier removal
-    pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterStatisticalOutlierRemoval(mv_PointCloudInput, mv_cloud_filtered, 5);
-    
-    //Apply the MLS smoothing filter
+    //Statistical outlier removal and MLS smoothing
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_smoothed (new  pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterMLSSmoothing(mv_cloud_filtered, mv_cloud_smoothed, 0.07);
+    TDK_Meshing::mf_PrepareCloud(mv_PointCloudInput, mv_cloud_smoothed);
 
     //Obtain a normal point estimation
     pcl::PointCloud<pcl::PointNormal>::Ptr mv_PointNormal1(new pcl::PointCloud<pcl::PointNormal>());
@@ -95,13 +122,9 @@ void TDK_Meshing::mf_Poisson(const PointCloud<PointXYZRGB>::Ptr &mv_PointCloudIn
     PointCloud<PointXYZ>::Ptr mv_PointCloudInput  (new PointCloud<PointXYZ>) ;
     TDK_Meshing::mf_ConvertFromXYZRGBtoXYZ(mv_PointCloudInputRGB, mv_PointCloudInput) ;
     
-    //Perform statistical outlier removal
-    pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterStatisticalOutlierRemoval(mv_PointCloudInput, mv_cloud_filtered, 5);
-    
-    //Apply the MLS smoothing filter
+    //Statistical outlier removal and MLS smoothing
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_smoothed (new  pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterMLSSmoothing(mv_cloud_filtered, mv_cloud_smoothed, 0.07);
+    TDK_Meshing::mf_PrepareCloud(mv_PointCloudInput, mv_cloud_smoothed);
 
     //Obtain a normal point estimation
     pcl::PointCloud<pcl::PointNormal>::Ptr mv_PointNormal1(new pcl::PointCloud<pcl::PointNormal>());
@@ -130,13 +153,9 @@ void TDK_Meshing::mf_Poisson(const PointCloud<PointXYZRGB>::Ptr &mv_PointCloudIn
 void TDK_Meshing::mf_Greedy_Projection_Triangulation(const PointCloud<PointXYZ>::Ptr &mv_PointCloudInput,
                                          pcl::PolygonMesh::Ptr &mv_MeshesOutput1){
     
-    //Perform statistical outlier removal
-    pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterStatisticalOutlierRemoval(mv_PointCloudInput, mv_cloud_filtered, 5);
-    
-    //Apply the MLS smoothing filter
+    //Statistical outlier removal and MLS smoothing
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_smoothed (new  pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterMLSSmoothing(mv_cloud_filtered, mv_cloud_smoothed, 0.07);
+    TDK_Meshing::mf_PrepareCloud(mv_PointCloudInput, mv_cloud_smoothed);
 
     //Obtain a normal point estimation
     pcl::PointCloud<pcl::PointNormal>::Ptr mv_PointNormal1(new pcl::PointCloud<pcl::PointNormal>());
@@ -176,13 +195,9 @@ void TDK_Meshing::mf_Greedy_Projection_Triangulation(const PointCloud<PointXYZRG
     PointCloud<PointXYZ>::Ptr mv_PointCloudInput  (new PointCloud<PointXYZ>) ;
     TDK_Meshing::mf_ConvertFromXYZRGBtoXYZ(mv_PointCloudInputRGB, mv_PointCloudInput);
 
-    //Perform statistical outlier removal
-    pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterStatisticalOutlierRemoval(mv_PointCloudInput, mv_cloud_filtered, 5);
-    
-    //Apply the MLS smoothing filter
+    //Statistical outlier removal and MLS smoothing
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_smoothed (new  pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterMLSSmoothing(mv_cloud_filtered, mv_cloud_smoothed, 0.07);
+    TDK_Meshing::mf_PrepareCloud(mv_PointCloudInput, mv_cloud_smoothed);
 
     //Obtain a normal point estimation
     pcl::PointCloud<pcl::PointNormal>::Ptr mv_PointNormal1(new pcl::PointCloud<pcl::PointNormal>());
@@ -217,13 +232,9 @@ void TDK_Meshing::mf_Greedy_Projection_Triangulation(const PointCloud<PointXYZRG
 void TDK_Meshing::mf_Grid_Projection(const pcl::PointCloud<pcl::PointXYZ>::Ptr &mv_PointCloudInput,
                                      pcl::PolygonMesh::Ptr &mv_MeshesOutput1){
     
-    //Perform statistical outlier removal
-    pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterStatisticalOutlierRemoval(mv_PointCloudInput, mv_cloud_filtered, 5);
-    
-    //Apply the MLS smoothing filter
+    //Statistical outlier removal and MLS smoothing
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_smoothed (new  pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterMLSSmoothing(mv_cloud_filtered, mv_cloud_smoothed, 0.07);
+    TDK_Meshing::mf_PrepareCloud(mv_PointCloudInput, mv_cloud_smoothed);
 
     //Obtain a normal point estimation
     pcl::PointCloud<pcl::PointNormal>::Ptr mv_PointNormal1(new pcl::PointCloud<pcl::PointNormal>());
@@ -255,13 +266,9 @@ void TDK_Meshing::mf_Grid_Projection(const pcl::PointCloud<pcl::PointXYZRGB>::Pt
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_PointCloudInput  (new pcl::PointCloud<pcl::PointXYZ>) ;
     TDK_Meshing::mf_ConvertFromXYZRGBtoXYZ(mv_PointCloudInputRGB, mv_PointCloudInput) ;
     
-    //Perform statistical outlier removal
-    pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterStatisticalOutlierRemoval(mv_PointCloudInput, mv_cloud_filtered, 5);
-    
-    //Apply the MLS smoothing filter
+    //Statistical outlier removal and MLS smoothing
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_smoothed (new  pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterMLSSmoothing(mv_cloud_filtered, mv_cloud_smoothed, 0.07);
+    TDK_Meshing::mf_PrepareCloud(mv_PointCloudInput, mv_cloud_smoothed);
 
 
     //Obtain a normal point estimation
@@ -292,13 +299,9 @@ void TDK_Meshing::mf_Marching_Cubes(const pcl::PointCloud<pcl::PointXYZ>::Ptr &m
                                      pcl::PolygonMesh::Ptr &mv_MeshesOutput1){
     qDebug()<<"inside marching cubes";
     
-    //Perform statistical outlier removal
-    pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterStatisticalOutlierRemoval(mv_PointCloudInput, mv_cloud_filtered, 5);
-    
-    //Apply the MLS smoothing filter
+    //Statistical outlier removal and MLS smoothing
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_smoothed (new  pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterMLSSmoothing(mv_cloud_filtered, mv_cloud_smoothed, 0.07);
+    TDK_Meshing::mf_PrepareCloud(mv_PointCloudInput, mv_cloud_smoothed);
     
     //Obtain a normal point estimation
     pcl::PointCloud<pcl::PointNormal>::Ptr mv_PointNormal1(new pcl::PointCloud<pcl::PointNormal>());
@@ -331,13 +334,9 @@ void TDK_Meshing::mf_Marching_Cubes(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_PointCloudInput  (new pcl::PointCloud<pcl::PointXYZ>) ;
     TDK_Meshing::mf_ConvertFromXYZRGBtoXYZ(mv_PointCloudInputRGB, mv_PointCloudInput) ;
     
-    //Perform statistical outlier removal
-    pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_filtered (new pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterStatisticalOutlierRemoval(mv_PointCloudInput, mv_cloud_filtered, 5);
-    
-    //Apply the MLS smoothing filter
+    //Statistical outlier removal and MLS smoothing
     pcl::PointCloud<pcl::PointXYZ>::Ptr mv_cloud_smoothed (new  pcl::PointCloud<pcl::PointXYZ>);
-    TDK_Filters::mf_FilterMLSSmoothing(mv_cloud_filtered, mv_cloud_smoothed, 0.07);
+    TDK_Meshing::mf_PrepareCloud(mv_PointCloudInput, mv_cloud_smoothed);
     
     //Obtain a normal point estimation
     pcl::PointCloud<pcl::PointNormal>::Ptr mv_PointNormal1(new pcl::PointCloud<pcl::PointNormal>());
@@ -364,3 +363,32 @@ void TDK_Meshing::mf_Marching_Cubes(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr
     
 }
 
+
+//TSDF fusion integrates every registered view at its pose in a truncated signed distance volume
+//and extracts the mesh directly, outlier removal, MLS and Poisson on the merged cloud are not needed
+bool TDK_Meshing::mf_TSDF_Fusion(const std::vector<PointCloud<PointXYZRGB>::Ptr> &mv_Views,
+                                 const std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > &mv_Poses,
+                                 pcl::PolygonMesh::Ptr &mv_MeshesOutput,
+                                 const float mv_VoxelSize, const float mv_TruncationDistance,
+                                 const std::function<void(double)> &mv_Progress){
+
+    if(mv_Views.empty() || mv_Views.size() != mv_Poses.size()){
+        qDebug()<<"TSDF fusion needs the pose of every view";
+        return false;
+    }
+
+    TDK_TSDFVolume mv_Volume(mv_VoxelSize, mv_TruncationDistance);
+    for(size_t i = 0; i < mv_Views.size(); ++i){
+        //Views have to be Kinect depth frames in their camera frame
+        if(!mv_Volume.mf_Integrate(mv_Views[i], mv_Poses[i]))
+            qDebug()<<"TSDF fusion skipped view"<<i<<", it is not a depth frame of the sensor";
+        //Fraction of the views integrated, the mesh extraction is the last step
+        if(mv_Progress)
+            mv_Progress(double(i + 1) / (mv_Views.size() + 1));
+    }
+
+    mv_Volume.mf_ExtractMesh(*mv_MeshesOutput);
+    qDebug()<<"finished TSDF fusion with"<<mv_Volume.mf_GetNumberOfBlocks()<<"blocks and"<<mv_MeshesOutput->polygons.size()<<"triangles";
+
+    return !mv_MeshesOutput->polygons.empty();
+}
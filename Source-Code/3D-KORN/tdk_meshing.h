@@ -3,6 +3,8 @@
 #define TDK_MESHING_H
 
 #include <QDebug>
+#include <QThreadStorage>
+#include <functional>
 #include <pcl/features/normal_3d_omp.h>
 #include <pcl/PolygonMesh.h>
 #include <pcl/common/projection_matrix.h>
@@ -14,7 +16,9 @@
 #include <pcl/surface/vtk_smoothing/vtk_mesh_smoothing_laplacian.h>
 #include <pcl/surface/marching_cubes_hoppe.h>
 
+#include "tdk_filterpipeline.h"
 #include "tdk_filters.h"
+#include "tdk_tsdfvolume.h"
 
 using namespace pcl;
 
@@ -49,6 +53,22 @@ public:
     static void mf_Marching_Cubes(const PointCloud<PointXYZRGB>::Ptr &mv_PointCloudInputRGB,
                                        pcl::PolygonMesh::Ptr &mv_MeshesOutput);
 
+    //for registered views with their poses, replaces merging, cleaning and meshing the merged cloud
+    static bool mf_TSDF_Fusion(const std::vector<PointCloud<PointXYZRGB>::Ptr> &mv_Views,
+                                       const std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > &mv_Poses,
+                                       pcl::PolygonMesh::Ptr &mv_MeshesOutput,
+                                       const float mv_VoxelSize = 0.002, const float mv_TruncationDistance = 0.01,
+                                       const std::function<void(double)> &mv_Progress = std::function<void(double)>());
+
+private:
+    //Outlier removal and MLS smoothing in front of the normal estimation
+    static void mf_PrepareCloud(const PointCloud<PointXYZ>::Ptr &mv_PointCloudInput,
+                                       PointCloud<PointXYZ>::Ptr &mv_PointCloudOutput);
+
+    //Pipeline of mf_PrepareCloud, built once per thread and kept so its buffers are reused.
+    //Sessions of the processing queue mesh in parallel, they must not share one
+    static TDK_FilterPipeline& mf_PreparePipeline();
+    static QThreadStorage<TDK_FilterPipeline*> mv_PreparePipelines;
 };
 
 #endif // TDK_MESHING_H
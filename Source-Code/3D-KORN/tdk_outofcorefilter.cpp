@@ -0,0 +1,1286 @@
+#include "tdk_outofcorefilter.h"
+#include "tdk_filters.h"
+
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+//Points read from the input at a time
+const int ReadChunkPoints = 1 << 18;
+//Cells of the coarse grid along the longest side of the cloud, at first and at most after refining
+const int GridCellsPerSide = 64;
+const int MaxGridCellsPerSide = 256;
+//Write buffer of a block file in points, the buffers of all blocks stay within a quarter of the memory
+const int MinBlockBufferPoints = 1024;
+const int MaxBlockBufferPoints = 65536;
+//Neighbours of the statistical outlier removal, as TDK_Filters uses for colored clouds
+const int DefaultMeanK = 8;
+
+//A point as it is read and spilled to the block files, rgba as in pcl::PointXYZRGB
+struct PointRecord
+{
+    float x, y, z;
+    uint32_t rgba;
+};
+
+enum ValueType
+{
+    Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64
+};
+
+inline int typeSize(const ValueType type)
+{
+    switch(type){
+    case Int8: case UInt8:      return 1;
+    case Int16: case UInt16:    return 2;
+    case Int32: case UInt32:    return 4;
+    case Float32:               return 4;
+    default:                    return 8;
+    }
+}
+
+template<typename T>
+inline double readAs(const char *data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return static_cast<double>(value);
+}
+
+inline double readValue(const char *data, const ValueType type)
+{
+    switch(type){
+    case Int8:      return readAs<int8_t>(data);
+    case UInt8:     return readAs<uint8_t>(data);
+    case Int16:     return readAs<int16_t>(data);
+    case UInt16:    return readAs<uint16_t>(data);
+    case Int32:     return readAs<int32_t>(data);
+    case UInt32:    return readAs<uint32_t>(data);
+    case Float32:   return readAs<float>(data);
+    default:        return readAs<double>(data);
+    }
+}
+
+bool plyType(const QByteArray &name, ValueType &type)
+{
+    if(name == "char" || name == "int8")            type = Int8;
+    else if(name == "uchar" || name == "uint8")     type = UInt8;
+    else if(name == "short" || name == "int16")     type = Int16;
+    else if(name == "ushort" || name == "uint16")   type = UInt16;
+    else if(name == "int" || name == "int32")       type = Int32;
+    else if(name == "uint" || name == "uint32")     type = UInt32;
+    else if(name == "float" || name == "float32")   type = Float32;
+    else if(name == "double" || name == "float64")  type = Float64;
+    else
+        return false;
+    return true;
+}
+
+bool pcdType(const QByteArray &name, const int size, ValueType &type)
+{
+    if(name == "F" && (size == 4 || size == 8))
+        type = size == 4 ? Float32 : Float64;
+    else if(name == "I" && (size == 1 || size == 2 || size == 4))
+        type = size == 1 ? Int8 : (size == 2 ? Int16 : Int32);
+    else if(name == "U" && (size == 1 || size == 2 || size == 4))
+        type = size == 1 ? UInt8 : (size == 2 ? UInt16 : UInt32);
+    else
+        return false;
+    return true;
+}
+
+//A value of a point in the file
+struct Field
+{
+    ValueType type = Float32;
+    int offset = -1;                        //bytes into a binary record, -1 when the file has no such value
+    int token = -1;                         //value on an ASCII line
+};
+
+/*
+ * Reads the vertices of a PLY or the points of a PCD file in chunks, binary little endian or ASCII.
+ * Coordinates x, y, z and the colors red, green, blue or a packed rgb/rgba value are kept, other
+ * values are skipped. The vertices have to be the first element of a PLY file.
+ */
+class PointFileReader
+{
+public:
+    bool mf_Open(const QString &fileName);
+    bool mf_Rewind();
+    //Appends at most maxPoints points, false on a truncated file
+    bool mf_Read(std::vector<PointRecord> &points, int maxPoints);
+
+    bool mf_HasColor() const    {   return color[0].offset >= 0 || packedColor.offset >= 0;  }
+    bool mf_AtEnd() const       {   return remaining == 0;  }
+    int64_t mf_Size() const     {   return numberOfPoints;  }
+
+private:
+    QFile file;
+    bool binary = false;
+    qint64 dataStart = 0;
+    int stride = 0;                         //bytes of a binary record
+    int tokens = 0;                         //values on an ASCII line
+    Field coordinate[3];
+    Field color[3];
+    Field packedColor;
+    int64_t numberOfPoints = 0;
+    int64_t remaining = 0;
+    std::vector<char> buffer;
+    std::vector<double> values;
+
+    bool mf_ParsePLYHeader();
+    bool mf_ParsePCDHeader();
+    void mf_AddField(const QByteArray &name, const ValueType type, const int offset, const int token);
+    void mf_Decode(const double *value, const char *packed, PointRecord &point) const;
+};
+
+bool PointFileReader::mf_Open(const QString &fileName)
+{
+    file.setFileName(fileName);
+    if(!file.open(QIODevice::ReadOnly)){
+        qWarning() << "OutOfCoreFilter: Could not read" << fileName;
+        return false;
+    }
+
+    const bool ply = file.readLine().trimmed() == "ply";
+    if(!ply)
+        file.seek(0);
+    if(!(ply ? mf_ParsePLYHeader() : mf_ParsePCDHeader())){
+        qWarning() << "OutOfCoreFilter: Unsupported or invalid header in" << fileName;
+        return false;
+    }
+    if(coordinate[0].offset < 0 || coordinate[1].offset < 0 || coordinate[2].offset < 0){
+        qWarning() << "OutOfCoreFilter:" << fileName << "has no x, y and z";
+        return false;
+    }
+
+    dataStart = file.pos();
+    remaining = numberOfPoints;
+    values.resize(tokens);
+    return true;
+}
+
+bool PointFileReader::mf_Rewind()
+{
+    remaining = numberOfPoints;
+    return file.seek(dataStart);
+}
+
+void PointFileReader::mf_AddField(const QByteArray &name, const ValueType type, const int offset, const int token)
+{
+    Field field;
+    field.type = type;
+    field.offset = offset;
+    field.token = token;
+
+    static const char *coordinateNames[3] = {"x", "y", "z"};
+    static const char *colorNames[3] = {"red", "green", "blue"};
+    for(int i = 0; i < 3; i++){
+        if(name == coordinateNames[i])
+            coordinate[i] = field;
+        if(name == colorNames[i])
+            color[i] = field;
+    }
+    if((name == "rgb" || name == "rgba") && typeSize(type) == 4)
+        packedColor = field;
+}
+
+bool PointFileReader::mf_ParsePLYHeader()
+{
+    bool vertexElement = false, pastVertexElement = false;
+    int offset = 0, token = 0;
+
+    while(!file.atEnd()){
+        const QList<QByteArray> words = file.readLine().simplified().split(' ');
+
+        if(words[0] == "format" && words.size() > 1){
+            if(words[1] != "ascii" && words[1] != "binary_little_endian")
+                return false;
+            binary = words[1] != "ascii";
+        }
+        else if(words[0] == "element" && words.size() > 2){
+            if(words[1] == "vertex" && !pastVertexElement){
+                vertexElement = true;
+                numberOfPoints = words[2].toLongLong();
+            }
+            else if(!vertexElement)
+                return false;
+            else{
+                vertexElement = false;
+                pastVertexElement = true;
+            }
+        }
+        else if(words[0] == "property" && vertexElement && words.size() > 2){
+            ValueType type;
+            if(words[1] == "list" || !plyType(words[1], type))
+                return false;
+            mf_AddField(words[2], type, offset, token);
+            offset += typeSize(type);
+            token++;
+        }
+        else if(words[0] == "end_header"){
+            stride = offset;
+            tokens = token;
+            return stride > 0;
+        }
+    }
+    return false;
+}
+
+bool PointFileReader::mf_ParsePCDHeader()
+{
+    QList<QByteArray> names, sizes, types, counts;
+
+    while(!file.atEnd()){
+        const QList<QByteArray> words = file.readLine().simplified().split(' ');
+        const QList<QByteArray> arguments = words.mid(1);
+
+        if(words[0] == "FIELDS")
+            names = arguments;
+        else if(words[0] == "SIZE")
+            sizes = arguments;
+        else if(words[0] == "TYPE")
+            types = arguments;
+        else if(words[0] == "COUNT")
+            counts = arguments;
+        else if(words[0] == "POINTS" && words.size() > 1)
+            numberOfPoints = words[1].toLongLong();
+        else if(words[0] == "DATA" && words.size() > 1){
+            if(words[1] != "ascii" && words[1] != "binary")
+                return false;
+            binary = words[1] == "binary";
+            if(names.isEmpty() || sizes.size() != names.size() || types.size() != names.size())
+                return false;
+
+            int offset = 0, token = 0;
+            for(int i = 0; i < names.size(); i++){
+                const int size = sizes[i].toInt();
+                const int count = i < counts.size() ? counts[i].toInt() : 1;
+                ValueType type;
+                if(!pcdType(types[i], size, type) || count < 1)
+                    return false;
+                if(count == 1)
+                    mf_AddField(names[i], type, offset, token);
+                offset += size * count;
+                token += count;
+            }
+            stride = offset;
+            tokens = token;
+            return true;
+        }
+    }
+    return false;
+}
+
+//value holds the value of every token, packed the 4 bytes of a packed color of a binary record
+void PointFileReader::mf_Decode(const double *value, const char *packed, PointRecord &point) const
+{
+    point.x = static_cast<float>(value[0]);
+    point.y = static_cast<float>(value[1]);
+    point.z = static_cast<float>(value[2]);
+    point.rgba = 0xff000000u;
+
+    if(color[0].offset >= 0 && color[1].offset >= 0 && color[2].offset >= 0)
+        point.rgba |= static_cast<uint32_t>(value[3]) << 16 | static_cast<uint32_t>(value[4]) << 8 |
+                      static_cast<uint32_t>(value[5]);
+    else if(packedColor.offset >= 0){
+        uint32_t rgb;
+        if(packed)
+            std::memcpy(&rgb, packed, 4);
+        else if(packedColor.type == Float32){
+            //ASCII PCD writes the float holding the packed bytes
+            const float packedFloat = static_cast<float>(value[6]);
+            std::memcpy(&rgb, &packedFloat, 4);
+        }
+        else
+            rgb = static_cast<uint32_t>(value[6]);
+        point.rgba |= rgb & 0x00ffffffu;
+    }
+}
+
+bool PointFileReader::mf_Read(std::vector<PointRecord> &points, const int maxPoints)
+{
+    const int count = static_cast<int>(std::min<int64_t>(remaining, maxPoints));
+    const Field *fields[7] = {&coordinate[0], &coordinate[1], &coordinate[2], &color[0], &color[1], &color[2], &packedColor};
+    double value[7] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    const size_t first = points.size();
+    points.resize(first + count);
+
+    if(binary){
+        buffer.resize(static_cast<size_t>(count) * stride);
+        if(count > 0 && file.read(&buffer[0], buffer.size()) != static_cast<qint64>(buffer.size())){
+            qWarning() << "OutOfCoreFilter:" << file.fileName() << "is truncated";
+            points.resize(first);
+            return false;
+        }
+        for(int i = 0; i < count; i++){
+            const char *record = &buffer[static_cast<size_t>(i) * stride];
+            for(int f = 0; f < 6; f++)
+                if(fields[f]->offset >= 0)
+                    value[f] = readValue(record + fields[f]->offset, fields[f]->type);
+            mf_Decode(value, packedColor.offset >= 0 ? record + packedColor.offset : nullptr, points[first + i]);
+        }
+    }
+    else{
+        buffer.resize(65536);
+        for(int i = 0; i < count; i++){
+            const qint64 length = file.readLine(&buffer[0], buffer.size());
+            if(length < 0 || (length == 0 && file.atEnd())){
+                qWarning() << "OutOfCoreFilter:" << file.fileName() << "is truncated";
+                points.resize(first + i);
+                return false;
+            }
+
+            char *position = &buffer[0];
+            int parsed = 0;
+            for(; parsed < tokens; parsed++){
+                char *end;
+                values[parsed] = std::strtod(position, &end);
+                if(end == position)
+                    break;
+                position = end;
+            }
+            if(parsed == 0){
+                //Empty line, the file ends before the header's count of points when nothing follows
+                if(file.atEnd()){
+                    qWarning() << "OutOfCoreFilter:" << file.fileName() << "is truncated";
+                    points.resize(first + i);
+                    return false;
+                }
+                i--;
+                continue;
+            }
+            if(parsed < tokens){
+                qWarning() << "OutOfCoreFilter:" << file.fileName() << "has a point with missing values";
+                points.resize(first + i);
+                return false;
+            }
+
+            for(int f = 0; f < 7; f++)
+                if(fields[f]->token >= 0)
+                    value[f] = values[fields[f]->token];
+            mf_Decode(value, nullptr, points[first + i]);
+        }
+    }
+
+    remaining -= count;
+    return true;
+}
+
+/*
+ * Writes a binary PLY or PCD file in pieces. The number of points is only known at the end, it is
+ * written as a fixed width placeholder and patched when the file is closed.
+ */
+class PointFileWriter
+{
+public:
+    bool mf_Open(const QString &fileName, const bool withColor);
+    bool mf_Close();
+
+    template<typename PointT>
+    bool mf_Write(const PointT *points, const int count);
+
+    int64_t mf_Size() const     {   return numberOfPoints;  }
+
+private:
+    QFile file;
+    bool color = false;
+    bool pcd = false;
+    std::vector<qint64> countPositions;
+    int64_t numberOfPoints = 0;
+    std::vector<char> buffer;
+};
+
+const int CountDigits = 10;
+
+bool PointFileWriter::mf_Open(const QString &fileName, const bool withColor)
+{
+    color = withColor;
+    pcd = fileName.endsWith(".pcd", Qt::CaseInsensitive);
+    file.setFileName(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        qWarning() << "OutOfCoreFilter: Could not write" << fileName;
+        return false;
+    }
+
+    const QByteArray placeholder(CountDigits, '0');
+    QByteArray header;
+    if(pcd){
+        header = "# .PCD v0.7 - Point Cloud Data file format\nVERSION 0.7\n";
+        header += color ? "FIELDS x y z rgb\nSIZE 4 4 4 4\nTYPE F F F F\nCOUNT 1 1 1 1\n" :
+                          "FIELDS x y z\nSIZE 4 4 4\nTYPE F F F\nCOUNT 1 1 1\n";
+        header += "WIDTH ";
+        countPositions.push_back(header.size());
+        header += placeholder + "\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS ";
+        countPositions.push_back(header.size());
+        header += placeholder + "\nDATA binary\n";
+    }
+    else{
+        header = "ply\nformat binary_little_endian 1.0\nelement vertex ";
+        countPositions.push_back(header.size());
+        header += placeholder + "\nproperty float x\nproperty float y\nproperty float z\n";
+        if(color)
+            header += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+        header += "end_header\n";
+    }
+
+    return file.write(header) == header.size();
+}
+
+template<typename PointT>
+bool PointFileWriter::mf_Write(const PointT *points, const int count)
+{
+    const int pointSize = pcd ? (color ? 16 : 12) : (color ? 15 : 12);
+    buffer.resize(static_cast<size_t>(count) * pointSize);
+
+    char *output = buffer.empty() ? nullptr : &buffer[0];
+    for(int i = 0; i < count; i++, output += pointSize){
+        std::memcpy(output, &points[i].x, 4);
+        std::memcpy(output + 4, &points[i].y, 4);
+        std::memcpy(output + 8, &points[i].z, 4);
+        if(color && pcd)
+            std::memcpy(output + 12, &points[i].rgba, 4);
+        else if(color){
+            output[12] = static_cast<char>((points[i].rgba >> 16) & 0xff);
+            output[13] = static_cast<char>((points[i].rgba >> 8) & 0xff);
+            output[14] = static_cast<char>(points[i].rgba & 0xff);
+        }
+    }
+
+    numberOfPoints += count;
+    return count == 0 || file.write(&buffer[0], buffer.size()) == static_cast<qint64>(buffer.size());
+}
+
+bool PointFileWriter::mf_Close()
+{
+    const QByteArray count = QByteArray::number(static_cast<qlonglong>(numberOfPoints)).rightJustified(CountDigits, '0');
+    bool written = count.size() == CountDigits;
+    for(size_t i = 0; i < countPositions.size() && written; i++)
+        written = file.seek(countPositions[i]) && file.write(count) == CountDigits;
+
+    file.close();
+    if(!written)
+        qWarning() << "OutOfCoreFilter: Could not write the number of points of" << file.fileName();
+    return written && file.error() == QFileDevice::NoError;
+}
+
+struct Block
+{
+    int lower[3];                           //first cell
+    int upper[3];                           //cell past the last one
+    int64_t points = 0;
+    int64_t pointsWithHalo = 0;             //upper bound from whole cells
+};
+
+/*
+ * Coarse grid of cubic cells over the cropped cloud. Every cell belongs to one block, a box of
+ * cells. With a voxel grid the cells are a whole number of voxels wide and a point goes to the
+ * cell of its voxel, so no voxel is split between blocks.
+ */
+struct BlockGrid
+{
+    float origin[3];
+    float cellSize;
+    float inverseCellSize;
+    int dimensions[3];
+
+    bool voxelAligned = false;
+    float inverseLeafSize = 0.0;
+    int originVoxel[3];
+    int cellVoxels = 1;
+
+    std::vector<int64_t> counts;            //points per cell
+    std::vector<int64_t> prefix;            //summed volume of counts, one extra layer per axis
+    std::vector<int> cellBlock;
+    std::vector<Block> blocks;
+
+    inline int mf_Index(const int x, const int y, const int z) const
+    {
+        return (z * dimensions[1] + y) * dimensions[0] + x;
+    }
+
+    inline int mf_Cell(const PointRecord &point, int cell[3]) const
+    {
+        const float coordinates[3] = {point.x, point.y, point.z};
+        for(int i = 0; i < 3; i++){
+            if(voxelAligned){
+                //Voxel as TDK_Filters computes it
+                const int voxel = static_cast<int>(std::floor(coordinates[i] * inverseLeafSize));
+                cell[i] = (voxel - originVoxel[i]) / cellVoxels;
+            }
+            else
+                cell[i] = static_cast<int>(std::floor((coordinates[i] - origin[i]) * inverseCellSize));
+            cell[i] = std::min(std::max(cell[i], 0), dimensions[i] - 1);
+        }
+        return mf_Index(cell[0], cell[1], cell[2]);
+    }
+
+    inline int64_t mf_Prefix(const int x, const int y, const int z) const
+    {
+        return prefix[(static_cast<size_t>(z) * (dimensions[1] + 1) + y) * (dimensions[0] + 1) + x];
+    }
+
+    int64_t mf_Count(const int lower[3], const int upper[3]) const
+    {
+        return mf_Prefix(upper[0], upper[1], upper[2]) - mf_Prefix(lower[0], upper[1], upper[2]) -
+               mf_Prefix(upper[0], lower[1], upper[2]) - mf_Prefix(upper[0], upper[1], lower[2]) +
+               mf_Prefix(lower[0], lower[1], upper[2]) + mf_Prefix(lower[0], upper[1], lower[2]) +
+               mf_Prefix(upper[0], lower[1], lower[2]) - mf_Prefix(lower[0], lower[1], lower[2]);
+    }
+
+    void mf_BuildPrefix()
+    {
+        const int sx = dimensions[0] + 1, sy = dimensions[1] + 1, sz = dimensions[2] + 1;
+        prefix.assign(static_cast<size_t>(sx) * sy * sz, 0);
+        for(int z = 1; z < sz; z++)
+            for(int y = 1; y < sy; y++)
+                for(int x = 1; x < sx; x++)
+                    prefix[(static_cast<size_t>(z) * sy + y) * sx + x] = counts[mf_Index(x - 1, y - 1, z - 1)] +
+                            mf_Prefix(x - 1, y, z) + mf_Prefix(x, y - 1, z) + mf_Prefix(x, y, z - 1) -
+                            mf_Prefix(x - 1, y - 1, z) - mf_Prefix(x - 1, y, z - 1) - mf_Prefix(x, y - 1, z - 1) +
+                            mf_Prefix(x - 1, y - 1, z - 1);
+    }
+
+    //Euclidean distance from a point to the box of a block
+    inline float mf_BlockDistance(const Block &block, const PointRecord &point) const
+    {
+        const float coordinates[3] = {point.x, point.y, point.z};
+        float squaredDistance = 0.0;
+        for(int i = 0; i < 3; i++){
+            const float low = origin[i] + block.lower[i] * cellSize, high = origin[i] + block.upper[i] * cellSize;
+            const float outside = std::max(low - coordinates[i], std::max(coordinates[i] - high, 0.0f));
+            squaredDistance += outside * outside;
+        }
+        return std::sqrt(squaredDistance);
+    }
+
+    //Distance from a point of a block to the sides it shares with other blocks
+    inline float mf_BorderDistance(const Block &block, const PointRecord &point) const
+    {
+        const float coordinates[3] = {point.x, point.y, point.z};
+        float distance = std::numeric_limits<float>::max();
+        for(int i = 0; i < 3; i++){
+            if(block.lower[i] > 0)
+                distance = std::min(distance, coordinates[i] - (origin[i] + block.lower[i] * cellSize));
+            if(block.upper[i] < dimensions[i])
+                distance = std::min(distance, origin[i] + block.upper[i] * cellSize - coordinates[i]);
+        }
+        return std::max(distance, 0.0f);
+    }
+};
+
+/*
+ * Splits a box of cells at the middle of its points along its longest side until the points of
+ * every part and of the cells of its halo fit in maxPoints, or the part is a single cell.
+ */
+void splitBlocks(BlockGrid &grid, const int lower[3], const int upper[3], const int haloCells, const int64_t maxPoints)
+{
+    Block block;
+    int expandedLower[3], expandedUpper[3];
+    for(int i = 0; i < 3; i++){
+        block.lower[i] = lower[i];
+        block.upper[i] = upper[i];
+        expandedLower[i] = std::max(0, lower[i] - haloCells);
+        expandedUpper[i] = std::min(grid.dimensions[i], upper[i] + haloCells);
+    }
+    block.points = grid.mf_Count(lower, upper);
+    if(block.points == 0)
+        return;
+    block.pointsWithHalo = grid.mf_Count(expandedLower, expandedUpper);
+
+    int axis = 0;
+    for(int i = 1; i < 3; i++)
+        if(upper[i] - lower[i] > upper[axis] - lower[axis])
+            axis = i;
+
+    if(block.pointsWithHalo <= maxPoints || upper[axis] - lower[axis] == 1){
+        grid.blocks.push_back(block);
+        return;
+    }
+
+    int split = lower[axis] + 1;
+    int64_t bestDifference = std::numeric_limits<int64_t>::max();
+    int partUpper[3] = {upper[0], upper[1], upper[2]};
+    for(int s = lower[axis] + 1; s < upper[axis]; s++){
+        partUpper[axis] = s;
+        const int64_t difference = std::abs(2 * grid.mf_Count(lower, partUpper) - block.points);
+        if(difference < bestDifference){
+            bestDifference = difference;
+            split = s;
+        }
+    }
+
+    int partLower[3] = {lower[0], lower[1], lower[2]};
+    partUpper[axis] = split;
+    partLower[axis] = split;
+    splitBlocks(grid, lower, partUpper, haloCells, maxPoints);
+    splitBlocks(grid, partLower, upper, haloCells, maxPoints);
+}
+
+inline bool insideCropBoxes(const PointRecord &point, const std::vector<std::vector<float> > &boxes)
+{
+    if(!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+        return false;
+    for(size_t i = 0; i < boxes.size(); i++){
+        const std::vector<float> &box = boxes[i];
+        if(point.x < box[0] || point.x > box[1] || point.y < box[2] || point.y > box[3] || point.z < box[4] || point.z > box[5])
+            return false;
+    }
+    return true;
+}
+
+//Reads the next chunk and drops the points outside the crop boxes
+bool readCropped(PointFileReader &reader, std::vector<PointRecord> &points, const std::vector<std::vector<float> > &boxes)
+{
+    points.clear();
+    if(!reader.mf_Read(points, ReadChunkPoints))
+        return false;
+    points.erase(std::remove_if(points.begin(), points.end(),
+                                [&boxes](const PointRecord &point){ return !insideCropBoxes(point, boxes); }), points.end());
+    return true;
+}
+
+bool appendFile(const QString &fileName, const void *data, const qint64 bytes)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(static_cast<const char*>(data), bytes) != bytes){
+        qWarning() << "OutOfCoreFilter: Could not write the temporary file" << fileName;
+        return false;
+    }
+    return true;
+}
+
+//Appends the content of a block file, a missing file has no points
+template<typename T>
+bool loadFile(const QString &fileName, std::vector<T> &values)
+{
+    QFile file(fileName);
+    if(!file.exists())
+        return true;
+    if(!file.open(QIODevice::ReadOnly)){
+        qWarning() << "OutOfCoreFilter: Could not read the temporary file" << fileName;
+        return false;
+    }
+    const size_t first = values.size(), count = static_cast<size_t>(file.size()) / sizeof(T);
+    values.resize(first + count);
+    const qint64 bytes = static_cast<qint64>(count * sizeof(T));
+    return count == 0 || file.read(reinterpret_cast<char*>(&values[first]), bytes) == bytes;
+}
+
+pcl::PointCloud<pcl::PointXYZ>::Ptr toPositions(const std::vector<PointRecord> &points)
+{
+    pcl::PointCloud<pcl::PointXYZ>::Ptr positions (new pcl::PointCloud<pcl::PointXYZ>);
+    positions->points.resize(points.size());
+    for(size_t i = 0; i < points.size(); i++)
+        positions->points[i] = pcl::PointXYZ(points[i].x, points[i].y, points[i].z);
+    positions->width = static_cast<uint32_t>(positions->points.size());
+    positions->height = 1;
+    return positions;
+}
+
+//A point of the statistical outlier removal whose kNN may reach past the halo of its block
+struct HaloMiss
+{
+    int block = 0;
+    int index = 0;                          //in the points of the block
+    PointRecord point;
+    float bound = 0.0;                      //squared distance of the last kNN within the block and its halo
+    float distance = 0.0;                   //mean kNN distance
+    std::vector<float> nearest;             //squared distances of the kNN over all blocks
+};
+
+void toCloud(const std::vector<PointRecord> &points, pcl::PointCloud<pcl::PointXYZRGB> &cloud)
+{
+    cloud.points.resize(points.size());
+    for(size_t i = 0; i < points.size(); i++){
+        pcl::PointXYZRGB &point = cloud.points[i];
+        point.x = points[i].x;
+        point.y = points[i].y;
+        point.z = points[i].z;
+        point.rgba = points[i].rgba;
+    }
+    cloud.width = static_cast<uint32_t>(cloud.points.size());
+    cloud.height = 1;
+    cloud.is_dense = true;
+}
+}
+
+TDK_OutOfCoreFilter::TDK_OutOfCoreFilter() :
+    mv_OutlierRemoval(NoOutlierRemoval),
+    mv_OutlierThreshold(2.5),
+    mv_OutlierMeanK(DefaultMeanK),
+    mv_Radius(0.0),
+    mv_MinNeighbors(5),
+    mv_LeafSize(0.0),
+    mv_NearestToCentroid(false),
+    mv_MaxPointsInMemory(10000000),
+    mv_Halo(0.01)
+{
+
+}
+
+TDK_OutOfCoreFilter::~TDK_OutOfCoreFilter()
+{
+
+}
+
+void TDK_OutOfCoreFilter::mf_AddCropBox(float x1, float x2, float y1, float y2, float z1, float z2)
+{
+    const float bounds[6] = {x1, x2, y1, y2, z1, z2};
+    mv_CropBoxes.push_back(std::vector<float>(bounds, bounds + 6));
+}
+
+void TDK_OutOfCoreFilter::mf_SetOutlierRemoval(float threshold, int meanK)
+{
+    mv_OutlierRemoval = StatisticalOutlierRemoval;
+    mv_OutlierThreshold = threshold;
+    mv_OutlierMeanK = meanK > 0 ? meanK : DefaultMeanK;
+}
+
+void TDK_OutOfCoreFilter::mf_SetRadiusOutlierRemoval(float radius, int minNeighbors)
+{
+    mv_OutlierRemoval = RadiusOutlierRemoval;
+    mv_Radius = radius;
+    mv_MinNeighbors = minNeighbors;
+}
+
+void TDK_OutOfCoreFilter::mf_SetVoxelGrid(float leafSize, bool nearestToCentroid)
+{
+    mv_LeafSize = leafSize;
+    mv_NearestToCentroid = nearestToCentroid;
+}
+
+void TDK_OutOfCoreFilter::mf_Clear()
+{
+    mv_CropBoxes.clear();
+    mv_OutlierRemoval = NoOutlierRemoval;
+    mv_LeafSize = 0.0;
+}
+
+/*!
+ * \brief TDK_OutOfCoreFilter::mf_SetStages
+ * \param stages parsed by TDK_FilterPipeline, approximate outlier removals run exact
+ * \return false for transforms, MLS smoothing or stages in another order, the filters are unchanged then
+ */
+bool TDK_OutOfCoreFilter::mf_SetStages(const std::vector<TDK_FilterPipeline::Stage> &stages)
+{
+    //Crop boxes first, outlier removal second, voxel grid last
+    int previousRank = 0;
+    for(size_t i = 0; i < stages.size(); i++){
+        int rank;
+        switch(stages[i].type){
+        case TDK_FilterPipeline::Stage::CropBox:                rank = 0; break;
+        case TDK_FilterPipeline::Stage::OutlierRemoval:
+        case TDK_FilterPipeline::Stage::RadiusOutlierRemoval:   rank = 1; break;
+        case TDK_FilterPipeline::Stage::VoxelGrid:              rank = 2; break;
+        default:
+            qWarning() << "OutOfCoreFilter: Transforms and MLS smoothing do not run out of core";
+            return false;
+        }
+        if(rank < previousRank || (rank > 0 && rank == previousRank)){
+            qWarning() << "OutOfCoreFilter: Needs crop boxes, then at most one outlier removal, then at most one voxel grid";
+            return false;
+        }
+        previousRank = rank;
+    }
+
+    mf_Clear();
+    for(size_t i = 0; i < stages.size(); i++){
+        const TDK_FilterPipeline::Stage &stage = stages[i];
+        if(stage.type == TDK_FilterPipeline::Stage::CropBox)
+            mf_AddCropBox(stage.bounds[0], stage.bounds[1], stage.bounds[2], stage.bounds[3], stage.bounds[4], stage.bounds[5]);
+        else if(stage.type == TDK_FilterPipeline::Stage::OutlierRemoval)
+            mf_SetOutlierRemoval(stage.threshold, stage.meanK);
+        else if(stage.type == TDK_FilterPipeline::Stage::RadiusOutlierRemoval)
+            mf_SetRadiusOutlierRemoval(stage.radius, stage.minNeighbors);
+        else
+            mf_SetVoxelGrid(stage.leafSize, stage.nearestToCentroid);
+    }
+    return true;
+}
+
+/*!
+ * \brief TDK_OutOfCoreFilter::mf_LoadConfig
+ * \param fileName JSON configuration of the batch processor, its "filters" object is used the same
+ * way: the "stages" array or outlierRemoval, outlierThreshold and voxelSize
+ * \return false when the file cannot be read or the stages cannot run out of core
+ */
+bool TDK_OutOfCoreFilter::mf_LoadConfig(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        qWarning() << "OutOfCoreFilter: Could not read" << fileName;
+        return false;
+    }
+
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+    if(!document.isObject()){
+        qWarning() << "OutOfCoreFilter: Invalid configuration" << fileName;
+        return false;
+    }
+
+    const QJsonObject filters = document.object().value("filters").toObject();
+    if(filters.contains("stages")){
+        TDK_FilterPipeline pipeline;
+        if(!pipeline.mf_SetStages(filters.value("stages").toArray()) || !mf_SetStages(pipeline.mf_GetStages()))
+            return false;
+    }
+    else{
+        mf_Clear();
+        if(filters.value("outlierRemoval").toBool(true))
+            mf_SetOutlierRemoval(filters.value("outlierThreshold").toDouble(2.5), DefaultMeanK);
+        if(filters.value("voxelSize").toDouble() > 0.0)
+            mf_SetVoxelGrid(filters.value("voxelSize").toDouble());
+    }
+
+    const QJsonObject outOfCore = filters.value("outOfCore").toObject();
+    mv_MaxPointsInMemory = outOfCore.value("maxPointsInMemory").toInt(mv_MaxPointsInMemory);
+    mv_Halo = outOfCore.value("halo").toDouble(mv_Halo);
+    mv_TemporaryDirectory = outOfCore.value("temporaryDirectory").toString(mv_TemporaryDirectory);
+
+    return true;
+}
+
+/*!
+ * \brief TDK_OutOfCoreFilter::mf_Process
+ * \param inputFileName PLY or PCD cloud
+ * \param outputFileName binary PLY or PCD cloud
+ * \return false when a file cannot be read or written
+ *
+ * Without outlier removal and voxel grid the cropped points are written as they are read. Otherwise
+ * the input is read three times: for the bounds, for the points per cell of the grid, and to spill
+ * the points and halos of every block. The points per cell are counted again for every refinement
+ * of a grid with cells over the memory, false when the cells can not get smaller. The statistical outlier removal goes twice over the blocks,
+ * first for the kNN distances, then for the threshold on them, with a search of the near blocks in
+ * between for the points whose kNN reach past the halo.
+ */
+bool TDK_OutOfCoreFilter::mf_Process(const QString &inputFileName, const QString &outputFileName)
+{
+    mv_Report = QJsonObject();
+    QElapsedTimer timer;
+    timer.start();
+
+    if(QFileInfo(inputFileName).absoluteFilePath() == QFileInfo(outputFileName).absoluteFilePath()){
+        qWarning() << "OutOfCoreFilter: The output has to be another file than the input";
+        return false;
+    }
+    if((mv_OutlierRemoval == RadiusOutlierRemoval && mv_Radius <= 0.0) ||
+            (mv_OutlierRemoval == StatisticalOutlierRemoval && mv_Halo <= 0.0) || mv_LeafSize < 0.0){
+        qWarning() << "OutOfCoreFilter: Radius, halo and leaf size have to be positive";
+        return false;
+    }
+
+    PointFileReader reader;
+    PointFileWriter writer;
+    if(!reader.mf_Open(inputFileName) || !writer.mf_Open(outputFileName, reader.mf_HasColor()))
+        return false;
+
+    const int64_t maxPoints = std::max(mv_MaxPointsInMemory, ReadChunkPoints);
+    std::vector<PointRecord> chunk;
+    chunk.reserve(ReadChunkPoints);
+
+    mv_Report["inputPoints"] = static_cast<double>(reader.mf_Size());
+
+    //Point-wise only, one pass
+    if(mv_OutlierRemoval == NoOutlierRemoval && mv_LeafSize == 0.0){
+        while(!reader.mf_AtEnd()){
+            if(!readCropped(reader, chunk, mv_CropBoxes) || !writer.mf_Write(chunk.data(), static_cast<int>(chunk.size())))
+                return false;
+        }
+        mv_Report["croppedPoints"] = static_cast<double>(writer.mf_Size());
+        mv_Report["outputPoints"] = static_cast<double>(writer.mf_Size());
+        mv_Report["passesOverInput"] = 1;
+        mv_Report["peakPointsInMemory"] = ReadChunkPoints;
+        mv_Report["ms"] = static_cast<double>(timer.elapsed());
+        return writer.mf_Close();
+    }
+
+    //Bounds of the cropped points
+    float minimum[3], maximum[3];
+    std::fill(minimum, minimum + 3, std::numeric_limits<float>::max());
+    std::fill(maximum, maximum + 3, -std::numeric_limits<float>::max());
+    int64_t numberOfPoints = 0;
+    while(!reader.mf_AtEnd()){
+        if(!readCropped(reader, chunk, mv_CropBoxes))
+            return false;
+        for(size_t i = 0; i < chunk.size(); i++){
+            const float coordinates[3] = {chunk[i].x, chunk[i].y, chunk[i].z};
+            for(int k = 0; k < 3; k++){
+                minimum[k] = std::min(minimum[k], coordinates[k]);
+                maximum[k] = std::max(maximum[k], coordinates[k]);
+            }
+        }
+        numberOfPoints += chunk.size();
+    }
+    mv_Report["croppedPoints"] = static_cast<double>(numberOfPoints);
+    if(numberOfPoints == 0){
+        mv_Report["outputPoints"] = 0;
+        return writer.mf_Close();
+    }
+
+    //Grid, cells at least as wide as the halo so the halo of a cell lies in its 26 neighbours. While a
+    //single cell holds more points than fit in memory with its halo the grid is refined, down to
+    //cells as wide as the halo or the leaf size
+    const float halo = mv_OutlierRemoval == RadiusOutlierRemoval ? mv_Radius :
+                       (mv_OutlierRemoval == StatisticalOutlierRemoval ? mv_Halo : 0.0f);
+    const float extent = std::max(maximum[0] - minimum[0], std::max(maximum[1] - minimum[1], maximum[2] - minimum[2]));
+    const float minimumCellSize = std::max(halo, std::max(mv_LeafSize, 1e-4f));
+    BlockGrid grid;
+    int cellsPerSide = GridCellsPerSide, passes = 1;
+    while(true){
+        grid = BlockGrid();
+        grid.cellSize = std::max(extent / cellsPerSide, minimumCellSize);
+        if(mv_LeafSize > 0.0){
+            grid.voxelAligned = true;
+            grid.inverseLeafSize = 1.0f / mv_LeafSize;
+            grid.cellVoxels = static_cast<int>(std::ceil(grid.cellSize / mv_LeafSize));
+            grid.cellSize = grid.cellVoxels * mv_LeafSize;
+            for(int i = 0; i < 3; i++){
+                grid.originVoxel[i] = static_cast<int>(std::floor(minimum[i] * grid.inverseLeafSize));
+                grid.origin[i] = grid.originVoxel[i] * mv_LeafSize;
+            }
+        }
+        else
+            std::copy(minimum, minimum + 3, grid.origin);
+        grid.inverseCellSize = 1.0f / grid.cellSize;
+        for(int i = 0; i < 3; i++)
+            grid.dimensions[i] = std::min(cellsPerSide + 2, static_cast<int>((maximum[i] - grid.origin[i]) * grid.inverseCellSize) + 1);
+        grid.counts.assign(static_cast<size_t>(grid.dimensions[0]) * grid.dimensions[1] * grid.dimensions[2], 0);
+
+        //Points per cell
+        if(!reader.mf_Rewind())
+            return false;
+        while(!reader.mf_AtEnd()){
+            if(!readCropped(reader, chunk, mv_CropBoxes))
+                return false;
+            int cell[3];
+            for(size_t i = 0; i < chunk.size(); i++)
+                grid.counts[grid.mf_Cell(chunk[i], cell)]++;
+        }
+        passes++;
+
+        //Blocks
+        grid.mf_BuildPrefix();
+        const int lower[3] = {0, 0, 0};
+        splitBlocks(grid, lower, grid.dimensions, halo > 0.0 ? 1 : 0, maxPoints);
+        int overBudgetBlocks = 0;
+        for(size_t b = 0; b < grid.blocks.size(); b++)
+            overBudgetBlocks += grid.blocks[b].pointsWithHalo > maxPoints;
+        if(overBudgetBlocks == 0)
+            break;
+
+        if(cellsPerSide >= MaxGridCellsPerSide || extent / cellsPerSide <= minimumCellSize){
+            qWarning() << "OutOfCoreFilter:" << overBudgetBlocks << "cells hold more points than fit in memory with their halo"
+                       << "at cells of" << grid.cellSize << ", a smaller halo or leaf size or more points in memory are needed";
+            return false;
+        }
+        cellsPerSide *= 2;
+    }
+    const int numberOfBlocks = static_cast<int>(grid.blocks.size());
+    grid.cellBlock.assign(grid.counts.size(), -1);
+    for(int b = 0; b < numberOfBlocks; b++){
+        const Block &block = grid.blocks[b];
+        for(int z = block.lower[2]; z < block.upper[2]; z++)
+            for(int y = block.lower[1]; y < block.upper[1]; y++)
+                for(int x = block.lower[0]; x < block.upper[0]; x++)
+                    grid.cellBlock[grid.mf_Index(x, y, z)] = b;
+    }
+
+    QTemporaryDir temporary(QDir(mv_TemporaryDirectory.isEmpty() ? QDir::tempPath() : mv_TemporaryDirectory).filePath("tdk_outofcore-XXXXXX"));
+    if(!temporary.isValid()){
+        qWarning() << "OutOfCoreFilter: Could not create a temporary folder in" << mv_TemporaryDirectory;
+        return false;
+    }
+    QDir directory(temporary.path());
+    std::vector<QString> coreFiles(numberOfBlocks), haloFiles(numberOfBlocks), distanceFiles(numberOfBlocks);
+    for(int b = 0; b < numberOfBlocks; b++){
+        coreFiles[b] = directory.filePath(QString("block%1.core").arg(b));
+        haloFiles[b] = directory.filePath(QString("block%1.halo").arg(b));
+        distanceFiles[b] = directory.filePath(QString("block%1.distances").arg(b));
+    }
+
+    //Spill every point to its block and to the halos of the blocks within the halo distance
+    const int64_t bufferPoints = std::min<int64_t>(MaxBlockBufferPoints,
+                                                   std::max<int64_t>(MinBlockBufferPoints, maxPoints / (8 * numberOfBlocks)));
+    std::vector<std::vector<PointRecord> > coreBuffers(numberOfBlocks), haloBuffers(numberOfBlocks);
+    const float haloSlack = 1e-4f * grid.cellSize;
+    int64_t haloPoints = 0;
+    bool written = true;
+
+    if(!reader.mf_Rewind())
+        return false;
+    while(!reader.mf_AtEnd() && written){
+        if(!readCropped(reader, chunk, mv_CropBoxes))
+            return false;
+        for(size_t i = 0; i < chunk.size() && written; i++){
+            const PointRecord &point = chunk[i];
+            int cell[3];
+            const int block = grid.cellBlock[grid.mf_Cell(point, cell)];
+            coreBuffers[block].push_back(point);
+            if(static_cast<int64_t>(coreBuffers[block].size()) >= bufferPoints){
+                written = appendFile(coreFiles[block], coreBuffers[block].data(), coreBuffers[block].size() * sizeof(PointRecord));
+                coreBuffers[block].clear();
+            }
+            if(halo == 0.0)
+                continue;
+
+            int neighbours[26];
+            int numberOfNeighbours = 0;
+            for(int dz = -1; dz <= 1; dz++)
+                for(int dy = -1; dy <= 1; dy++)
+                    for(int dx = -1; dx <= 1; dx++){
+                        const int x = cell[0] + dx, y = cell[1] + dy, z = cell[2] + dz;
+                        if(x < 0 || y < 0 || z < 0 || x >= grid.dimensions[0] || y >= grid.dimensions[1] || z >= grid.dimensions[2])
+                            continue;
+                        const int neighbour = grid.cellBlock[grid.mf_Index(x, y, z)];
+                        if(neighbour < 0 || neighbour == block || std::find(neighbours, neighbours + numberOfNeighbours, neighbour) != neighbours + numberOfNeighbours)
+                            continue;
+                        neighbours[numberOfNeighbours++] = neighbour;
+                        if(grid.mf_BlockDistance(grid.blocks[neighbour], point) > halo + haloSlack)
+                            continue;
+                        haloBuffers[neighbour].push_back(point);
+                        haloPoints++;
+                        if(static_cast<int64_t>(haloBuffers[neighbour].size()) >= bufferPoints){
+                            written = written && appendFile(haloFiles[neighbour], haloBuffers[neighbour].data(),
+                                                            haloBuffers[neighbour].size() * sizeof(PointRecord));
+                            haloBuffers[neighbour].clear();
+                        }
+                    }
+        }
+    }
+    for(int b = 0; b < numberOfBlocks && written; b++){
+        if(!coreBuffers[b].empty())
+            written = appendFile(coreFiles[b], coreBuffers[b].data(), coreBuffers[b].size() * sizeof(PointRecord));
+        if(!haloBuffers[b].empty() && written)
+            written = appendFile(haloFiles[b], haloBuffers[b].data(), haloBuffers[b].size() * sizeof(PointRecord));
+        std::vector<PointRecord>().swap(coreBuffers[b]);
+        std::vector<PointRecord>().swap(haloBuffers[b]);
+    }
+    std::vector<PointRecord>().swap(chunk);
+    if(!written)
+        return false;
+
+    mv_Report["blocks"] = numberOfBlocks;
+    mv_Report["gridCellsPerSide"] = cellsPerSide;
+    mv_Report["haloPoints"] = static_cast<double>(haloPoints);
+    mv_Report["passesOverInput"] = passes + 1;
+
+    //kNN distances of the statistical outlier removal, within the block and its halo
+    int64_t peakPoints = 0, haloMisses = 0;
+    double distanceThreshold = std::numeric_limits<double>::max();
+    std::vector<HaloMiss> misses;
+    const size_t maxMisses = static_cast<size_t>(maxPoints / 4);
+    if(mv_OutlierRemoval == StatisticalOutlierRemoval){
+        double sum = 0.0, sumOfSquares = 0.0;
+        for(int b = 0; b < numberOfBlocks; b++){
+            std::vector<PointRecord> points;
+            if(!loadFile(coreFiles[b], points))
+                return false;
+            const int numberOfCorePoints = static_cast<int>(points.size());
+            if(!loadFile(haloFiles[b], points))
+                return false;
+            QFile::remove(haloFiles[b]);
+            peakPoints = std::max<int64_t>(peakPoints, points.size());
+
+            pcl::PointCloud<pcl::PointXYZ>::Ptr positions = toPositions(points);
+            pcl::KdTreeFLANN<pcl::PointXYZ> tree;
+            tree.setInputCloud(positions);
+
+            //The point itself is its first neighbour, as in pcl::StatisticalOutlierRemoval
+            const int k = std::min(mv_OutlierMeanK + 1, static_cast<int>(points.size()));
+            const Block &block = grid.blocks[b];
+            std::vector<float> distances(numberOfCorePoints), bounds(numberOfCorePoints, -1.0f);
+            double blockSum = 0.0, blockSumOfSquares = 0.0;
+
+#pragma omp parallel reduction(+:blockSum, blockSumOfSquares)
+            {
+                std::vector<int> indices(k);
+                std::vector<float> squaredDistances(k);
+#pragma omp for
+                for(int i = 0; i < numberOfCorePoints; i++){
+                    const int found = tree.nearestKSearch(positions->points[i], k, indices, squaredDistances);
+                    double total = 0.0;
+                    for(int j = 1; j < found; j++)
+                        total += std::sqrt(squaredDistances[j]);
+                    distances[i] = found > 1 ? static_cast<float>(total / (found - 1)) : 0.0f;
+                    blockSum += distances[i];
+                    blockSumOfSquares += static_cast<double>(distances[i]) * distances[i];
+                    //Points beyond the halo are further than the border distance plus the halo
+                    if(found < mv_OutlierMeanK + 1)
+                        bounds[i] = std::numeric_limits<float>::max();
+                    else if(std::sqrt(squaredDistances[found - 1]) > grid.mf_BorderDistance(block, points[i]) + halo)
+                        bounds[i] = squaredDistances[found - 1];
+                }
+            }
+
+            for(int i = 0; i < numberOfCorePoints; i++){
+                if(bounds[i] < 0.0f)
+                    continue;
+                haloMisses++;
+                if(misses.size() < maxMisses){
+                    HaloMiss miss;
+                    miss.block = b;
+                    miss.index = i;
+                    miss.point = points[i];
+                    miss.bound = bounds[i];
+                    miss.distance = distances[i];
+                    misses.push_back(miss);
+                }
+            }
+
+            sum += blockSum;
+            sumOfSquares += blockSumOfSquares;
+            if(numberOfCorePoints > 0 && !appendFile(distanceFiles[b], distances.data(), distances.size() * sizeof(float)))
+                return false;
+        }
+
+        //kNN of the missed points over the points of all blocks, a block is only searched when it is
+        //nearer than the kNN found so far
+        if(haloMisses > static_cast<int64_t>(misses.size())){
+            qWarning() << "OutOfCoreFilter:" << haloMisses << "points need neighbours past the halo, more than fit in memory."
+                       << "Their kNN distances are taken within the halo, a larger halo avoids that";
+            misses.clear();
+        }
+        const int k = mv_OutlierMeanK + 1;
+        for(int b = 0; b < numberOfBlocks && !misses.empty(); b++){
+            std::vector<int> candidates;
+            for(size_t m = 0; m < misses.size(); m++){
+                const HaloMiss &miss = misses[m];
+                const float bound = static_cast<int>(miss.nearest.size()) == k ? std::min(miss.bound, miss.nearest.back()) : miss.bound;
+                if(grid.mf_BlockDistance(grid.blocks[b], miss.point) <= std::sqrt(bound) + haloSlack)
+                    candidates.push_back(static_cast<int>(m));
+            }
+            if(candidates.empty())
+                continue;
+
+            std::vector<PointRecord> points;
+            if(!loadFile(coreFiles[b], points))
+                return false;
+            peakPoints = std::max<int64_t>(peakPoints, points.size());
+            pcl::KdTreeFLANN<pcl::PointXYZ> tree;
+            tree.setInputCloud(toPositions(points));
+            const int numberOfCandidates = static_cast<int>(candidates.size());
+            const int blockK = std::min(k, static_cast<int>(points.size()));
+
+#pragma omp parallel
+            {
+                std::vector<int> indices(blockK);
+                std::vector<float> squaredDistances(blockK);
+#pragma omp for
+                for(int c = 0; c < numberOfCandidates; c++){
+                    HaloMiss &miss = misses[candidates[c]];
+                    const int found = tree.nearestKSearch(pcl::PointXYZ(miss.point.x, miss.point.y, miss.point.z),
+                                                          blockK, indices, squaredDistances);
+                    miss.nearest.insert(miss.nearest.end(), squaredDistances.begin(), squaredDistances.begin() + found);
+                    std::sort(miss.nearest.begin(), miss.nearest.end());
+                    if(static_cast<int>(miss.nearest.size()) > k)
+                        miss.nearest.resize(k);
+                }
+            }
+        }
+        for(size_t m = 0; m < misses.size(); m++){
+            HaloMiss &miss = misses[m];
+            const int found = static_cast<int>(miss.nearest.size());
+            double total = 0.0;
+            for(int j = 1; j < found; j++)
+                total += std::sqrt(miss.nearest[j]);
+            const float distance = found > 1 ? static_cast<float>(total / (found - 1)) : 0.0f;
+            sum += static_cast<double>(distance) - miss.distance;
+            sumOfSquares += static_cast<double>(distance) * distance - static_cast<double>(miss.distance) * miss.distance;
+            miss.distance = distance;
+            std::vector<float>().swap(miss.nearest);
+        }
+
+        const double mean = sum / numberOfPoints;
+        const double variance = numberOfPoints > 1 ? (sumOfSquares - sum * sum / numberOfPoints) / (numberOfPoints - 1) : 0.0;
+        distanceThreshold = mean + mv_OutlierThreshold * std::sqrt(std::max(variance, 0.0));
+        mv_Report["meanDistance"] = mean;
+        mv_Report["distanceThreshold"] = distanceThreshold;
+        mv_Report["haloMisses"] = static_cast<double>(haloMisses);
+        mv_Report["refinedMisses"] = static_cast<double>(misses.size());
+    }
+
+    //Filter every block, only its own points go to the output
+    int64_t outlierRemoved = 0;
+    size_t nextMiss = 0;
+    for(int b = 0; b < numberOfBlocks; b++){
+        std::vector<PointRecord> points;
+        if(!loadFile(coreFiles[b], points))
+            return false;
+        const int numberOfCorePoints = static_cast<int>(points.size());
+
+        if(mv_OutlierRemoval == StatisticalOutlierRemoval){
+            std::vector<float> distances;
+            if(!loadFile(distanceFiles[b], distances) || static_cast<int>(distances.size()) != numberOfCorePoints)
+                return false;
+            for(; nextMiss < misses.size() && misses[nextMiss].block == b; nextMiss++)
+                distances[misses[nextMiss].index] = misses[nextMiss].distance;
+            int kept = 0;
+            for(int i = 0; i < numberOfCorePoints; i++)
+                if(distances[i] <= distanceThreshold)
+                    points[kept++] = points[i];
+            points.resize(kept);
+        }
+        else if(mv_OutlierRemoval == RadiusOutlierRemoval && !loadFile(haloFiles[b], points))
+            return false;
+        peakPoints = std::max<int64_t>(peakPoints, points.size());
+        QFile::remove(coreFiles[b]);
+        QFile::remove(haloFiles[b]);
+        QFile::remove(distanceFiles[b]);
+
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>);
+        toCloud(points, *cloud);
+        std::vector<PointRecord>().swap(points);
+
+        if(mv_OutlierRemoval == RadiusOutlierRemoval){
+            TDK_Filters::mf_FilterRadiusOutlierRemoval(cloud, cloud, mv_Radius, mv_MinNeighbors);
+            //Drop the halo, its points belong to other blocks
+            int kept = 0, cell[3];
+            for(size_t i = 0; i < cloud->points.size(); i++){
+                const pcl::PointXYZRGB &point = cloud->points[i];
+                const PointRecord record = {point.x, point.y, point.z, point.rgba};
+                if(grid.cellBlock[grid.mf_Cell(record, cell)] == b)
+                    cloud->points[kept++] = point;
+            }
+            cloud->points.resize(kept);
+            cloud->width = kept;
+        }
+        if(mv_OutlierRemoval != NoOutlierRemoval)
+            outlierRemoved += numberOfCorePoints - static_cast<int64_t>(cloud->points.size());
+
+        if(mv_LeafSize > 0.0)
+            TDK_Filters::mf_FilterVoxelGridDownsample(cloud, cloud, mv_LeafSize, mv_NearestToCentroid);
+
+        if(!writer.mf_Write(cloud->points.data(), static_cast<int>(cloud->points.size())))
+            return false;
+    }
+
+    mv_Report["outlierRemoved"] = static_cast<double>(outlierRemoved);
+    mv_Report["outputPoints"] = static_cast<double>(writer.mf_Size());
+    mv_Report["peakPointsInMemory"] = static_cast<double>(std::max<int64_t>(peakPoints, ReadChunkPoints));
+    mv_Report["ms"] = static_cast<double>(timer.elapsed());
+
+    qDebug() << "OutOfCoreFilter:" << numberOfPoints << "points in" << numberOfBlocks << "blocks," << writer.mf_Size() << "written";
+
+    return writer.mf_Close();
+}
@@ -0,0 +1,91 @@
+#ifndef TDK_OUTOFCOREFILTER_H
+#define TDK_OUTOFCOREFILTER_H
+
+#include <vector>
+
+#include <QJsonObject>
+#include <QString>
+
+#include "tdk_filterpipeline.h"
+
+/*!
+ * \brief The TDK_OutOfCoreFilter class
+ *
+ * Crops, removes outliers from and downsamples a PLY/PCD cloud larger than the memory, file to
+ * file. The input is read in chunks, the cropped points are sorted into blocks of a coarse grid
+ * split until every block holds at most mf_SetMaxPointsInMemory points together with its halo,
+ * the points around the block that the outlier removal of its points needs. The grid is refined
+ * while a cell alone holds more, mf_Process fails when its cells can not get smaller than the halo. Blocks are spilled
+ * to temporary files, then filtered one after the other with TDK_Filters and only their own
+ * points are appended to the output. Block borders lie on voxel borders, the voxel grid gives
+ * the voxels of the in-memory filter.
+ *
+ * The radius outlier removal takes its radius as halo. The statistical outlier removal finds the
+ * kNN of a point within the halo set by mf_SetHalo, points whose kNN could reach past the halo,
+ * mostly the outliers themselves, are searched again in every block near enough. The mean and
+ * deviation of the kNN distances are taken over the whole cloud before the points are removed.
+ * Both give the points of the in-memory filters.
+ *
+ * Binary and ASCII PLY and PCD are read, binary PLY or PCD is written with colors when the input
+ * has colors.
+ *
+ * Use example
+ * TDK_OutOfCoreFilter filter;
+ * filter.mf_SetMaxPointsInMemory(10000000);
+ * filter.mf_SetOutlierRemoval(2.5, 8);
+ * filter.mf_SetVoxelGrid(0.002);
+ * filter.mf_Process("merged.ply", "filtered.ply");
+ */
+class TDK_OutOfCoreFilter
+{
+public:
+    TDK_OutOfCoreFilter();
+    ~TDK_OutOfCoreFilter();
+
+    //"filters" object of the batch configuration, its "outOfCore" object sets the memory, halo and
+    //temporary folder
+    bool    mf_LoadConfig                   (const QString &fileName);
+    //Crop boxes, then at most one outlier removal, then at most one voxel grid
+    bool    mf_SetStages                    (const std::vector<TDK_FilterPipeline::Stage> &stages);
+
+    void    mf_AddCropBox                   (float x1, float x2, float y1, float y2, float z1, float z2);
+    void    mf_SetOutlierRemoval            (float threshold = 2.5, int meanK = 8);
+    void    mf_SetRadiusOutlierRemoval      (float radius, int minNeighbors = 5);
+    void    mf_SetVoxelGrid                 (float leafSize, bool nearestToCentroid = false);
+    void    mf_Clear                        ();
+
+    void    mf_SetMaxPointsInMemory         (int maxPoints)                 {   mv_MaxPointsInMemory = maxPoints;   }
+    void    mf_SetHalo                      (float halo)                    {   mv_Halo = halo;                     }
+    void    mf_SetTemporaryDirectory        (const QString &directory)     {   mv_TemporaryDirectory = directory;  }
+
+    //outputFileName may not be inputFileName
+    bool    mf_Process                      (const QString &inputFileName, const QString &outputFileName);
+
+    //Points, blocks, halo, peak points in memory and time of the last run
+    QJsonObject mf_GetReport                () const    {   return mv_Report;   }
+
+private:
+    enum OutlierRemoval
+    {
+        NoOutlierRemoval,
+        StatisticalOutlierRemoval,
+        RadiusOutlierRemoval
+    };
+
+    std::vector<std::vector<float> >    mv_CropBoxes;   //x1, x2, y1, y2, z1, z2
+    OutlierRemoval  mv_OutlierRemoval;
+    float           mv_OutlierThreshold;
+    int             mv_OutlierMeanK;
+    float           mv_Radius;
+    int             mv_MinNeighbors;
+    float           mv_LeafSize;                        //0 keeps every point
+    bool            mv_NearestToCentroid;
+
+    int             mv_MaxPointsInMemory;
+    float           mv_Halo;                            //of the statistical outlier removal
+    QString         mv_TemporaryDirectory;              //system temporary folder when empty
+
+    QJsonObject     mv_Report;
+};
+
+#endif // TDK_OUTOFCOREFILTER_H
@@ -0,0 +1,215 @@
+#include "tdk_posegraph.h"
+
+#include <cmath>
+
+TDK_PoseGraph::TDK_PoseGraph()
+{
+
+}
+
+TDK_PoseGraph::~TDK_PoseGraph()
+{
+
+}
+
+/*!
+ * \brief TDK_PoseGraph::mf_AddNode
+ * \param pose initial pose of the scan (scan frame to model frame)
+ * \return index of the new node
+ */
+int TDK_PoseGraph::mf_AddNode(const Eigen::Matrix4f &pose)
+{
+    Eigen::Isometry3d isometry;
+    isometry.matrix() = pose.cast<double>();
+    mv_Poses.push_back(isometry);
+    return static_cast<int>(mv_Poses.size()) - 1;
+}
+
+/*!
+ * \brief TDK_PoseGraph::mf_AddEdge
+ * \param from index of the first node
+ * \param to index of the second node
+ * \param relativePose measured pose of node "to" in the frame of node "from" (X_from^-1 * X_to)
+ * \param information 6x6 information matrix of the measurement, ordered (translation, rotation)
+ */
+void TDK_PoseGraph::mf_AddEdge(const int from, const int to,
+                               const Eigen::Matrix4f &relativePose,
+                               const Matrix6d &information)
+{
+    Edge edge;
+    edge.from = from;
+    edge.to = to;
+    edge.measurement.matrix() = relativePose.cast<double>();
+    edge.information = information;
+    mv_Edges.push_back(edge);
+}
+
+/*!
+ * \brief TDK_PoseGraph::mf_Optimize
+ * \param maxIterations maximum number of Gauss-Newton iterations
+ * \param epsilon stop when the squared norm of the increment is below this value
+ * \return number of iterations performed
+ *
+ * Builds the sparse normal equations H * dx = -b over all nodes but the first one,
+ * solves them with a sparse Cholesky (LDLT) factorization and applies the increment
+ * on the right of every pose. Jacobians are computed numerically per edge, each edge only
+ * touches two 6x6 blocks so the cost grows linearly with the number of edges.
+ */
+int TDK_PoseGraph::mf_Optimize(const int maxIterations, const double epsilon)
+{
+    const int numberOfNodes = static_cast<int>(mv_Poses.size());
+    if (numberOfNodes < 2 || mv_Edges.empty())
+        return 0;
+
+    const int dimension = 6 * (numberOfNodes - 1);
+    const double step = 1e-7;
+    const double damping = 1e-6;
+
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > solver;
+    std::vector<Eigen::Triplet<double> > triplets;
+    triplets.reserve(mv_Edges.size() * 4 * 36 + dimension);
+
+    int iteration = 0;
+    for (; iteration < maxIterations; ++iteration)
+    {
+        triplets.clear();
+        Eigen::VectorXd b = Eigen::VectorXd::Zero(dimension);
+
+        for (size_t k = 0; k < mv_Edges.size(); ++k)
+        {
+            const Edge &edge = mv_Edges[k];
+            const Eigen::Isometry3d &poseFrom = mv_Poses[edge.from];
+            const Eigen::Isometry3d &poseTo = mv_Poses[edge.to];
+
+            Vector6d error = mf_EdgeError(edge, poseFrom, poseTo);
+
+            //Numerical jacobians with respect to a right perturbation of both poses
+            Matrix6d jacobianFrom, jacobianTo;
+            for (int d = 0; d < 6; ++d)
+            {
+                Vector6d delta = Vector6d::Zero();
+                delta(d) = step;
+                jacobianFrom.col(d) = (mf_EdgeError(edge, poseFrom * mf_Exp(delta), poseTo) - error) / step;
+                jacobianTo.col(d) = (mf_EdgeError(edge, poseFrom, poseTo * mf_Exp(delta)) - error) / step;
+            }
+
+            //First node is fixed, it is not part of the system
+            const int blocks[2] = { edge.from - 1, edge.to - 1 };
+            const Matrix6d *jacobians[2] = { &jacobianFrom, &jacobianTo };
+
+            for (int r = 0; r < 2; ++r)
+            {
+                if (blocks[r] < 0)
+                    continue;
+
+                const Eigen::Matrix<double, 6, 6> jtOmega = jacobians[r]->transpose() * edge.information;
+                b.segment<6>(6 * blocks[r]) += jtOmega * error;
+
+                for (int c = 0; c < 2; ++c)
+                {
+                    if (blocks[c] < 0)
+                        continue;
+
+                    const Matrix6d block = jtOmega * (*jacobians[c]);
+                    for (int i = 0; i < 6; ++i)
+                        for (int j = 0; j < 6; ++j)
+                            triplets.push_back(Eigen::Triplet<double>(6 * blocks[r] + i, 6 * blocks[c] + j, block(i, j)));
+                }
+            }
+        }
+
+        //Small damping keeps nodes without constraints in some direction solvable
+        for (int i = 0; i < dimension; ++i)
+            triplets.push_back(Eigen::Triplet<double>(i, i, damping));
+
+        Eigen::SparseMatrix<double> H(dimension, dimension);
+        H.setFromTriplets(triplets.begin(), triplets.end());
+
+        solver.compute(H);
+        if (solver.info() != Eigen::Success)
+            break;
+
+        Eigen::VectorXd dx = solver.solve(-b);
+        if (solver.info() != Eigen::Success)
+            break;
+
+        for (int n = 1; n < numberOfNodes; ++n)
+            mv_Poses[n] = mv_Poses[n] * mf_Exp(dx.segment<6>(6 * (n - 1)));
+
+        if (dx.squaredNorm() < epsilon)
+        {
+            ++iteration;
+            break;
+        }
+    }
+
+    return iteration;
+}
+
+Eigen::Matrix4f TDK_PoseGraph::mf_GetPose(const int node) const
+{
+    return mv_Poses[node].matrix().cast<float>();
+}
+
+/*!
+ * \brief TDK_PoseGraph::mf_GetEdgeResiduals
+ * \return residual of every edge with the current poses, in the order the edges were added
+ */
+std::vector<TDK_PoseGraph::EdgeResidual> TDK_PoseGraph::mf_GetEdgeResiduals() const
+{
+    std::vector<EdgeResidual> residuals;
+    residuals.reserve(mv_Edges.size());
+
+    for (size_t k = 0; k < mv_Edges.size(); ++k)
+    {
+        const Edge &edge = mv_Edges[k];
+        Vector6d error = mf_EdgeError(edge, mv_Poses[edge.from], mv_Poses[edge.to]);
+
+        EdgeResidual residual;
+        residual.from = edge.from;
+        residual.to = edge.to;
+        residual.chi2 = error.dot(edge.information * error);
+        residual.translationError = error.head<3>().norm();
+        residual.rotationError = error.tail<3>().norm() * 180.0 / M_PI;
+        residuals.push_back(residual);
+    }
+
+    return residuals;
+}
+
+double TDK_PoseGraph::mf_GetTotalChi2() const
+{
+    double chi2 = 0.0;
+    std::vector<EdgeResidual> residuals = mf_GetEdgeResiduals();
+    for (size_t k = 0; k < residuals.size(); ++k)
+        chi2 += residuals[k].chi2;
+    return chi2;
+}
+
+TDK_PoseGraph::Vector6d TDK_PoseGraph::mf_EdgeError(const Edge &edge,
+                                                    const Eigen::Isometry3d &poseFrom,
+                                                    const Eigen::Isometry3d &poseTo) const
+{
+    return mf_Log(edge.measurement.inverse() * poseFrom.inverse() * poseTo);
+}
+
+TDK_PoseGraph::Vector6d TDK_PoseGraph::mf_Log(const Eigen::Isometry3d &transformation)
+{
+    Vector6d result;
+    Eigen::AngleAxisd angleAxis(transformation.rotation());
+    result.head<3>() = transformation.translation();
+    result.tail<3>() = angleAxis.angle() * angleAxis.axis();
+    return result;
+}
+
+Eigen::Isometry3d TDK_PoseGraph::mf_Exp(const Vector6d &increment)
+{
+    Eigen::Isometry3d result = Eigen::Isometry3d::Identity();
+    const Eigen::Vector3d rotation = increment.tail<3>();
+    const double angle = rotation.norm();
+
+    if (angle > 1e-12)
+        result.linear() = Eigen::AngleAxisd(angle, rotation / angle).toRotationMatrix();
+    result.translation() = increment.head<3>();
+    return result;
+}
@@ -0,0 +1,83 @@
+#ifndef TDK_POSEGRAPH_H
+#define TDK_POSEGRAPH_H
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/Sparse>
+#include <Eigen/StdVector>
+#include <vector>
+
+/*!
+ * \brief The TDK_PoseGraph class
+ *
+ * Sparse pose graph used as back end of the scan registration. Nodes are scan poses
+ * (transformation from the scan frame into the model frame), edges are relative poses
+ * measured by pairwise ICP together with their 6x6 information matrix. The first node
+ * is kept fixed and the graph is solved with Gauss-Newton on a sparse normal system.
+ *
+ * Edge error is e = log(Z_ij^-1 * X_i^-1 * X_j) written as (translation, rotation vector),
+ * information matrices use the same ordering.
+ *
+ * Use example
+ * TDK_PoseGraph graph;
+ * graph.mf_AddNode(Eigen::Matrix4f::Identity());
+ * graph.mf_AddNode(pose1);
+ * graph.mf_AddEdge(0, 1, pairTransformation01, information01);
+ * graph.mf_AddEdge(0, 1, loopClosureTransformation, loopClosureInformation);
+ * graph.mf_Optimize();
+ * Eigen::Matrix4f optimizedPose1 = graph.mf_GetPose(1);
+ */
+class TDK_PoseGraph
+{
+public:
+    typedef Eigen::Matrix<double, 6, 1> Vector6d;
+    typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+
+    //Residual of one edge after optimization
+    struct EdgeResidual
+    {
+        int     from;
+        int     to;
+        double  chi2;                   //e^T * information * e
+        double  translationError;       //meters
+        double  rotationError;          //degrees
+    };
+
+    TDK_PoseGraph();
+    ~TDK_PoseGraph();
+
+    int     mf_AddNode              (const Eigen::Matrix4f &pose);
+    void    mf_AddEdge              (const int from, const int to,
+                                     const Eigen::Matrix4f &relativePose,
+                                     const Matrix6d &information = Matrix6d::Identity());
+
+    int     mf_Optimize             (const int maxIterations = 20, const double epsilon = 1e-8);
+
+    int                             mf_GetNumberOfNodes     () const    {   return static_cast<int>(mv_Poses.size());   }
+    int                             mf_GetNumberOfEdges     () const    {   return static_cast<int>(mv_Edges.size());   }
+    Eigen::Matrix4f                 mf_GetPose              (const int node) const;
+    std::vector<EdgeResidual>       mf_GetEdgeResiduals     () const;
+    double                          mf_GetTotalChi2         () const;
+
+private:
+    struct Edge
+    {
+        int                 from;
+        int                 to;
+        Eigen::Isometry3d   measurement;
+        Matrix6d            information;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> >   mv_Poses;
+    std::vector<Edge, Eigen::aligned_allocator<Edge> >                             mv_Edges;
+
+    static Vector6d             mf_Log              (const Eigen::Isometry3d &transformation);
+    static Eigen::Isometry3d    mf_Exp              (const Vector6d &increment);
+    Vector6d                    mf_EdgeError        (const Edge &edge,
+                                                     const Eigen::Isometry3d &poseFrom,
+                                                     const Eigen::Isometry3d &poseTo) const;
+};
+
+#endif // TDK_POSEGRAPH_H
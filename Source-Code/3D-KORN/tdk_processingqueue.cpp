@@ -0,0 +1,334 @@
+#include "tdk_processingqueue.h"
+#include "tdk_batchprocessor.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+const char *stateNames[] = { "pending", "running", "done", "failed" };
+
+TDK_ProcessingQueue::State stateFromName(const QString &name)
+{
+    for(int i = 0; i < 4; i++)
+        if(name == stateNames[i])
+            return static_cast<TDK_ProcessingQueue::State>(i);
+    return TDK_ProcessingQueue::Pending;
+}
+}
+
+TDK_ProcessingQueue::TDK_ProcessingQueue(const QString &stateFileName, QObject *parent) :
+    QObject(parent),
+    mv_StateFileName(stateFileName),
+    mv_ThreadBudget(std::max(1, QThread::idealThreadCount())),
+    mv_MaximumConcurrentSessions(2),
+    mv_FlagStarted(false),
+    mv_NextSequence(0)
+{
+    mv_ThreadPool.setMaxThreadCount(mv_MaximumConcurrentSessions);
+
+    if(!mv_StateFileName.isEmpty() && QFile::exists(mv_StateFileName))
+        mf_LoadState();
+}
+
+TDK_ProcessingQueue::~TDK_ProcessingQueue()
+{
+    //Running sessions are finished and recorded, pending ones stay in the state file
+    mv_FlagStarted = false;
+    for(QMap<QFutureWatcher<QString>*, QString>::iterator it = mv_Watchers.begin(); it != mv_Watchers.end(); ++it){
+        it.key()->waitForFinished();
+        const int index = mf_FindSession(it.value());
+        const QString error = it.key()->result();
+        mv_Sessions[index].state = error.isEmpty() ? Done : Failed;
+        mv_Sessions[index].error = error;
+    }
+    mv_Watchers.clear();
+    mf_SaveState();
+}
+
+/*!
+ * \brief TDK_ProcessingQueue::mf_SetThreadBudget
+ * \param threads cores shared by all running sessions, the ideal thread count by default
+ */
+void TDK_ProcessingQueue::mf_SetThreadBudget(const int threads)
+{
+    mv_ThreadBudget = std::max(1, threads);
+}
+
+/*!
+ * \brief TDK_ProcessingQueue::mf_SetMaximumConcurrentSessions
+ * \param sessions sessions running at the same time, 2 by default. Takes effect for sessions
+ * started afterwards.
+ */
+void TDK_ProcessingQueue::mf_SetMaximumConcurrentSessions(const int sessions)
+{
+    mv_MaximumConcurrentSessions = std::max(1, sessions);
+    mv_ThreadPool.setMaxThreadCount(mv_MaximumConcurrentSessions);
+    mf_Dispatch();
+}
+
+/*!
+ * \brief TDK_ProcessingQueue::mf_Enqueue
+ * \param inputDirectory folder with the PLY/PCD scans of the session
+ * \param configFile JSON configuration of TDK_BatchProcessor, empty for the defaults
+ * \param cloudFile merged cloud, not written when empty
+ * \param meshFile mesh, not written when empty
+ * \param priority interactive sessions start before batch sessions
+ * \param reportFile stage times and registration telemetry, not written when empty
+ * \return id of the session
+ */
+QString TDK_ProcessingQueue::mf_Enqueue(const QString &inputDirectory, const QString &configFile,
+                                        const QString &cloudFile, const QString &meshFile,
+                                        const Priority priority, const QString &reportFile)
+{
+    Session session;
+    session.sequence = mv_NextSequence++;
+    session.id = QString("session-%1").arg(session.sequence);
+    session.priority = priority;
+    session.inputDirectory = inputDirectory;
+    session.configFile = configFile;
+    session.cloudFile = cloudFile;
+    session.meshFile = meshFile;
+    session.reportFile = reportFile;
+    mv_Sessions.append(session);
+
+    qDebug() << "ProcessingQueue: Queued" << session.id << (priority == Interactive ? "interactive" : "batch") << inputDirectory;
+
+    mf_SaveState();
+    mf_Dispatch();
+    return session.id;
+}
+
+int TDK_ProcessingQueue::mf_GetNumberOfPendingSessions() const
+{
+    int pending = 0;
+    for(int i = 0; i < mv_Sessions.size(); i++)
+        if(mv_Sessions[i].state == Pending)
+            pending++;
+    return pending;
+}
+
+void TDK_ProcessingQueue::mf_ClearFinished()
+{
+    for(int i = mv_Sessions.size() - 1; i >= 0; i--)
+        if(mv_Sessions[i].state == Done || mv_Sessions[i].state == Failed)
+            mv_Sessions.removeAt(i);
+    mf_SaveState();
+}
+
+void TDK_ProcessingQueue::mf_Start()
+{
+    mv_FlagStarted = true;
+    mf_Dispatch();
+}
+
+void TDK_ProcessingQueue::mf_Pause()
+{
+    mv_FlagStarted = false;
+}
+
+/*!
+ * \brief TDK_ProcessingQueue::mf_Dispatch
+ *
+ * Starts pending sessions until all slots are used. Emits mf_SignalQueueEmpty when nothing is
+ * running and nothing is left to start.
+ */
+void TDK_ProcessingQueue::mf_Dispatch()
+{
+    while(mv_FlagStarted && mv_Watchers.size() < mv_MaximumConcurrentSessions){
+        //One slot is left to interactive sessions
+        const int batchSlots = std::max(1, mv_MaximumConcurrentSessions - 1);
+        int runningBatch = 0;
+        foreach(const QString &id, mv_Watchers)
+            if(mv_Sessions[mf_FindSession(id)].priority == Batch)
+                runningBatch++;
+        const bool batchAllowed = runningBatch < batchSlots;
+
+        int next = -1;
+        for(int i = 0; i < mv_Sessions.size(); i++){
+            const Session &session = mv_Sessions[i];
+            if(session.state != Pending || (session.priority == Batch && !batchAllowed))
+                continue;
+            if(next < 0 || session.priority < mv_Sessions[next].priority ||
+                    (session.priority == mv_Sessions[next].priority && session.sequence < mv_Sessions[next].sequence))
+                next = i;
+        }
+        if(next < 0)
+            break;
+
+        //Batch sessions share the budget among the slots they may use, so the reserved slot keeps
+        //no cores idle. An interactive session gets the share of one of all slots
+        const int slots = mv_Sessions[next].priority == Batch ? batchSlots : mv_MaximumConcurrentSessions;
+        const int threads = std::max(1, mv_ThreadBudget / slots);
+        mv_Sessions[next].state = Running;
+        mv_Sessions[next].error.clear();
+        mf_SaveState();
+
+        QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+        connect(watcher, SIGNAL(finished()), this, SLOT(mf_SlotSessionFinished()));
+        mv_Watchers.insert(watcher, mv_Sessions[next].id);
+        watcher->setFuture(QtConcurrent::run(&mv_ThreadPool, &TDK_ProcessingQueue::mf_RunSession, mv_Sessions[next], threads));
+
+        qDebug() << "ProcessingQueue: Started" << mv_Sessions[next].id << "with" << threads << "threads";
+        emit mf_SignalSessionStarted(mv_Sessions[next].id);
+    }
+
+    if(mv_Watchers.isEmpty() && mf_GetNumberOfPendingSessions() == 0)
+        emit mf_SignalQueueEmpty();
+}
+
+void TDK_ProcessingQueue::mf_SlotSessionFinished()
+{
+    QFutureWatcher<QString> *watcher = static_cast<QFutureWatcher<QString>*>(sender());
+    const QString id = mv_Watchers.take(watcher);
+    const QString error = watcher->result();
+    watcher->deleteLater();
+
+    const int index = mf_FindSession(id);
+    mv_Sessions[index].state = error.isEmpty() ? Done : Failed;
+    mv_Sessions[index].error = error;
+    mf_SaveState();
+
+    if(error.isEmpty())
+        qDebug() << "ProcessingQueue: Finished" << id;
+    else
+        qWarning() << "ProcessingQueue: Failed" << id << error;
+    emit mf_SignalSessionFinished(id, error.isEmpty());
+
+    mf_Dispatch();
+}
+
+int TDK_ProcessingQueue::mf_FindSession(const QString &id) const
+{
+    for(int i = 0; i < mv_Sessions.size(); i++)
+        if(mv_Sessions[i].id == id)
+            return i;
+    return -1;
+}
+
+/*!
+ * \brief TDK_ProcessingQueue::mf_LoadState
+ * \return false when the state file cannot be read
+ *
+ * Sessions that were running are queued again
+ */
+bool TDK_ProcessingQueue::mf_LoadState()
+{
+    QFile file(mv_StateFileName);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        qWarning() << "ProcessingQueue: Could not read" << mv_StateFileName;
+        return false;
+    }
+
+    const QJsonObject state = QJsonDocument::fromJson(file.readAll()).object();
+    const QJsonArray sessions = state.value("sessions").toArray();
+
+    mv_Sessions.clear();
+    mv_NextSequence = static_cast<qint64>(state.value("nextSequence").toDouble());
+    int resumed = 0;
+    for(int i = 0; i < sessions.size(); i++){
+        const QJsonObject object = sessions[i].toObject();
+        Session session;
+        session.id = object.value("id").toString();
+        session.priority = object.value("priority").toString() == "interactive" ? Interactive : Batch;
+        session.state = stateFromName(object.value("state").toString());
+        session.sequence = static_cast<qint64>(object.value("sequence").toDouble());
+        session.inputDirectory = object.value("input").toString();
+        session.configFile = object.value("config").toString();
+        session.cloudFile = object.value("cloud").toString();
+        session.meshFile = object.value("mesh").toString();
+        session.reportFile = object.value("report").toString();
+        session.error = object.value("error").toString();
+        if(session.state == Running){
+            session.state = Pending;
+            resumed++;
+        }
+        mv_NextSequence = std::max(mv_NextSequence, session.sequence + 1);
+        mv_Sessions.append(session);
+    }
+
+    qDebug() << "ProcessingQueue: Restored" << mv_Sessions.size() << "sessions," << resumed << "interrupted ones are queued again";
+    return true;
+}
+
+bool TDK_ProcessingQueue::mf_SaveState() const
+{
+    if(mv_StateFileName.isEmpty())
+        return true;
+
+    QJsonArray sessions;
+    for(int i = 0; i < mv_Sessions.size(); i++){
+        const Session &session = mv_Sessions[i];
+        QJsonObject object;
+        object["id"] = session.id;
+        object["priority"] = session.priority == Interactive ? "interactive" : "batch";
+        object["state"] = stateNames[session.state];
+        object["sequence"] = static_cast<double>(session.sequence);
+        object["input"] = session.inputDirectory;
+        object["config"] = session.configFile;
+        object["cloud"] = session.cloudFile;
+        object["mesh"] = session.meshFile;
+        object["report"] = session.reportFile;
+        if(!session.error.isEmpty())
+            object["error"] = session.error;
+        sessions.append(object);
+    }
+
+    QJsonObject state;
+    state["nextSequence"] = static_cast<double>(mv_NextSequence);
+    state["sessions"] = sessions;
+
+    //Written to a temporary file first, a crash never leaves half a state behind
+    QSaveFile file(mv_StateFileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)){
+        qWarning() << "ProcessingQueue: Could not write" << mv_StateFileName;
+        return false;
+    }
+    file.write(QJsonDocument(state).toJson());
+    return file.commit();
+}
+
+/*!
+ * \brief TDK_ProcessingQueue::mf_RunSession
+ * \param session session to process, runs in a thread of the queue pool
+ * \param threads OpenMP threads of the session
+ * \return empty on success, the reason of the failure otherwise
+ */
+QString TDK_ProcessingQueue::mf_RunSession(const Session session, const int threads)
+{
+#ifdef _OPENMP
+    //Applies to the parallel regions started from this pool thread
+    omp_set_num_threads(threads);
+#else
+    Q_UNUSED(threads);
+#endif
+
+    TDK_BatchProcessor processor;
+    if(!session.configFile.isEmpty() && !processor.mf_LoadConfig(session.configFile))
+        return QString("Could not load the configuration %1").arg(session.configFile);
+    if(!processor.mf_LoadScans(session.inputDirectory))
+        return QString("Could not load at least two scans from %1").arg(session.inputDirectory);
+
+    const bool success = processor.mf_Run(session.cloudFile, session.meshFile);
+
+    if(!session.reportFile.isEmpty()){
+        QFile file(session.reportFile);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+            return QString("Could not write %1").arg(session.reportFile);
+        file.write(QJsonDocument(processor.mf_GetReport()).toJson());
+    }
+
+    return success ? QString() : QString("Registration or writing the outputs failed");
+}
@@ -0,0 +1,118 @@
+#ifndef TDK_PROCESSINGQUEUE_H
+#define TDK_PROCESSINGQUEUE_H
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+/*!
+ * \brief The TDK_ProcessingQueue class
+ *
+ * Schedules independent scan sessions, each registered, filtered and meshed by a
+ * TDK_BatchProcessor, and runs several of them at the same time within a global thread
+ * budget. Every running session gets a share of the budget for its OpenMP regions.
+ *
+ * Interactive sessions are started before batch sessions, sessions of the same priority in
+ * the order they were queued. When more than one session may run at once, one slot is kept
+ * free of batch sessions so an interactive session never waits for a long batch. Batch
+ * sessions split the whole budget among the other slots, an interactive session gets the
+ * share of one of all slots on top while it runs next to them.
+ *
+ * With a state file the queue is written after every change and read back on construction.
+ * Sessions that were running when the process stopped are queued again, so a restart
+ * resumes the work. Finished sessions stay in the file until mf_ClearFinished.
+ *
+ * Signals are emitted in the thread of the queue object, it needs a running event loop.
+ *
+ * Use example
+ * TDK_ProcessingQueue queue("queue.json");
+ * queue.mf_Enqueue("scans/mug", "config.json", "mug.ply", "mug_mesh.ply");
+ * connect(&queue, SIGNAL(mf_SignalQueueEmpty()), &app, SLOT(quit()));
+ * queue.mf_Start();
+ */
+class TDK_ProcessingQueue : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority
+    {
+        Interactive = 0,
+        Batch = 1
+    };
+
+    enum State
+    {
+        Pending,
+        Running,
+        Done,
+        Failed
+    };
+
+    struct Session
+    {
+        QString     id;
+        Priority    priority = Batch;
+        State       state = Pending;
+        qint64      sequence = 0;           //order of queueing
+        QString     inputDirectory;
+        QString     configFile;             //empty for the default configuration
+        QString     cloudFile;
+        QString     meshFile;
+        QString     reportFile;
+        QString     error;
+    };
+
+    explicit TDK_ProcessingQueue(const QString &stateFileName = QString(), QObject *parent = 0);
+    ~TDK_ProcessingQueue();
+
+    void    mf_SetThreadBudget              (const int threads);
+    void    mf_SetMaximumConcurrentSessions (const int sessions);
+    int     mf_GetThreadBudget              () const    {   return mv_ThreadBudget;             }
+    int     mf_GetMaximumConcurrentSessions () const    {   return mv_MaximumConcurrentSessions;    }
+
+    QString mf_Enqueue                      (const QString &inputDirectory, const QString &configFile,
+                                             const QString &cloudFile, const QString &meshFile,
+                                             const Priority priority = Batch, const QString &reportFile = QString());
+
+    QList<Session>  mf_GetSessions          () const    {   return mv_Sessions;     }
+    int     mf_GetNumberOfPendingSessions   () const;
+    int     mf_GetNumberOfRunningSessions   () const    {   return mv_Watchers.size();  }
+    void    mf_ClearFinished                ();
+
+    bool    mf_IsStarted                    () const    {   return mv_FlagStarted;  }
+
+public slots:
+    void    mf_Start                        ();
+    //Running sessions finish, no new one is started
+    void    mf_Pause                        ();
+
+signals:
+    void    mf_SignalSessionStarted         (QString id);
+    void    mf_SignalSessionFinished        (QString id, bool success);
+    void    mf_SignalQueueEmpty             ();
+
+private slots:
+    void    mf_SlotSessionFinished          ();
+
+private:
+    QString                                 mv_StateFileName;
+    int                                     mv_ThreadBudget;
+    int                                     mv_MaximumConcurrentSessions;
+    bool                                    mv_FlagStarted;
+    qint64                                  mv_NextSequence;
+    QList<Session>                          mv_Sessions;
+    QThreadPool                             mv_ThreadPool;
+    QMap<QFutureWatcher<QString>*, QString> mv_Watchers;        //running sessions
+
+    void    mf_Dispatch                     ();
+    int     mf_FindSession                  (const QString &id) const;
+    bool    mf_LoadState                    ();
+    bool    mf_SaveState                    () const;
+
+    static QString  mf_RunSession           (const Session session, const int threads);
+};
+
+#endif // TDK_PROCESSINGQUEUE_H
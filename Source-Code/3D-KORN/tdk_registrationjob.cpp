@@ -0,0 +1,135 @@
+#include "tdk_registrationjob.h"
+#include "tdk_meshing.h"
+
+#include <QDebug>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+namespace
+{
+//Worker pool shared by all registration jobs
+QThreadPool *registrationThreadPool()
+{
+    static QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    return &pool;
+}
+}
+
+TDK_RegistrationJob::TDK_RegistrationJob(TDK_ScanRegistration *scanRegistration, QObject *parent) :
+    QObject(parent),
+    mv_ScanRegistration(scanRegistration),
+    mv_FlagRunning(false),
+    mv_FlagFuseViews(false)
+{
+    qRegisterMetaType<pcl::PointCloud<pcl::PointXYZRGB>::Ptr>("pcl::PointCloud<pcl::PointXYZRGB>::Ptr");
+    qRegisterMetaType<pcl::PolygonMesh::Ptr>("pcl::PolygonMesh::Ptr");
+
+    connect(&mv_Watcher, SIGNAL(finished()), this, SLOT(mf_SlotJobFinished()));
+    connect(&mv_FusionWatcher, SIGNAL(finished()), this, SLOT(mf_SlotFusionFinished()));
+}
+
+TDK_RegistrationJob::~TDK_RegistrationJob()
+{
+    //The worker uses the scan registration, it has to stop before its owner goes away
+    mf_Cancel();
+    mf_WaitForFinished();
+}
+
+/*!
+ * \brief TDK_RegistrationJob::mf_Start
+ * \return false when the job is already running
+ */
+bool TDK_RegistrationJob::mf_Start()
+{
+    if(mv_FlagRunning)
+        return false;
+
+    mv_FlagRunning = true;
+    //A cancel that arrived after the previous run finished must not stop this one
+    mv_ScanRegistration->mf_clearCancelRequest();
+    emit mf_SignalProgress(0.0);
+
+    //Progress is emitted from the worker thread and queued to this object
+    connect(mv_ScanRegistration, SIGNAL(mf_SignalRegistrationProgress(double)), this, SIGNAL(mf_SignalProgress(double)));
+
+    mv_Watcher.setFuture(QtConcurrent::run(registrationThreadPool(), this, &TDK_RegistrationJob::mf_Run));
+    return true;
+}
+
+/*!
+ * \brief TDK_RegistrationJob::mf_Cancel
+ *
+ * Returns immediately, mf_SignalCancelled is emitted once the worker has stopped
+ */
+void TDK_RegistrationJob::mf_Cancel()
+{
+    if(mv_FlagRunning)
+        mv_ScanRegistration->mf_requestCancel();
+}
+
+bool TDK_RegistrationJob::mf_IsRunning() const
+{
+    return mv_FlagRunning;
+}
+
+void TDK_RegistrationJob::mf_WaitForFinished()
+{
+    mv_Watcher.waitForFinished();
+    mv_FusionWatcher.waitForFinished();
+}
+
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_RegistrationJob::mf_Run()
+{
+    return mv_ScanRegistration->Process_and_getAlignedPC();
+}
+
+/*!
+ * \brief TDK_RegistrationJob::mf_SlotJobFinished
+ *
+ * Runs in the thread of the job once the worker returned. Cancelled registrations return no cloud.
+ * The fusion is queued on the worker before the cloud is delivered, so the job still runs when
+ * the receivers see the cloud.
+ */
+void TDK_RegistrationJob::mf_SlotJobFinished()
+{
+    disconnect(mv_ScanRegistration, SIGNAL(mf_SignalRegistrationProgress(double)), this, SIGNAL(mf_SignalProgress(double)));
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr registeredPointCloud = mv_Watcher.result();
+    if(!registeredPointCloud){
+        mv_FlagRunning = false;
+        qDebug() << "RegistrationJob: Cancelled";
+        emit mf_SignalCancelled();
+        return;
+    }
+
+    if(mv_FlagFuseViews)
+        mv_FusionWatcher.setFuture(QtConcurrent::run(registrationThreadPool(), this, &TDK_RegistrationJob::mf_RunFusion));
+    else
+        mv_FlagRunning = false;
+
+    emit mf_SignalProgress(1.0);
+    emit mf_SignalFinished(registeredPointCloud);
+}
+
+/*!
+ * \brief TDK_RegistrationJob::mf_RunFusion
+ * \return mesh of the registered views in their poses, none when the fusion failed
+ *
+ * Runs on the worker, the views and poses of the scan registration are not changed until the
+ * job has finished.
+ */
+pcl::PolygonMesh::Ptr TDK_RegistrationJob::mf_RunFusion()
+{
+    pcl::PolygonMesh::Ptr mesh (new pcl::PolygonMesh);
+    if(!TDK_Meshing::mf_TSDF_Fusion(*mv_ScanRegistration->getRoughlyAlignedPCs(), *mv_ScanRegistration->getRegisteredPoses(), mesh,
+                                    0.002, 0.01, [this](double fraction){ emit mf_SignalFusionProgress(fraction); }))
+        return pcl::PolygonMesh::Ptr();
+    return mesh;
+}
+
+void TDK_RegistrationJob::mf_SlotFusionFinished()
+{
+    mv_FlagRunning = false;
+    emit mf_SignalMeshFinished(mv_FusionWatcher.result());
+}
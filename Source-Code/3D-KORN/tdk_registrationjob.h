@@ -0,0 +1,82 @@
+#ifndef TDK_REGISTRATIONJOB_H
+#define TDK_REGISTRATIONJOB_H
+
+#include <QObject>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QMetaType>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PolygonMesh.h>
+
+#include "tdk_scanregistration.h"
+
+/*!
+ * \brief The TDK_RegistrationJob class
+ *
+ * Runs TDK_ScanRegistration::Process_and_getAlignedPC on a worker pool so the GUI keeps
+ * responding while the views are registered. Jobs share one worker thread and run one after
+ * the other, the registration itself already uses all cores with OpenMP.
+ *
+ * Progress is reported as the fraction of aligned pairs. A job can be cancelled, the pair
+ * being aligned is finished first. Signals are emitted in the thread of the job object, so
+ * the registered cloud can be stored in TDK_Database directly from a connected slot.
+ *
+ * With mf_SetFuseViews the registered views are then fused into a mesh with TSDF fusion on the
+ * same worker, mf_SignalFusionProgress reports the fraction of views fused and
+ * mf_SignalMeshFinished delivers the mesh. The fusion can not be cancelled, the job keeps
+ * running until it is done.
+ *
+ * The scan registration must not be used by anyone else while the job is running.
+ *
+ * Use example
+ * TDK_RegistrationJob *job = new TDK_RegistrationJob(scanRegistration, this);
+ * connect(job, SIGNAL(mf_SignalFinished(pcl::PointCloud<pcl::PointXYZRGB>::Ptr)),
+ *         this, SLOT(mf_SlotRegistrationFinished(pcl::PointCloud<pcl::PointXYZRGB>::Ptr)));
+ * job->mf_Start();
+ */
+class TDK_RegistrationJob : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TDK_RegistrationJob(TDK_ScanRegistration *scanRegistration, QObject *parent = 0);
+    ~TDK_RegistrationJob();
+
+    void    mf_SetFuseViews         (bool fuse)     {   mv_FlagFuseViews = fuse;    }
+
+    bool    mf_Start                ();
+    bool    mf_IsRunning            () const;
+    void    mf_WaitForFinished      ();
+
+public slots:
+    void    mf_Cancel               ();
+
+signals:
+    void    mf_SignalProgress       (double fraction);
+    void    mf_SignalFinished       (pcl::PointCloud<pcl::PointXYZRGB>::Ptr registeredPointCloud);
+    void    mf_SignalCancelled      ();
+    //Emitted from the worker thread
+    void    mf_SignalFusionProgress (double fraction);
+    //No mesh when the fusion failed
+    void    mf_SignalMeshFinished   (pcl::PolygonMesh::Ptr mesh);
+
+private slots:
+    void    mf_SlotJobFinished      ();
+    void    mf_SlotFusionFinished   ();
+
+private:
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr  mf_Run          ();
+    pcl::PolygonMesh::Ptr                   mf_RunFusion    ();
+
+    TDK_ScanRegistration                                       *mv_ScanRegistration;
+    QFutureWatcher<pcl::PointCloud<pcl::PointXYZRGB>::Ptr>      mv_Watcher;
+    QFutureWatcher<pcl::PolygonMesh::Ptr>                       mv_FusionWatcher;
+    bool                                                        mv_FlagRunning;
+    bool                                                        mv_FlagFuseViews;
+};
+
+Q_DECLARE_METATYPE(pcl::PointCloud<pcl::PointXYZRGB>::Ptr)
+Q_DECLARE_METATYPE(pcl::PolygonMesh::Ptr)
+
+#endif // TDK_REGISTRATIONJOB_H
@@ -1,15 +1,122 @@
 #include "tdk_scanregistration.h"
 #include "tdk_filters.h"
+#include "tdk_kinectv2intrinsics.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTime>
 
 #include <iostream>
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 using namespace std;
 
+namespace
+{
+//Exposes the iteration count, GICP does not report its iterations through the visualization callback
+class IterationCountingGICP: public pcl::GeneralizedIterativeClosestPoint<pcl::PointXYZRGB, pcl::PointXYZRGB>
+{
+public:
+    int getNumberOfIterations() const { return nr_iterations_; }
+};
+
+//Measures the time the PCL ICP loop spends searching correspondences and keeps the size of the last set
+template <typename PointT>
+class TimedCorrespondenceEstimation: public pcl::registration::CorrespondenceEstimation<PointT, PointT>
+{
+public:
+    typedef boost::shared_ptr<TimedCorrespondenceEstimation<PointT> > Ptr;
+
+    TimedCorrespondenceEstimation(): elapsed_ms_(0.0), last_size_(0) {}
+
+    void determineCorrespondences(pcl::Correspondences &correspondences, double max_distance)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        pcl::registration::CorrespondenceEstimation<PointT, PointT>::determineCorrespondences(correspondences, max_distance);
+        elapsed_ms_ += timer.nsecsElapsed() / 1e6;
+        last_size_ = static_cast<int>(correspondences.size());
+    }
+
+    double getElapsedMs() const { return elapsed_ms_; }
+    int getLastNumberOfCorrespondences() const { return last_size_; }
+
+private:
+    double elapsed_ms_;
+    int last_size_;
+};
+
+//Pairs with fewer points matched at the end, relative to the smaller cloud, are reported as failed
+const double MinimumInlierRatio = 0.3;
+
+//Integral image normals are not smoothed across depth jumps larger than this part of the depth,
+//a point is only given the normal of its pixel when their depths are that close
+const float MaxDepthChangeFactor = 0.02f;
+//Clouds with fewer points given an integral image normal get KD-tree normals for every point,
+//above it only the points without one do
+const float MinViewNormalRatio = 0.8f;
+
+//Records are emitted from the streaming worker thread, queued connections need the type
+const int PairRecordMetaTypeId = qRegisterMetaType<TDK_ScanRegistration::PairRecord>("TDK_ScanRegistration::PairRecord");
+
+//The overlap of two clouds is at most the smaller one. Register aligns the growing model to a
+//single view, a ratio over the model would fall below the minimum after a few views
+double inlierRatio(const TDK_ScanRegistration::PairRecord &record)
+{
+    const int points = std::min(record.sourcePoints, record.targetPoints);
+    return points > 0 ? double(record.icp.inliers) / points : 0.0;
+}
+
+bool pairFailed(const TDK_ScanRegistration::PairRecord &record)
+{
+    return !record.icp.converged || inlierRatio(record) < MinimumInlierRatio;
+}
+
+//Total, mean and maximum of one stage over all pairs, unmeasured values (negative) are skipped
+QJsonObject stageSummary(const std::vector<double> &values)
+{
+    double total = 0.0;
+    double maximum = 0.0;
+    int count = 0;
+    for (size_t i = 0; i < values.size(); ++i){
+        if (values[i] < 0.0)
+            continue;
+        total += values[i];
+        maximum = std::max(maximum, values[i]);
+        count++;
+    }
+
+    QJsonObject summary;
+    summary["totalMs"] = total;
+    summary["meanMs"] = count > 0 ? QJsonValue(total / count) : QJsonValue();
+    summary["maxMs"] = count > 0 ? QJsonValue(maximum) : QJsonValue();
+    return summary;
+}
+
+//Threads for the PCL OMP estimators, setNumberOfThreads(0) would take every core and ignore
+//the budget the processing queue sets with omp_set_num_threads for each session
+unsigned int ompThreadBudget()
+{
+#ifdef _OPENMP
+    return static_cast<unsigned int>(omp_get_max_threads());
+#else
+    return 1;
+#endif
+}
+}
+
 TDK_ScanRegistration::TDK_ScanRegistration()
 {
     //Empty constructor
@@ -43,6 +150,12 @@ void TDK_ScanRegistration::setDefaultParameters()
     mv_scannerCenterRotationSet = false;
     mv_accumulatedRotation = 0.0;
 
+    //Sign of the turntable rotation around its axis as seen from the scanner
+    mv_turntableDirection = 1.0;
+
+    mv_streamingRunning = false;
+    mv_cancelRequested = false;
+
     //Size in meters used in the downsampling of input for inital alignment
     mv_voxelSideLength = 0.015;
 
@@ -58,13 +171,28 @@ void TDK_ScanRegistration::setDefaultParameters()
     //Max distance in meters between two points to find correspondances for
     //loop closing and IncrementalICP layers
     mv_ICPPost_MaxCorrespondanceDistance = 0.03;
+
+    //FPFH support radius in meters for global pre-alignment, has to be larger than the normal radius
+    mv_featureRadiusSearch = 0.1;
+
+    //Max distance in meters between a transformed keypoint and its match to count as RANSAC inlier
+    mv_RANSAC_InlierDistance = 0.02;
+
+    //Number of RANSAC hypotheses evaluated in global pre-alignment
+    mv_RANSAC_Iterations = 20000;
+
+    //Voxel side in meters of the merged model, overlapping views are averaged per voxel.
+    //Kinect V2 samples about 2 mm apart at scanning distance, finer voxels do not bound the model
+    mv_modelVoxelSize = 0.002;
+    mv_streamingModel.mf_SetVoxelSize(mv_modelVoxelSize);
 }
 
 /////////////////////////////////////////////////////
 TDK_ScanRegistration::~TDK_ScanRegistration()
 {
-    //Destructor is empty since all of the dynamic allocation
-    //is performed with boost smart pointers
+    //All of the dynamic allocation is performed with boost smart pointers,
+    //only the streaming worker has to finish before the members go away
+    mv_streamingFuture.waitForFinished();
 }
 
 /////////////////////////////////////////////////////
@@ -125,8 +253,22 @@ bool TDK_ScanRegistration::addNextPointCloud(
         //Remove outliers and store reference to denoised Pointcloud
         mv_originalRotatedDenoisedPCs.push_back(mf_outlierRemovalPC(mv_originalRotatedPCs.back()));
 
+        QMutexLocker locker(&mv_streamingMutex);
+
+        //Keep the turntable angle of every view for the initial guess of the registration
+        mv_accumulatedRotation += degreesRotatedY;
+        mv_alignedPCsAccumulatedYRotation.push_back(mv_accumulatedRotation);
+
+        //The worker runs with the settings of the last added view
+        mv_ICPSelection = mf_currentICPSelection();
         mf_processInPostWithICP();
 
+        //Align the new view in the background while the turntable moves to the next step
+        if(mv_streamingRegistration && !mv_streamingRunning){
+            mv_streamingRunning = true;
+            mv_streamingFuture = QtConcurrent::run(this, &TDK_ScanRegistration::mf_streamingRegistrationWorker);
+        }
+
         return true;
     }
 }
@@ -164,14 +306,19 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::getRoughlyAlignedPC
     for (it = mv_alignedOriginalPCs.begin(); it != mv_alignedOriginalPCs.end(); ++it)
         *mergedAlignedOriginal += *(*it);
 
-    return mf_outlierRemovalPC(mergedAlignedOriginal, 1.0);
+    //The merged cloud is large, decisions near the threshold are checked exactly up to 1% error.
+    //Same meanK of 8 as the exact mf_outlierRemovalPC, the grid cells are sized to hold that many points
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr denoised(new pcl::PointCloud<pcl::PointXYZRGB>());
+    TDK_Filters::mf_FilterApproximateStatisticalOutlierRemoval(mergedAlignedOriginal, denoised, 8, 2.5, 0.01);
+    return denoised;
 }
 
 
 
 
 
-pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::Register(std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> &Data ) {
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::Register(std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> &Data,
+                                                                      const std::vector<float> &accumulatedYRotations) {
 
     // PCL_INFO (" \n Loaded %d datasets ... \n", (int)Data.size ());
 
@@ -179,22 +326,49 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::Register(std::vecto
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt (new pcl::PointCloud<pcl::PointXYZRGB>);
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_src (new pcl::PointCloud<pcl::PointXYZRGB>);
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_tgt (new pcl::PointCloud<pcl::PointXYZRGB>);
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr result1 (new pcl::PointCloud<pcl::PointXYZRGB>);
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr result2 (new pcl::PointCloud<pcl::PointXYZRGB>);
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr fusedCloud (new pcl::PointCloud<pcl::PointXYZRGB>);
     const float VoxelGridLeafSize = 0.002; // 0.004
 
+    //Views are fused into a voxel model in the frame of the first view,
+    //pose maps the last registered view into that frame
+    TDK_VoxelAccumulator model(mv_modelVoxelSize);
+    Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+    model.mf_Integrate(Data[0]);
+
+    ICPSelection selection;
+    {
+        QMutexLocker locker(&mv_streamingMutex);
+        selection = mv_ICPSelection;
+    }
+    mv_registeredPoses.assign(1, pose);
+    mf_clearPairRecords();
 
     result2 = Data[0];
     std::cout<< "data size"<< Data.size ()<<endl;
     for (size_t i = 1; i < Data.size (); ++i)
     {
+        if (mv_cancelRequested){
+            qDebug() << "ScanRegistration: Registration cancelled before pair" << i;
+            mv_registeredPoses.clear();
+            mf_clearScanCaches();
+            return pcl::PointCloud<pcl::PointXYZRGB>::Ptr();
+        }
 
-        cloud_src = result2; // source
+        QElapsedTimer pairTimer;
+        pairTimer.start();
+
+        cloud_src = mv_use2DFeatureDetection ? result2 : model.mf_GetPointCloud(); // source
         cloud_tgt = Data[i]; // target
 
+        //New buffers for every pair, descriptors and covariances are cached per cloud
+        QElapsedTimer stageTimer;
+        stageTimer.start();
+        src.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+        tgt.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
         TDK_Filters::mf_FilterVoxelGridDownsample (cloud_src, src, VoxelGridLeafSize);
         TDK_Filters::mf_FilterVoxelGridDownsample (cloud_tgt, tgt, VoxelGridLeafSize);
+        const double downsampleMs = stageTimer.nsecsElapsed() / 1e6;
 
 
         if (mv_use2DFeatureDetection == true){
@@ -213,15 +387,6 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::Register(std::vecto
 
             std::cout << "MATCHING DONE! " << std::endl;
 
-
-             //To visualize point clouds in a different window
-            boost::shared_ptr<pcl::visualization::PCLVisualizer> rgbViewer2 = rgbVis(fusedCloud);
-                        while (!rgbViewer2->wasStopped ())
-                        {
-                            rgbViewer2->spinOnce (100);
-                            boost::this_thread::sleep (boost::posix_time::microseconds (100000));
-                        }
-
             *fusedCloud += *cloud_tgt;
 
            //result2 =  TDK_ScanRegistration::mf_outlierRemovalPC(fusedCloud);
@@ -232,27 +397,170 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::Register(std::vecto
         }
         else{
 
-            if (mv_ICP_Normals == false)
-                result1 = TDK_ScanRegistration::ICP(src, tgt);
-            else
-                result1 = TDK_ScanRegistration::ICPNormal(src, tgt);
-
-            *result1 += *cloud_tgt;
-            result2 = result1;
-            //result2 =  TDK_ScanRegistration::mf_outlierRemovalPC(result1);
+            //Start ICP from the turntable rotation between both views when it is known,
+            //the model is moved into the previous view first
+            Eigen::Matrix4f guess = Eigen::Matrix4f::Identity();
+            if (accumulatedYRotations.size() == Data.size())
+                guess = mf_turntableInitialGuess(accumulatedYRotations[i] - accumulatedYRotations[i-1]);
+            guess = guess * pose.inverse();
+
+            PairRecord record;
+            record.source = -1;             //the model of views 0 to i-1
+            record.target = static_cast<int>(i);
+            record.method = mf_selectedICPName(selection);
+            record.sourcePoints = static_cast<int>(src->size());
+            record.targetPoints = static_cast<int>(tgt->size());
+            record.downsampleMs = downsampleMs;
+
+            //Without turntable angle fall back to a feature based global alignment
+            if (selection.globalPreAlignment && !mv_scannerCenterRotationSet){
+                stageTimer.restart();
+                mf_globalPreAlignment(src, tgt, guess);
+                record.preAlignmentMs = stageTimer.nsecsElapsed() / 1e6;
+            }
+
+            Eigen::Matrix4f modelToView = guess;
+            mf_alignWithSelectedICP(selection, src, tgt, guess, &modelToView, &record.icp,
+                                    pcl::PointCloud<pcl::PointXYZRGB>::Ptr(), cloud_tgt);
+
+            pose = modelToView.inverse();
+            model.mf_Integrate(cloud_tgt, pose);
+            mv_registeredPoses.push_back(pose);
+
+            record.transformation = modelToView;
+            record.totalMs = pairTimer.nsecsElapsed() / 1e6;
+            mf_recordPair(record);
 
 
         }
+
+        emit mf_SignalRegistrationProgress(double(i) / (Data.size() - 1));
+    }
+
+    //Model is returned in the frame of the last view, as the merged clouds were before
+    if (mv_use2DFeatureDetection)
+        mv_registeredPoses.clear();
+    else{
+        result2.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+        pcl::transformPointCloud (*model.mf_GetPointCloud(), *result2, Eigen::Matrix4f(pose.inverse()));
     }
 
 
+    //Merged source clouds are not used again, neither are their descriptors
+    mf_clearScanCaches();
+
     return result2;
 
 }
 
+/*!
+ * \brief TDK_ScanRegistration::mf_alignWithSelectedICP
+ * \param selection ICP variant, a copy of the mv_ICP_* flags
+ * \param src source point cloud
+ * \param tgt target point cloud
+ * \param guess initial transformation of the source
+ * \param finalTransformation optional output for the estimated transformation
+ * \param stats optional output for iterations, fitness and stage timings
+ * \param sourceView optional full resolution view src was downsampled from
+ * \param targetView optional full resolution view tgt was downsampled from
+ * \return source point cloud aligned to the target
+ *
+ * Runs the selected ICP variant. Looking up or computing cached
+ * normals, covariances and color gradients counts as normal estimation time.
+ */
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::mf_alignWithSelectedICP(
+        const ICPSelection &selection,
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr src,
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+        const Eigen::Matrix4f &guess,
+        Eigen::Matrix4f *finalTransformation,
+        RegistrationStats *stats,
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &sourceView,
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &targetView)
+{
+    QElapsedTimer cacheTimer;
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr aligned;
+
+    if (selection.colored){
+        cacheTimer.start();
+        const ScanColorGradients targetGradients = mf_getCachedColorGradients(tgt);
+        const double cacheMs = cacheTimer.nsecsElapsed() / 1e6;
+        aligned = TDK_ScanRegistration::ICPColored(src, tgt, guess, finalTransformation, stats, &targetGradients);
+        if (stats)
+            stats->normalsMs += cacheMs;
+    }
+    else if (selection.generalized){
+        cacheTimer.start();
+        const ScanCovariances sourceCovariances = mf_getCachedCovariances(src);
+        const ScanCovariances targetCovariances = mf_getCachedCovariances(tgt);
+        const double cacheMs = cacheTimer.nsecsElapsed() / 1e6;
+        aligned = TDK_ScanRegistration::ICPGeneralized(src, tgt, guess, finalTransformation, stats,
+                                                       &sourceCovariances, &targetCovariances);
+        if (stats)
+            stats->normalsMs += cacheMs;
+    }
+    else if (selection.projective || selection.normals){
+        cacheTimer.start();
+        const pcl::PointCloud<pcl::PointNormal>::Ptr sourceNormals = mf_getCachedNormals(src, sourceView);
+        const pcl::PointCloud<pcl::PointNormal>::Ptr targetNormals = mf_getCachedNormals(tgt, targetView);
+        const double cacheMs = cacheTimer.nsecsElapsed() / 1e6;
+        if (selection.projective)
+            aligned = TDK_ScanRegistration::ICPProjective(src, tgt, guess, finalTransformation, stats,
+                                                          sourceNormals, targetNormals);
+        else
+            aligned = TDK_ScanRegistration::ICPNormal(src, tgt, guess, finalTransformation, stats,
+                                                      sourceNormals, targetNormals);
+        if (stats)
+            stats->normalsMs += cacheMs;
+    }
+    else
+        aligned = TDK_ScanRegistration::ICP(src, tgt, guess, finalTransformation, stats);
+
+    return aligned;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_currentICPSelection
+ * \return copy of the mv_ICP_* flags and mv_globalPreAlignment, to be taken on the thread that sets them
+ */
+TDK_ScanRegistration::ICPSelection TDK_ScanRegistration::mf_currentICPSelection() const
+{
+    ICPSelection selection;
+    selection.normals = mv_ICP_Normals;
+    selection.projective = mv_ICP_Projective;
+    selection.generalized = mv_ICP_Generalized;
+    selection.colored = mv_ICP_Colored;
+    selection.globalPreAlignment = mv_globalPreAlignment;
+    return selection;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_selectedICPName
+ * \param selection ICP variant
+ * \return name of the ICP variant, as used in the registration benchmark
+ */
+QString TDK_ScanRegistration::mf_selectedICPName(const ICPSelection &selection)
+{
+    if (selection.colored)
+        return "ColoredICP";
+    else if (selection.generalized)
+        return "GICP";
+    else if (selection.projective)
+        return "ICPProjective";
+    else if (!selection.normals)
+        return "ICP";
+    else
+        return "ICPNormal";
+}
+
 
 
-pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICPNormal(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt){
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICPNormal(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                                       const Eigen::Matrix4f &guess,
+                                                                       Eigen::Matrix4f *finalTransformation,
+                                                                       RegistrationStats *stats,
+                                                                       const pcl::PointCloud<pcl::PointNormal>::Ptr &sourceNormals,
+                                                                       const pcl::PointCloud<pcl::PointNormal>::Ptr &targetNormals){
 
 
     float MaxDistance=0.015;
@@ -260,31 +568,29 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICPNormal(pcl::Poin
     float Iterations = 100;
 
 
-    pcl::PointCloud<pcl::PointNormal>::Ptr points_with_normals_src (new pcl::PointCloud<pcl::PointNormal>);
-    pcl::PointCloud<pcl::PointNormal>::Ptr points_with_normals_tgt (new pcl::PointCloud<pcl::PointNormal>);
+    pcl::PointCloud<pcl::PointNormal>::Ptr points_with_normals_src = sourceNormals;
+    pcl::PointCloud<pcl::PointNormal>::Ptr points_with_normals_tgt = targetNormals;
 
     pcl::PointCloud<pcl::PointNormal>::Ptr normals_icp (new pcl::PointCloud<pcl::PointNormal>);
 
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_norm (new pcl::PointCloud<pcl::PointXYZRGB>);
 
-    pcl::NormalEstimation<pcl::PointXYZRGB, pcl::PointNormal> norm_est;
-    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZRGB> ());
-
-    qDebug() << "Tree and Normal estimation set up!";
-    norm_est.setSearchMethod (tree);
-    norm_est.setKSearch (12);
-
-    norm_est.setInputCloud (src);
-    norm_est.compute (*points_with_normals_src);
-    qDebug() << "Normals computed! (1)";
-    pcl::copyPointCloud (*src, *points_with_normals_src);
-
-    norm_est.setInputCloud (tgt);
-    norm_est.compute (*points_with_normals_tgt);
-    qDebug() << "Normals computed! (2)";
-    pcl::copyPointCloud (*tgt, *points_with_normals_tgt);
+    //Normals given by the caller are used as they are
+    QElapsedTimer timer;
+    timer.start();
+    if (!points_with_normals_src){
+        mf_computeKdTreeNormals(src, points_with_normals_src);
+        qDebug() << "Normals computed! (1)";
+    }
+    if (!points_with_normals_tgt){
+        mf_computeKdTreeNormals(tgt, points_with_normals_tgt);
+        qDebug() << "Normals computed! (2)";
+    }
+    const double normalsMs = timer.nsecsElapsed() / 1e6;
 
     pcl::IterativeClosestPointWithNormals<pcl::PointNormal, pcl::PointNormal> reg;
+    TimedCorrespondenceEstimation<pcl::PointNormal>::Ptr correspondenceEstimation (new TimedCorrespondenceEstimation<pcl::PointNormal>);
+    reg.setCorrespondenceEstimation (correspondenceEstimation);
     reg.setTransformationEpsilon (1e-8);
 
     reg.setMaxCorrespondenceDistance (MaxDistance);
@@ -292,9 +598,19 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICPNormal(pcl::Poin
     reg.setMaximumIterations (Iterations);
 
 
+    //The visualization callback is invoked once per iteration, use it to count them
+    int performedIterations = 0;
+    boost::function<void(const pcl::PointCloud<pcl::PointNormal>&, const std::vector<int>&,
+                         const pcl::PointCloud<pcl::PointNormal>&, const std::vector<int>&)> iterationCounter =
+            [&performedIterations](const pcl::PointCloud<pcl::PointNormal>&, const std::vector<int>&,
+                                   const pcl::PointCloud<pcl::PointNormal>&, const std::vector<int>&) { performedIterations++; };
+    reg.registerVisualizationCallback (iterationCounter);
+
     reg.setInputSource (points_with_normals_src);
     reg.setInputTarget (points_with_normals_tgt);
-    reg.align (*normals_icp);
+    timer.restart();
+    reg.align (*normals_icp, guess);
+    const double alignMs = timer.nsecsElapsed() / 1e6;
 
     qDebug() << "Normals aligned!";
 
@@ -303,6 +619,17 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICPNormal(pcl::Poin
     Eigen::Matrix4f transform_normals = reg.getFinalTransformation ();
     qDebug() << "Transformations obtained!";
     pcl::transformPointCloud (*src, *cloud_norm, transform_normals);
+    if (finalTransformation)
+        *finalTransformation = transform_normals;
+    if (stats){
+        stats->iterations = performedIterations;
+        stats->converged = reg.hasConverged();
+        stats->fitness = reg.getFitnessScore();
+        stats->inliers = correspondenceEstimation->getLastNumberOfCorrespondences();
+        stats->normalsMs = normalsMs;
+        stats->correspondenceMs = correspondenceEstimation->getElapsedMs();
+        stats->solveMs = alignMs - stats->correspondenceMs;
+    }
 
     std::cout<<cloud_norm<<std::endl;
     return cloud_norm;
@@ -312,7 +639,10 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICPNormal(pcl::Poin
 
 ///////////////////////////////////////////////////
 
-pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICP(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt){
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICP(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                                 const Eigen::Matrix4f &guess,
+                                                                 Eigen::Matrix4f *finalTransformation,
+                                                                 RegistrationStats *stats){
     // Start first ICP
     float MaxDistance=0.015;
     float RansacVar = 0.01;
@@ -321,27 +651,869 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICP(pcl::PointCloud
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr Final (new pcl::PointCloud<pcl::PointXYZRGB>);
 
     pcl::IterativeClosestPoint<pcl::PointXYZRGB, pcl::PointXYZRGB> icp;
+    TimedCorrespondenceEstimation<pcl::PointXYZRGB>::Ptr correspondenceEstimation (new TimedCorrespondenceEstimation<pcl::PointXYZRGB>);
+    icp.setCorrespondenceEstimation (correspondenceEstimation);
     icp.setMaxCorrespondenceDistance (MaxDistance); //0.10 //0.015
     icp.setRANSACOutlierRejectionThreshold (RansacVar); // 0.05
     icp.setTransformationEpsilon (1e-8);
     icp.setMaximumIterations (Iterations);
+
+    //The visualization callback is invoked once per iteration, use it to count them
+    int performedIterations = 0;
+    boost::function<void(const pcl::PointCloud<pcl::PointXYZRGB>&, const std::vector<int>&,
+                         const pcl::PointCloud<pcl::PointXYZRGB>&, const std::vector<int>&)> iterationCounter =
+            [&performedIterations](const pcl::PointCloud<pcl::PointXYZRGB>&, const std::vector<int>&,
+                                   const pcl::PointCloud<pcl::PointXYZRGB>&, const std::vector<int>&) { performedIterations++; };
+    icp.registerVisualizationCallback(iterationCounter);
+
     icp.setInputSource(src);
     icp.setInputTarget(tgt);
-    icp.align(*Final);
+    QElapsedTimer timer;
+    timer.start();
+    icp.align(*Final, guess);
+    const double alignMs = timer.nsecsElapsed() / 1e6;
 
     std::cout << "ICP converged with score: " << icp.getFitnessScore() << std::endl;
+    if (finalTransformation)
+        *finalTransformation = icp.getFinalTransformation();
+    if (stats){
+        stats->iterations = performedIterations;
+        stats->converged = icp.hasConverged();
+        stats->fitness = icp.getFitnessScore();
+        stats->inliers = correspondenceEstimation->getLastNumberOfCorrespondences();
+        stats->normalsMs = 0.0;
+        stats->correspondenceMs = correspondenceEstimation->getElapsedMs();
+        stats->solveMs = alignMs - stats->correspondenceMs;
+    }
 
     return Final;
 
 }
 
+/*!
+ * \brief TDK_ScanRegistration::ICPGeneralized
+ * \param src source point cloud
+ * \param tgt target point cloud
+ * \param guess initial transformation of the source
+ * \param finalTransformation optional output for the estimated transformation
+ * \param stats optional output for iterations, fitness and stage timings
+ * \param sourceCovariances optional covariances of src from mf_computeCovariances
+ * \param targetCovariances optional covariances of tgt from mf_computeCovariances
+ * \return source point cloud aligned to the target
+ *
+ * Generalized ICP, minimizes a plane-to-plane distance weighted with the local covariances of
+ * both clouds, which is less sensitive to depth noise than point-to-plane. Covariances that are
+ * not given are computed here. PCL runs correspondence search and optimization in one loop,
+ * their time is reported together as solve time.
+ */
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICPGeneralized(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                                            const Eigen::Matrix4f &guess,
+                                                                            Eigen::Matrix4f *finalTransformation,
+                                                                            RegistrationStats *stats,
+                                                                            const ScanCovariances *sourceCovariances,
+                                                                            const ScanCovariances *targetCovariances){
+
+    float MaxDistance = 0.015;
+    float Iterations = 100;
+
+    QElapsedTimer timer;
+    timer.start();
+    const ScanCovariances source = sourceCovariances ? *sourceCovariances : mf_computeCovariances(src);
+    const ScanCovariances target = targetCovariances ? *targetCovariances : mf_computeCovariances(tgt);
+    const double normalsMs = timer.nsecsElapsed() / 1e6;
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr Final (new pcl::PointCloud<pcl::PointXYZRGB>);
+
+    IterationCountingGICP gicp;
+    gicp.setMaxCorrespondenceDistance (MaxDistance);
+    gicp.setTransformationEpsilon (1e-8);
+    gicp.setMaximumIterations (Iterations);
+    gicp.setInputSource (src);
+    gicp.setInputTarget (tgt);
+
+    //Reuse the trees and covariances of the scans instead of rebuilding them for every pair
+    gicp.setSearchMethodSource (source.tree, true);
+    gicp.setSearchMethodTarget (target.tree, true);
+    gicp.setSourceCovariances (source.covariances);
+    gicp.setTargetCovariances (target.covariances);
+    timer.restart();
+    gicp.align (*Final, guess);
+    const double alignMs = timer.nsecsElapsed() / 1e6;
+
+    qDebug() << "ScanRegistration: GICP converged after" << gicp.getNumberOfIterations() << "iterations with score:" << gicp.getFitnessScore();
+    if (finalTransformation)
+        *finalTransformation = gicp.getFinalTransformation();
+    if (stats){
+        //Inliers are the aligned source points with a target point within the correspondence distance
+        const int size = static_cast<int>(Final->size());
+        const float maxDistanceSqr = MaxDistance * MaxDistance;
+        int inliers = 0;
+#pragma omp parallel
+        {
+            std::vector<int> index(1);
+            std::vector<float> distanceSqr(1);
+#pragma omp for reduction(+:inliers)
+            for (int i = 0; i < size; ++i)
+                if (pcl::isFinite(Final->points[i]) &&
+                        target.tree->nearestKSearch(Final->points[i], 1, index, distanceSqr) > 0 &&
+                        distanceSqr[0] <= maxDistanceSqr)
+                    inliers++;
+        }
+
+        stats->iterations = gicp.getNumberOfIterations();
+        stats->converged = gicp.hasConverged();
+        stats->fitness = gicp.getFitnessScore();
+        stats->inliers = inliers;
+        stats->normalsMs = normalsMs;
+        stats->correspondenceMs = -1.0;
+        stats->solveMs = alignMs;
+    }
+
+    return Final;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_computeCovariances
+ * \param cloud_in input point cloud
+ * \param kNeighbours number of neighbours of the local covariance
+ * \return KD-tree of the cloud and one covariance per point
+ *
+ * Every covariance keeps the directions of the local neighbourhood but its eigenvalues are
+ * replaced by (1, 1, 0.001), a plane with small uncertainty along the normal as expected by
+ * the plane-to-plane cost of GICP. Points are processed in parallel with OpenMP.
+ */
+TDK_ScanRegistration::ScanCovariances TDK_ScanRegistration::mf_computeCovariances(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+        const int kNeighbours)
+{
+    const double Epsilon = 0.001;
+
+    ScanCovariances result;
+    result.tree.reset(new pcl::search::KdTree<pcl::PointXYZRGB>());
+    result.tree->setInputCloud(cloud_in);
+    result.covariances.reset(new CovarianceVector(cloud_in->size(), Eigen::Matrix3d::Identity()));
+
+    const int size = static_cast<int>(cloud_in->size());
+    const Eigen::Vector3d planeEigenvalues(1.0, 1.0, Epsilon);
+
+#pragma omp parallel
+    {
+        std::vector<int> indices(kNeighbours);
+        std::vector<float> squaredDistances(kNeighbours);
+
+#pragma omp for schedule(dynamic, 256)
+        for(int i = 0; i < size; i++){
+            const int found = result.tree->nearestKSearch(cloud_in->points[i], kNeighbours, indices, squaredDistances);
+            if(found < 3)
+                continue;
+
+            Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+            Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+            for(int j = 0; j < found; j++){
+                const Eigen::Vector3d point = cloud_in->points[indices[j]].getVector3fMap().cast<double>();
+                mean += point;
+                covariance += point * point.transpose();
+            }
+            mean /= found;
+            covariance = covariance / found - mean * mean.transpose();
+
+            //Singular values come sorted in decreasing order, the last vector is the normal
+            Eigen::JacobiSVD<Eigen::Matrix3d> svd(covariance, Eigen::ComputeFullU);
+            (*result.covariances)[i] = svd.matrixU() * planeEigenvalues.asDiagonal() * svd.matrixU().transpose();
+        }
+    }
+
+    return result;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_getCachedCovariances
+ * \param cloud scan point cloud
+ * \return KD-tree and GICP covariances of the scan, computed on first use
+ */
+TDK_ScanRegistration::ScanCovariances TDK_ScanRegistration::mf_getCachedCovariances(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud)
+{
+    {
+        QMutexLocker locker(&mv_featureCacheMutex);
+        std::map<pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr, ScanCovariances>::const_iterator it = mv_covarianceCache.find(cloud);
+        if(it != mv_covarianceCache.end())
+            return it->second;
+    }
+
+    ScanCovariances covariances = mf_computeCovariances(cloud);
+
+    QMutexLocker locker(&mv_featureCacheMutex);
+    mv_covarianceCache[cloud] = covariances;
+    return covariances;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::ICPColored
+ * \param src source point cloud
+ * \param tgt target point cloud
+ * \param guess initial transformation of the source
+ * \param finalTransformation optional output for the estimated transformation
+ * \param stats optional output for iterations, fitness and stage timings
+ * \param targetGradients optional color gradients of tgt from mf_computeColorGradients
+ * \return source point cloud aligned to the target
+ *
+ * Joint photometric and geometric ICP (Park et al., Colored Point Cloud Registration Revisited).
+ * Every correspondence adds a point-to-plane residual and an intensity residual, the target
+ * intensity is a first order model on the tangent plane of the target point built from its
+ * precomputed color gradient. Geometry drives the alignment across the surface normal while the
+ * texture constrains sliding along flat or symmetric surfaces. Correspondences and the normal
+ * equations are computed in parallel with OpenMP.
+ */
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICPColored(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                                        const Eigen::Matrix4f &guess,
+                                                                        Eigen::Matrix4f *finalTransformation,
+                                                                        RegistrationStats *stats,
+                                                                        const ScanColorGradients *targetGradients){
+
+    float MaxDistance = 0.015;
+    float Iterations = 100;
+    double TransformationEpsilon = 1e-8;
+    //Weight of the geometric term, the rest goes to the photometric one
+    double LambdaGeometric = 0.968;
+
+    QElapsedTimer timer;
+    timer.start();
+    const ScanColorGradients target = targetGradients ? *targetGradients : mf_computeColorGradients(tgt);
+    const double normalsMs = timer.nsecsElapsed() / 1e6;
+
+    const int size = static_cast<int>(src->size());
+    const float maxDistanceSqr = MaxDistance * MaxDistance;
+    const double weightGeometric = LambdaGeometric;
+    const double weightPhotometric = 1.0 - LambdaGeometric;
+
+    std::vector<float> sourceIntensities(size);
+    for (int i = 0; i < size; ++i){
+        const pcl::PointXYZRGB &p = src->points[i];
+        sourceIntensities[i] = (p.r + p.g + p.b) / (3.0f * 255.0f);
+    }
+
+    Eigen::Matrix4f transform = guess;
+    double fitness = 0.0;
+    int iteration = 0;
+    int numberOfCorrespondences = 0;
+    bool converged = true;
+    double correspondenceMs = 0.0;
+    double solveMs = 0.0;
+
+    //Transformed source points and their closest target point, -1 without correspondence
+    std::vector<Eigen::Vector3f> transformedPoints(size);
+    std::vector<int> correspondences(size);
+
+    for (; iteration < Iterations; ++iteration)
+    {
+        typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+        typedef Eigen::Matrix<double, 6, 1> Vector6d;
+
+        Matrix6d JtJ = Matrix6d::Zero();
+        Vector6d Jtr = Vector6d::Zero();
+        double squaredError = 0.0;
+        numberOfCorrespondences = 0;
+
+        const Eigen::Matrix3f rotation = transform.topLeftCorner<3,3>();
+        const Eigen::Vector3f translation = transform.topRightCorner<3,1>();
+
+        timer.restart();
+#pragma omp parallel
+        {
+            std::vector<int> index(1);
+            std::vector<float> distanceSqr(1);
+
+#pragma omp for schedule(dynamic, 256)
+            for (int i = 0; i < size; ++i)
+            {
+                correspondences[i] = -1;
+
+                pcl::PointXYZRGB transformed;
+                transformed.getVector3fMap() = rotation * src->points[i].getVector3fMap() + translation;
+                if (!pcl::isFinite(transformed))
+                    continue;
+
+                if (target.tree->nearestKSearch(transformed, 1, index, distanceSqr) < 1 || distanceSqr[0] > maxDistanceSqr)
+                    continue;
+
+                transformedPoints[i] = transformed.getVector3fMap();
+                correspondences[i] = index[0];
+            }
+        }
+        correspondenceMs += timer.nsecsElapsed() / 1e6;
+
+        timer.restart();
+#pragma omp parallel
+        {
+            Matrix6d threadJtJ = Matrix6d::Zero();
+            Vector6d threadJtr = Vector6d::Zero();
+            double threadSquaredError = 0.0;
+            int threadCorrespondences = 0;
+
+#pragma omp for schedule(static)
+            for (int i = 0; i < size; ++i)
+            {
+                const int j = correspondences[i];
+                if (j < 0)
+                    continue;
+
+                const Eigen::Vector3d n = target.normals->points[j].getNormalVector3fMap().cast<double>();
+                if (!n.allFinite())
+                    continue;
+
+                const Eigen::Vector3d p = transformedPoints[i].cast<double>();
+                const Eigen::Vector3d q = tgt->points[j].getVector3fMap().cast<double>();
+                const Eigen::Vector3d d = (*target.gradients)[j].cast<double>();
+
+                //Point to plane residual
+                const double geometricResidual = (p - q).dot(n);
+                Vector6d geometricJacobian;
+                geometricJacobian << p.cross(n), n;
+
+                //Intensity residual against the target intensity on its tangent plane
+                const Eigen::Vector3d projected = p - geometricResidual * n;
+                const double photometricResidual = sourceIntensities[i] - ((*target.intensities)[j] + d.dot(projected - q));
+                Vector6d photometricJacobian;
+                photometricJacobian << -p.cross(d), -d;
+
+                threadJtJ += weightGeometric * geometricJacobian * geometricJacobian.transpose() +
+                        weightPhotometric * photometricJacobian * photometricJacobian.transpose();
+                threadJtr += weightGeometric * geometricJacobian * geometricResidual +
+                        weightPhotometric * photometricJacobian * photometricResidual;
+                threadSquaredError += geometricResidual * geometricResidual;
+                threadCorrespondences++;
+            }
+
+#pragma omp critical
+            {
+                JtJ += threadJtJ;
+                Jtr += threadJtr;
+                squaredError += threadSquaredError;
+                numberOfCorrespondences += threadCorrespondences;
+            }
+        }
+
+        //Six degrees of freedom need at least six pairs
+        if (numberOfCorrespondences < 6){
+            qDebug() << "ScanRegistration: Not enough colored ICP correspondences" << numberOfCorrespondences;
+            converged = false;
+            solveMs += timer.nsecsElapsed() / 1e6;
+            break;
+        }
+        fitness = squaredError / numberOfCorrespondences;
+
+        //Increment as (rotation vector, translation), applied on the left
+        const Vector6d delta = JtJ.ldlt().solve(-Jtr);
+        const Eigen::Vector3d omega = delta.head<3>();
+        Eigen::Affine3d increment = Eigen::Affine3d::Identity();
+        if (omega.norm() > 0.0)
+            increment.linear() = Eigen::AngleAxisd(omega.norm(), omega.normalized()).toRotationMatrix();
+        increment.translation() = delta.tail<3>();
+        transform = increment.matrix().cast<float>() * transform;
+        solveMs += timer.nsecsElapsed() / 1e6;
+
+        if (delta.squaredNorm() < TransformationEpsilon){
+            ++iteration;
+            break;
+        }
+    }
+
+    qDebug() << "ScanRegistration: Colored ICP converged after" << iteration << "iterations with score:" << fitness;
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_colored (new pcl::PointCloud<pcl::PointXYZRGB>);
+    pcl::transformPointCloud (*src, *cloud_colored, transform);
+    if (finalTransformation)
+        *finalTransformation = transform;
+    if (stats){
+        stats->iterations = iteration;
+        stats->converged = converged;
+        stats->fitness = fitness;
+        stats->inliers = numberOfCorrespondences;
+        stats->normalsMs = normalsMs;
+        stats->correspondenceMs = correspondenceMs;
+        stats->solveMs = solveMs;
+    }
+
+    return cloud_colored;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_computeColorGradients
+ * \param cloud_in input point cloud
+ * \param kNeighbours number of neighbours used for the normal and the gradient of every point
+ * \return KD-tree, normals, intensities and intensity gradients of the cloud
+ *
+ * The gradient d of a point p is the least squares solution of I(p) + d.(q' - p) = I(q) over
+ * its neighbours q, where q' is q projected on the tangent plane of p. An extra equation keeps
+ * d orthogonal to the normal. Points are processed in parallel with OpenMP.
+ */
+TDK_ScanRegistration::ScanColorGradients TDK_ScanRegistration::mf_computeColorGradients(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+        const int kNeighbours)
+{
+    const int size = static_cast<int>(cloud_in->size());
+
+    ScanColorGradients result;
+    result.tree.reset(new pcl::search::KdTree<pcl::PointXYZRGB>());
+    result.tree->setInputCloud(cloud_in);
+    result.normals.reset(new pcl::PointCloud<pcl::Normal>());
+    result.intensities.reset(new std::vector<float>(size));
+    result.gradients.reset(new GradientVector(size, Eigen::Vector3f::Zero()));
+
+    pcl::NormalEstimationOMP<pcl::PointXYZRGB, pcl::Normal> normalEstimation;
+    normalEstimation.setNumberOfThreads(ompThreadBudget());
+    normalEstimation.setInputCloud(cloud_in);
+    normalEstimation.setSearchMethod(result.tree);
+    normalEstimation.setKSearch(kNeighbours);
+    normalEstimation.compute(*result.normals);
+
+    for(int i = 0; i < size; i++){
+        const pcl::PointXYZRGB &p = cloud_in->points[i];
+        (*result.intensities)[i] = (p.r + p.g + p.b) / (3.0f * 255.0f);
+    }
+
+#pragma omp parallel
+    {
+        std::vector<int> indices(kNeighbours);
+        std::vector<float> squaredDistances(kNeighbours);
+
+#pragma omp for schedule(dynamic, 256)
+        for(int i = 0; i < size; i++){
+            const Eigen::Vector3f n = result.normals->points[i].getNormalVector3fMap();
+            if(!n.allFinite())
+                continue;
+
+            const int found = result.tree->nearestKSearch(cloud_in->points[i], kNeighbours, indices, squaredDistances);
+            if(found < 4)
+                continue;
+
+            const Eigen::Vector3f p = cloud_in->points[i].getVector3fMap();
+            const float intensity = (*result.intensities)[i];
+
+            Eigen::Matrix3f AtA = Eigen::Matrix3f::Zero();
+            Eigen::Vector3f Atb = Eigen::Vector3f::Zero();
+            for(int k = 0; k < found; k++){
+                const Eigen::Vector3f q = cloud_in->points[indices[k]].getVector3fMap();
+                const Eigen::Vector3f offset = (q - p) - (q - p).dot(n) * n;
+                AtA += offset * offset.transpose();
+                Atb += offset * ((*result.intensities)[indices[k]] - intensity);
+            }
+
+            //Extra equation n.d = 0 keeps the gradient on the tangent plane
+            AtA += n * n.transpose();
+            (*result.gradients)[i] = AtA.ldlt().solve(Atb);
+        }
+    }
+
+    return result;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_getCachedColorGradients
+ * \param cloud scan point cloud
+ * \return colored ICP target data of the scan, computed on first use
+ */
+TDK_ScanRegistration::ScanColorGradients TDK_ScanRegistration::mf_getCachedColorGradients(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud)
+{
+    {
+        QMutexLocker locker(&mv_featureCacheMutex);
+        std::map<pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr, ScanColorGradients>::const_iterator it = mv_colorGradientCache.find(cloud);
+        if(it != mv_colorGradientCache.end())
+            return it->second;
+    }
+
+    ScanColorGradients gradients = mf_computeColorGradients(cloud);
+
+    QMutexLocker locker(&mv_featureCacheMutex);
+    mv_colorGradientCache[cloud] = gradients;
+    return gradients;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_computeKdTreeNormals
+ * \param cloud_in input point cloud
+ * \param cloud_normals output points of cloud_in with their normals
+ * \param kNeighbours number of neighbours of the local plane
+ *
+ * Normals of unorganized clouds, a plane is fitted to the neighbours found in a KD-tree.
+ */
+void TDK_ScanRegistration::mf_computeKdTreeNormals(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+        pcl::PointCloud<pcl::PointNormal>::Ptr &cloud_normals,
+        const int kNeighbours)
+{
+    pcl::NormalEstimation<pcl::PointXYZRGB, pcl::PointNormal> norm_est;
+    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZRGB> ());
+    norm_est.setSearchMethod (tree);
+    norm_est.setKSearch (kNeighbours);
+
+    cloud_normals.reset(new pcl::PointCloud<pcl::PointNormal>);
+    norm_est.setInputCloud (cloud_in);
+    norm_est.compute (*cloud_normals);
+    pcl::copyPointCloud (*cloud_in, *cloud_normals);
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_computeViewNormals
+ * \param view input point cloud of a single view, in the camera frame of the Kinect
+ * \param normalImage output organized point cloud of depth image size with the normals of every pixel,
+ * NaN where no point projects or the normal is undefined
+ * \param minProjectedRatio minimum ratio of input points that have to fall inside the depth image
+ * \return true if the view could be organized as a Kinect depth image
+ *
+ * The view is organized with mf_organizeByProjection and its normals are estimated on integral
+ * images, the normal of a pixel is the cross product of the mean horizontal and vertical 3D
+ * gradients over a window summed in constant time. A few milliseconds per view instead of a
+ * KD-tree search per point. Windows shrink at depth jumps, normals are not smoothed across edges.
+ */
+bool TDK_ScanRegistration::mf_computeViewNormals(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &view,
+        pcl::PointCloud<pcl::PointNormal>::Ptr &normalImage,
+        const float minProjectedRatio)
+{
+    pcl::PointCloud<pcl::PointNormal>::Ptr points (new pcl::PointCloud<pcl::PointNormal>);
+    pcl::copyPointCloud (*view, *points);
+
+    normalImage.reset(new pcl::PointCloud<pcl::PointNormal>);
+    if (!mf_organizeByProjection(points, normalImage, minProjectedRatio))
+        return false;
+
+    typedef pcl::IntegralImageNormalEstimation<pcl::PointNormal, pcl::Normal> IntegralImageNormals;
+    IntegralImageNormals normalEstimation;
+    normalEstimation.setNormalEstimationMethod(IntegralImageNormals::AVERAGE_3D_GRADIENT);
+    normalEstimation.setMaxDepthChangeFactor(MaxDepthChangeFactor);
+    normalEstimation.setNormalSmoothingSize(10.0f);
+    normalEstimation.setInputCloud(normalImage);
+
+    pcl::PointCloud<pcl::Normal> normals;
+    normalEstimation.compute(normals);
+
+    for (size_t i = 0; i < normalImage->size(); ++i)
+    {
+        pcl::PointNormal &p = normalImage->points[i];
+        const pcl::Normal &n = normals.points[i];
+        p.normal_x = n.normal_x;
+        p.normal_y = n.normal_y;
+        p.normal_z = n.normal_z;
+        p.curvature = n.curvature;
+    }
+
+    return true;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_sampleViewNormals
+ * \param cloud_in input point cloud in the camera frame of the view, the view or a downsampled copy of it
+ * \param normalImage normals of the view from mf_computeViewNormals
+ * \param cloud_normals output points of cloud_in in their order, with their normals
+ * \param minViewRatio below this ratio of points with a view normal every point gets a KD-tree normal
+ * \param kNeighbours number of neighbours of the KD-tree normals
+ * \return ratio of the input points that got the normal of their pixel
+ *
+ * Every point takes the normal of the pixel it projects to. Points far behind the surface seen
+ * in their pixel, the back of a merged model for example, or outside the image get a KD-tree
+ * normal from their neighbours in cloud_in, as mf_computeKdTreeNormals gives it.
+ */
+float TDK_ScanRegistration::mf_sampleViewNormals(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+        const pcl::PointCloud<pcl::PointNormal>::Ptr &normalImage,
+        pcl::PointCloud<pcl::PointNormal>::Ptr &cloud_normals,
+        const float minViewRatio,
+        const int kNeighbours)
+{
+    const int width = normalImage->width;
+    const int height = normalImage->height;
+
+    cloud_normals.reset(new pcl::PointCloud<pcl::PointNormal>);
+    pcl::copyPointCloud (*cloud_in, *cloud_normals);
+    pcl::IndicesPtr unmatched (new std::vector<int>);
+
+    for (size_t i = 0; i < cloud_in->size(); ++i)
+    {
+        const pcl::PointXYZRGB &p = cloud_in->points[i];
+        pcl::PointNormal &point = cloud_normals->points[i];
+        point.normal_x = point.normal_y = point.normal_z = point.curvature = std::numeric_limits<float>::quiet_NaN();
+        if (!pcl::isFinite(p) || p.z <= 0){
+            unmatched->push_back(static_cast<int>(i));
+            continue;
+        }
+
+        int u = static_cast<int>(std::lround(TDK_KinectV2Intrinsics::fx * p.x / p.z + TDK_KinectV2Intrinsics::cx));
+        int v = static_cast<int>(std::lround(TDK_KinectV2Intrinsics::fy * p.y / p.z + TDK_KinectV2Intrinsics::cy));
+        if (u < 0 || u >= width || v < 0 || v >= height){
+            unmatched->push_back(static_cast<int>(i));
+            continue;
+        }
+
+        const pcl::PointNormal &pixel = normalImage->at(u, v);
+        if (!pcl::isFinite(pixel) || !pixel.getNormalVector3fMap().allFinite() ||
+                std::abs(p.z - pixel.z) > MaxDepthChangeFactor * p.z){
+            unmatched->push_back(static_cast<int>(i));
+            continue;
+        }
+
+        point.normal_x = pixel.normal_x;
+        point.normal_y = pixel.normal_y;
+        point.normal_z = pixel.normal_z;
+        point.curvature = pixel.curvature;
+    }
+
+    const float ratio = cloud_in->empty() ? 0.0f : 1.0f - float(unmatched->size()) / cloud_in->size();
+    if (ratio < minViewRatio){
+        mf_computeKdTreeNormals(cloud_in, cloud_normals, kNeighbours);
+        return ratio;
+    }
+    if (unmatched->empty())
+        return ratio;
+
+    pcl::NormalEstimation<pcl::PointXYZRGB, pcl::Normal> norm_est;
+    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZRGB> ());
+    norm_est.setSearchMethod (tree);
+    norm_est.setKSearch (kNeighbours);
+    norm_est.setInputCloud (cloud_in);
+    norm_est.setIndices (unmatched);
+
+    pcl::PointCloud<pcl::Normal> normals;
+    norm_est.compute (normals);
+    for (size_t i = 0; i < unmatched->size(); ++i)
+    {
+        pcl::PointNormal &point = cloud_normals->points[(*unmatched)[i]];
+        const pcl::Normal &n = normals.points[i];
+        point.normal_x = n.normal_x;
+        point.normal_y = n.normal_y;
+        point.normal_z = n.normal_z;
+        point.curvature = n.curvature;
+    }
+
+    return ratio;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_getCachedNormals
+ * \param cloud scan point cloud
+ * \param view full resolution view the scan was downsampled from, none for a merged model
+ * \return points of the scan with normals, computed on first use
+ *
+ * A single Kinect view gets integral image normals of its full resolution image, in its camera
+ * frame, ICP moves them with the points. Merged models, views moved out of the camera frame and
+ * views too sparse for the integral images get KD-tree normals.
+ */
+pcl::PointCloud<pcl::PointNormal>::Ptr TDK_ScanRegistration::mf_getCachedNormals(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud,
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &view)
+{
+    {
+        QMutexLocker locker(&mv_featureCacheMutex);
+        std::map<pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr, pcl::PointCloud<pcl::PointNormal>::Ptr>::const_iterator it = mv_normalCache.find(cloud);
+        if(it != mv_normalCache.end())
+            return it->second;
+    }
+
+    pcl::PointCloud<pcl::PointNormal>::Ptr normalImage;
+    pcl::PointCloud<pcl::PointNormal>::Ptr normals;
+    if(view && mf_computeViewNormals(view, normalImage))
+        mf_sampleViewNormals(cloud, normalImage, normals, MinViewNormalRatio);
+    else
+        mf_computeKdTreeNormals(cloud, normals);
+
+    QMutexLocker locker(&mv_featureCacheMutex);
+    mv_normalCache[cloud] = normals;
+    return normals;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::ICPProjective
+ * \param src source point cloud, in the camera frame of the previous view
+ * \param tgt target point cloud, in the camera frame of the Kinect
+ * \param guess initial transformation of the source
+ * \param finalTransformation optional output for the estimated transformation
+ * \param stats optional output for iterations, fitness and stage timings
+ * \return source point cloud aligned to the target
+ *
+ * Point-to-plane ICP where correspondences come from projecting the source points through
+ * the Kinect V2 depth intrinsics into the target depth image (projective data association),
+ * which is O(1) per point instead of a KD-tree search. Pairs whose normals disagree are rejected.
+ * Falls back to ICPNormal when the target cannot be organized as a depth image.
+ * Normals not given by the caller are computed with mf_computeKdTreeNormals.
+ */
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::ICPProjective(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                                           const Eigen::Matrix4f &guess,
+                                                                           Eigen::Matrix4f *finalTransformation,
+                                                                           RegistrationStats *stats,
+                                                                           const pcl::PointCloud<pcl::PointNormal>::Ptr &sourceNormals,
+                                                                           const pcl::PointCloud<pcl::PointNormal>::Ptr &targetNormals){
+
+    float MaxDistance = 0.03;
+    float MaxNormalAngle = 30.0; //degrees
+    float Iterations = 100;
+    double TransformationEpsilon = 1e-8;
+
+    pcl::PointCloud<pcl::PointNormal>::Ptr points_with_normals_src = sourceNormals;
+    pcl::PointCloud<pcl::PointNormal>::Ptr points_with_normals_tgt = targetNormals;
+    pcl::PointCloud<pcl::PointNormal>::Ptr organized_tgt (new pcl::PointCloud<pcl::PointNormal>);
+    pcl::PointCloud<pcl::PointNormal>::Ptr transformed_src (new pcl::PointCloud<pcl::PointNormal>);
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_proj (new pcl::PointCloud<pcl::PointXYZRGB>);
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!points_with_normals_src)
+        mf_computeKdTreeNormals(src, points_with_normals_src);
+    if (!points_with_normals_tgt)
+        mf_computeKdTreeNormals(tgt, points_with_normals_tgt);
+
+    //Projective association needs the target as a depth image
+    if(!mf_organizeByProjection(points_with_normals_tgt, organized_tgt)){
+        qDebug() << "ScanRegistration: Target is not a Kinect view, falling back to KD-tree ICP";
+        return TDK_ScanRegistration::ICPNormal(src, tgt, guess, finalTransformation, stats,
+                                               points_with_normals_src, points_with_normals_tgt);
+    }
+    const double normalsMs = timer.nsecsElapsed() / 1e6;
+
+    const int width = organized_tgt->width;
+    const int height = organized_tgt->height;
+    const float maxDistanceSqr = MaxDistance * MaxDistance;
+    const float minNormalCos = cos(MaxNormalAngle * M_PI / 180.0);
+
+    pcl::registration::TransformationEstimationPointToPlaneLLS<pcl::PointNormal, pcl::PointNormal> estimation;
+    pcl::Correspondences correspondences;
+    Eigen::Matrix4f transform = guess;
+    double fitness = 0.0;
+    int iteration = 0;
+    bool converged = true;
+    double correspondenceMs = 0.0;
+    double solveMs = 0.0;
+
+    for (; iteration < Iterations; ++iteration)
+    {
+        timer.restart();
+        pcl::transformPointCloudWithNormals (*points_with_normals_src, *transformed_src, transform);
+
+        //Find correspondences by projecting each source point into the target image
+        correspondences.clear();
+        fitness = 0.0;
+        for (size_t i = 0; i < transformed_src->size(); ++i)
+        {
+            const pcl::PointNormal &p = transformed_src->points[i];
+            if (!pcl::isFinite(p) || p.z <= 0)
+                continue;
+
+            int u = static_cast<int>(std::lround(TDK_KinectV2Intrinsics::fx * p.x / p.z + TDK_KinectV2Intrinsics::cx));
+            int v = static_cast<int>(std::lround(TDK_KinectV2Intrinsics::fy * p.y / p.z + TDK_KinectV2Intrinsics::cy));
+            if (u < 0 || u >= width || v < 0 || v >= height)
+                continue;
+
+            const pcl::PointNormal &q = organized_tgt->at(u, v);
+            if (!pcl::isFinite(q))
+                continue;
+
+            float distanceSqr = (p.getVector3fMap() - q.getVector3fMap()).squaredNorm();
+            if (distanceSqr > maxDistanceSqr)
+                continue;
+
+            //Normal compatibility rejection, also drops points without a valid normal
+            if (!(p.getNormalVector3fMap().dot(q.getNormalVector3fMap()) >= minNormalCos))
+                continue;
+
+            correspondences.push_back(pcl::Correspondence(static_cast<int>(i), v * width + u, distanceSqr));
+            fitness += distanceSqr;
+        }
+        correspondenceMs += timer.nsecsElapsed() / 1e6;
+
+        //Point to plane estimation needs at least as many pairs as degrees of freedom
+        if (correspondences.size() < 6){
+            qDebug() << "ScanRegistration: Not enough projective correspondences" << correspondences.size();
+            converged = false;
+            break;
+        }
+        fitness /= correspondences.size();
+
+        timer.restart();
+        Eigen::Matrix4f increment;
+        estimation.estimateRigidTransformation (*transformed_src, *organized_tgt, correspondences, increment);
+        transform = increment * transform;
+        solveMs += timer.nsecsElapsed() / 1e6;
+
+        if ((increment - Eigen::Matrix4f::Identity()).squaredNorm() < TransformationEpsilon){
+            ++iteration;
+            break;
+        }
+    }
+
+    qDebug() << "ScanRegistration: Projective ICP converged after" << iteration << "iterations with score:" << fitness;
+
+    pcl::transformPointCloud (*src, *cloud_proj, transform);
+    if (finalTransformation)
+        *finalTransformation = transform;
+    if (stats){
+        stats->iterations = iteration;
+        stats->converged = converged;
+        stats->fitness = fitness;
+        stats->inliers = static_cast<int>(correspondences.size());
+        stats->normalsMs = normalsMs;
+        stats->correspondenceMs = correspondenceMs;
+        stats->solveMs = solveMs;
+    }
+
+    return cloud_proj;
+}
+
 /////////////////////////////////////////////////////
 
 pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::Process_and_getAlignedPC()
 {
+    //Stored views are added now and registered without the streaming worker. The modes are
+    //restored afterwards, so the views of the next run are stored and streamed as before
     if(! mv_registerInRealTime){
+        const bool streamingRegistration = mv_streamingRegistration;
         mv_registerInRealTime = true;
+        mv_streamingRegistration = false;
         addAllPointClouds(mv_originalPCs, mv_originalPointcloudsYRotation);
+        mv_originalPCs.clear();
+        mv_originalPointcloudsYRotation.clear();
+
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr mergedAlignedOriginal = Process_and_getAlignedPC();
+        mv_registerInRealTime = false;
+        mv_streamingRegistration = streamingRegistration;
+        return mergedAlignedOriginal;
+    }
+
+    //Views were already aligned while scanning, only wait for the last one
+    if(mv_streamingRegistration){
+        emit mf_SignalStatusChanged(tr("Finishing registration..."), QColor(Qt::red));
+
+        //A cancelled run left views unaligned, resume the worker where it stopped
+        {
+            QMutexLocker locker(&mv_streamingMutex);
+            if(!mv_streamingRunning && mv_streamingPoses.size() < mv_alignedOriginalPCs.size()){
+                mv_streamingRunning = true;
+                mv_streamingFuture = QtConcurrent::run(this, &TDK_ScanRegistration::mf_streamingRegistrationWorker);
+            }
+        }
+        mv_streamingFuture.waitForFinished();
+
+        QMutexLocker locker(&mv_streamingMutex);
+        if(mv_cancelRequested.exchange(false) && mv_streamingPoses.size() < mv_alignedOriginalPCs.size()){
+            emit mf_SignalStatusChanged(tr("Registration cancelled"), QColor(Qt::red));
+            return pcl::PointCloud<pcl::PointXYZRGB>::Ptr();
+        }
+        if(!mv_alignedOriginalPCs.empty() && mv_streamingPoses.size() == mv_alignedOriginalPCs.size()){
+            //Distribute the drift accumulated around a full rotation
+            if(mv_loopClosure && mv_streamingPoses.size() > 2){
+                if(mf_coversFullTurn()){
+                    emit mf_SignalStatusChanged(tr("Closing loop..."), QColor(Qt::red));
+                    mf_closeLoopAndMerge();
+                }
+                else
+                    qDebug() << "ScanRegistration: Views do not cover a full turn, loop not closed";
+            }
+            mv_registeredPoses = mv_streamingPoses;
+            mf_clearScanCaches();
+            emit mf_SignalStatusChanged(tr("Registration done!"), QColor(Qt::darkGreen));
+            return mv_streamingModel.mf_GetPointCloud();
+        }
     }
 
     if(!mv_scannerCenterRotationSet){
@@ -354,9 +1526,24 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::Process_and_getAlig
 
         qDebug() << "ScanRegistration: PostProcessing with feature detection";
 
+        //Register runs the algorithm selected now, not the one of the last added view
+        {
+            QMutexLocker locker(&mv_streamingMutex);
+            mv_ICPSelection = mf_currentICPSelection();
+        }
+
         emit mf_SignalStatusChanged(tr("Registration started..."), QColor(Qt::red));
 
-        mergedAlignedOriginal = TDK_ScanRegistration::Register(mv_alignedOriginalPCs);
+        if (mv_scannerCenterRotationSet)
+            mergedAlignedOriginal = TDK_ScanRegistration::Register(mv_alignedOriginalPCs, mv_alignedPCsAccumulatedYRotation);
+        else
+            mergedAlignedOriginal = TDK_ScanRegistration::Register(mv_alignedOriginalPCs);
+
+        mv_cancelRequested = false;
+        if (!mergedAlignedOriginal){
+            emit mf_SignalStatusChanged(tr("Registration cancelled"), QColor(Qt::red));
+            return mergedAlignedOriginal;
+        }
 
         emit mf_SignalStatusChanged(tr("Registration done!"), QColor(Qt::darkGreen));
 
@@ -364,6 +1551,289 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::Process_and_getAlig
     return mergedAlignedOriginal;
 }
 
+/*!
+ * \brief TDK_ScanRegistration::mf_requestCancel
+ *
+ * Can be called from any thread. The pair being aligned is finished first, the request is
+ * consumed by the Process_and_getAlignedPC call it stops.
+ */
+void TDK_ScanRegistration::mf_requestCancel()
+{
+    mv_cancelRequested = true;
+}
+
+bool TDK_ScanRegistration::mf_isCancelRequested() const
+{
+    return mv_cancelRequested;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_clearCancelRequest
+ *
+ * Called by TDK_RegistrationJob before a new run is launched, so a request that arrived
+ * after the previous run had already returned does not stop the new one.
+ */
+void TDK_ScanRegistration::mf_clearCancelRequest()
+{
+    mv_cancelRequested = false;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_turntableInitialGuess
+ * \param degreesRotatedY rotation of the turntable between two views
+ * \return rigid transformation that moves points of the first view into the second one
+ *
+ * The turntable axis goes through the scanner center set with setScannerRotationAxis and is
+ * the Y axis tilted by the scanner inclination (vp_x) around X. Returns identity when the
+ * rotation axis was not set.
+ */
+Eigen::Matrix4f TDK_ScanRegistration::mf_turntableInitialGuess(const float &degreesRotatedY) const
+{
+    if(!mv_scannerCenterRotationSet || degreesRotatedY == 0.0)
+        return Eigen::Matrix4f::Identity();
+
+    Eigen::Vector3f center(mv_scannerCenter.x, mv_scannerCenter.y, mv_scannerCenter.z);
+    Eigen::Vector3f axis = Eigen::AngleAxisf(-mv_scannerCenter.vp_x*(M_PI/180.0), Eigen::Vector3f::UnitX()) * Eigen::Vector3f::UnitY();
+
+    Eigen::Transform<float,3,Eigen::Affine> transform =
+            Eigen::Translation3f(center) *
+            Eigen::AngleAxisf(mv_turntableDirection*degreesRotatedY*(M_PI/180.0), axis) *
+            Eigen::Translation3f(-center);
+
+    return transform.matrix();
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_computeFPFHFeatures
+ * \param cloud_in input point cloud
+ * \param voxelSideLength leaf size of the voxel grid used to select the keypoints
+ * \param normalRadius radius for the normal estimation
+ * \param featureRadius radius for the FPFH estimation
+ * \param keypoints output downsampled cloud, one descriptor per point
+ * \param descriptors output FPFH descriptors
+ *
+ * Normals and descriptors are computed with the OpenMP versions of the PCL estimators,
+ * using all the available cores.
+ */
+void TDK_ScanRegistration::mf_computeFPFHFeatures(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+        const float voxelSideLength,
+        const float normalRadius,
+        const float featureRadius,
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr &keypoints,
+        pcl::PointCloud<pcl::FPFHSignature33>::Ptr &descriptors)
+{
+    keypoints = mf_voxelDownSamplePointCloud(cloud_in, voxelSideLength);
+
+    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZRGB>());
+    pcl::PointCloud<pcl::Normal>::Ptr normals (new pcl::PointCloud<pcl::Normal>());
+
+    pcl::NormalEstimationOMP<pcl::PointXYZRGB, pcl::Normal> normalEstimation;
+    normalEstimation.setNumberOfThreads(ompThreadBudget());
+    normalEstimation.setInputCloud(keypoints);
+    normalEstimation.setSearchMethod(tree);
+    normalEstimation.setRadiusSearch(normalRadius);
+    normalEstimation.compute(*normals);
+
+    descriptors.reset(new pcl::PointCloud<pcl::FPFHSignature33>());
+
+    pcl::FPFHEstimationOMP<pcl::PointXYZRGB, pcl::Normal, pcl::FPFHSignature33> fpfhEstimation;
+    fpfhEstimation.setNumberOfThreads(ompThreadBudget());
+    fpfhEstimation.setInputCloud(keypoints);
+    fpfhEstimation.setInputNormals(normals);
+    fpfhEstimation.setSearchMethod(tree);
+    fpfhEstimation.setRadiusSearch(featureRadius);
+    fpfhEstimation.compute(*descriptors);
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_getCachedFeatures
+ * \param cloud scan point cloud
+ * \return keypoints and FPFH descriptors of the scan
+ *
+ * Descriptors are computed once per scan, a cloud used as target of one pair and as
+ * source of the next one is only described once.
+ */
+TDK_ScanRegistration::ScanFeatures TDK_ScanRegistration::mf_getCachedFeatures(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud)
+{
+    {
+        QMutexLocker locker(&mv_featureCacheMutex);
+        std::map<pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr, ScanFeatures>::const_iterator it = mv_featureCache.find(cloud);
+        if(it != mv_featureCache.end())
+            return it->second;
+    }
+
+    ScanFeatures features;
+    mf_computeFPFHFeatures(cloud, mv_voxelSideLength, mv_normalRadiusSearch, mv_featureRadiusSearch,
+                           features.keypoints, features.descriptors);
+
+    QMutexLocker locker(&mv_featureCacheMutex);
+    mv_featureCache[cloud] = features;
+    return features;
+}
+
+/////////////////////////////////////////////////////
+
+void TDK_ScanRegistration::mf_clearScanCaches()
+{
+    QMutexLocker locker(&mv_featureCacheMutex);
+    mv_featureCache.clear();
+    mv_covarianceCache.clear();
+    mv_colorGradientCache.clear();
+    mv_normalCache.clear();
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_globalPreAlignment
+ * \param source point cloud to align
+ * \param target reference point cloud
+ * \param transformation output rigid transformation from source to target, untouched on failure
+ * \return true when enough inliers support the transformation
+ *
+ * Global alignment for views of unknown turntable angle. Every source keypoint is matched with
+ * the nearest target keypoint in FPFH space, then RANSAC hypotheses of three matches are
+ * evaluated in parallel with OpenMP. Samples whose point distances differ between source and
+ * target are rejected before counting inliers. The best hypothesis is refined with all its inliers.
+ */
+bool TDK_ScanRegistration::mf_globalPreAlignment(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &source,
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &target,
+        Eigen::Matrix4f &transformation)
+{
+    QTime timer;
+    timer.start();
+
+    ScanFeatures sourceFeatures = mf_getCachedFeatures(source);
+    ScanFeatures targetFeatures = mf_getCachedFeatures(target);
+
+    if(sourceFeatures.descriptors->empty() || targetFeatures.descriptors->empty())
+        return false;
+
+    //Invalid descriptors are left out of the tree by the FLANN point representation
+    pcl::KdTreeFLANN<pcl::FPFHSignature33> descriptorTree;
+    descriptorTree.setInputCloud(targetFeatures.descriptors);
+
+    const int numberOfDescriptors = static_cast<int>(sourceFeatures.descriptors->size());
+    std::vector<int> matches(numberOfDescriptors, -1);
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for(int i = 0; i < numberOfDescriptors; i++){
+        const pcl::FPFHSignature33 &descriptor = sourceFeatures.descriptors->points[i];
+        if(!pcl_isfinite(descriptor.histogram[0]))
+            continue;
+
+        std::vector<int> index(1);
+        std::vector<float> squaredDistance(1);
+        if(descriptorTree.nearestKSearch(descriptor, 1, index, squaredDistance) > 0)
+            matches[i] = index[0];
+    }
+
+    Eigen::Matrix3Xf sourcePoints(3, numberOfDescriptors);
+    Eigen::Matrix3Xf targetPoints(3, numberOfDescriptors);
+    int numberOfMatches = 0;
+    for(int i = 0; i < numberOfDescriptors; i++){
+        if(matches[i] < 0)
+            continue;
+        sourcePoints.col(numberOfMatches) = sourceFeatures.keypoints->points[i].getVector3fMap();
+        targetPoints.col(numberOfMatches) = targetFeatures.keypoints->points[matches[i]].getVector3fMap();
+        numberOfMatches++;
+    }
+
+    if(numberOfMatches < 3)
+        return false;
+
+    sourcePoints.conservativeResize(3, numberOfMatches);
+    targetPoints.conservativeResize(3, numberOfMatches);
+
+    const float inlierSquaredDistance = mv_RANSAC_InlierDistance * mv_RANSAC_InlierDistance;
+    const float edgeSimilarity = 0.9;
+    const int iterations = mv_RANSAC_Iterations;
+
+    int bestInliers = 0;
+    Eigen::Matrix4f bestTransformation = Eigen::Matrix4f::Identity();
+
+#pragma omp parallel
+    {
+        int threadBestInliers = 0;
+        Eigen::Matrix4f threadBestTransformation = Eigen::Matrix4f::Identity();
+
+#pragma omp for schedule(static)
+        for(int iteration = 0; iteration < iterations; iteration++){
+            //Seeded per hypothesis, results do not depend on the number of threads.
+            //Consecutive seeds are spread out, minstd starts badly correlated for small ones
+            std::minstd_rand generator(static_cast<unsigned int>(iteration) * 2654435761u + 1u);
+            std::uniform_int_distribution<int> pick(0, numberOfMatches - 1);
+
+            int sample[3];
+            sample[0] = pick(generator);
+            sample[1] = pick(generator);
+            sample[2] = pick(generator);
+            if(sample[0] == sample[1] || sample[0] == sample[2] || sample[1] == sample[2])
+                continue;
+
+            //A rigid transformation keeps the distances between the sampled points
+            bool consistent = true;
+            for(int a = 0; a < 3 && consistent; a++){
+                const int b = (a + 1) % 3;
+                const float sourceLength = (sourcePoints.col(sample[a]) - sourcePoints.col(sample[b])).norm();
+                const float targetLength = (targetPoints.col(sample[a]) - targetPoints.col(sample[b])).norm();
+                if(std::min(sourceLength, targetLength) < edgeSimilarity * std::max(sourceLength, targetLength))
+                    consistent = false;
+            }
+            if(!consistent)
+                continue;
+
+            Eigen::Matrix3f sampleSource, sampleTarget;
+            for(int a = 0; a < 3; a++){
+                sampleSource.col(a) = sourcePoints.col(sample[a]);
+                sampleTarget.col(a) = targetPoints.col(sample[a]);
+            }
+            const Eigen::Matrix4f hypothesis = Eigen::umeyama(sampleSource, sampleTarget, false);
+
+            const Eigen::Matrix3Xf residuals =
+                    (hypothesis.topLeftCorner<3,3>() * sourcePoints).colwise() + hypothesis.topRightCorner<3,1>() - targetPoints;
+            const int inliers = static_cast<int>((residuals.colwise().squaredNorm().array() < inlierSquaredDistance).count());
+
+            if(inliers > threadBestInliers){
+                threadBestInliers = inliers;
+                threadBestTransformation = hypothesis;
+            }
+        }
+
+#pragma omp critical
+        {
+            if(threadBestInliers > bestInliers){
+                bestInliers = threadBestInliers;
+                bestTransformation = threadBestTransformation;
+            }
+        }
+    }
+
+    if(bestInliers < 3){
+        qDebug() << "ScanRegistration: Global pre-alignment failed," << numberOfMatches << "matches";
+        return false;
+    }
+
+    //Refine with every inlier of the best hypothesis
+    const Eigen::Matrix3Xf residuals =
+            (bestTransformation.topLeftCorner<3,3>() * sourcePoints).colwise() + bestTransformation.topRightCorner<3,1>() - targetPoints;
+    Eigen::Matrix3Xf inlierSource(3, bestInliers), inlierTarget(3, bestInliers);
+    int k = 0;
+    for(int i = 0; i < numberOfMatches && k < bestInliers; i++){
+        if(residuals.col(i).squaredNorm() < inlierSquaredDistance){
+            inlierSource.col(k) = sourcePoints.col(i);
+            inlierTarget.col(k) = targetPoints.col(i);
+            k++;
+        }
+    }
+    transformation = Eigen::umeyama(inlierSource.leftCols(k), inlierTarget.leftCols(k), false);
+
+    qDebug() << "ScanRegistration: Global pre-alignment" << bestInliers << "inliers of" << numberOfMatches
+             << "matches in" << timer.elapsed() << "ms";
+    return true;
+}
+
 /////////////////////////////////////////////////////
 
 vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr>* TDK_ScanRegistration::getRoughlyAlignedPCs()
@@ -371,6 +1841,12 @@ vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr>* TDK_ScanRegistration::getRoughly
     return &mv_alignedOriginalPCs;
 }
 
+/////////////////////////////////////////////////////
+vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >* TDK_ScanRegistration::getRegisteredPoses()
+{
+    return &mv_registeredPoses;
+}
+
 
 /////////////////////////////////////////////////////
 
@@ -456,6 +1932,325 @@ vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr>* TDK_ScanRegistration::getRotatio
 //}
 
 
+/*!
+ * \brief TDK_ScanRegistration::mf_streamingRegistrationWorker
+ *
+ * Runs on a thread of the global QThreadPool. Aligns every view added with addNextPointCloud
+ * to the previous one, chains the transformations into the frame of the first view and
+ * integrates the view into the voxel model. Returns when all views added so far
+ * are aligned; addNextPointCloud starts it again for the next one.
+ */
+void TDK_ScanRegistration::mf_streamingRegistrationWorker()
+{
+    const float VoxelGridLeafSize = 0.002;
+
+    while(true){
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr previousCloud;
+        Eigen::Matrix4f guess = Eigen::Matrix4f::Identity();
+        ICPSelection selection;
+        size_t index;
+
+        {
+            QMutexLocker locker(&mv_streamingMutex);
+            index = mv_streamingPoses.size();
+            if(index >= mv_alignedOriginalPCs.size() || mv_cancelRequested){
+                mv_streamingRunning = false;
+                return;
+            }
+            cloud = mv_alignedOriginalPCs[index];
+            selection = mv_ICPSelection;
+            if(index > 0)
+                previousCloud = mv_alignedOriginalPCs[index-1];
+
+            //Turntable guess maps the previous view into the new one, we align the other way
+            if(index > 0 && index < mv_alignedPCsAccumulatedYRotation.size())
+                guess = mf_turntableInitialGuess(mv_alignedPCsAccumulatedYRotation[index] -
+                                                 mv_alignedPCsAccumulatedYRotation[index-1]).inverse();
+        }
+
+        QElapsedTimer pairTimer;
+        pairTimer.start();
+
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr downsampled (new pcl::PointCloud<pcl::PointXYZRGB>);
+        TDK_Filters::mf_FilterVoxelGridDownsample (cloud, downsampled, VoxelGridLeafSize);
+        const double downsampleMs = pairTimer.nsecsElapsed() / 1e6;
+
+        Eigen::Matrix4f pose = Eigen::Matrix4f::Identity();
+        if(index > 0){
+            PairRecord record;
+            record.source = static_cast<int>(index);
+            record.target = static_cast<int>(index) - 1;
+            record.method = mf_selectedICPName(selection);
+            record.sourcePoints = static_cast<int>(downsampled->size());
+            record.targetPoints = static_cast<int>(mv_streamingPreviousDownsampled->size());
+            record.downsampleMs = downsampleMs;
+
+            //Views of unknown angle get their initial guess from FPFH matching
+            if(selection.globalPreAlignment && !mv_scannerCenterRotationSet){
+                QElapsedTimer preAlignmentTimer;
+                preAlignmentTimer.start();
+                mf_globalPreAlignment(downsampled, mv_streamingPreviousDownsampled, guess);
+                record.preAlignmentMs = preAlignmentTimer.nsecsElapsed() / 1e6;
+            }
+
+            Eigen::Matrix4f pairTransformation = guess;
+            mf_alignWithSelectedICP(selection, downsampled, mv_streamingPreviousDownsampled, guess, &pairTransformation, &record.icp,
+                                    cloud, previousCloud);
+            pose = mv_streamingPoses.back() * pairTransformation;
+
+            record.transformation = pairTransformation;
+            record.totalMs = pairTimer.nsecsElapsed() / 1e6;
+            mf_recordPair(record);
+
+            //Keep the pairwise constraint for the pose graph
+            mv_streamingPairTransformations.push_back(pairTransformation);
+            mv_streamingPairInformation.push_back(
+                        mf_computeInformationMatrix(downsampled, mv_streamingPreviousDownsampled,
+                                                    pairTransformation, mv_ICPPost_MaxCorrespondanceDistance));
+        }
+        else{
+            mv_streamingFirstDownsampled = downsampled;
+            mf_clearPairRecords();
+        }
+        mv_streamingPreviousDownsampled = downsampled;
+
+        mv_streamingModel.mf_Integrate(cloud, pose);
+
+        size_t numberOfViews;
+        {
+            QMutexLocker locker(&mv_streamingMutex);
+            mv_streamingPoses.push_back(pose);
+            numberOfViews = mv_alignedOriginalPCs.size();
+        }
+
+        qDebug() << "ScanRegistration: Streamed view" << index << "aligned";
+        emit mf_SignalStreamingModelUpdated(static_cast<int>(index) + 1);
+        emit mf_SignalRegistrationProgress(double(index + 1) / numberOfViews);
+    }
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_coversFullTurn
+ * \return true when one more turntable step after the last view reaches the first view again
+ *
+ * Partial or stopped scans do not end where they started, closing their loop would bend the
+ * model. Has to be called with mv_streamingMutex locked.
+ */
+bool TDK_ScanRegistration::mf_coversFullTurn() const
+{
+    const size_t views = mv_alignedPCsAccumulatedYRotation.size();
+    if(views < 3 || views != mv_alignedOriginalPCs.size())
+        return false;
+
+    const float step = std::abs(mv_alignedPCsAccumulatedYRotation[views-1] - mv_alignedPCsAccumulatedYRotation[views-2]);
+    const float rotation = std::abs(mv_alignedPCsAccumulatedYRotation[views-1] - mv_alignedPCsAccumulatedYRotation[0]) + step;
+    return step > 0.0f && std::abs(rotation - 360.0f) <= 0.5f * step;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_closeLoopAndMerge
+ *
+ * Aligns the last view to the first one, builds a pose graph from the pairwise streaming
+ * constraints plus this loop closure edge and optimizes it. The merged model is rebuilt
+ * from the optimized poses. Has to be called with mv_streamingMutex locked and the worker finished.
+ */
+void TDK_ScanRegistration::mf_closeLoopAndMerge()
+{
+    const float VoxelGridLeafSize = 0.002;
+
+    TDK_PoseGraph poseGraph;
+    for(size_t i = 0; i < mv_streamingPoses.size(); i++)
+        poseGraph.mf_AddNode(mv_streamingPoses[i]);
+    for(size_t i = 0; i < mv_streamingPairTransformations.size(); i++)
+        poseGraph.mf_AddEdge(i, i+1, mv_streamingPairTransformations[i], mv_streamingPairInformation[i]);
+
+    //Loop closure edge, the chained pose of the last view is the initial guess
+    const int last = static_cast<int>(mv_streamingPoses.size()) - 1;
+    QElapsedTimer pairTimer;
+    pairTimer.start();
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr lastDownsampled (new pcl::PointCloud<pcl::PointXYZRGB>);
+    TDK_Filters::mf_FilterVoxelGridDownsample (mv_alignedOriginalPCs[last], lastDownsampled, VoxelGridLeafSize);
+
+    PairRecord record;
+    record.source = last;
+    record.target = 0;
+    record.method = mf_selectedICPName(mv_ICPSelection);
+    record.sourcePoints = static_cast<int>(lastDownsampled->size());
+    record.targetPoints = static_cast<int>(mv_streamingFirstDownsampled->size());
+    record.downsampleMs = pairTimer.nsecsElapsed() / 1e6;
+
+    Eigen::Matrix4f closureTransformation = mv_streamingPoses[last];
+    mf_alignWithSelectedICP(mv_ICPSelection, lastDownsampled, mv_streamingFirstDownsampled, mv_streamingPoses[last], &closureTransformation, &record.icp,
+                            mv_alignedOriginalPCs[last], mv_alignedOriginalPCs[0]);
+    record.transformation = closureTransformation;
+    record.totalMs = pairTimer.nsecsElapsed() / 1e6;
+    mf_recordPair(record);
+    poseGraph.mf_AddEdge(0, last, closureTransformation,
+                         mf_computeInformationMatrix(lastDownsampled, mv_streamingFirstDownsampled,
+                                                     closureTransformation, mv_ICPPost_MaxCorrespondanceDistance));
+
+    QTime timer;
+    timer.start();
+    int iterations = poseGraph.mf_Optimize();
+    qDebug() << "ScanRegistration: Pose graph optimized in" << iterations << "iterations," << timer.elapsed() << "ms";
+
+    std::vector<TDK_PoseGraph::EdgeResidual> residuals = poseGraph.mf_GetEdgeResiduals();
+    for(size_t i = 0; i < residuals.size(); i++){
+        qDebug() << "ScanRegistration: Edge" << residuals[i].from << "->" << residuals[i].to
+                 << "chi2" << residuals[i].chi2
+                 << "translation" << residuals[i].translationError << "m"
+                 << "rotation" << residuals[i].rotationError << "deg";
+    }
+
+    //Rebuild the merged model with the optimized poses
+    mv_streamingModel.mf_Clear();
+    for(size_t i = 0; i < mv_streamingPoses.size(); i++){
+        mv_streamingPoses[i] = poseGraph.mf_GetPose(i);
+        mv_streamingModel.mf_Integrate(mv_alignedOriginalPCs[i], mv_streamingPoses[i]);
+    }
+}
+
+/////////////////////////////////////////////////////
+
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::getStreamingAlignedPC()
+{
+    return mv_streamingModel.mf_GetPointCloud();
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_recordPair
+ * \param record telemetry of a registered pair
+ *
+ * Stores the record in the session, writes it to the log as one line of JSON and emits it
+ */
+void TDK_ScanRegistration::mf_recordPair(const PairRecord &record)
+{
+    {
+        QMutexLocker locker(&mv_pairRecordsMutex);
+        mv_pairRecords.push_back(record);
+    }
+
+    qDebug().noquote() << "ScanRegistration: Pair" << QJsonDocument(mf_pairRecordToJson(record)).toJson(QJsonDocument::Compact);
+    emit mf_SignalPairRegistered(record);
+}
+
+void TDK_ScanRegistration::mf_clearPairRecords()
+{
+    QMutexLocker locker(&mv_pairRecordsMutex);
+    mv_pairRecords.clear();
+}
+
+vector<TDK_ScanRegistration::PairRecord> TDK_ScanRegistration::getPairRecords() const
+{
+    QMutexLocker locker(&mv_pairRecordsMutex);
+    return mv_pairRecords;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_pairRecordToJson
+ * \param record telemetry of a registered pair
+ * \return the record with its transformation as 16 row major values, the source is "model" when
+ * it was the model of all views before the target. A pair failed when ICP did not converge or
+ * fewer correspondences than 30% of the points of the smaller cloud remained.
+ */
+QJsonObject TDK_ScanRegistration::mf_pairRecordToJson(const PairRecord &record)
+{
+    QJsonObject timings;
+    timings["downsampleMs"] = record.downsampleMs;
+    timings["preAlignmentMs"] = record.preAlignmentMs;
+    timings["normalsMs"] = record.icp.normalsMs;
+    timings["correspondenceMs"] = record.icp.correspondenceMs >= 0.0 ? QJsonValue(record.icp.correspondenceMs) : QJsonValue();
+    timings["solveMs"] = record.icp.solveMs;
+    timings["totalMs"] = record.totalMs;
+
+    QJsonArray transformation;
+    for (int row = 0; row < 4; ++row)
+        for (int col = 0; col < 4; ++col)
+            transformation.append(record.transformation(row, col));
+
+    QJsonObject json;
+    json["source"] = record.source >= 0 ? QJsonValue(record.source) : QJsonValue("model");
+    json["target"] = record.target;
+    json["method"] = record.method;
+    json["sourcePoints"] = record.sourcePoints;
+    json["targetPoints"] = record.targetPoints;
+    json["timings"] = timings;
+    json["iterations"] = record.icp.iterations;
+    json["converged"] = record.icp.converged;
+    json["fitness"] = record.icp.fitness;
+    json["inliers"] = record.icp.inliers;
+    json["inlierRatio"] = std::min(record.sourcePoints, record.targetPoints) > 0 ? QJsonValue(inlierRatio(record)) : QJsonValue();
+    json["failed"] = pairFailed(record);
+    json["transformation"] = transformation;
+    return json;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::getSessionTelemetry
+ * \return every pair of the session, totals, means and maxima per stage, the slowest pair
+ * and the pairs that failed
+ */
+QJsonObject TDK_ScanRegistration::getSessionTelemetry() const
+{
+    const vector<PairRecord> records = getPairRecords();
+
+    std::vector<double> downsample, preAlignment, normals, correspondence, solve, total;
+    QJsonArray pairs;
+    QJsonArray failedPairs;
+    int slowest = -1;
+    for (size_t i = 0; i < records.size(); ++i){
+        const PairRecord &record = records[i];
+        downsample.push_back(record.downsampleMs);
+        preAlignment.push_back(record.preAlignmentMs);
+        normals.push_back(record.icp.normalsMs);
+        correspondence.push_back(record.icp.correspondenceMs);
+        solve.push_back(record.icp.solveMs);
+        total.push_back(record.totalMs);
+
+        const QJsonObject json = mf_pairRecordToJson(record);
+        pairs.append(json);
+        if (pairFailed(record))
+            failedPairs.append(json);
+        if (slowest < 0 || record.totalMs > records[slowest].totalMs)
+            slowest = static_cast<int>(i);
+    }
+
+    QJsonObject stages;
+    stages["downsample"] = stageSummary(downsample);
+    stages["preAlignment"] = stageSummary(preAlignment);
+    stages["normals"] = stageSummary(normals);
+    stages["correspondence"] = stageSummary(correspondence);
+    stages["solve"] = stageSummary(solve);
+    stages["total"] = stageSummary(total);
+
+    QJsonObject session;
+    session["numberOfPairs"] = static_cast<int>(records.size());
+    session["numberOfFailedPairs"] = failedPairs.size();
+    session["stages"] = stages;
+    session["slowestPair"] = slowest >= 0 ? QJsonValue(mf_pairRecordToJson(records[slowest])) : QJsonValue();
+    session["failedPairs"] = failedPairs;
+    session["pairs"] = pairs;
+    return session;
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_exportTelemetry
+ * \param fileName JSON file to write
+ * \return false when the file could not be written
+ */
+bool TDK_ScanRegistration::mf_exportTelemetry(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        qDebug() << "ScanRegistration: Cannot write telemetry to" << fileName;
+        return false;
+    }
+
+    file.write(QJsonDocument(getSessionTelemetry()).toJson());
+    return true;
+}
+
 /////////////////////////////////////////////////////
 
 bool TDK_ScanRegistration::mf_processInPostWithICP()
@@ -475,12 +2270,8 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_ScanRegistration::mf_voxelDownSampleP
 {
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr downSampledPointCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
 
-
-    pcl::VoxelGrid<pcl::PointXYZRGB> vg;
-    vg.setLeafSize (voxelSideLength, voxelSideLength, voxelSideLength);
-
-    vg.setInputCloud (cloud_in);
-    vg.filter (*downSampledPointCloud);
+    //Hash voxel grid, does not overflow with small voxels on large clouds as pcl::VoxelGrid does
+    TDK_Filters::mf_FilterVoxelGridDownsample(cloud_in, downSampledPointCloud, voxelSideLength);
 
     return downSampledPointCloud;
 }
@@ -497,16 +2288,120 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr TDK_ScanRegistration::mf_voxelDownSamplePoin
     //pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_in_xyz(new pcl::PointCloud<pcl::PointXYZ>);
     //PointCloudXYZRGBtoXYZ(cloud_in, cloud_in_xyz);
 
-    pcl::VoxelGrid<pcl::PointXYZ> vg;
-    vg.setLeafSize (voxelSideLength, voxelSideLength, voxelSideLength);
-
-    vg.setInputCloud (cloud_in);
-    vg.filter (*downSampledPointCloud);
+    TDK_Filters::mf_FilterVoxelGridDownsample(cloud_in, downSampledPointCloud, voxelSideLength);
 
     return downSampledPointCloud;
 }
 
 
+/*!
+ * \brief TDK_ScanRegistration::mf_organizeByProjection
+ * \param cloud_in input point cloud with normals, in the camera frame of the Kinect
+ * \param cloud_organized output organized point cloud of depth image size, NaN where no point projects
+ * \param minProjectedRatio minimum ratio of input points that have to fall inside the depth image
+ * \return true if the input could be organized as a Kinect depth image
+ *
+ * The grabber drops filtered points, so captured point clouds lose their image structure.
+ * Function restores it by projecting every point through the Kinect V2 depth intrinsics
+ * and keeping the closest point per pixel. Merged clouds or clouds moved out of the
+ * camera frame do not project and are reported as unorganized.
+ */
+bool
+TDK_ScanRegistration::mf_organizeByProjection(
+        const pcl::PointCloud<pcl::PointNormal>::Ptr &cloud_in,
+        pcl::PointCloud<pcl::PointNormal>::Ptr &cloud_organized,
+        const float minProjectedRatio
+        )
+{
+    const int width = TDK_KinectV2Intrinsics::depthWidth;
+    const int height = TDK_KinectV2Intrinsics::depthHeight;
+
+    pcl::PointNormal nanPoint;
+    nanPoint.x = nanPoint.y = nanPoint.z = std::numeric_limits<float>::quiet_NaN();
+    nanPoint.normal_x = nanPoint.normal_y = nanPoint.normal_z = std::numeric_limits<float>::quiet_NaN();
+
+    cloud_organized->clear();
+    cloud_organized->width = width;
+    cloud_organized->height = height;
+    cloud_organized->is_dense = false;
+    cloud_organized->points.assign(width * height, nanPoint);
+
+    size_t projected = 0;
+    for (size_t i = 0; i < cloud_in->size(); ++i)
+    {
+        const pcl::PointNormal &p = cloud_in->points[i];
+        if (!pcl::isFinite(p) || p.z <= 0)
+            continue;
+
+        int u = static_cast<int>(std::lround(TDK_KinectV2Intrinsics::fx * p.x / p.z + TDK_KinectV2Intrinsics::cx));
+        int v = static_cast<int>(std::lround(TDK_KinectV2Intrinsics::fy * p.y / p.z + TDK_KinectV2Intrinsics::cy));
+        if (u < 0 || u >= width || v < 0 || v >= height)
+            continue;
+
+        projected++;
+
+        //Keep the closest point when several project to the same pixel
+        pcl::PointNormal &cell = cloud_organized->points[v * width + u];
+        if (!pcl::isFinite(cell) || p.z < cell.z)
+            cell = p;
+    }
+
+    return !cloud_in->empty() && projected >= minProjectedRatio * cloud_in->size();
+}
+
+/*!
+ * \brief TDK_ScanRegistration::mf_computeInformationMatrix
+ * \param source source point cloud in its own frame
+ * \param target target point cloud
+ * \param transformation estimated transformation from source to target
+ * \param maxCorrespondenceDistance max distance in meters between corresponding points
+ * \return 6x6 information matrix ordered (translation, rotation)
+ *
+ * Information of a point to point alignment, sum of J^T * J over all correspondences
+ * with J = [I, -[p]x] for a source point p.
+ */
+TDK_PoseGraph::Matrix6d
+TDK_ScanRegistration::mf_computeInformationMatrix(
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &source,
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &target,
+        const Eigen::Matrix4f &transformation,
+        const float maxCorrespondenceDistance
+        )
+{
+    TDK_PoseGraph::Matrix6d information = TDK_PoseGraph::Matrix6d::Zero();
+    if(source->empty() || target->empty())
+        return information;
+
+    pcl::KdTreeFLANN<pcl::PointXYZRGB> kdtree;
+    kdtree.setInputCloud(target);
+
+    std::vector<int> index(1);
+    std::vector<float> distanceSqr(1);
+    const float maxDistanceSqr = maxCorrespondenceDistance * maxCorrespondenceDistance;
+
+    for(size_t i = 0; i < source->size(); i++){
+        const pcl::PointXYZRGB &p = source->points[i];
+        if(!pcl::isFinite(p))
+            continue;
+
+        pcl::PointXYZRGB q = p;
+        q.getVector3fMap() = (transformation * p.getVector4fMap()).head<3>();
+        if(kdtree.nearestKSearch(q, 1, index, distanceSqr) < 1 || distanceSqr[0] > maxDistanceSqr)
+            continue;
+
+        Eigen::Matrix<double, 3, 6> jacobian;
+        jacobian.leftCols<3>().setIdentity();
+        jacobian(0, 3) = 0.0;  jacobian(0, 4) =  p.z;  jacobian(0, 5) = -p.y;
+        jacobian(1, 3) = -p.z; jacobian(1, 4) = 0.0;   jacobian(1, 5) =  p.x;
+        jacobian(2, 3) =  p.y; jacobian(2, 4) = -p.x;  jacobian(2, 5) = 0.0;
+        information += jacobian.transpose() * jacobian;
+    }
+
+    return information;
+}
+
+/////////////////////////////////////////////////////
+
 pcl::PointCloud<pcl::PointXYZ>::Ptr
 TDK_ScanRegistration::mf_outlierRemovalPC(
         const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud_in,
@@ -602,6 +2497,17 @@ void TDK_ScanRegistration::set_voxelSideLength(float value)
     mv_voxelSideLength = value;
 }
 
+float TDK_ScanRegistration::get_modelVoxelSize() const
+{
+    return mv_modelVoxelSize;
+}
+
+void TDK_ScanRegistration::set_modelVoxelSize(float value)
+{
+    mv_modelVoxelSize = value;
+    mv_streamingModel.mf_SetVoxelSize(value);
+}
+
 double TDK_ScanRegistration::get_SVD_MaxDistance() const
 {
     return mv_SVD_MaxDistance;
@@ -631,6 +2537,16 @@ TDK_ScanRegistration::set_ICP_MaxCorrespondenceDistance(float value)
     mv_ICP_MaxCorrespondenceDistance = value;
 }
 
+float TDK_ScanRegistration::get_turntableDirection() const
+{
+    return mv_turntableDirection;
+}
+
+void TDK_ScanRegistration::set_turntableDirection(float value)
+{
+    mv_turntableDirection = (value < 0) ? -1.0 : 1.0;
+}
+
 
 void TDK_ScanRegistration::MatchRegistration(pcl::PointCloud<pcl::PointXYZRGB>::Ptr refCloud,
                                              pcl::PointCloud<pcl::PointXYZRGB>::Ptr sampleCloud,
@@ -664,15 +2580,8 @@ void TDK_ScanRegistration::MatchRegistration(pcl::PointCloud<pcl::PointXYZRGB>::
 
     // Registration refinement using ICP with all points
 
-        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_in (new pcl::PointCloud<pcl::PointXYZ>);
-        copyColor2XYZ(fusedCloud, cloud_in);
-        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_out(new pcl::PointCloud<pcl::PointXYZ>);
-        copyColor2XYZ(refCloud, cloud_out);
-        icp.setInputCloud(cloud_in);
-        icp.setInputTarget(cloud_out);
-        icp.align(aligned);
-        transMat = icp.getFinalTransformation();
-        pcl::transformPointCloud(*fusedCloud, *fusedCloud, transMat);
+        //Geometry and color together in one colored ICP
+        *fusedCloud = *TDK_ScanRegistration::ICPColored(fusedCloud, refCloud);
         for(int i=0; i<refCloud->size(); i++)
           {
             fusedCloud->push_back(refCloud->at(i));
@@ -733,19 +2642,6 @@ void tdk_PointCloudXYZRGBtoXYZI(
 
 
 
-// Extract color information
-void copyColor2XYZ(pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_in, pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_out)
-{
-    for(int i=0; i<cloud_in->size();i++)
-    {
-        pcl::PointXYZ pt;
-        pt.x = cloud_in->at(i).r/255.0;
-        pt.y = cloud_in->at(i).g/255.0;
-        pt.z = cloud_in->at(i).b/255.0;
-        cloud_out->push_back(pt);
-    }
-}
-
 boost::shared_ptr<pcl::visualization::PCLVisualizer> rgbVis (pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr cloud)
 {
     // --------------------------------------------
@@ -6,6 +6,8 @@
 #include <math.h>
 #include <pcl/PCLPointCloud2.h>
 #include <pcl/common/transforms.h>
+#include <pcl/features/fpfh_omp.h>
+#include <pcl/features/integral_image_normal.h>
 #include <pcl/features/normal_3d.h>
 #include <pcl/filters/statistical_outlier_removal.h>
 #include <pcl/filters/voxel_grid.h>
@@ -15,18 +17,30 @@
 #include <pcl/registration/correspondence_estimation_backprojection.h>
 #include <pcl/registration/correspondence_rejection_sample_consensus.h>
 #include <pcl/registration/elch.h>
+#include <pcl/registration/gicp.h>
 #include <pcl/registration/icp.h>
 #include <pcl/registration/incremental_registration.h>
+#include <pcl/registration/transformation_estimation_point_to_plane_lls.h>
 #include <pcl/registration/transformation_estimation_svd.h>
 #include <vector>
 
+#include <atomic>
+#include <map>
+
 #include <QColor>
+#include <QFuture>
+#include <QJsonObject>
+#include <QMetaType>
+#include <QMutex>
 #include <QObject>
 #include <QString>
+#include <QtConcurrent/QtConcurrent>
 
 
 
 #include "tdk_2dfeaturedetection.h"
+#include "tdk_posegraph.h"
+#include "tdk_voxelaccumulator.h"
 
 // From Group 3
 
@@ -82,9 +96,6 @@ void tdk_PointCloudXYZRGBtoXYZI(
         );
 
 
-void copyColor2XYZ(pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_in,
-                   pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_out);
-
 boost::shared_ptr<pcl::visualization::PCLVisualizer> rgbVis (pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr cloud);
 
 
@@ -100,25 +111,118 @@ public:
 
     bool mv_use2DFeatureDetection = false;
     bool mv_ICP_Normals = true;
+    bool mv_ICP_Projective = false;
+    bool mv_ICP_Generalized = false;
+    bool mv_ICP_Colored = false;
+    bool mv_streamingRegistration = true;
+    bool mv_loopClosure = false;
+    bool mv_globalPreAlignment = false;
+
+    //Per point plane-to-plane covariances of a scan and the KD-tree they were computed with
+    typedef std::vector<Eigen::Matrix3d, Eigen::aligned_allocator<Eigen::Matrix3d> > CovarianceVector;
+    struct ScanCovariances
+    {
+        pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree;
+        boost::shared_ptr<CovarianceVector> covariances;
+    };
+
+    //Normals, intensities and intensity gradients of a scan used as colored ICP target
+    typedef std::vector<Eigen::Vector3f> GradientVector;
+    struct ScanColorGradients
+    {
+        pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree;
+        pcl::PointCloud<pcl::Normal>::Ptr normals;
+        boost::shared_ptr<std::vector<float> > intensities;
+        boost::shared_ptr<GradientVector> gradients;
+    };
+
+    //Outcome of one ICP run, times in milliseconds. Correspondence search time is -1 when the
+    //method does not measure it apart from the solve
+    struct RegistrationStats
+    {
+        int iterations = 0;
+        bool converged = false;
+        double fitness = 0.0;
+        int inliers = 0;                    //correspondences of the last iteration
+        double normalsMs = 0.0;             //normals, covariances or color gradients of the clouds
+        double correspondenceMs = -1.0;
+        double solveMs = 0.0;
+    };
+
+    //Telemetry of one registered pair of views, times in milliseconds
+    struct PairRecord
+    {
+        int source = -1;                    //-1 in Register, the model of all views before the target
+        int target = -1;
+        QString method;
+        int sourcePoints = 0;               //after downsampling
+        int targetPoints = 0;
+        double downsampleMs = 0.0;
+        double preAlignmentMs = 0.0;        //FPFH global pre-alignment, 0 when it is not used
+        double totalMs = 0.0;
+        RegistrationStats icp;
+        //Moves source points into the target frame
+        Eigen::Matrix<float, 4, 4, Eigen::DontAlign> transformation = Eigen::Matrix4f::Identity();
+    };
 
     //Input
     bool addNextPointCloud(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &inputPointcloud,
                            const float degreesRotatedY=0.0);
     // OUR REGISTRATION FUNCTIONS
 
-    static pcl::PointCloud<pcl::PointXYZRGB>::Ptr ICP(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt);
-    static pcl::PointCloud<pcl::PointXYZRGB>::Ptr ICPNormal(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt);
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr Register(std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> &Data );
+    static pcl::PointCloud<pcl::PointXYZRGB>::Ptr ICP(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                      const Eigen::Matrix4f &guess = Eigen::Matrix4f::Identity(),
+                                                      Eigen::Matrix4f *finalTransformation = nullptr,
+                                                      RegistrationStats *stats = nullptr);
+    static pcl::PointCloud<pcl::PointXYZRGB>::Ptr ICPNormal(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                            const Eigen::Matrix4f &guess = Eigen::Matrix4f::Identity(),
+                                                            Eigen::Matrix4f *finalTransformation = nullptr,
+                                                            RegistrationStats *stats = nullptr,
+                                                            const pcl::PointCloud<pcl::PointNormal>::Ptr &sourceNormals = pcl::PointCloud<pcl::PointNormal>::Ptr(),
+                                                            const pcl::PointCloud<pcl::PointNormal>::Ptr &targetNormals = pcl::PointCloud<pcl::PointNormal>::Ptr());
+    static pcl::PointCloud<pcl::PointXYZRGB>::Ptr ICPProjective(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                                const Eigen::Matrix4f &guess = Eigen::Matrix4f::Identity(),
+                                                                Eigen::Matrix4f *finalTransformation = nullptr,
+                                                                RegistrationStats *stats = nullptr,
+                                                                const pcl::PointCloud<pcl::PointNormal>::Ptr &sourceNormals = pcl::PointCloud<pcl::PointNormal>::Ptr(),
+                                                                const pcl::PointCloud<pcl::PointNormal>::Ptr &targetNormals = pcl::PointCloud<pcl::PointNormal>::Ptr());
+    static pcl::PointCloud<pcl::PointXYZRGB>::Ptr ICPGeneralized(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                                 const Eigen::Matrix4f &guess = Eigen::Matrix4f::Identity(),
+                                                                 Eigen::Matrix4f *finalTransformation = nullptr,
+                                                                 RegistrationStats *stats = nullptr,
+                                                                 const ScanCovariances *sourceCovariances = nullptr,
+                                                                 const ScanCovariances *targetCovariances = nullptr);
+    static pcl::PointCloud<pcl::PointXYZRGB>::Ptr ICPColored(pcl::PointCloud<pcl::PointXYZRGB>::Ptr src, pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                                                             const Eigen::Matrix4f &guess = Eigen::Matrix4f::Identity(),
+                                                             Eigen::Matrix4f *finalTransformation = nullptr,
+                                                             RegistrationStats *stats = nullptr,
+                                                             const ScanColorGradients *targetGradients = nullptr);
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr Register(std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> &Data,
+                                                    const std::vector<float> &accumulatedYRotations = std::vector<float>());
     //Ouput
     pcl::PointCloud<pcl::PointXYZ>::Ptr getLastDownSampledPointcloud();
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr getRoughlyAlignedPC();
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr getStreamingAlignedPC();
 
 
 
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr Process_and_getAlignedPC();
 
+    //Stops a running Process_and_getAlignedPC between two pairs, it then returns a null pointer
+    void mf_requestCancel();
+    bool mf_isCancelRequested() const;
+    //Clears a cancel left over from an earlier run, call before starting a new one
+    void mf_clearCancelRequest();
+
     vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr>* getRotationCompensatedPCs();
     vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr>* getRoughlyAlignedPCs();
+    vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> >* getRegisteredPoses();
+
+    //Telemetry of the pairs registered in the current session
+    vector<PairRecord> getPairRecords() const;
+    QJsonObject getSessionTelemetry() const;
+    bool mf_exportTelemetry(const QString &fileName) const;
+    static QJsonObject mf_pairRecordToJson(const PairRecord &record);
 
 
 
@@ -133,6 +237,66 @@ public:
 
 
     //Utility functions
+    static TDK_PoseGraph::Matrix6d
+    mf_computeInformationMatrix(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &source,
+                                const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &target,
+                                const Eigen::Matrix4f &transformation,
+                                const float maxCorrespondenceDistance);
+
+    static void
+    mf_computeFPFHFeatures(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+                           const float voxelSideLength,
+                           const float normalRadius,
+                           const float featureRadius,
+                           pcl::PointCloud<pcl::PointXYZRGB>::Ptr &keypoints,
+                           pcl::PointCloud<pcl::FPFHSignature33>::Ptr &descriptors);
+
+    static ScanCovariances
+    mf_computeCovariances(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+                          const int kNeighbours=20);
+
+    ScanCovariances
+    mf_getCachedCovariances(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud);
+
+    static ScanColorGradients
+    mf_computeColorGradients(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+                             const int kNeighbours=12);
+
+    ScanColorGradients
+    mf_getCachedColorGradients(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud);
+
+    static void
+    mf_computeKdTreeNormals(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+                            pcl::PointCloud<pcl::PointNormal>::Ptr &cloud_normals,
+                            const int kNeighbours=12);
+
+    static bool
+    mf_computeViewNormals(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &view,
+                          pcl::PointCloud<pcl::PointNormal>::Ptr &normalImage,
+                          const float minProjectedRatio=0.9);
+
+    static float
+    mf_sampleViewNormals(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud_in,
+                         const pcl::PointCloud<pcl::PointNormal>::Ptr &normalImage,
+                         pcl::PointCloud<pcl::PointNormal>::Ptr &cloud_normals,
+                         const float minViewRatio=0.0,
+                         const int kNeighbours=12);
+
+    //view is the full resolution view cloud was downsampled from, KD-tree normals when empty
+    pcl::PointCloud<pcl::PointNormal>::Ptr
+    mf_getCachedNormals(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud,
+                        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &view = pcl::PointCloud<pcl::PointXYZRGB>::Ptr());
+
+    bool
+    mf_globalPreAlignment(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &source,
+                          const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &target,
+                          Eigen::Matrix4f &transformation);
+
+    static bool
+    mf_organizeByProjection(const pcl::PointCloud<pcl::PointNormal>::Ptr &cloud_in,
+                            pcl::PointCloud<pcl::PointNormal>::Ptr &cloud_organized,
+                            const float minProjectedRatio=0.9);
+
     static pcl::PointCloud<pcl::PointXYZ>::Ptr
     mf_outlierRemovalPC(const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud_in,
                         const float meanK=8,
@@ -158,15 +322,22 @@ public:
     float get_voxelSideLength() const;
     double get_SVD_MaxDistance() const;
     float get_ICP_MaxCorrespondenceDistance() const;
+    float get_turntableDirection() const;
+    float get_modelVoxelSize() const;
 
     void set_normalRadiusSearch(float value);
     void set_voxelSideLength(float value);
     void set_SVD_MaxDistance(double value);
     void set_ICP_MaxCorrespondenceDistance(float value);
     void set_PostICP_MaxCorrespondanceDistance(float value);
+    void set_turntableDirection(float value);
+    void set_modelVoxelSize(float value);
 
 signals:
     void mf_SignalStatusChanged(QString, QColor);
+    void mf_SignalStreamingModelUpdated(int);
+    void mf_SignalPairRegistered(TDK_ScanRegistration::PairRecord);
+    void mf_SignalRegistrationProgress(double);
 
 public slots:
     //void set_Use2DFeatureDetection(int);
@@ -176,6 +347,7 @@ public slots:
 private:
     //Class operation configuration
     bool mv_registerInRealTime;
+    std::atomic<bool> mv_cancelRequested;
 
 
 
@@ -185,15 +357,21 @@ private:
     double mv_SVD_MaxDistance;
     float mv_ICP_MaxCorrespondenceDistance;
     float mv_ICPPost_MaxCorrespondanceDistance;
+    float mv_featureRadiusSearch;
+    float mv_RANSAC_InlierDistance;
+    int mv_RANSAC_Iterations;
+    float mv_modelVoxelSize;
 
     //Scanner orientation and rotation compensation
     bool mv_scannerCenterRotationSet;
     pcl::PointWithViewpoint mv_scannerCenter;
     float mv_accumulatedRotation;
+    float mv_turntableDirection;
 
     //Internal data storage
     vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> mv_originalPCs;
     vector<float> mv_originalPointcloudsYRotation;
+    vector<float> mv_alignedPCsAccumulatedYRotation;
     vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> mv_originalRotatedPCs;
     vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> mv_originalRotatedDenoisedPCs;
     vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> mv_downSampledPCs;
@@ -202,15 +380,84 @@ private:
     vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> mv_alignedDownSampledPCs;
     vector<Eigen::Matrix4f> mv_transformationMatrices;
     vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> mv_alignedOriginalPCs;
+    //Pose of every aligned view in the frame of the first one, empty when the registration gave no poses
+    vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > mv_registeredPoses;
 
     //feature detection service
     TDK_2DFeatureDetection mv_2DFeatureDetectionPtr;
 
+    //Streaming registration while scanning, guarded by mv_streamingMutex
+    QMutex mv_streamingMutex;
+    //Copy of the mv_ICP_* flags and mv_globalPreAlignment taken when a view is added,
+    //the worker never reads the public flags the GUI writes
+    struct ICPSelection
+    {
+        bool normals = true;
+        bool projective = false;
+        bool generalized = false;
+        bool colored = false;
+        bool globalPreAlignment = false;
+    };
+    ICPSelection mv_ICPSelection;
+    QFuture<void> mv_streamingFuture;
+    bool mv_streamingRunning;
+    vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > mv_streamingPoses;
+    vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > mv_streamingPairTransformations;
+    vector<TDK_PoseGraph::Matrix6d, Eigen::aligned_allocator<TDK_PoseGraph::Matrix6d> > mv_streamingPairInformation;
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr mv_streamingFirstDownsampled;
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr mv_streamingPreviousDownsampled;
+    TDK_VoxelAccumulator mv_streamingModel;
+
+    //Per scan data reused between pairs, guarded by mv_featureCacheMutex. Keys keep the
+    //clouds alive, a cloud is never changed after it has been described.
+    //FPFH descriptors used in global pre-alignment
+    struct ScanFeatures
+    {
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr keypoints;
+        pcl::PointCloud<pcl::FPFHSignature33>::Ptr descriptors;
+    };
+    QMutex mv_featureCacheMutex;
+    std::map<pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr, ScanFeatures> mv_featureCache;
+    //Covariances used in generalized ICP
+    std::map<pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr, ScanCovariances> mv_covarianceCache;
+    //Color gradients used in colored ICP
+    std::map<pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr, ScanColorGradients> mv_colorGradientCache;
+    //Points with normals used in point to plane and projective ICP
+    std::map<pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr, pcl::PointCloud<pcl::PointNormal>::Ptr> mv_normalCache;
+
+    //Telemetry of the registered pairs, written by Register, the streaming worker and the loop closure
+    mutable QMutex mv_pairRecordsMutex;
+    vector<PairRecord> mv_pairRecords;
+
     //Private class functions
     bool
     mf_processCorrespondencesSVDICP();
     bool
     mf_processInPostWithICP();
+    void
+    mf_streamingRegistrationWorker();
+    bool
+    mf_coversFullTurn() const;
+    void
+    mf_closeLoopAndMerge();
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr
+    mf_alignWithSelectedICP(const ICPSelection &selection,
+                            pcl::PointCloud<pcl::PointXYZRGB>::Ptr src,
+                            pcl::PointCloud<pcl::PointXYZRGB>::Ptr tgt,
+                            const Eigen::Matrix4f &guess,
+                            Eigen::Matrix4f *finalTransformation = nullptr,
+                            RegistrationStats *stats = nullptr,
+                            const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &sourceView = pcl::PointCloud<pcl::PointXYZRGB>::Ptr(),
+                            const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &targetView = pcl::PointCloud<pcl::PointXYZRGB>::Ptr());
+    ICPSelection
+    mf_currentICPSelection() const;
+    static QString
+    mf_selectedICPName(const ICPSelection &selection);
+    void
+    mf_recordPair(const PairRecord &record);
+    void
+    mf_clearPairRecords();
 
     bool
     addAllPointClouds(const vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> &inputPCs,
@@ -219,6 +466,14 @@ private:
     void
     setDefaultParameters();
 
+    Eigen::Matrix4f
+    mf_turntableInitialGuess(const float &degreesRotatedY) const;
+
+    ScanFeatures
+    mf_getCachedFeatures(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &cloud);
+    void
+    mf_clearScanCaches();
+
 
 
     pcl::PointCloud<pcl::Normal>::Ptr
@@ -252,4 +507,6 @@ private:
                            pcl::PointCloud<pcl::PointXYZRGB>::Ptr fusedCloud);
 };
 
+Q_DECLARE_METATYPE(TDK_ScanRegistration::PairRecord)
+
 #endif // TDK_SCANREGISTRATION_H
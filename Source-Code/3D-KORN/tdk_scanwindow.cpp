@@ -18,6 +18,7 @@ TDK_ScanWindow::TDK_ScanWindow(QMainWindow *parent) : QMainWindow(parent),
     mv_ZMaximumSpinBox                      (new QDoubleSpinBox)                                ,
     mv_InclinationSpinBox                   (new QDoubleSpinBox)                                ,
     mv_FilterBoxCheckBox                    (new QCheckBox)                                     ,
+    mv_SmoothDepthCheckBox                  (new QCheckBox)                                     ,
     mv_RegistrationCheckBox                 (new QCheckBox)                                     ,
     mv_CapturePointCloudPushButton          (new QPushButton(QString("CAPTURE POINT CLOUD")))   ,
     mv_StartScanPushButton                  (new QPushButton(QString("START SCAN")))            ,
@@ -31,6 +32,7 @@ TDK_ScanWindow::TDK_ScanWindow(QMainWindow *parent) : QMainWindow(parent),
     mv_NumberOfPointCloudsCaptured          (0)                                                 ,
     mv_NumberOfPointCloudsCapturedLabel     (new QLabel("0"))                                   ,
     mv_ScanRegistration                     (new TDK_ScanRegistration)                          ,
+    mv_RegistrationJob                      (new TDK_RegistrationJob(mv_ScanRegistration, this)),
     mv_SerialPortNameLineEdit               (new QLineEdit)                                     ,
     mv_SerialPortBaudRateComboBox           (new QComboBox)                                     ,
     mv_Turntable                            (new TDK_Turntable)
@@ -48,6 +50,7 @@ TDK_ScanWindow::TDK_ScanWindow(QMainWindow *parent) : QMainWindow(parent),
     connect(mv_InclinationSpinBox, SIGNAL(valueChanged(double)), this, SLOT(mf_SlotUpdateBoundingBox()));
     connect(mv_RegistrationCheckBox, SIGNAL(clicked(bool)), this, SLOT(mf_SlotPointCloudRegistration(bool)));
     connect(mv_FilterBoxCheckBox, SIGNAL(clicked(bool)), this, SLOT(mf_SlotActivateFiltering(bool)));
+    connect(mv_SmoothDepthCheckBox, SIGNAL(clicked(bool)), this, SLOT(mf_SlotActivateDepthSmoothing(bool)));
     connect(mv_StartScanPushButton, SIGNAL(clicked(bool)), this, SLOT(mf_SlotStartScan()));
     connect(mv_StopScanPushButton, SIGNAL(clicked(bool)), this, SLOT(mf_SlotStopScan()));
     connect(mv_CapturePointCloudPushButton, SIGNAL(clicked(bool)), this, SLOT(mf_SlotCapturePointCloudButtonClick()));
@@ -57,6 +60,11 @@ TDK_ScanWindow::TDK_ScanWindow(QMainWindow *parent) : QMainWindow(parent),
     connect(mv_Turntable, SIGNAL(mf_SignalRotationsDone()), this, SLOT(mf_SlotStopScan()));
 
     connect(this, SIGNAL(mf_SignalStatusChanged(QString,QColor)), this, SLOT(mf_SlotUpdateStatusBar(QString,QColor)));
+    connect(mv_ScanRegistration, SIGNAL(mf_SignalStreamingModelUpdated(int)), this, SLOT(mf_SlotStreamingModelUpdated(int)));
+    connect(mv_RegistrationJob, SIGNAL(mf_SignalProgress(double)), this, SLOT(mf_SlotRegistrationProgress(double)));
+    connect(mv_RegistrationJob, SIGNAL(mf_SignalFinished(pcl::PointCloud<pcl::PointXYZRGB>::Ptr)),
+            this, SLOT(mf_SlotRegistrationFinished(pcl::PointCloud<pcl::PointXYZRGB>::Ptr)), Qt::QueuedConnection);
+    connect(mv_RegistrationJob, SIGNAL(mf_SignalCancelled()), this, SLOT(mf_SlotRegistrationCancelled()));
 
 }
 
@@ -191,6 +199,7 @@ void TDK_ScanWindow::mf_SetupSensorWidget()
     mv_StopScanPushButton->setFixedHeight(22);
 
     mv_FilterBoxCheckBox->setText(QString("Activate filtering point cloud"));
+    mv_SmoothDepthCheckBox->setText(QString("Smooth depth frames (edge preserving)"));
     mv_RegistrationCheckBox->setText(QString("Register point cloud during scan"));
 
     gridLayout->addWidget(new QLabel("Select sensor : "), 0, 0, 1, 2);
@@ -210,12 +219,13 @@ void TDK_ScanWindow::mf_SetupSensorWidget()
     gridLayout->addWidget(new QLabel(QString("Inclination : ")), 4, 0);
     gridLayout->addWidget(mv_InclinationSpinBox, 4, 1);
     gridLayout->addWidget(mv_FilterBoxCheckBox, 5, 0, 1, 4);
-    gridLayout->addWidget(mv_RegistrationCheckBox, 6, 0, 1, 4);
-    gridLayout->addWidget(mv_StartScanPushButton, 7, 0, 1, 2);
-    gridLayout->addWidget(mv_StopScanPushButton, 7, 2, 1, 2);
-    gridLayout->addWidget(new QLabel(QString("Number of point clouds captured : ")), 8, 0, 1, 3);
-    gridLayout->addWidget(mv_NumberOfPointCloudsCapturedLabel, 8, 3, 1, 1);
-    gridLayout->addWidget(mv_CapturePointCloudPushButton, 9, 0, 1, 4);
+    gridLayout->addWidget(mv_SmoothDepthCheckBox, 6, 0, 1, 4);
+    gridLayout->addWidget(mv_RegistrationCheckBox, 7, 0, 1, 4);
+    gridLayout->addWidget(mv_StartScanPushButton, 8, 0, 1, 2);
+    gridLayout->addWidget(mv_StopScanPushButton, 8, 2, 1, 2);
+    gridLayout->addWidget(new QLabel(QString("Number of point clouds captured : ")), 9, 0, 1, 3);
+    gridLayout->addWidget(mv_NumberOfPointCloudsCapturedLabel, 9, 3, 1, 1);
+    gridLayout->addWidget(mv_CapturePointCloudPushButton, 10, 0, 1, 4);
 
     gridLayout->setRowMinimumHeight(0, 30);
     gridLayout->setHorizontalSpacing(10);
@@ -338,6 +348,13 @@ void TDK_ScanWindow::mf_SlotUpdateStatusBar(QString status, QColor statusColor)
     }
 }
 
+void TDK_ScanWindow::mf_SlotStreamingModelUpdated(int numberOfViewsAligned)
+{
+    if(mv_FlagScanning){
+        emit mf_SignalStatusChanged(QString("Scanning... %1 point clouds registered").arg(numberOfViewsAligned), Qt::blue);
+    }
+}
+
 void TDK_ScanWindow::mf_SlotUpdateBoundingBox()
 {
     mv_Sensor->mf_SetFilterBox(mv_XMinimumSpinBox->value(), mv_XMaximumSpinBox->value(), mv_YMinimumSpinBox->value(), mv_YMaximumSpinBox->value(), mv_ZMinimumSpinBox->value(), mv_ZMaximumSpinBox->value());
@@ -374,6 +391,11 @@ void TDK_ScanWindow::mf_SlotActivateFiltering(bool flagFiltering)
     mv_Sensor->mf_SetMvFlagFilterPoints(flagFiltering);
 }
 
+void TDK_ScanWindow::mf_SlotActivateDepthSmoothing(bool flagSmoothing)
+{
+    mv_Sensor->mf_SetMvFlagSmoothDepth(flagSmoothing);
+}
+
 void TDK_ScanWindow::mf_SlotPointCloudRegistration(bool flagRealTimeScan)
 {
     if(!mv_FlagScanning){
@@ -398,10 +420,13 @@ void TDK_ScanWindow::mf_SlotStartScan()
         mv_ZMaximumSpinBox->setEnabled(false);
         mv_InclinationSpinBox->setEnabled(false);
         mv_FilterBoxCheckBox->setEnabled(false);
+        mv_SmoothDepthCheckBox->setEnabled(false);
         mv_RegistrationCheckBox->setEnabled(false);
         mv_StartScanPushButton->setEnabled(false);
         mv_FlagPointCloudExists = false;
         qDebug() << mv_FlagTurnTableParametersEnabled << !mv_Turntable->mf_IsRunning();
+        //Turntable scans may close the loop, the registration does it only when the views cover a full turn
+        mv_ScanRegistration->mv_loopClosure = mv_FlagTurnTableParametersEnabled;
         if(mv_FlagTurnTableParametersEnabled && !mv_Turntable->mf_IsRunning()){
             qDebug() << "Start platform from scan window";
             mf_InitializeScannerCenter();
@@ -427,6 +452,7 @@ void TDK_ScanWindow::mf_SlotStopScan()
         mv_ZMaximumSpinBox->setEnabled(true);
         mv_InclinationSpinBox->setEnabled(true);
         mv_FilterBoxCheckBox->setEnabled(true);
+        mv_SmoothDepthCheckBox->setEnabled(true);
         mv_RegistrationCheckBox->setEnabled(true);
         mv_StartScanPushButton->setEnabled(true);
 
@@ -436,14 +462,47 @@ void TDK_ScanWindow::mf_SlotStopScan()
 
         if(mv_FlagPointCloudExists){
             emit mf_SignalStatusChanged(QString("Registering point clouds..."), Qt::blue);
-            TDK_Database::mf_StaticAddRegisteredPointCloud(mv_ScanRegistration->Process_and_getAlignedPC()->makeShared());
-            emit mf_SignalDatabaseRegisteredPointCloudUpdated();
-            emit mf_SignalStatusChanged(QString("Registration done."), Qt::green);
+
+            //The registration keeps using the scan data, no new scan until it is done
+            if(mv_RegistrationJob->mf_Start()){
+                mv_StartScanPushButton->setEnabled(false);
+                mv_RegistrationCheckBox->setEnabled(false);
+                mv_StopScanPushButton->setText(QString("CANCEL REGISTRATION"));
+            }
         }
         //mf_SetNumberOfPointCloudsCaptured(0);
         //this->close();
 
     }
+    else if(sender() == mv_StopScanPushButton && mv_RegistrationJob->mf_IsRunning()){
+        //Stop button cancels the registration of the last scan
+        emit mf_SignalStatusChanged(QString("Cancelling registration..."), Qt::blue);
+        mv_RegistrationJob->mf_Cancel();
+    }
+}
+
+void TDK_ScanWindow::mf_SlotRegistrationProgress(double fraction)
+{
+    emit mf_SignalStatusChanged(QString("Registering point clouds... %1%").arg(qRound(fraction * 100)), Qt::blue);
+}
+
+void TDK_ScanWindow::mf_SlotRegistrationFinished(pcl::PointCloud<pcl::PointXYZRGB>::Ptr registeredPointCloud)
+{
+    mv_StartScanPushButton->setEnabled(true);
+    mv_RegistrationCheckBox->setEnabled(true);
+    mv_StopScanPushButton->setText(QString("STOP SCAN"));
+
+    TDK_Database::mf_StaticAddRegisteredPointCloud(registeredPointCloud);
+    emit mf_SignalDatabaseRegisteredPointCloudUpdated();
+    emit mf_SignalStatusChanged(QString("Registration done."), Qt::green);
+}
+
+void TDK_ScanWindow::mf_SlotRegistrationCancelled()
+{
+    mv_StartScanPushButton->setEnabled(true);
+    mv_RegistrationCheckBox->setEnabled(true);
+    mv_StopScanPushButton->setText(QString("STOP SCAN"));
+    emit mf_SignalStatusChanged(QString("Registration cancelled."), Qt::red);
 }
 
 void TDK_ScanWindow::mf_SlotHandlePlatformParameters(bool flagEnablePlatformParameters)
@@ -477,6 +536,7 @@ void TDK_ScanWindow::mf_SlotUpdateWindow(int sensorIndex)
     qDebug() << mv_Sensor->mf_GetMvName();
     mv_Sensor->mf_SetFilterBox(mv_XMinimumSpinBox->value(), mv_XMaximumSpinBox->value(), mv_YMinimumSpinBox->value(), mv_YMaximumSpinBox->value(), mv_ZMinimumSpinBox->value(), mv_ZMaximumSpinBox->value());
     mv_Sensor->mf_SetMvFlagFilterPoints(mv_FilterBoxCheckBox->isChecked());
+    mv_Sensor->mf_SetMvFlagSmoothDepth(mv_SmoothDepthCheckBox->isChecked());
     connect(mv_Sensor, SIGNAL(mf_SignalPointCloudUpdated()), this, SLOT(mf_SlotUpdatePointCloudStream()));
     mv_Sensor->mf_StartSensor();
 }
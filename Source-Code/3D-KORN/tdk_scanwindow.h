@@ -30,6 +30,7 @@
 #include "tdk_sensorcontroller.h"
 #include "tdk_database.h"
 #include "tdk_scanregistration.h"
+#include "tdk_registrationjob.h"
 #include "tdk_turntable.h"
 
 class TDK_ScanWindow : public QMainWindow
@@ -48,6 +49,7 @@ public:
     QVTKWidget                                          *mv_PointCloudStreamQVTKWidget;
     int                                                  mv_NumberOfPointCloudsCaptured;
     TDK_ScanRegistration                                *mv_ScanRegistration;
+    TDK_RegistrationJob                                 *mv_RegistrationJob;
     TDK_Turntable                                       *mv_Turntable;
 
 
@@ -67,6 +69,7 @@ public:
     QDoubleSpinBox      *mv_ZMaximumSpinBox;
     QDoubleSpinBox      *mv_InclinationSpinBox;
     QCheckBox           *mv_FilterBoxCheckBox;
+    QCheckBox           *mv_SmoothDepthCheckBox;
     QCheckBox           *mv_RegistrationCheckBox;
     QPushButton         *mv_StartScanPushButton;
     QPushButton         *mv_StopScanPushButton;
@@ -103,6 +106,7 @@ public slots:
     void    mf_SlotUpdateWindow                         (int sensorIndex);
     void    mf_SlotUpdateBoundingBox                    ();
     void    mf_SlotActivateFiltering                    (bool flagFiltering);
+    void    mf_SlotActivateDepthSmoothing               (bool flagSmoothing);
     void    mf_SlotPointCloudRegistration               (bool flagRealTimeScan);
     void    mf_SlotStartScan                            ();
     void    mf_SlotStopScan                             ();
@@ -114,6 +118,11 @@ public slots:
     void    mf_SlotCapturePointCloudButtonClick         ();
 
     void    mf_SlotUpdateStatusBar                      (QString status, QColor statusColor);
+    void    mf_SlotStreamingModelUpdated                (int numberOfViewsAligned);
+
+    void    mf_SlotRegistrationProgress                 (double fraction);
+    void    mf_SlotRegistrationFinished                 (pcl::PointCloud<pcl::PointXYZRGB>::Ptr registeredPointCloud);
+    void    mf_SlotRegistrationCancelled                ();
 
 };
 
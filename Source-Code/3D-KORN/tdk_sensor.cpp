@@ -13,7 +13,8 @@ TDK_Sensor::TDK_Sensor(QObject *parent) : QObject(parent),
     mv_YMin             (   -1.5    )   ,
     mv_YMax             (    1.0    )   ,
     mv_ZMin             (    2.0    )   ,
-    mv_ZMax             (    3.0    )
+    mv_ZMax             (    3.0    )   ,
+    mv_FlagSmoothDepth  (   false   )
 {
 
 }
@@ -69,4 +70,10 @@ void TDK_Sensor::mf_SetMvFlagFilterPoints(bool value)
     emit mf_SignalFlagFilterUpdated();
 }
 
+void TDK_Sensor::mf_SetMvFlagSmoothDepth(bool value)
+{
+    mv_FlagSmoothDepth = value;
+    emit mf_SignalFlagSmoothDepthUpdated();
+}
+
 /****************************************************************************/
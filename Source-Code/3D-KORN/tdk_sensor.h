@@ -40,6 +40,7 @@ public:
     void    mf_SetMvName                (const QString &value)                             {    mv_Name = value;            }
     void    mf_SetMvSensorDetails       (const std::map<QString, QString> &value)          {    mv_SensorDetails = value;   }
     void    mf_SetMvFlagFilterPoints    (bool value);
+    void    mf_SetMvFlagSmoothDepth     (bool value);
     void    mf_SetMvPointCloud          (const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr
                                          &pointCloudPtr);
 
@@ -49,6 +50,7 @@ public:
     std::map<QString, QString>                  mf_GetMvSensorDetails       () const       {    return mv_SensorDetails;    }
     pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr mf_GetMvPointCloud          () const       {    return mv_PointCloud;       }
     bool                                        mf_GetMvFlagFilterPoints    () const       {    return mv_FlagFilterPoints; }
+    bool                                        mf_GetMvFlagSmoothDepth     () const       {    return mv_FlagSmoothDepth;  }
 
 protected:
     QString     mv_Id;                                                      //Sensor id
@@ -58,6 +60,7 @@ protected:
     float       mv_XMin, mv_XMax;                                           //Filter min and max x values
     float       mv_YMin, mv_YMax;                                           //Filter min and max y values
     float       mv_ZMin, mv_ZMax;                                           //Filter min and max z values
+    bool        mv_FlagSmoothDepth;                                         //Enable/Disable flag for the depth frame smoothing
 
     std::map<QString, QString>                      mv_SensorDetails;       //Map to store additional sensor details
     pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr     mv_PointCloud;          //Pointer to current point cloud captured by sensor
@@ -66,6 +69,7 @@ signals:
     void    mf_SignalPointCloudUpdated  ();                                 //Signals pointcloud update
     void    mf_SignalFlagFilterUpdated  ();                                 //Signals filter box flag update
     void    mf_SignalFilterBoxUpdated   ();                                 //Signals filter box update
+    void    mf_SignalFlagSmoothDepthUpdated ();                             //Signals depth smoothing flag update
 
 };
 
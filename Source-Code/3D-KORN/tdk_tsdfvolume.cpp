@@ -0,0 +1,418 @@
+#include "tdk_tsdfvolume.h"
+#include "tdk_kinectv2intrinsics.h"
+
+#include <Eigen/Geometry>
+#include <pcl/conversions.h>
+#include <pcl/surface/marching_cubes.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+//Voxel indices are stored in 21 bits per axis around the origin
+const int IndexOffset = 1 << 20;
+
+//Cube corners and edges in the order of pcl::edgeTable and pcl::triTable
+const int CornerOffsets[8][3] = { {0,0,0}, {1,0,0}, {1,0,1}, {0,0,1}, {0,1,0}, {1,1,0}, {1,1,1}, {0,1,1} };
+const int EdgeCorners[12][2] = { {0,1}, {1,2}, {2,3}, {3,0}, {4,5}, {5,6}, {6,7}, {7,4}, {0,4}, {1,5}, {2,6}, {3,7} };
+
+//Vertex of an extracted triangle, identified by the cube edge it lies on
+struct EdgeVertex
+{
+    uint64_t            key;            //lower voxel of the edge
+    int                 axis;
+    Eigen::Vector3f     position;
+    Eigen::Vector3f     color;
+};
+
+int floorDivide(const int value, const int divisor)
+{
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+bool packIndex(const Eigen::Vector3i &index, uint64_t &key)
+{
+    key = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const int64_t shifted = static_cast<int64_t>(index(axis)) + IndexOffset;
+        if (shifted < 0 || shifted >= 2 * IndexOffset)
+            return false;
+        key |= static_cast<uint64_t>(shifted) << (21 * axis);
+    }
+    return true;
+}
+}
+
+TDK_TSDFVolume::TDK_TSDFVolume(const float voxelSize, const float truncationDistance) :
+    mv_VoxelSize(voxelSize),
+    mv_TruncationDistance(truncationDistance),
+    mv_MaximumWeight(64.0),
+    mv_Width(TDK_KinectV2Intrinsics::depthWidth),
+    mv_Height(TDK_KinectV2Intrinsics::depthHeight),
+    mv_Fx(TDK_KinectV2Intrinsics::fx),
+    mv_Fy(TDK_KinectV2Intrinsics::fy),
+    mv_Cx(TDK_KinectV2Intrinsics::cx),
+    mv_Cy(TDK_KinectV2Intrinsics::cy)
+{
+
+}
+
+TDK_TSDFVolume::~TDK_TSDFVolume()
+{
+
+}
+
+void TDK_TSDFVolume::mf_SetIntrinsics(const int width, const int height,
+                                      const float fx, const float fy, const float cx, const float cy)
+{
+    mv_Width = width;
+    mv_Height = height;
+    mv_Fx = fx;
+    mv_Fy = fy;
+    mv_Cx = cx;
+    mv_Cy = cy;
+}
+
+/*!
+ * \brief TDK_TSDFVolume::mf_Integrate
+ * \param cloud depth frame as point cloud in the camera frame
+ * \param pose transformation from the camera frame into the volume frame
+ * \param minProjectedRatio minimum ratio of points that have to fall inside the depth image
+ * \return false when the cloud is not a depth frame of the camera, nothing is integrated then
+ *
+ * Blocks touched by the truncation band around every measurement are allocated first,
+ * then every voxel of those blocks is projected into the depth image and updated.
+ */
+bool TDK_TSDFVolume::mf_Integrate(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+                                  const Eigen::Matrix4f &pose,
+                                  const float minProjectedRatio)
+{
+    //Depth image of the frame, closest point per pixel
+    const int pixels = mv_Width * mv_Height;
+    std::vector<float> depth(pixels, 0.0f);
+    std::vector<int> pointOfPixel(pixels, -1);
+
+    size_t valid = 0;
+    size_t projected = 0;
+    for (size_t i = 0; i < cloud->size(); ++i)
+    {
+        const pcl::PointXYZRGB &p = cloud->points[i];
+        if (!pcl::isFinite(p) || p.z <= 0)
+            continue;
+        valid++;
+
+        const int u = static_cast<int>(mv_Fx * p.x / p.z + mv_Cx);
+        const int v = static_cast<int>(mv_Fy * p.y / p.z + mv_Cy);
+        if (u < 0 || u >= mv_Width || v < 0 || v >= mv_Height)
+            continue;
+        projected++;
+
+        const int pixel = v * mv_Width + u;
+        if (depth[pixel] == 0.0f || p.z < depth[pixel])
+        {
+            depth[pixel] = p.z;
+            pointOfPixel[pixel] = static_cast<int>(i);
+        }
+    }
+
+    if (valid == 0 || projected < minProjectedRatio * valid)
+        return false;
+
+    const Eigen::Matrix3f rotation = pose.topLeftCorner<3,3>();
+    const Eigen::Vector3f translation = pose.topRightCorner<3,1>();
+    const float blockSize = mv_VoxelSize * BlockSide;
+    const float truncation = mv_TruncationDistance;
+
+    //Blocks crossed by the ray segment of +-truncation around every measurement
+    const int steps = std::max(1, static_cast<int>(std::ceil(4.0f * truncation / blockSize)));
+    std::vector<uint64_t> touched;
+
+#pragma omp parallel
+    {
+        std::vector<uint64_t> local;
+
+#pragma omp for
+        for (int pixel = 0; pixel < pixels; ++pixel)
+        {
+            if (pointOfPixel[pixel] < 0)
+                continue;
+
+            const Eigen::Vector3f rayPoint = rotation * cloud->points[pointOfPixel[pixel]].getVector3fMap();
+            const Eigen::Vector3f direction = rayPoint.normalized();
+            const Eigen::Vector3f point = rayPoint + translation;
+
+            for (int s = 0; s <= steps; ++s)
+            {
+                const Eigen::Vector3f sample = point + direction * (truncation * (2.0f * s / steps - 1.0f));
+                const Eigen::Vector3i block(static_cast<int>(std::floor(sample.x() / blockSize)),
+                                            static_cast<int>(std::floor(sample.y() / blockSize)),
+                                            static_cast<int>(std::floor(sample.z() / blockSize)));
+                uint64_t key;
+                if (mf_BlockKey(block, key) && (local.empty() || local.back() != key))
+                    local.push_back(key);
+            }
+        }
+
+#pragma omp critical
+        touched.insert(touched.end(), local.begin(), local.end());
+    }
+
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+    const int numberOfBlocks = static_cast<int>(touched.size());
+    std::vector<Block*> blocks(numberOfBlocks);
+    for (int k = 0; k < numberOfBlocks; ++k)
+    {
+        boost::shared_ptr<Block> &block = mv_Blocks[touched[k]];
+        if (!block)
+        {
+            block.reset(new Block);
+            for (int i = 0; i < BlockVoxels; ++i)
+            {
+                Voxel &voxel = block->voxels[i];
+                voxel.tsdf = 1.0f;
+                voxel.weight = voxel.r = voxel.g = voxel.b = 0.0f;
+            }
+        }
+        blocks[k] = block.get();
+    }
+
+    //Voxels of different blocks never share memory, blocks are updated in parallel
+    const Eigen::Matrix3f inverseRotation = rotation.transpose();
+    const Eigen::Vector3f inverseTranslation = -inverseRotation * translation;
+
+#pragma omp parallel for schedule(dynamic, 4)
+    for (int k = 0; k < numberOfBlocks; ++k)
+    {
+        const Eigen::Vector3i origin = mf_BlockOfKey(touched[k]) * BlockSide;
+        Block &block = *blocks[k];
+
+        for (int i = 0; i < BlockVoxels; ++i)
+        {
+            const Eigen::Vector3i index = origin + Eigen::Vector3i(i % BlockSide, (i / BlockSide) % BlockSide, i / (BlockSide * BlockSide));
+            const Eigen::Vector3f camera = inverseRotation * (index.cast<float>() * mv_VoxelSize) + inverseTranslation;
+            if (camera.z() <= 0)
+                continue;
+
+            const int u = static_cast<int>(mv_Fx * camera.x() / camera.z() + mv_Cx);
+            const int v = static_cast<int>(mv_Fy * camera.y() / camera.z() + mv_Cy);
+            if (u < 0 || u >= mv_Width || v < 0 || v >= mv_Height)
+                continue;
+
+            const int pixel = v * mv_Width + u;
+            if (pointOfPixel[pixel] < 0)
+                continue;
+
+            //Projective distance along the optical axis, voxels far behind the surface are occluded
+            const float distance = depth[pixel] - camera.z();
+            if (distance < -truncation)
+                continue;
+
+            Voxel &voxel = block.voxels[i];
+            const float weight = voxel.weight + 1.0f;
+            voxel.tsdf += (std::min(1.0f, distance / truncation) - voxel.tsdf) / weight;
+
+            if (distance < truncation)
+            {
+                const pcl::PointXYZRGB &point = cloud->points[pointOfPixel[pixel]];
+                voxel.r += (point.r - voxel.r) / weight;
+                voxel.g += (point.g - voxel.g) / weight;
+                voxel.b += (point.b - voxel.b) / weight;
+            }
+            voxel.weight = std::min(weight, mv_MaximumWeight);
+        }
+    }
+
+    return true;
+}
+
+/*!
+ * \brief TDK_TSDFVolume::mf_ExtractMesh
+ * \param mesh output colored triangle mesh of the zero crossing, in the volume frame
+ *
+ * Marching cubes over all allocated blocks in parallel. Cubes with an unobserved corner are
+ * skipped, so the surface ends where no frame has seen it. Triangles are oriented along the
+ * gradient of the distance field and vertices are welded by the cube edge they lie on.
+ */
+void TDK_TSDFVolume::mf_ExtractMesh(pcl::PolygonMesh &mesh) const
+{
+    std::vector<uint64_t> keys;
+    std::vector<const Block*> blocks;
+    keys.reserve(mv_Blocks.size());
+    blocks.reserve(mv_Blocks.size());
+    for (BlockMap::const_iterator it = mv_Blocks.begin(); it != mv_Blocks.end(); ++it)
+    {
+        keys.push_back(it->first);
+        blocks.push_back(it->second.get());
+    }
+
+    const int numberOfBlocks = static_cast<int>(keys.size());
+    std::vector<EdgeVertex> triangles;
+
+#pragma omp parallel
+    {
+        std::vector<EdgeVertex> local;
+
+#pragma omp for schedule(dynamic, 4)
+        for (int k = 0; k < numberOfBlocks; ++k)
+        {
+            const Eigen::Vector3i origin = mf_BlockOfKey(keys[k]) * BlockSide;
+
+            for (int i = 0; i < BlockVoxels; ++i)
+            {
+                const Eigen::Vector3i local3(i % BlockSide, (i / BlockSide) % BlockSide, i / (BlockSide * BlockSide));
+                const Eigen::Vector3i index = origin + local3;
+                const bool inside = (local3.array() < BlockSide - 1).all();
+
+                //Corners of the cube, inside the block they are read directly
+                const Voxel *corners[8];
+                bool observed = true;
+                int cubeIndex = 0;
+                for (int c = 0; c < 8 && observed; ++c)
+                {
+                    const Eigen::Vector3i offset(CornerOffsets[c][0], CornerOffsets[c][1], CornerOffsets[c][2]);
+                    if (inside)
+                    {
+                        const Eigen::Vector3i corner = local3 + offset;
+                        corners[c] = &blocks[k]->voxels[corner.x() + BlockSide * (corner.y() + BlockSide * corner.z())];
+                    }
+                    else
+                    {
+                        corners[c] = mf_FindVoxel(index + offset);
+                    }
+
+                    observed = corners[c] && corners[c]->weight > 0.0f;
+                    if (observed && corners[c]->tsdf < 0.0f)
+                        cubeIndex |= 1 << c;
+                }
+
+                if (!observed || pcl::edgeTable[cubeIndex] == 0)
+                    continue;
+
+                //Points out of the object, towards growing distance
+                Eigen::Vector3f gradient = Eigen::Vector3f::Zero();
+                for (int c = 0; c < 8; ++c)
+                    gradient += corners[c]->tsdf * Eigen::Vector3f(2 * CornerOffsets[c][0] - 1,
+                                                                   2 * CornerOffsets[c][1] - 1,
+                                                                   2 * CornerOffsets[c][2] - 1);
+
+                EdgeVertex edgeVertices[12];
+                for (int e = 0; e < 12; ++e)
+                {
+                    if (!(pcl::edgeTable[cubeIndex] & (1 << e)))
+                        continue;
+
+                    const int a = EdgeCorners[e][0];
+                    const int b = EdgeCorners[e][1];
+                    const Eigen::Vector3f offsetA(CornerOffsets[a][0], CornerOffsets[a][1], CornerOffsets[a][2]);
+                    const Eigen::Vector3f offsetB(CornerOffsets[b][0], CornerOffsets[b][1], CornerOffsets[b][2]);
+                    const float t = corners[a]->tsdf / (corners[a]->tsdf - corners[b]->tsdf);
+
+                    EdgeVertex &vertex = edgeVertices[e];
+                    vertex.position = (index.cast<float>() + offsetA + t * (offsetB - offsetA)) * mv_VoxelSize;
+                    vertex.color = Eigen::Vector3f(corners[a]->r, corners[a]->g, corners[a]->b) * (1.0f - t) +
+                            Eigen::Vector3f(corners[b]->r, corners[b]->g, corners[b]->b) * t;
+
+                    const Eigen::Vector3f lower = offsetA.cwiseMin(offsetB);
+                    (offsetB - offsetA).cwiseAbs().maxCoeff(&vertex.axis);
+                    packIndex(index + lower.cast<int>(), vertex.key);
+                }
+
+                for (int t = 0; pcl::triTable[cubeIndex][t] != -1; t += 3)
+                {
+                    const EdgeVertex &v0 = edgeVertices[pcl::triTable[cubeIndex][t]];
+                    const EdgeVertex &v1 = edgeVertices[pcl::triTable[cubeIndex][t + 1]];
+                    const EdgeVertex &v2 = edgeVertices[pcl::triTable[cubeIndex][t + 2]];
+
+                    const Eigen::Vector3f normal = (v1.position - v0.position).cross(v2.position - v0.position);
+                    local.push_back(v0);
+                    if (normal.dot(gradient) >= 0.0f)
+                    {
+                        local.push_back(v1);
+                        local.push_back(v2);
+                    }
+                    else
+                    {
+                        local.push_back(v2);
+                        local.push_back(v1);
+                    }
+                }
+            }
+        }
+
+#pragma omp critical
+        triangles.insert(triangles.end(), local.begin(), local.end());
+    }
+
+    //Weld vertices of neighbouring cubes, one map per edge direction
+    pcl::PointCloud<pcl::PointXYZRGB> vertices;
+    std::unordered_map<uint64_t, int> vertexOfEdge[3];
+    mesh.polygons.clear();
+    mesh.polygons.reserve(triangles.size() / 3);
+
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        pcl::Vertices polygon;
+        for (size_t j = i; j < i + 3; ++j)
+        {
+            const EdgeVertex &vertex = triangles[j];
+            std::unordered_map<uint64_t, int>::iterator it = vertexOfEdge[vertex.axis].find(vertex.key);
+            if (it == vertexOfEdge[vertex.axis].end())
+            {
+                pcl::PointXYZRGB point;
+                point.getVector3fMap() = vertex.position;
+                point.r = static_cast<uint8_t>(vertex.color.x() + 0.5f);
+                point.g = static_cast<uint8_t>(vertex.color.y() + 0.5f);
+                point.b = static_cast<uint8_t>(vertex.color.z() + 0.5f);
+                it = vertexOfEdge[vertex.axis].insert(std::make_pair(vertex.key, static_cast<int>(vertices.size()))).first;
+                vertices.push_back(point);
+            }
+            polygon.vertices.push_back(it->second);
+        }
+        mesh.polygons.push_back(polygon);
+    }
+
+    pcl::toPCLPointCloud2(vertices, mesh.cloud);
+}
+
+/*!
+ * \brief TDK_TSDFVolume::mf_BlockKey
+ * \param block block index
+ * \param key packed block index
+ * \return false outside of the volume, whose voxel indices have to fit in 21 bits per axis
+ */
+bool TDK_TSDFVolume::mf_BlockKey(const Eigen::Vector3i &block, uint64_t &key)
+{
+    if (!(block.array().abs() < IndexOffset / BlockSide).all())
+        return false;
+    return packIndex(block, key);
+}
+
+Eigen::Vector3i TDK_TSDFVolume::mf_BlockOfKey(const uint64_t key)
+{
+    const uint64_t mask = (1u << 21) - 1;
+    return Eigen::Vector3i(static_cast<int>(key & mask) - IndexOffset,
+                           static_cast<int>((key >> 21) & mask) - IndexOffset,
+                           static_cast<int>((key >> 42) & mask) - IndexOffset);
+}
+
+const TDK_TSDFVolume::Voxel *TDK_TSDFVolume::mf_FindVoxel(const Eigen::Vector3i &voxel) const
+{
+    const Eigen::Vector3i block(floorDivide(voxel.x(), BlockSide),
+                                floorDivide(voxel.y(), BlockSide),
+                                floorDivide(voxel.z(), BlockSide));
+
+    uint64_t key;
+    if (!mf_BlockKey(block, key))
+        return 0;
+
+    BlockMap::const_iterator it = mv_Blocks.find(key);
+    if (it == mv_Blocks.end())
+        return 0;
+
+    const Eigen::Vector3i local = voxel - block * BlockSide;
+    return &it->second->voxels[local.x() + BlockSide * (local.y() + BlockSide * local.z())];
+}
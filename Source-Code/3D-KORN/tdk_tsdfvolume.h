@@ -0,0 +1,94 @@
+#ifndef TDK_TSDFVOLUME_H
+#define TDK_TSDFVOLUME_H
+
+#include <Eigen/Core>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PolygonMesh.h>
+#include <boost/shared_ptr.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief The TDK_TSDFVolume class
+ *
+ * Truncated signed distance field over a sparse hash of voxel blocks, fusing posed depth
+ * frames into one surface (Curless and Levoy, KinectFusion, voxel hashing of Niessner et al.).
+ * Only blocks within the truncation distance of a measured surface are allocated, so memory
+ * follows the scanned surface instead of the bounding box of the scene.
+ *
+ * A frame is a Kinect point cloud in its camera frame. It is projected back into a depth
+ * image with the depth intrinsics, then every voxel of the blocks it touches is projected
+ * into that image and updates its weighted running average of the signed distance and color.
+ * Blocks are independent, a frame is integrated in parallel over blocks with OpenMP.
+ *
+ * The mesh is extracted with marching cubes on the zero crossing, vertices are shared
+ * between neighbouring cubes and faces point out of the object.
+ *
+ * Use example
+ * TDK_TSDFVolume volume(0.002, 0.01);
+ * volume.mf_Integrate(view, pose);
+ * pcl::PolygonMesh mesh;
+ * volume.mf_ExtractMesh(mesh);
+ */
+class TDK_TSDFVolume
+{
+public:
+    TDK_TSDFVolume(const float voxelSize = 0.002, const float truncationDistance = 0.01);
+    ~TDK_TSDFVolume();
+
+    //Depth camera of the frames, Kinect V2 depth intrinsics by default
+    void    mf_SetIntrinsics            (const int width, const int height,
+                                         const float fx, const float fy, const float cx, const float cy);
+    //Voxel weights saturate at this value, lower values let later frames override older ones
+    void    mf_SetMaximumWeight         (const float maximumWeight)     {   mv_MaximumWeight = maximumWeight;   }
+
+    float   mf_GetVoxelSize             () const    {   return mv_VoxelSize;            }
+    float   mf_GetTruncationDistance    () const    {   return mv_TruncationDistance;   }
+    int     mf_GetNumberOfBlocks        () const    {   return static_cast<int>(mv_Blocks.size());  }
+
+    bool    mf_Integrate                (const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+                                         const Eigen::Matrix4f &pose,
+                                         const float minProjectedRatio = 0.9);
+    void    mf_ExtractMesh              (pcl::PolygonMesh &mesh) const;
+
+    void    mf_Clear                    ()      {   mv_Blocks.clear();  }
+
+private:
+    static const int BlockSide = 8;
+    static const int BlockVoxels = BlockSide * BlockSide * BlockSide;
+
+    struct Voxel
+    {
+        float   tsdf;                   //signed distance divided by the truncation distance, positive in front of the surface
+        float   weight;
+        float   r;
+        float   g;
+        float   b;
+    };
+
+    struct Block
+    {
+        Voxel   voxels[BlockVoxels];
+    };
+
+    typedef std::unordered_map<uint64_t, boost::shared_ptr<Block> > BlockMap;
+
+    float       mv_VoxelSize;
+    float       mv_TruncationDistance;
+    float       mv_MaximumWeight;
+    int         mv_Width;
+    int         mv_Height;
+    float       mv_Fx;
+    float       mv_Fy;
+    float       mv_Cx;
+    float       mv_Cy;
+    BlockMap    mv_Blocks;
+
+    static bool         mf_BlockKey         (const Eigen::Vector3i &block, uint64_t &key);
+    static Eigen::Vector3i mf_BlockOfKey    (const uint64_t key);
+    const Voxel        *mf_FindVoxel        (const Eigen::Vector3i &voxel) const;
+};
+
+#endif // TDK_TSDFVOLUME_H
@@ -0,0 +1,186 @@
+#include "tdk_voxelaccumulator.h"
+
+#include <cmath>
+#include <vector>
+
+TDK_VoxelAccumulator::TDK_VoxelAccumulator(const float voxelSize) :
+    mv_VoxelSize(voxelSize),
+    mv_MaximumNumberOfVoxels(0),
+    mv_NumberOfVoxels(0)
+{
+
+}
+
+TDK_VoxelAccumulator::~TDK_VoxelAccumulator()
+{
+
+}
+
+/*!
+ * \brief TDK_VoxelAccumulator::mf_SetVoxelSize
+ * \param voxelSize side of a voxel in meters, the model is cleared
+ */
+void TDK_VoxelAccumulator::mf_SetVoxelSize(const float voxelSize)
+{
+    mf_Clear();
+    mv_VoxelSize = voxelSize;
+}
+
+/*!
+ * \brief TDK_VoxelAccumulator::mf_Integrate
+ * \param cloud scan to add to the model
+ * \param pose transformation of the scan into the model frame
+ * \param weight weight of every point of the scan
+ *
+ * Points are transformed and hashed in parallel, then every shard integrates its points with
+ * its lock held once, so threads never wait on each other inside one scan.
+ */
+void TDK_VoxelAccumulator::mf_Integrate(const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+                                        const Eigen::Matrix4f &pose,
+                                        const float weight)
+{
+    const int size = static_cast<int>(cloud->size());
+    const Eigen::Matrix3f rotation = pose.topLeftCorner<3,3>();
+    const Eigen::Vector3f translation = pose.topRightCorner<3,1>();
+
+    std::vector<Eigen::Vector3f> positions(size);
+    std::vector<uint64_t> keys(size);
+    std::vector<int> shardOfPoint(size, -1);
+
+#pragma omp parallel for
+    for (int i = 0; i < size; ++i)
+    {
+        if (!pcl::isFinite(cloud->points[i]))
+            continue;
+
+        positions[i] = rotation * cloud->points[i].getVector3fMap() + translation;
+        if (mf_ComputeKey(positions[i], keys[i]))
+            shardOfPoint[i] = mf_ShardOfKey(keys[i]);
+    }
+
+    std::vector<std::vector<int> > buckets(NumberOfShards);
+    for (int i = 0; i < size; ++i)
+        if (shardOfPoint[i] >= 0)
+            buckets[shardOfPoint[i]].push_back(i);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int s = 0; s < NumberOfShards; ++s)
+    {
+        if (buckets[s].empty())
+            continue;
+
+        Shard &shard = mv_Shards[s];
+        QMutexLocker locker(&shard.mutex);
+
+        for (size_t k = 0; k < buckets[s].size(); ++k)
+        {
+            const int i = buckets[s][k];
+            const pcl::PointXYZRGB &point = cloud->points[i];
+            const Eigen::Vector3f color(point.r, point.g, point.b);
+
+            std::unordered_map<uint64_t, Voxel>::iterator it = shard.voxels.find(keys[i]);
+            if (it == shard.voxels.end())
+            {
+                //Reserve a slot of the voxel budget before creating the voxel
+                if (++mv_NumberOfVoxels > mv_MaximumNumberOfVoxels && mv_MaximumNumberOfVoxels > 0)
+                {
+                    --mv_NumberOfVoxels;
+                    continue;
+                }
+
+                Voxel voxel;
+                voxel.position = positions[i];
+                voxel.color = color;
+                voxel.weight = weight;
+                shard.voxels[keys[i]] = voxel;
+                continue;
+            }
+
+            //Running weighted mean
+            Voxel &voxel = it->second;
+            voxel.weight += weight;
+            const float ratio = weight / voxel.weight;
+            voxel.position += (positions[i] - voxel.position) * ratio;
+            voxel.color += (color - voxel.color) * ratio;
+        }
+    }
+}
+
+/*!
+ * \brief TDK_VoxelAccumulator::mf_GetPointCloud
+ * \param minimumWeight voxels with a lower total weight are skipped, e.g. to drop points seen only once
+ * \return one point per voxel at its mean position and with its mean color
+ */
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr TDK_VoxelAccumulator::mf_GetPointCloud(const float minimumWeight) const
+{
+    std::vector<pcl::PointCloud<pcl::PointXYZRGB> > shardClouds(NumberOfShards);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int s = 0; s < NumberOfShards; ++s)
+    {
+        const Shard &shard = mv_Shards[s];
+        QMutexLocker locker(&shard.mutex);
+
+        pcl::PointCloud<pcl::PointXYZRGB> &shardCloud = shardClouds[s];
+        shardCloud.reserve(shard.voxels.size());
+
+        std::unordered_map<uint64_t, Voxel>::const_iterator it;
+        for (it = shard.voxels.begin(); it != shard.voxels.end(); ++it)
+        {
+            const Voxel &voxel = it->second;
+            if (voxel.weight < minimumWeight)
+                continue;
+
+            pcl::PointXYZRGB point;
+            point.getVector3fMap() = voxel.position;
+            point.r = static_cast<uint8_t>(voxel.color.x() + 0.5f);
+            point.g = static_cast<uint8_t>(voxel.color.y() + 0.5f);
+            point.b = static_cast<uint8_t>(voxel.color.z() + 0.5f);
+            shardCloud.push_back(point);
+        }
+    }
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr result (new pcl::PointCloud<pcl::PointXYZRGB>);
+    for (int s = 0; s < NumberOfShards; ++s)
+        *result += shardClouds[s];
+
+    return result;
+}
+
+void TDK_VoxelAccumulator::mf_Clear()
+{
+    for (int s = 0; s < NumberOfShards; ++s)
+    {
+        QMutexLocker locker(&mv_Shards[s].mutex);
+        mv_Shards[s].voxels.clear();
+    }
+    mv_NumberOfVoxels = 0;
+}
+
+/*!
+ * \brief TDK_VoxelAccumulator::mf_ComputeKey
+ * \param point position in the model frame
+ * \param key 21 bits per voxel index, x in the lowest bits
+ * \return false when the point lies outside the 2^21 voxels per axis around the origin
+ */
+bool TDK_VoxelAccumulator::mf_ComputeKey(const Eigen::Vector3f &point, uint64_t &key) const
+{
+    const int64_t Offset = 1 << 20;
+    const int64_t Range = 1 << 21;
+
+    key = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const int64_t index = static_cast<int64_t>(std::floor(point(axis) / mv_VoxelSize)) + Offset;
+        if (index < 0 || index >= Range)
+            return false;
+        key |= static_cast<uint64_t>(index) << (21 * axis);
+    }
+    return true;
+}
+
+int TDK_VoxelAccumulator::mf_ShardOfKey(const uint64_t key)
+{
+    //Fibonacci hashing, the top bits pick the shard
+    return static_cast<int>((key * 0x9E3779B97F4A7C15ull) >> 58);
+}
@@ -0,0 +1,80 @@
+#ifndef TDK_VOXELACCUMULATOR_H
+#define TDK_VOXELACCUMULATOR_H
+
+#include <Eigen/Core>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+
+#include <QMutex>
+
+/*!
+ * \brief The TDK_VoxelAccumulator class
+ *
+ * Sparse voxel hash that fuses aligned scans into one model. Every voxel keeps the running
+ * weighted mean of the position and color of the points that fell into it and their total
+ * weight, so overlapping views refine the model instead of duplicating it and the number of
+ * points is bounded by the scanned surface, not by the number of views.
+ *
+ * Voxels are spread over independent shards of the hash, each with its own lock. A scan is
+ * integrated in parallel with one thread per shard, and several threads may integrate scans
+ * at the same time.
+ *
+ * Use example
+ * TDK_VoxelAccumulator model(0.002);
+ * model.mf_Integrate(firstView);
+ * model.mf_Integrate(secondView, secondViewPose);
+ * pcl::PointCloud<pcl::PointXYZRGB>::Ptr merged = model.mf_GetPointCloud();
+ */
+class TDK_VoxelAccumulator
+{
+public:
+    TDK_VoxelAccumulator(const float voxelSize = 0.002);
+    ~TDK_VoxelAccumulator();
+
+    void    mf_SetVoxelSize                 (const float voxelSize);
+    float   mf_GetVoxelSize                 () const    {   return mv_VoxelSize;    }
+
+    //New voxels are dropped once the limit is reached, existing ones keep being updated. 0 means no limit
+    void    mf_SetMaximumNumberOfVoxels     (const int maximum)     {   mv_MaximumNumberOfVoxels = maximum; }
+    int     mf_GetNumberOfVoxels            () const    {   return mv_NumberOfVoxels;   }
+
+    void    mf_Integrate                    (const pcl::PointCloud<pcl::PointXYZRGB>::ConstPtr &cloud,
+                                             const Eigen::Matrix4f &pose = Eigen::Matrix4f::Identity(),
+                                             const float weight = 1.0);
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr  mf_GetPointCloud    (const float minimumWeight = 0.0) const;
+
+    void    mf_Clear                        ();
+
+private:
+    struct Voxel
+    {
+        Eigen::Vector3f     position;
+        Eigen::Vector3f     color;
+        float               weight;
+    };
+
+    struct Shard
+    {
+        mutable QMutex                          mutex;
+        std::unordered_map<uint64_t, Voxel>     voxels;
+    };
+
+    static const int        NumberOfShards = 64;
+
+    float                   mv_VoxelSize;
+    int                     mv_MaximumNumberOfVoxels;
+    std::atomic<int>        mv_NumberOfVoxels;
+    Shard                   mv_Shards[NumberOfShards];
+
+    bool                    mf_ComputeKey       (const Eigen::Vector3f &point, uint64_t &key) const;
+    static int              mf_ShardOfKey       (const uint64_t key);
+
+    TDK_VoxelAccumulator(const TDK_VoxelAccumulator &);
+    TDK_VoxelAccumulator &operator=(const TDK_VoxelAccumulator &);
+};
+
+#endif // TDK_VOXELACCUMULATOR_H
@@ -0,0 +1,52 @@
+#-------------------------------------------------
+#
+# Headless batch registration and meshing of 3D-KORN scans
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = batch_processing
+TEMPLATE = app
+
+KORN_DIR = $$PWD/../3D-KORN
+
+include($$KORN_DIR/dependencies.pri)
+
+INCLUDEPATH += $$KORN_DIR
+
+# No viewer or match windows, the registration runs unattended
+DEFINES += TDK_HEADLESS
+
+SOURCES += main.cpp \
+    $$KORN_DIR/tdk_batchprocessor.cpp \
+    $$KORN_DIR/tdk_processingqueue.cpp \
+    $$KORN_DIR/tdk_scanregistration.cpp \
+    $$KORN_DIR/tdk_2dfeaturedetection.cpp \
+    $$KORN_DIR/tdk_filters.cpp \
+    $$KORN_DIR/tdk_posegraph.cpp \
+    $$KORN_DIR/tdk_voxelaccumulator.cpp \
+    $$KORN_DIR/tdk_tsdfvolume.cpp \
+    $$KORN_DIR/tdk_meshing.cpp \
+    $$KORN_DIR/tdk_filterpipeline.cpp \
+    $$KORN_DIR/tdk_outofcorefilter.cpp
+
+HEADERS += \
+    $$KORN_DIR/tdk_batchprocessor.h \
+    $$KORN_DIR/tdk_processingqueue.h \
+    $$KORN_DIR/tdk_kinectv2intrinsics.h \
+    $$KORN_DIR/tdk_scanregistration.h \
+    $$KORN_DIR/tdk_2dfeaturedetection.h \
+    $$KORN_DIR/tdk_filters.h \
+    $$KORN_DIR/tdk_posegraph.h \
+    $$KORN_DIR/tdk_voxelaccumulator.h \
+    $$KORN_DIR/tdk_tsdfvolume.h \
+    $$KORN_DIR/tdk_meshing.h \
+    $$KORN_DIR/tdk_filterpipeline.h \
+    $$KORN_DIR/tdk_outofcorefilter.h
+
+DISTFILES += \
+    batch_config_example.json
@@ -0,0 +1,143 @@
+// Disable Error C4996 that occur when using Boost.Signals2.
+#ifdef _DEBUG
+#define _SCL_SECURE_NO_WARNINGS
+#endif
+
+#include "tdk_batchprocessor.h"
+#include "tdk_outofcorefilter.h"
+#include "tdk_processingqueue.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QThread>
+
+/*
+ * Usage examples
+ * batch_processing --input scans --output-cloud merged.ply --output-mesh mesh.ply
+ * batch_processing --input scans --config batch_config_example.json --output-mesh mesh.stl --report report.json
+ * batch_processing --queue queue.json --input scans/mug --output-mesh mug.ply --priority interactive
+ * batch_processing --queue queue.json --threads 8 --sessions 2
+ * batch_processing --filter-cloud merged.ply --config batch_config_example.json --output-cloud filtered.ply
+ *
+ * Exits with 1 when the scans cannot be loaded, the registration fails or an output cannot be written.
+ * With --queue the session is added to the persistent queue, then every unfinished session of the
+ * queue is processed, including the ones left over by an interrupted run.
+ * With --filter-cloud a merged cloud is filtered out of core with the filters of the configuration,
+ * without registration, for clouds larger than the memory.
+ */
+static bool writeReport(const QString &fileName, const QJsonObject &report)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)){
+        qCritical() << "Could not write" << fileName;
+        return false;
+    }
+    file.write(QJsonDocument(report).toJson());
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("batch_processing");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless registration and meshing of 3D-KORN scans");
+    parser.addHelpOption();
+
+    QCommandLineOption inputOption("input", "Folder with the PLY/PCD scans, registered in the order of their names.", "folder");
+    QCommandLineOption configOption("config", "JSON configuration of the registration, filters and meshing.", "file");
+    QCommandLineOption cloudOption("output-cloud", "Write the merged and filtered cloud, PLY or PCD.", "file");
+    QCommandLineOption meshOption("output-mesh", "Write the mesh, PLY, OBJ, STL or VTK.", "file");
+    QCommandLineOption reportOption("report", "Write stage times and registration telemetry as JSON.", "file");
+    QCommandLineOption queueOption("queue", "Process the sessions of this persistent queue state.", "file");
+    QCommandLineOption priorityOption("priority", "Priority of the queued session, interactive or batch.", "priority", "batch");
+    QCommandLineOption threadsOption("threads", "Threads shared by all running sessions of the queue.", "count",
+                                     QString::number(QThread::idealThreadCount()));
+    QCommandLineOption sessionsOption("sessions", "Sessions of the queue running at the same time.", "count", "2");
+    QCommandLineOption filterOption("filter-cloud", "Filter this cloud out of core into --output-cloud instead of registering scans.", "file");
+
+    parser.addOption(inputOption);
+    parser.addOption(configOption);
+    parser.addOption(cloudOption);
+    parser.addOption(meshOption);
+    parser.addOption(reportOption);
+    parser.addOption(queueOption);
+    parser.addOption(priorityOption);
+    parser.addOption(threadsOption);
+    parser.addOption(sessionsOption);
+    parser.addOption(filterOption);
+    parser.process(app);
+
+    if(parser.isSet(filterOption)){
+        if(!parser.isSet(cloudOption)){
+            qCritical() << "Filtering a cloud needs --output-cloud";
+            parser.showHelp(1);
+        }
+
+        //Same filters as the batch processor without configuration
+        TDK_OutOfCoreFilter filter;
+        filter.mf_SetOutlierRemoval();
+        if(parser.isSet(configOption) && !filter.mf_LoadConfig(parser.value(configOption))){
+            qCritical() << "Could not load the configuration" << parser.value(configOption);
+            return 1;
+        }
+
+        const bool success = filter.mf_Process(parser.value(filterOption), parser.value(cloudOption));
+        if(parser.isSet(reportOption) && !writeReport(parser.value(reportOption), filter.mf_GetReport()))
+            return 1;
+        return success ? 0 : 1;
+    }
+
+    if(parser.isSet(queueOption)){
+        TDK_ProcessingQueue queue(parser.value(queueOption));
+        queue.mf_SetThreadBudget(parser.value(threadsOption).toInt());
+        queue.mf_SetMaximumConcurrentSessions(parser.value(sessionsOption).toInt());
+
+        if(parser.isSet(inputOption)){
+            const TDK_ProcessingQueue::Priority priority = parser.value(priorityOption) == "interactive" ?
+                        TDK_ProcessingQueue::Interactive : TDK_ProcessingQueue::Batch;
+            queue.mf_Enqueue(parser.value(inputOption), parser.value(configOption),
+                             parser.value(cloudOption), parser.value(meshOption),
+                             priority, parser.value(reportOption));
+        }
+
+        int failures = 0;
+        QObject::connect(&queue, &TDK_ProcessingQueue::mf_SignalSessionFinished,
+                         [&failures](QString, bool success){ if(!success) failures++; });
+        QObject::connect(&queue, SIGNAL(mf_SignalQueueEmpty()), &app, SLOT(quit()), Qt::QueuedConnection);
+
+        queue.mf_Start();
+        if(queue.mf_GetNumberOfRunningSessions() > 0)
+            app.exec();
+
+        return failures == 0 ? 0 : 1;
+    }
+
+    if(!parser.isSet(inputOption) || (!parser.isSet(cloudOption) && !parser.isSet(meshOption))){
+        qCritical() << "An input folder and at least one output file are required";
+        parser.showHelp(1);
+    }
+
+    TDK_BatchProcessor processor;
+
+    if(parser.isSet(configOption) && !processor.mf_LoadConfig(parser.value(configOption))){
+        qCritical() << "Could not load the configuration" << parser.value(configOption);
+        return 1;
+    }
+
+    if(!processor.mf_LoadScans(parser.value(inputOption))){
+        qCritical() << "Could not load at least two scans from" << parser.value(inputOption);
+        return 1;
+    }
+
+    const bool success = processor.mf_Run(parser.value(cloudOption), parser.value(meshOption));
+
+    if(parser.isSet(reportOption) && !writeReport(parser.value(reportOption), processor.mf_GetReport()))
+        return 1;
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#-------------------------------------------------
+#
+# Benchmark of the 3D-KORN point cloud filters
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = filter_benchmark
+TEMPLATE = app
+
+KORN_DIR = $$PWD/../3D-KORN
+
+include($$KORN_DIR/dependencies.pri)
+
+INCLUDEPATH += $$KORN_DIR
+
+SOURCES += main.cpp \
+    tdk_filterbenchmark.cpp \
+    $$KORN_DIR/tdk_filters.cpp \
+    $$KORN_DIR/tdk_depthbilateralfilter.cpp \
+    $$KORN_DIR/tdk_incrementalpassthrough.cpp \
+    $$KORN_DIR/tdk_filterpipeline.cpp \
+    $$KORN_DIR/tdk_outofcorefilter.cpp
+
+HEADERS += \
+    tdk_filterbenchmark.h \
+    $$KORN_DIR/tdk_filters.h \
+    $$KORN_DIR/tdk_depthbilateralfilter.h \
+    $$KORN_DIR/tdk_incrementalpassthrough.h \
+    $$KORN_DIR/tdk_filterpipeline.h \
+    $$KORN_DIR/tdk_outofcorefilter.h
@@ -0,0 +1,89 @@
+// Disable Error C4996 that occur when using Boost.Signals2.
+#ifdef _DEBUG
+#define _SCL_SECURE_NO_WARNINGS
+#endif
+
+#include "tdk_filterbenchmark.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+
+/*
+ * Usage examples
+ * filter_benchmark --points 2000000 --output report.json
+ * filter_benchmark --cloud merged.ply --cases CropBox --repetitions 9
+ *
+ * Exits with 1 when the cloud cannot be loaded or an optimized filter does not match its reference,
+ * the same points or, for the depth filter, close depths.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("filter_benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark of the 3D-KORN point cloud filters");
+    parser.addHelpOption();
+
+    QCommandLineOption cloudOption("cloud", "PLY/PCD cloud to filter instead of a synthetic one.", "file");
+    QCommandLineOption pointsOption("points", "Points of the synthetic cloud.", "count", "2000000");
+    QCommandLineOption seedOption("seed", "Seed of the synthetic cloud.", "seed", "1");
+    QCommandLineOption casesOption("cases", "Comma separated cases: " +
+                                   TDK_FilterBenchmark::mf_AvailableCases().join(",") + ".", "cases");
+    QCommandLineOption repetitionsOption("repetitions", "Runs of every filter, the median is reported.", "count", "5");
+    QCommandLineOption outputOption("output", "Write the JSON report to this file instead of the standard output.", "file");
+
+    parser.addOption(cloudOption);
+    parser.addOption(pointsOption);
+    parser.addOption(seedOption);
+    parser.addOption(casesOption);
+    parser.addOption(repetitionsOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    TDK_FilterBenchmark benchmark;
+
+    if(parser.isSet(cloudOption)){
+        if(!benchmark.mf_LoadCloud(parser.value(cloudOption))){
+            qCritical() << "Could not load" << parser.value(cloudOption);
+            return 1;
+        }
+    }
+    else{
+        benchmark.mf_GenerateSyntheticCloud(parser.value(pointsOption).toInt(), parser.value(seedOption).toUInt());
+    }
+
+    if(parser.isSet(casesOption))
+        benchmark.mf_SetCases(parser.value(casesOption).split(',', QString::SkipEmptyParts));
+    benchmark.mf_SetRepetitions(parser.value(repetitionsOption).toInt());
+
+    QJsonObject report = benchmark.mf_Run();
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if(parser.isSet(outputOption)){
+        QFile file(parser.value(outputOption));
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Text)){
+            qCritical() << "Could not write" << parser.value(outputOption);
+            return 1;
+        }
+        file.write(json);
+    }
+    else{
+        QTextStream(stdout) << json;
+    }
+
+    const QJsonArray cases = report["cases"].toArray();
+    for(int i = 0; i < cases.size(); i++){
+        if(!cases[i].toObject()["matchesReference"].toBool()){
+            qCritical() << "Output differs from the reference:" << cases[i].toObject()["case"].toString();
+            return 1;
+        }
+    }
+
+    return 0;
+}
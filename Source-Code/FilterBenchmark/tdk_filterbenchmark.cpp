@@ -0,0 +1,734 @@
+#include "tdk_filterbenchmark.h"
+#include "tdk_depthbilateralfilter.h"
+#include "tdk_filters.h"
+#include "tdk_incrementalpassthrough.h"
+#include "tdk_outofcorefilter.h"
+
+#include <pcl/common/common.h>
+#include <pcl/filters/passthrough.h>
+#include <pcl/filters/radius_outlier_removal.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+#include <pcl/surface/mls.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QTemporaryDir>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+//Voxel of a point as pcl::VoxelGrid and TDK_Filters compute it
+inline std::tuple<int, int, int> voxelOf(const pcl::PointXYZRGB &point, const float leafSize)
+{
+    const float inverseLeafSize = 1.0f / leafSize;
+    return std::make_tuple(static_cast<int>(std::floor(point.x * inverseLeafSize)),
+                           static_cast<int>(std::floor(point.y * inverseLeafSize)),
+                           static_cast<int>(std::floor(point.z * inverseLeafSize)));
+}
+
+//Same voxels with centroids within a thousandth of the leaf and colors within one level, in any order
+bool sameVoxels(const pcl::PointCloud<pcl::PointXYZRGB> &a, const pcl::PointCloud<pcl::PointXYZRGB> &b, const float leafSize)
+{
+    if(a.size() != b.size())
+        return false;
+
+    std::map<std::tuple<int, int, int>, int> voxels;
+    for(size_t i = 0; i < a.size(); i++)
+        voxels[voxelOf(a.points[i], leafSize)] = static_cast<int>(i);
+    for(size_t i = 0; i < b.size(); i++){
+        std::map<std::tuple<int, int, int>, int>::const_iterator it = voxels.find(voxelOf(b.points[i], leafSize));
+        if(it == voxels.end())
+            return false;
+        const pcl::PointXYZRGB &p = a.points[it->second], &q = b.points[i];
+        if((p.getVector3fMap() - q.getVector3fMap()).norm() > 1e-3 * leafSize ||
+                std::abs(p.r - q.r) > 1 || std::abs(p.g - q.g) > 1 || std::abs(p.b - q.b) > 1)
+            return false;
+    }
+    return true;
+}
+
+//Same points with the same coordinates and colors in the same order
+bool samePoints(const pcl::PointCloud<pcl::PointXYZRGB> &a, const pcl::PointCloud<pcl::PointXYZRGB> &b)
+{
+    if(a.size() != b.size())
+        return false;
+    for(size_t i = 0; i < a.size(); i++)
+        if(std::memcmp(a.points[i].data, b.points[i].data, 3 * sizeof(float)) != 0 || a.points[i].rgba != b.points[i].rgba)
+            return false;
+    return true;
+}
+
+//Same points with the same coordinates and colors in any order, the alpha is not compared
+bool samePointSets(const pcl::PointCloud<pcl::PointXYZRGB> &a, const pcl::PointCloud<pcl::PointXYZRGB> &b)
+{
+    if(a.size() != b.size())
+        return false;
+    std::vector<std::tuple<float, float, float, uint32_t> > first, second;
+    for(size_t i = 0; i < a.size(); i++){
+        first.push_back(std::make_tuple(a.points[i].x, a.points[i].y, a.points[i].z, a.points[i].rgba & 0x00ffffffu));
+        second.push_back(std::make_tuple(b.points[i].x, b.points[i].y, b.points[i].z, b.points[i].rgba & 0x00ffffffu));
+    }
+    std::sort(first.begin(), first.end());
+    std::sort(second.begin(), second.end());
+    return first == second;
+}
+}
+
+TDK_FilterBenchmark::TDK_FilterBenchmark() :
+    mv_Cloud(new pcl::PointCloud<pcl::PointXYZRGB>),
+    mv_Cases(mf_AvailableCases()),
+    mv_Repetitions(5)
+{
+
+}
+
+TDK_FilterBenchmark::~TDK_FilterBenchmark()
+{
+
+}
+
+QStringList TDK_FilterBenchmark::mf_AvailableCases()
+{
+    return QStringList() << "CropBox" << "CropBoxDoubleBounds" << "IncrementalPassthrough" << "RadiusOutlierRemoval" << "VoxelGrid" << "MLSSmoothing" << "DepthBilateral" << "OutOfCore";
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_LoadCloud
+ * \param fileName PLY or PCD cloud, invalid points are kept
+ * \return false when the cloud cannot be read or is empty
+ */
+bool TDK_FilterBenchmark::mf_LoadCloud(const QString &fileName)
+{
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const int status = fileName.endsWith(".pcd", Qt::CaseInsensitive) ?
+                pcl::io::loadPCDFile(fileName.toStdString(), *cloud) : pcl::io::loadPLYFile(fileName.toStdString(), *cloud);
+    if(status < 0 || cloud->empty()){
+        qWarning() << "FilterBenchmark: Could not read" << fileName;
+        return false;
+    }
+
+    mv_Cloud = cloud;
+    mv_CloudName = QFileInfo(fileName).fileName();
+    return true;
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_GenerateSyntheticCloud
+ * \param numberOfPoints size of the cloud, a Kinect V2 frame has 217088 points
+ * \param seed random seed, the same seed gives the same cloud
+ *
+ * Points fill the box the Kinect sees up to 4.5 m, one point in ten is invalid like the pixels
+ * without depth of a frame.
+ */
+void TDK_FilterBenchmark::mf_GenerateSyntheticCloud(const int numberOfPoints, const unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> uniform(0.0, 1.0);
+
+    mv_Cloud.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+    mv_Cloud->points.resize(numberOfPoints);
+    for(int i = 0; i < numberOfPoints; i++){
+        pcl::PointXYZRGB &point = mv_Cloud->points[i];
+        if(uniform(generator) < 0.1){
+            point.x = point.y = point.z = std::numeric_limits<float>::quiet_NaN();
+        }
+        else{
+            point.z = 0.5 + 4.0 * uniform(generator);
+            point.x = (2.0 * uniform(generator) - 1.0) * 0.7 * point.z;
+            point.y = (2.0 * uniform(generator) - 1.0) * 0.6 * point.z;
+        }
+        point.r = static_cast<uint8_t>(255 * uniform(generator));
+        point.g = static_cast<uint8_t>(255 * uniform(generator));
+        point.b = static_cast<uint8_t>(255 * uniform(generator));
+    }
+    mv_Cloud->width = numberOfPoints;
+    mv_Cloud->height = 1;
+    mv_Cloud->is_dense = false;
+
+    mv_CloudName = QString("synthetic_%1").arg(numberOfPoints);
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_Run
+ * \return report with one entry per case, reference and optimized median time and whether the
+ * optimized filter matches its reference
+ */
+QJsonObject TDK_FilterBenchmark::mf_Run()
+{
+    QJsonArray cases;
+    for(int i = 0; i < mv_Cases.size(); i++){
+        QJsonObject result;
+        if(mv_Cases[i] == "CropBox")
+            result = mf_RunCropBox();
+        else if(mv_Cases[i] == "CropBoxDoubleBounds")
+            result = mf_RunCropBoxDoubleBounds();
+        else if(mv_Cases[i] == "IncrementalPassthrough")
+            result = mf_RunIncrementalPassthrough();
+        else if(mv_Cases[i] == "RadiusOutlierRemoval")
+            result = mf_RunRadiusOutlierRemoval();
+        else if(mv_Cases[i] == "VoxelGrid")
+            result = mf_RunVoxelGrid();
+        else if(mv_Cases[i] == "MLSSmoothing")
+            result = mf_RunMLSSmoothing();
+        else if(mv_Cases[i] == "DepthBilateral")
+            result = mf_RunDepthBilateral();
+        else if(mv_Cases[i] == "OutOfCore")
+            result = mf_RunOutOfCore();
+        else{
+            qWarning() << "FilterBenchmark: Unknown case" << mv_Cases[i];
+            continue;
+        }
+
+        result["case"] = mv_Cases[i];
+        result["speedup"] = result["optimizedMs"].toDouble() > 0.0 ?
+                    result["referenceMs"].toDouble() / result["optimizedMs"].toDouble() : 0.0;
+        //Exact cases report identical, approximations close
+        result["matchesReference"] = result.contains("close") ? result["close"].toBool() : result["identical"].toBool();
+        qDebug().noquote() << "FilterBenchmark:" << mv_Cases[i] << result["referenceMs"].toDouble() << "ms ->"
+                           << result["optimizedMs"].toDouble() << "ms, matches reference" << result["matchesReference"].toBool();
+        cases.append(result);
+    }
+
+    QJsonObject report;
+    report["cloud"] = mv_CloudName;
+    report["points"] = static_cast<int>(mv_Cloud->size());
+    report["repetitions"] = mv_Repetitions;
+    report["cases"] = cases;
+    return report;
+}
+
+double TDK_FilterBenchmark::mf_MedianMs(const std::function<void()> &run) const
+{
+    std::vector<double> times;
+    for(int r = 0; r < mv_Repetitions; r++){
+        QElapsedTimer timer;
+        timer.start();
+        run();
+        times.push_back(timer.nsecsElapsed() / 1e6);
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_RunCropBox
+ *
+ * Reference are the three pcl::PassThrough passes mf_FilterPassthroughBri ran before, with its
+ * default limits
+ */
+QJsonObject TDK_FilterBenchmark::mf_RunCropBox()
+{
+    const float x1 = -0.4, x2 = 0.4, y1 = -0.85, y2 = 1.2, z1 = 0.1, z2 = 2.0;
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr reference (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double referenceMs = mf_MedianMs([&](){
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr filteredZ (new pcl::PointCloud<pcl::PointXYZRGB>);
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr filteredY (new pcl::PointCloud<pcl::PointXYZRGB>);
+        pcl::PassThrough<pcl::PointXYZRGB> pass;
+        pass.setInputCloud(mv_Cloud);
+        pass.setFilterFieldName("z");
+        pass.setFilterLimits(z1, z2);
+        pass.filter(*filteredZ);
+        pass.setInputCloud(filteredZ);
+        pass.setFilterFieldName("y");
+        pass.setFilterLimits(y1, y2);
+        pass.filter(*filteredY);
+        pass.setInputCloud(filteredY);
+        pass.setFilterFieldName("x");
+        pass.setFilterLimits(x1, x2);
+        pass.filter(*reference);
+    });
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr optimized (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double optimizedMs = mf_MedianMs([&](){
+        TDK_Filters::mf_FilterCropBox(mv_Cloud, optimized, x1, x2, y1, y2, z1, z2);
+    });
+
+    //In place compaction of a copy, the copy is not timed
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr inPlace (new pcl::PointCloud<pcl::PointXYZRGB>(*mv_Cloud));
+    QElapsedTimer timer;
+    timer.start();
+    TDK_Filters::mf_FilterCropBox(inPlace, inPlace, x1, x2, y1, y2, z1, z2);
+    const double inPlaceMs = timer.nsecsElapsed() / 1e6;
+
+    QJsonObject result;
+    result["referenceMs"] = referenceMs;
+    result["optimizedMs"] = optimizedMs;
+    result["inPlaceMs"] = inPlaceMs;
+    result["outputPoints"] = static_cast<int>(optimized->size());
+    result["identical"] = samePoints(*reference, *optimized) && samePoints(*reference, *inPlace);
+    return result;
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_RunCropBoxDoubleBounds
+ *
+ * Bounds as FilterPCPassthrough computes them from its sliders, doubles that no float represents.
+ * Reference is the z, y and x pcl::PassThrough chain FilterPCPassthrough ran with them. Points on
+ * the floats around every bound, those a rounding other than to the nearest float would decide
+ * otherwise, are added to the cloud.
+ */
+QJsonObject TDK_FilterBenchmark::mf_RunCropBoxDoubleBounds()
+{
+    //Sliders at 200 and 220 of 255 over the default limits of mf_FilterPassthroughBri
+    const double limits[6] = { -0.4, 0.4, -0.85, 1.2, 0.1, 2.0 };
+    double bounds[6];
+    for(int a = 0; a < 3; a++){
+        const double range = limits[2 * a + 1] - limits[2 * a];
+        bounds[2 * a] = limits[2 * a + 1] - 200*range/255;
+        bounds[2 * a + 1] = 220*range/255 + limits[2 * a];
+    }
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>(*mv_Cloud));
+    int notRepresentable = 0;
+    for(int b = 0; b < 6; b++){
+        const float nearest = static_cast<float>(bounds[b]);
+        notRepresentable += static_cast<double>(nearest) != bounds[b];
+        const float around[3] = { std::nextafter(nearest, -std::numeric_limits<float>::infinity()), nearest,
+                                  std::nextafter(nearest, std::numeric_limits<float>::infinity()) };
+        for(int k = 0; k < 3; k++){
+            pcl::PointXYZRGB point;
+            for(int a = 0; a < 3; a++)
+                point.data[a] = static_cast<float>((bounds[2 * a] + bounds[2 * a + 1]) / 2);
+            point.data[b / 2] = around[k];
+            point.r = point.g = point.b = 0;
+            cloud->push_back(point);
+        }
+    }
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr reference (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double referenceMs = mf_MedianMs([&](){
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr filteredZ (new pcl::PointCloud<pcl::PointXYZRGB>);
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr filteredY (new pcl::PointCloud<pcl::PointXYZRGB>);
+        pcl::PassThrough<pcl::PointXYZRGB> pass;
+        pass.setInputCloud(cloud);
+        pass.setFilterFieldName("z");
+        pass.setFilterLimits(bounds[4], bounds[5]);
+        pass.filter(*filteredZ);
+        pass.setInputCloud(filteredZ);
+        pass.setFilterFieldName("y");
+        pass.setFilterLimits(bounds[2], bounds[3]);
+        pass.filter(*filteredY);
+        pass.setInputCloud(filteredY);
+        pass.setFilterFieldName("x");
+        pass.setFilterLimits(bounds[0], bounds[1]);
+        pass.filter(*reference);
+    });
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr optimized (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double optimizedMs = mf_MedianMs([&](){
+        TDK_Filters::mf_FilterCropBox(cloud, optimized, bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+    });
+
+    QJsonObject result;
+    result["referenceMs"] = referenceMs;
+    result["optimizedMs"] = optimizedMs;
+    result["notRepresentableBounds"] = notRepresentable;
+    result["outputPoints"] = static_cast<int>(optimized->size());
+    result["identical"] = samePoints(*reference, *optimized);
+    return result;
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_RunIncrementalPassthrough
+ *
+ * Drags the six sliders of FilterPCPassthrough by a few steps at a time, from the full extent
+ * of the cloud inwards and back. Reference crops the whole cloud for every move, the times are
+ * the median of one move. The sort of the incremental filter is reported on its own.
+ */
+QJsonObject TDK_FilterBenchmark::mf_RunIncrementalPassthrough()
+{
+    const int numberOfMoves = 200;
+
+    pcl::PointXYZRGB minimum, maximum;
+    pcl::getMinMax3D(*mv_Cloud, minimum, maximum);
+    const double rangeMinimum[3] = { minimum.x, minimum.y, minimum.z };
+    const double rangeMaximum[3] = { maximum.x, maximum.y, maximum.z };
+
+    QElapsedTimer timer;
+    timer.start();
+    TDK_IncrementalPassthrough passthrough;
+    passthrough.mf_SetInputCloud(mv_Cloud);
+    passthrough.mf_SetSliderRange(rangeMinimum[0], rangeMaximum[0], rangeMinimum[1], rangeMaximum[1], rangeMinimum[2], rangeMaximum[2]);
+    const double setupMs = timer.nsecsElapsed() / 1e6;
+
+    std::mt19937 generator(7);
+    unsigned int lower[3] = { 255, 255, 255 }, upper[3] = { 255, 255, 255 };
+    double bounds[6];
+    std::vector<double> referenceTimes, optimizedTimes;
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr reference (new pcl::PointCloud<pcl::PointXYZRGB>);
+    long long changedPoints = 0;
+
+    for(int m = 0; m < numberOfMoves; m++){
+        //Inwards for the first half, outwards for the second
+        const bool lowerBounds = m % 2 == 0;
+        const int direction = m < numberOfMoves / 2 ? -1 : 1;
+        unsigned int *positions = lowerBounds ? lower : upper;
+        for(int a = 0; a < 3; a++){
+            const int position = static_cast<int>(positions[a]) + direction * static_cast<int>(1 + generator() % 3);
+            positions[a] = static_cast<unsigned int>(std::min(255, std::max(64, position)));
+            bounds[2 * a] = rangeMaximum[a] - lower[a]*(rangeMaximum[a]-rangeMinimum[a])/255;
+            bounds[2 * a + 1] = upper[a]*(rangeMaximum[a]-rangeMinimum[a])/255 + rangeMinimum[a];
+        }
+
+        timer.restart();
+        TDK_Filters::mf_FilterCropBox(mv_Cloud, reference, bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+        referenceTimes.push_back(timer.nsecsElapsed() / 1e6);
+
+        timer.restart();
+        passthrough.mf_SetSliderPositions(lowerBounds, positions[0], positions[1], positions[2]);
+        optimizedTimes.push_back(timer.nsecsElapsed() / 1e6);
+        changedPoints += passthrough.mf_GetNumberOfChangedPoints();
+    }
+
+    std::sort(referenceTimes.begin(), referenceTimes.end());
+    std::sort(optimizedTimes.begin(), optimizedTimes.end());
+
+    pcl::PointCloud<pcl::PointXYZRGB> extracted;
+    passthrough.mf_ExtractFilteredCloud(extracted);
+
+    QJsonObject result;
+    result["referenceMs"] = referenceTimes[referenceTimes.size() / 2];
+    result["optimizedMs"] = optimizedTimes[optimizedTimes.size() / 2];
+    result["setupMs"] = setupMs;
+    result["moves"] = numberOfMoves;
+    result["meanChangedPoints"] = static_cast<double>(changedPoints) / numberOfMoves;
+    result["outputPoints"] = passthrough.mf_GetNumberOfFilteredPoints();
+    result["identical"] = samePoints(*reference, extracted) &&
+            passthrough.mf_GetNumberOfFilteredPoints() == static_cast<int>(reference->size());
+    return result;
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_RunRadiusOutlierRemoval
+ *
+ * Reference is pcl::RadiusOutlierRemoval with its kd-tree, on the valid points of the cloud as the
+ * kd-tree takes no invalid queries. The filter on the cells alone is timed on its own, it keeps
+ * every point the exact filter keeps.
+ */
+QJsonObject TDK_FilterBenchmark::mf_RunRadiusOutlierRemoval()
+{
+    const float radius = 0.02;
+    const int minNeighbors = 5;
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>);
+    for(size_t i = 0; i < mv_Cloud->size(); i++)
+        if(pcl::isFinite(mv_Cloud->points[i]))
+            cloud->points.push_back(mv_Cloud->points[i]);
+    cloud->width = static_cast<uint32_t>(cloud->size());
+    cloud->height = 1;
+    cloud->is_dense = true;
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr reference (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double referenceMs = mf_MedianMs([&](){
+        pcl::RadiusOutlierRemoval<pcl::PointXYZRGB> outlierRemoval;
+        outlierRemoval.setInputCloud(cloud);
+        outlierRemoval.setRadiusSearch(radius);
+        outlierRemoval.setMinNeighborsInRadius(minNeighbors);
+        outlierRemoval.filter(*reference);
+    });
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr optimized (new pcl::PointCloud<pcl::PointXYZRGB>);
+    TDK_Filters::RadiusOutlierStats stats;
+    const double optimizedMs = mf_MedianMs([&](){
+        TDK_Filters::mf_FilterRadiusOutlierRemoval(cloud, optimized, radius, minNeighbors, true, &stats);
+    });
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cells (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double cellsMs = mf_MedianMs([&](){
+        TDK_Filters::mf_FilterRadiusOutlierRemoval(cloud, cells, radius, minNeighbors, false);
+    });
+
+    QJsonObject result;
+    result["referenceMs"] = referenceMs;
+    result["optimizedMs"] = optimizedMs;
+    result["cellsOnlyMs"] = cellsMs;
+    result["inputPoints"] = static_cast<int>(cloud->size());
+    result["outputPoints"] = static_cast<int>(optimized->size());
+    result["cellsOnlyOutputPoints"] = static_cast<int>(cells->size());
+    result["decidedByCells"] = stats.decidedByCells;
+    result["identical"] = samePoints(*reference, *optimized) && cells->size() >= optimized->size();
+    return result;
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_RunVoxelGrid
+ *
+ * Reference is pcl::VoxelGrid with a leaf it accepts for the extent of the benchmark cloud. The
+ * hash voxel grid is also timed with the 0.002 leaf of Register, which pcl::VoxelGrid refuses on
+ * large clouds, and with the nearest input point of every voxel as output.
+ */
+QJsonObject TDK_FilterBenchmark::mf_RunVoxelGrid()
+{
+    const float leafSize = 0.01, registrationLeafSize = 0.002;
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr reference (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double referenceMs = mf_MedianMs([&](){
+        pcl::VoxelGrid<pcl::PointXYZRGB> grid;
+        grid.setInputCloud(mv_Cloud);
+        grid.setLeafSize(leafSize, leafSize, leafSize);
+        grid.filter(*reference);
+    });
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr optimized (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double optimizedMs = mf_MedianMs([&](){
+        TDK_Filters::mf_FilterVoxelGridDownsample(mv_Cloud, optimized, leafSize);
+    });
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr nearest (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double nearestMs = mf_MedianMs([&](){
+        TDK_Filters::mf_FilterVoxelGridDownsample(mv_Cloud, nearest, leafSize, true);
+    });
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr registration (new pcl::PointCloud<pcl::PointXYZRGB>);
+    const double registrationLeafMs = mf_MedianMs([&](){
+        TDK_Filters::mf_FilterVoxelGridDownsample(mv_Cloud, registration, registrationLeafSize);
+    });
+
+    //Every nearest point lies in the voxel of its centroid
+    bool nearestInVoxel = nearest->size() == optimized->size();
+    for(size_t i = 0; nearestInVoxel && i < nearest->size(); i++)
+        nearestInVoxel = voxelOf(nearest->points[i], leafSize) == voxelOf(optimized->points[i], leafSize);
+
+    QJsonObject result;
+    result["referenceMs"] = referenceMs;
+    result["optimizedMs"] = optimizedMs;
+    result["nearestMs"] = nearestMs;
+    result["registrationLeafMs"] = registrationLeafMs;
+    result["outputPoints"] = static_cast<int>(optimized->size());
+    result["registrationLeafPoints"] = static_cast<int>(registration->size());
+    result["identical"] = sameVoxels(*reference, *optimized, leafSize) && nearestInVoxel;
+    return result;
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_RunMLSSmoothing
+ *
+ * Reference is the single pcl::MovingLeastSquares mf_FilterMLSSmoothing ran before, with the radius
+ * of TDK_Meshing, on the first 200000 valid points of the cloud. The tiled smoothing is timed with
+ * its tiles built on every run and with a tiling built once, as for several smoothings of the
+ * same cloud. Both have to give the points of the reference bit for bit.
+ */
+QJsonObject TDK_FilterBenchmark::mf_RunMLSSmoothing()
+{
+    const float searchRadius = 0.07;
+    const size_t maximumPoints = 200000;
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>);
+    for(size_t i = 0; i < mv_Cloud->size() && cloud->size() < maximumPoints; i++)
+        if(pcl::isFinite(mv_Cloud->points[i]))
+            cloud->points.push_back(pcl::PointXYZ(mv_Cloud->points[i].x, mv_Cloud->points[i].y, mv_Cloud->points[i].z));
+    cloud->width = static_cast<uint32_t>(cloud->size());
+    cloud->height = 1;
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr reference (new pcl::PointCloud<pcl::PointXYZ>);
+    const double referenceMs = mf_MedianMs([&](){
+        pcl::search::KdTree<pcl::PointXYZ>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZ>);
+        pcl::PointCloud<pcl::PointNormal> mlsPoints;
+        pcl::MovingLeastSquares<pcl::PointXYZ, pcl::PointNormal> mls;
+        mls.setComputeNormals(true);
+        mls.setInputCloud(cloud);
+        mls.setPolynomialFit(true);
+        mls.setSearchMethod(tree);
+        mls.setSearchRadius(searchRadius);
+        mls.process(mlsPoints);
+        pcl::copyPointCloud(mlsPoints, *reference);
+    });
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr optimized (new pcl::PointCloud<pcl::PointXYZ>);
+    const double optimizedMs = mf_MedianMs([&](){
+        TDK_Filters::mf_FilterMLSSmoothing(cloud, optimized, searchRadius);
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    TDK_Filters::MLSTiling tiling;
+    TDK_Filters::mf_BuildMLSTiling(cloud, tiling);
+    const double tilingMs = timer.nsecsElapsed() / 1e6;
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr reused (new pcl::PointCloud<pcl::PointXYZ>);
+    std::vector<TDK_Filters::MLSTileTiming> timings;
+    const double reusedMs = mf_MedianMs([&](){
+        TDK_Filters::mf_FilterMLSSmoothing(cloud, reused, searchRadius, &tiling, &timings);
+    });
+
+    double slowestTileMs = 0.0;
+    int largestTilePoints = 0;
+    for(size_t t = 0; t < timings.size(); t++){
+        slowestTileMs = std::max(slowestTileMs, timings[t].ms);
+        largestTilePoints = std::max(largestTilePoints, timings[t].points);
+    }
+
+    bool identical = reference->size() == optimized->size() && reference->size() == reused->size();
+    for(size_t i = 0; identical && i < reference->size(); i++)
+        identical = std::memcmp(reference->points[i].data, optimized->points[i].data, 3 * sizeof(float)) == 0 &&
+                std::memcmp(reference->points[i].data, reused->points[i].data, 3 * sizeof(float)) == 0;
+
+    QJsonObject result;
+    result["referenceMs"] = referenceMs;
+    result["optimizedMs"] = optimizedMs;
+    result["tilingMs"] = tilingMs;
+    result["reusedTilingMs"] = reusedMs;
+    result["tiles"] = static_cast<int>(timings.size());
+    result["slowestTileMs"] = slowestTileMs;
+    result["largestTilePoints"] = largestTilePoints;
+    result["inputPoints"] = static_cast<int>(cloud->size());
+    result["outputPoints"] = static_cast<int>(optimized->size());
+    result["identical"] = identical;
+    return result;
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_RunDepthBilateral
+ *
+ * Smooths a synthetic 512x424 Kinect V2 depth frame, independent of the cloud: a tilted disc at
+ * 1.5 m in front of a wall at 2.8 m, depth noise of 0.3 % and one pixel in fifty without depth.
+ * The disc is bright and the wall dark in the guide. Reference is the full bilateral kernel, the
+ * separable filter is close when its mean difference stays below a millimeter. Depths between the
+ * disc and the wall would be flying pixels.
+ */
+QJsonObject TDK_FilterBenchmark::mf_RunDepthBilateral()
+{
+    const int width = 512, height = 424;
+    std::vector<uint16_t> truth(width * height), depth(width * height), reference(width * height), optimized(width * height);
+    std::vector<uint8_t> guide(width * height);
+
+    std::mt19937 generator(3);
+    std::normal_distribution<float> noise(0.0, 1.0);
+    for(int y = 0; y < height; y++)
+        for(int x = 0; x < width; x++){
+            const int i = y * width + x;
+            const bool disc = (x - 256) * (x - 256) + (y - 212) * (y - 212) < 120 * 120;
+            const float z = disc ? 1500.0f + 0.5f * (x - 256) : 2800.0f;
+            truth[i] = static_cast<uint16_t>(z);
+            guide[i] = disc ? 200 : 60;
+            depth[i] = generator() % 50 == 0 ? 0 : static_cast<uint16_t>(z + 0.003f * z * noise(generator));
+        }
+
+    TDK_DepthBilateralFilter filter;
+    filter.mf_SetSeparable(false);
+    const double referenceMs = mf_MedianMs([&](){
+        filter.mf_Filter(&depth[0], &reference[0], width, height, &guide[0]);
+    });
+
+    filter.mf_SetSeparable(true);
+    const double optimizedMs = mf_MedianMs([&](){
+        filter.mf_Filter(&depth[0], &optimized[0], width, height, &guide[0]);
+    });
+
+    double inputError = 0.0, outputError = 0.0, difference = 0.0;
+    int validPixels = 0, flyingPixels = 0;
+    for(int i = 0; i < width * height; i++){
+        if(depth[i] == 0){
+            flyingPixels += optimized[i] != 0;
+            continue;
+        }
+        validPixels++;
+        inputError += std::abs(static_cast<float>(depth[i]) - truth[i]);
+        outputError += std::abs(static_cast<float>(optimized[i]) - truth[i]);
+        difference += std::abs(static_cast<float>(optimized[i]) - reference[i]);
+        flyingPixels += optimized[i] > 1800 && optimized[i] < 2600;
+    }
+
+    QJsonObject result;
+    result["referenceMs"] = referenceMs;
+    result["optimizedMs"] = optimizedMs;
+    result["inputErrorMm"] = inputError / validPixels;
+    result["outputErrorMm"] = outputError / validPixels;
+    result["meanDifferenceMm"] = difference / validPixels;
+    result["flyingPixels"] = flyingPixels;
+    //Not identical, the separable kernel only approximates the full one
+    result["close"] = difference / validPixels < 1.0 && flyingPixels == 0;
+    return result;
+}
+
+/*!
+ * \brief TDK_FilterBenchmark::mf_RunOutOfCore
+ *
+ * Filters the cloud file to file with TDK_OutOfCoreFilter, a quarter of the cloud in memory, in
+ * four runs: crop alone, then crop with the voxel grid, the statistical and the radius outlier
+ * removal. Reference are the same filters of TDK_Filters on the whole cloud in memory. The out of
+ * core filter writes the points block by block, so the points are compared in any order. Clouds of
+ * a million points and more are split into several blocks.
+ */
+QJsonObject TDK_FilterBenchmark::mf_RunOutOfCore()
+{
+    const float x1 = -3.0, x2 = 3.0, y1 = -2.5, y2 = 2.5, z1 = 0.5, z2 = 4.0;
+    const float leafSize = 0.01, radius = 0.05, halo = 0.15;
+    const int minNeighbors = 5;
+    const int maxPointsInMemory = std::max(1, static_cast<int>(mv_Cloud->size() / 4));
+
+    QJsonObject result;
+    QTemporaryDir temporary;
+    const QString inputFileName = QDir(temporary.path()).filePath("input.pcd");
+    const QString outputFileName = QDir(temporary.path()).filePath("output.pcd");
+    if(!temporary.isValid() || pcl::io::savePCDFileBinary(inputFileName.toStdString(), *mv_Cloud) < 0){
+        qWarning() << "FilterBenchmark: Could not write the cloud to a temporary file";
+        result["identical"] = false;
+        return result;
+    }
+
+    enum Stage { CropOnly, VoxelGrid, StatisticalOutlierRemoval, RadiusOutlierRemoval };
+    const char *stageNames[4] = { "crop", "voxelGrid", "statisticalOutlierRemoval", "radiusOutlierRemoval" };
+    double referenceMs = 0.0, optimizedMs = 0.0;
+    bool identical = true;
+
+    for(int stage = CropOnly; stage <= RadiusOutlierRemoval; stage++){
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr reference (new pcl::PointCloud<pcl::PointXYZRGB>);
+        referenceMs += mf_MedianMs([&](){
+            TDK_Filters::mf_FilterCropBox(mv_Cloud, reference, x1, x2, y1, y2, z1, z2);
+            if(stage == VoxelGrid)
+                TDK_Filters::mf_FilterVoxelGridDownsample(reference, reference, leafSize);
+            else if(stage == StatisticalOutlierRemoval)
+                TDK_Filters::mf_FilterStatisticalOutlierRemoval(reference, reference);
+            else if(stage == RadiusOutlierRemoval)
+                TDK_Filters::mf_FilterRadiusOutlierRemoval(reference, reference, radius, minNeighbors);
+        });
+
+        TDK_OutOfCoreFilter filter;
+        filter.mf_SetMaxPointsInMemory(maxPointsInMemory);
+        filter.mf_SetTemporaryDirectory(temporary.path());
+        filter.mf_AddCropBox(x1, x2, y1, y2, z1, z2);
+        if(stage == VoxelGrid)
+            filter.mf_SetVoxelGrid(leafSize);
+        else if(stage == StatisticalOutlierRemoval){
+            filter.mf_SetOutlierRemoval();
+            filter.mf_SetHalo(halo);
+        }
+        else if(stage == RadiusOutlierRemoval)
+            filter.mf_SetRadiusOutlierRemoval(radius, minNeighbors);
+
+        bool processed = true;
+        optimizedMs += mf_MedianMs([&](){
+            processed = filter.mf_Process(inputFileName, outputFileName) && processed;
+        });
+
+        pcl::PointCloud<pcl::PointXYZRGB> optimized;
+        const bool same = processed && pcl::io::loadPCDFile(outputFileName.toStdString(), optimized) >= 0 &&
+                (stage == VoxelGrid ? sameVoxels(*reference, optimized, leafSize) : samePointSets(*reference, optimized));
+        identical = identical && same;
+
+        QJsonObject stageResult = filter.mf_GetReport();
+        stageResult["referencePoints"] = static_cast<int>(reference->size());
+        stageResult["identical"] = same;
+        result[stageNames[stage]] = stageResult;
+    }
+
+    result["referenceMs"] = referenceMs;
+    result["optimizedMs"] = optimizedMs;
+    result["maxPointsInMemory"] = maxPointsInMemory;
+    result["identical"] = identical;
+    return result;
+}
@@ -0,0 +1,62 @@
+#ifndef TDK_FILTERBENCHMARK_H
+#define TDK_FILTERBENCHMARK_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <algorithm>
+#include <functional>
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+/*!
+ * \brief The TDK_FilterBenchmark class
+ *
+ * Times the filters of TDK_Filters against the PCL pipelines they replace on the same cloud and
+ * checks that both give the same points. Every case runs a number of times, the median time is
+ * reported. The out of core case compares the file to file filter with the in-memory filters.
+ *
+ * The cloud is a PLY/PCD file or a synthetic Kinect frame sized cloud, a box of random points
+ * in front of the camera with invalid points mixed in.
+ *
+ * Use example
+ * TDK_FilterBenchmark benchmark;
+ * benchmark.mf_GenerateSyntheticCloud(2000000);
+ * QJsonObject report = benchmark.mf_Run();
+ */
+class TDK_FilterBenchmark
+{
+public:
+    TDK_FilterBenchmark();
+    ~TDK_FilterBenchmark();
+
+    static QStringList  mf_AvailableCases   ();
+
+    bool    mf_LoadCloud                    (const QString &fileName);
+    void    mf_GenerateSyntheticCloud       (const int numberOfPoints, const unsigned int seed = 1);
+
+    void    mf_SetCases                     (const QStringList &cases)     {   mv_Cases = cases;   }
+    void    mf_SetRepetitions               (const int repetitions)        {   mv_Repetitions = std::max(1, repetitions);  }
+
+    QJsonObject mf_Run                      ();
+
+private:
+    QString                                 mv_CloudName;
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr  mv_Cloud;
+    QStringList                             mv_Cases;
+    int                                     mv_Repetitions;
+
+    double      mf_MedianMs                 (const std::function<void()> &run) const;
+
+    QJsonObject mf_RunCropBox               ();
+    QJsonObject mf_RunCropBoxDoubleBounds   ();
+    QJsonObject mf_RunIncrementalPassthrough    ();
+    QJsonObject mf_RunRadiusOutlierRemoval  ();
+    QJsonObject mf_RunVoxelGrid             ();
+    QJsonObject mf_RunMLSSmoothing          ();
+    QJsonObject mf_RunDepthBilateral        ();
+    QJsonObject mf_RunOutOfCore             ();
+};
+
+#endif // TDK_FILTERBENCHMARK_H
@@ -0,0 +1,116 @@
+// Disable Error C4996 that occur when using Boost.Signals2.
+#ifdef _DEBUG
+#define _SCL_SECURE_NO_WARNINGS
+#endif
+
+#include "tdk_registrationbenchmark.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QTextStream>
+
+/*
+ * Usage examples
+ * registration_benchmark --synthetic --views 12 --step 30 --output report.json
+ * registration_benchmark --dataset ../ScanRegistrationDev --modes ICP,ICPNormal
+ * registration_benchmark --synthetic --baseline previous_report.json
+ *
+ * Exits with 1 when the dataset cannot be loaded or a mode regressed against the baseline.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("registration_benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark of the 3D-KORN registration modes");
+    parser.addHelpOption();
+
+    QCommandLineOption datasetOption("dataset", "Folder with PLY/PCD views and an optional poses.txt.", "folder");
+    QCommandLineOption syntheticOption("synthetic", "Use a synthetic turntable scan with known poses (default).");
+    QCommandLineOption viewsOption("views", "Number of synthetic views.", "count", "12");
+    QCommandLineOption stepOption("step", "Turntable step between synthetic views in degrees.", "degrees", "30");
+    QCommandLineOption noiseOption("noise", "Synthetic depth noise at one meter in meters.", "meters", "0.001");
+    QCommandLineOption seedOption("seed", "Seed of the synthetic dataset.", "seed", "1");
+    QCommandLineOption modesOption("modes", "Comma separated registration modes: " +
+                                   TDK_RegistrationBenchmark::mf_AvailableModes().join(",") + ".", "modes");
+    QCommandLineOption perturbationDegOption("perturbation-deg", "Rotation error of the initial guess in degrees.", "degrees", "3");
+    QCommandLineOption perturbationMOption("perturbation-m", "Translation error of the initial guess in meters.", "meters", "0.01");
+    QCommandLineOption inlierOption("inlier-distance", "Inlier distance for the fitness in meters.", "meters", "0.005");
+    QCommandLineOption outputOption("output", "Write the JSON report to this file instead of the standard output.", "file");
+    QCommandLineOption baselineOption("baseline", "Compare with the JSON report of a previous build.", "file");
+    QCommandLineOption toleranceOption("time-tolerance", "Allowed relative increase of the mean time per pair.", "ratio", "0.2");
+
+    parser.addOption(datasetOption);
+    parser.addOption(syntheticOption);
+    parser.addOption(viewsOption);
+    parser.addOption(stepOption);
+    parser.addOption(noiseOption);
+    parser.addOption(seedOption);
+    parser.addOption(modesOption);
+    parser.addOption(perturbationDegOption);
+    parser.addOption(perturbationMOption);
+    parser.addOption(inlierOption);
+    parser.addOption(outputOption);
+    parser.addOption(baselineOption);
+    parser.addOption(toleranceOption);
+    parser.process(app);
+
+    TDK_RegistrationBenchmark benchmark;
+
+    if(parser.isSet(datasetOption) && !parser.isSet(syntheticOption)){
+        if(!benchmark.mf_LoadDataset(parser.value(datasetOption))){
+            qCritical() << "Could not load at least two views from" << parser.value(datasetOption);
+            return 1;
+        }
+    }
+    else{
+        benchmark.mf_GenerateSyntheticDataset(parser.value(viewsOption).toInt(),
+                                              parser.value(stepOption).toFloat(),
+                                              parser.value(noiseOption).toFloat(),
+                                              parser.value(seedOption).toUInt());
+    }
+
+    if(parser.isSet(modesOption))
+        benchmark.mf_SetModes(parser.value(modesOption).split(',', QString::SkipEmptyParts));
+    benchmark.mf_SetInitialPerturbation(parser.value(perturbationDegOption).toFloat(),
+                                        parser.value(perturbationMOption).toFloat());
+    benchmark.mf_SetInlierDistance(parser.value(inlierOption).toFloat());
+
+    QJsonObject report = benchmark.mf_Run();
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if(parser.isSet(outputOption)){
+        QFile file(parser.value(outputOption));
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Text)){
+            qCritical() << "Could not write" << parser.value(outputOption);
+            return 1;
+        }
+        file.write(json);
+    }
+    else{
+        QTextStream(stdout) << json;
+    }
+
+    if(parser.isSet(baselineOption)){
+        QFile file(parser.value(baselineOption));
+        if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+            qCritical() << "Could not read" << parser.value(baselineOption);
+            return 1;
+        }
+
+        QStringList regressions;
+        if(!TDK_RegistrationBenchmark::mf_CompareWithBaseline(report, QJsonDocument::fromJson(file.readAll()).object(),
+                                                              parser.value(toleranceOption).toDouble(), regressions)){
+            for(int i = 0; i < regressions.size(); i++)
+                qCritical().noquote() << "Regression:" << regressions[i];
+            return 1;
+        }
+        qDebug() << "No regression against" << parser.value(baselineOption);
+    }
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+#-------------------------------------------------
+#
+# Benchmark of the 3D-KORN registration modes
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = registration_benchmark
+TEMPLATE = app
+
+KORN_DIR = $$PWD/../3D-KORN
+
+include($$KORN_DIR/dependencies.pri)
+
+INCLUDEPATH += $$KORN_DIR
+
+# Peak memory of the process
+LIBS += psapi.lib
+
+SOURCES += main.cpp \
+    tdk_registrationbenchmark.cpp \
+    $$KORN_DIR/tdk_scanregistration.cpp \
+    $$KORN_DIR/tdk_2dfeaturedetection.cpp \
+    $$KORN_DIR/tdk_filters.cpp \
+    $$KORN_DIR/tdk_posegraph.cpp \
+    $$KORN_DIR/tdk_voxelaccumulator.cpp
+
+HEADERS += \
+    tdk_registrationbenchmark.h \
+    $$KORN_DIR/tdk_kinectv2intrinsics.h \
+    $$KORN_DIR/tdk_scanregistration.h \
+    $$KORN_DIR/tdk_2dfeaturedetection.h \
+    $$KORN_DIR/tdk_filters.h \
+    $$KORN_DIR/tdk_posegraph.h \
+    $$KORN_DIR/tdk_voxelaccumulator.h
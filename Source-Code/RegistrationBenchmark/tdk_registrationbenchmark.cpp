@@ -0,0 +1,538 @@
+#include "tdk_registrationbenchmark.h"
+#include "tdk_filters.h"
+#include "tdk_scanregistration.h"
+
+#include <pcl/filters/filter.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include <QCollator>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+TDK_RegistrationBenchmark::TDK_RegistrationBenchmark() :
+    mv_HasGroundTruth(false),
+    mv_Modes(mf_AvailableModes()),
+    mv_InlierDistance(0.005),
+    mv_VoxelGridLeafSize(0.002)
+{
+    //Error left by the turntable initial guess in practice
+    mf_SetInitialPerturbation(3.0, 0.01);
+}
+
+TDK_RegistrationBenchmark::~TDK_RegistrationBenchmark()
+{
+
+}
+
+QStringList TDK_RegistrationBenchmark::mf_AvailableModes()
+{
+    return QStringList() << "ICP" << "ICPNormal" << "ICPProjective" << "GICP" << "ColoredICP" << "FPFH+ICPNormal";
+}
+
+/*!
+ * \brief TDK_RegistrationBenchmark::mf_SetInitialPerturbation
+ * \param degrees rotation added to the ground truth initial guess
+ * \param meters translation added to the ground truth initial guess
+ *
+ * Pairs with ground truth start from the true relative pose composed with this fixed error,
+ * pairs without ground truth start from identity. The global pre-alignment mode ignores it.
+ */
+void TDK_RegistrationBenchmark::mf_SetInitialPerturbation(const float degrees, const float meters)
+{
+    mv_PerturbationDegrees = degrees;
+    mv_PerturbationMeters = meters;
+
+    Eigen::Transform<float,3,Eigen::Affine> perturbation =
+            Eigen::Translation3f(meters * Eigen::Vector3f(1.0, -1.0, 1.0).normalized()) *
+            Eigen::AngleAxisf(degrees * (M_PI/180.0), Eigen::Vector3f(0.3, 1.0, 0.2).normalized());
+    mv_Perturbation = perturbation.matrix();
+}
+
+/*!
+ * \brief TDK_RegistrationBenchmark::mf_LoadDataset
+ * \param directory folder with the PLY/PCD views, sorted by name, and an optional poses.txt
+ * \return false when the folder does not hold at least two readable views
+ */
+bool TDK_RegistrationBenchmark::mf_LoadDataset(const QString &directory)
+{
+    QDir dir(directory);
+    if(!dir.exists()){
+        qWarning() << "RegistrationBenchmark: Dataset folder" << directory << "does not exist";
+        return false;
+    }
+
+    QStringList files = dir.entryList(QStringList() << "*.pcd" << "*.ply", QDir::Files);
+    QCollator collator;
+    collator.setNumericMode(true);
+    std::sort(files.begin(), files.end(), collator);
+
+    //Ground truth poses, view frame to model frame
+    QStringList poseNames;
+    std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > poses;
+    QFile posesFile(dir.filePath("poses.txt"));
+    if(posesFile.open(QIODevice::ReadOnly | QIODevice::Text)){
+        QTextStream stream(&posesFile);
+        while(!stream.atEnd()){
+            QStringList fields = stream.readLine().simplified().split(' ', QString::SkipEmptyParts);
+            if(fields.size() != 17 || fields[0].startsWith('#'))
+                continue;
+
+            Eigen::Matrix4f pose;
+            for(int k = 0; k < 16; k++)
+                pose(k / 4, k % 4) = fields[k + 1].toFloat();
+            poseNames << fields[0];
+            poses.push_back(pose);
+        }
+    }
+
+    mv_Views.clear();
+    mv_Poses.clear();
+    mv_HasGroundTruth = true;
+
+    for(int i = 0; i < files.size(); i++){
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>);
+        const std::string path = dir.filePath(files[i]).toStdString();
+        const int status = files[i].endsWith(".pcd", Qt::CaseInsensitive) ?
+                    pcl::io::loadPCDFile(path, *cloud) : pcl::io::loadPLYFile(path, *cloud);
+        if(status < 0 || cloud->empty()){
+            qWarning() << "RegistrationBenchmark: Could not read" << files[i];
+            continue;
+        }
+
+        std::vector<int> indices;
+        cloud->is_dense = false;
+        pcl::removeNaNFromPointCloud(*cloud, *cloud, indices);
+        mv_Views.push_back(cloud);
+
+        const int poseIndex = poseNames.indexOf(files[i]);
+        if(poseIndex >= 0)
+            mv_Poses.push_back(poses[poseIndex]);
+        else{
+            mv_Poses.push_back(Eigen::Matrix4f::Identity());
+            mv_HasGroundTruth = false;
+        }
+    }
+
+    mv_DatasetName = dir.dirName();
+    qDebug() << "RegistrationBenchmark: Loaded" << mv_Views.size() << "views from" << directory
+             << (mv_HasGroundTruth ? "with" : "without") << "ground truth";
+
+    return mv_Views.size() > 1;
+}
+
+/*!
+ * \brief TDK_RegistrationBenchmark::mf_GenerateSyntheticDataset
+ * \param numberOfViews number of views around the object
+ * \param stepAngle turntable rotation in degrees between two views
+ * \param noise standard deviation in meters of the depth noise at one meter, grows with depth squared
+ * \param seed random seed, the same seed gives the same dataset
+ *
+ * Samples a box with a cylinder and a sphere on top placed 1.2 m in front of the camera, colored
+ * with a smooth pattern. Every view rotates it around the vertical axis through its center and
+ * keeps the surface facing the camera. Self occlusions are not simulated.
+ */
+void TDK_RegistrationBenchmark::mf_GenerateSyntheticDataset(const int numberOfViews, const float stepAngle,
+                                                            const float noise, const unsigned int seed)
+{
+    mv_DatasetName = QString("synthetic_%1x%2deg").arg(numberOfViews).arg(stepAngle);
+    mv_Views.clear();
+    mv_Poses.clear();
+    mv_HasGroundTruth = true;
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> uniform(0.0, 1.0);
+    std::normal_distribution<float> gaussian(0.0, 1.0);
+
+    //Points per square meter, one about every 2 mm
+    const float density = 250000.0;
+    const Eigen::Vector3f center(0.0, 0.0, 1.2);
+
+    pcl::PointCloud<pcl::PointXYZRGBNormal> model;
+    auto addPoint = [&model](const Eigen::Vector3f &position, const Eigen::Vector3f &normal)
+    {
+        pcl::PointXYZRGBNormal point;
+        point.getVector3fMap() = position;
+        point.getNormalVector3fMap() = normal;
+        point.r = static_cast<uint8_t>(128 + 127 * std::sin(40.0 * position.x()));
+        point.g = static_cast<uint8_t>(128 + 127 * std::sin(40.0 * position.y()));
+        point.b = static_cast<uint8_t>(128 + 127 * std::cos(40.0 * position.z()));
+        model.push_back(point);
+    };
+
+    //Box, one face at a time
+    const Eigen::Vector3f boxCenter = center + Eigen::Vector3f(0.0, 0.05, 0.0);
+    const Eigen::Vector3f boxHalfSize(0.15, 0.1, 0.1);
+    for(int a = 0; a < 3; a++){
+        const int b = (a + 1) % 3;
+        const int c = (a + 2) % 3;
+        const int samples = static_cast<int>(4.0 * boxHalfSize(b) * boxHalfSize(c) * density);
+
+        for(int side = -1; side <= 1; side += 2){
+            const Eigen::Vector3f normal = static_cast<float>(side) * Eigen::Vector3f::Unit(a);
+            for(int i = 0; i < samples; i++){
+                Eigen::Vector3f position = boxCenter + side * boxHalfSize(a) * Eigen::Vector3f::Unit(a);
+                position(b) += (2.0 * uniform(generator) - 1.0) * boxHalfSize(b);
+                position(c) += (2.0 * uniform(generator) - 1.0) * boxHalfSize(c);
+                addPoint(position, normal);
+            }
+        }
+    }
+
+    //Cylinder standing on the box, the Y axis of the camera points down
+    const Eigen::Vector3f cylinderBase = boxCenter + Eigen::Vector3f(0.06, -boxHalfSize.y(), 0.02);
+    const float cylinderRadius = 0.05;
+    const float cylinderHeight = 0.2;
+    const int cylinderSamples = static_cast<int>(2.0 * M_PI * cylinderRadius * cylinderHeight * density);
+    for(int i = 0; i < cylinderSamples; i++){
+        const float angle = 2.0 * M_PI * uniform(generator);
+        const Eigen::Vector3f normal(std::cos(angle), 0.0, std::sin(angle));
+        addPoint(cylinderBase + cylinderRadius * normal - cylinderHeight * uniform(generator) * Eigen::Vector3f::UnitY(), normal);
+    }
+
+    //Sphere resting on the box
+    const float sphereRadius = 0.06;
+    const Eigen::Vector3f sphereCenter = boxCenter + Eigen::Vector3f(-0.08, -boxHalfSize.y() - sphereRadius, -0.03);
+    const int sphereSamples = static_cast<int>(4.0 * M_PI * sphereRadius * sphereRadius * density);
+    for(int i = 0; i < sphereSamples; i++){
+        const Eigen::Vector3f normal = Eigen::Vector3f(gaussian(generator), gaussian(generator), gaussian(generator)).normalized();
+        addPoint(sphereCenter + sphereRadius * normal, normal);
+    }
+
+    for(int view = 0; view < numberOfViews; view++){
+        const Eigen::Transform<float,3,Eigen::Affine> rotation =
+                Eigen::Translation3f(center) *
+                Eigen::AngleAxisf(view * stepAngle * (M_PI/180.0), Eigen::Vector3f::UnitY()) *
+                Eigen::Translation3f(-center);
+
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZRGB>);
+        for(size_t i = 0; i < model.size(); i++){
+            const Eigen::Vector3f position = rotation * model[i].getVector3fMap();
+            const Eigen::Vector3f normal = rotation.linear() * model[i].getNormalVector3fMap();
+
+            //Camera sits at the origin, keep the surface facing it
+            if(normal.dot(-position) <= 0.0)
+                continue;
+
+            const float depthNoise = noise * position.z() * position.z() * gaussian(generator);
+
+            pcl::PointXYZRGB point;
+            point.getVector3fMap() = position + depthNoise * position.normalized();
+            point.rgb = model[i].rgb;
+            cloud->push_back(point);
+        }
+
+        mv_Views.push_back(cloud);
+        mv_Poses.push_back(rotation.inverse().matrix());
+    }
+
+    qDebug() << "RegistrationBenchmark: Generated" << numberOfViews << "synthetic views of"
+             << model.size() << "model points";
+}
+
+/*!
+ * \brief TDK_RegistrationBenchmark::mf_Run
+ * \return report with one entry per mode, every pair and a summary of each mode
+ *
+ * Views are voxel downsampled once before registration, the same input the registration
+ * of the scan window gets. Only the registration call itself is timed.
+ */
+QJsonObject TDK_RegistrationBenchmark::mf_Run()
+{
+    const int numberOfViews = static_cast<int>(mv_Views.size());
+
+    std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> downsampled(numberOfViews);
+    for(int i = 0; i < numberOfViews; i++){
+        downsampled[i].reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+        TDK_Filters::mf_FilterVoxelGridDownsample(mv_Views[i], downsampled[i], mv_VoxelGridLeafSize);
+    }
+
+    QJsonObject report;
+    report["dataset"] = mv_DatasetName;
+    report["views"] = numberOfViews;
+    report["groundTruth"] = mv_HasGroundTruth;
+    report["initialPerturbationDeg"] = mv_PerturbationDegrees;
+    report["initialPerturbationM"] = mv_PerturbationMeters;
+    report["inlierDistanceM"] = mv_InlierDistance;
+    report["voxelGridLeafSize"] = mv_VoxelGridLeafSize;
+
+    QJsonArray modes;
+    for(int m = 0; m < mv_Modes.size(); m++){
+        const QString &mode = mv_Modes[m];
+        if(!mf_AvailableModes().contains(mode)){
+            qWarning() << "RegistrationBenchmark: Unknown mode" << mode;
+            continue;
+        }
+
+        //One registration object per mode, descriptors and covariances are cached across the pairs of a mode only
+        TDK_ScanRegistration registration;
+
+        QJsonArray pairs;
+        double totalTime = 0.0, totalIterations = 0.0, totalFitness = 0.0;
+        double totalRotationError = 0.0, maxRotationError = 0.0;
+        double totalTranslationError = 0.0, maxTranslationError = 0.0;
+
+        for(int i = 1; i < numberOfViews; i++){
+            PairResult result = mf_RunPair(registration, mode, i, i - 1, downsampled[i], downsampled[i - 1]);
+
+            QJsonObject pair;
+            pair["source"] = result.source;
+            pair["target"] = result.target;
+            pair["timeMs"] = result.timeMs;
+            pair["iterations"] = result.iterations;
+            pair["fitness"] = result.fitness;
+            pair["rmseM"] = result.rmse;
+            pair["rotationErrorDeg"] = result.hasGroundTruth ? QJsonValue(result.rotationError) : QJsonValue();
+            pair["translationErrorM"] = result.hasGroundTruth ? QJsonValue(result.translationError) : QJsonValue();
+            pairs.append(pair);
+
+            totalTime += result.timeMs;
+            totalIterations += result.iterations;
+            totalFitness += result.fitness;
+            totalRotationError += result.rotationError;
+            totalTranslationError += result.translationError;
+            maxRotationError = std::max(maxRotationError, result.rotationError);
+            maxTranslationError = std::max(maxTranslationError, result.translationError);
+
+            qDebug() << "RegistrationBenchmark:" << mode << "pair" << result.source << "->" << result.target
+                     << result.timeMs << "ms" << result.iterations << "iterations fitness" << result.fitness;
+        }
+
+        const double numberOfPairs = std::max(1, numberOfViews - 1);
+
+        QJsonObject summary;
+        summary["totalTimeMs"] = totalTime;
+        summary["meanTimeMs"] = totalTime / numberOfPairs;
+        summary["meanIterations"] = totalIterations / numberOfPairs;
+        summary["meanFitness"] = totalFitness / numberOfPairs;
+        summary["meanRotationErrorDeg"] = mv_HasGroundTruth ? QJsonValue(totalRotationError / numberOfPairs) : QJsonValue();
+        summary["maxRotationErrorDeg"] = mv_HasGroundTruth ? QJsonValue(maxRotationError) : QJsonValue();
+        summary["meanTranslationErrorM"] = mv_HasGroundTruth ? QJsonValue(totalTranslationError / numberOfPairs) : QJsonValue();
+        summary["maxTranslationErrorM"] = mv_HasGroundTruth ? QJsonValue(maxTranslationError) : QJsonValue();
+        //Peak of the whole process so far, run one mode per process for a per mode value
+        summary["peakMemoryMB"] = mf_PeakMemoryMB();
+
+        QJsonObject modeReport;
+        modeReport["mode"] = mode;
+        modeReport["pairs"] = pairs;
+        modeReport["summary"] = summary;
+        modes.append(modeReport);
+    }
+
+    report["modes"] = modes;
+    report["peakMemoryMB"] = mf_PeakMemoryMB();
+    return report;
+}
+
+/*!
+ * \brief TDK_RegistrationBenchmark::mf_RunPair
+ * \param registration registration object of the current mode
+ * \param mode one of mf_AvailableModes
+ * \param source index of the source view
+ * \param target index of the target view
+ * \param sourceCloud downsampled source view
+ * \param targetCloud downsampled target view
+ * \return timing, iterations, fitness and errors against the ground truth of the pair
+ */
+TDK_RegistrationBenchmark::PairResult TDK_RegistrationBenchmark::mf_RunPair(
+        TDK_ScanRegistration &registration, const QString &mode,
+        const int source, const int target,
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &sourceCloud,
+        const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &targetCloud)
+{
+    PairResult result;
+    result.source = source;
+    result.target = target;
+    result.iterations = 0;
+    result.hasGroundTruth = mv_HasGroundTruth;
+    result.rotationError = 0.0;
+    result.translationError = 0.0;
+
+    //Ground truth moves source points into the target frame
+    const Eigen::Matrix4f groundTruth = mv_Poses[target].inverse() * mv_Poses[source];
+    Eigen::Matrix4f guess = mv_HasGroundTruth ? Eigen::Matrix4f(groundTruth * mv_Perturbation) : Eigen::Matrix4f::Identity();
+    Eigen::Matrix4f transformation = guess;
+
+    TDK_ScanRegistration::RegistrationStats stats;
+    QElapsedTimer timer;
+    timer.start();
+
+    if(mode == "ICP")
+        TDK_ScanRegistration::ICP(sourceCloud, targetCloud, guess, &transformation, &stats);
+    else if(mode == "ICPNormal")
+        TDK_ScanRegistration::ICPNormal(sourceCloud, targetCloud, guess, &transformation, &stats);
+    else if(mode == "ICPProjective")
+        TDK_ScanRegistration::ICPProjective(sourceCloud, targetCloud, guess, &transformation, &stats);
+    else if(mode == "GICP"){
+        //Covariances are cached per view, each view is described once for both of its pairs
+        const TDK_ScanRegistration::ScanCovariances sourceCovariances = registration.mf_getCachedCovariances(sourceCloud);
+        const TDK_ScanRegistration::ScanCovariances targetCovariances = registration.mf_getCachedCovariances(targetCloud);
+        TDK_ScanRegistration::ICPGeneralized(sourceCloud, targetCloud, guess, &transformation, &stats,
+                                             &sourceCovariances, &targetCovariances);
+    }
+    else if(mode == "ColoredICP"){
+        const TDK_ScanRegistration::ScanColorGradients targetGradients = registration.mf_getCachedColorGradients(targetCloud);
+        TDK_ScanRegistration::ICPColored(sourceCloud, targetCloud, guess, &transformation, &stats,
+                                         &targetGradients);
+    }
+    else if(mode == "FPFH+ICPNormal"){
+        guess = Eigen::Matrix4f::Identity();
+        registration.mf_globalPreAlignment(sourceCloud, targetCloud, guess);
+        TDK_ScanRegistration::ICPNormal(sourceCloud, targetCloud, guess, &transformation, &stats);
+    }
+
+    result.timeMs = timer.nsecsElapsed() / 1e6;
+    result.iterations = stats.iterations;
+
+    mf_ComputeFitness(sourceCloud, targetCloud, transformation, result.fitness, result.rmse);
+
+    if(result.hasGroundTruth){
+        const Eigen::Matrix3f rotationDifference =
+                transformation.topLeftCorner<3,3>().transpose() * groundTruth.topLeftCorner<3,3>();
+        const double cosine = std::min(1.0, std::max(-1.0, (rotationDifference.trace() - 1.0) / 2.0));
+        result.rotationError = std::acos(cosine) * 180.0 / M_PI;
+        result.translationError = (transformation.topRightCorner<3,1>() - groundTruth.topRightCorner<3,1>()).norm();
+    }
+
+    return result;
+}
+
+/*!
+ * \brief TDK_RegistrationBenchmark::mf_ComputeFitness
+ * \param source source point cloud
+ * \param target target point cloud
+ * \param transformation estimated transformation of the source
+ * \param fitness output ratio of source points closer than mv_InlierDistance to the target
+ * \param rmse output root mean square distance of those points
+ */
+void TDK_RegistrationBenchmark::mf_ComputeFitness(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &source,
+                                                  const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &target,
+                                                  const Eigen::Matrix4f &transformation,
+                                                  double &fitness, double &rmse) const
+{
+    fitness = 0.0;
+    rmse = 0.0;
+    if(source->empty() || target->empty())
+        return;
+
+    pcl::PointCloud<pcl::PointXYZRGB> transformed;
+    pcl::transformPointCloud(*source, transformed, transformation);
+
+    pcl::KdTreeFLANN<pcl::PointXYZRGB> tree;
+    tree.setInputCloud(target);
+
+    const float inlierSquaredDistance = mv_InlierDistance * mv_InlierDistance;
+    std::vector<int> index(1);
+    std::vector<float> squaredDistance(1);
+    int inliers = 0;
+    double sum = 0.0;
+
+    for(size_t i = 0; i < transformed.size(); i++){
+        if(tree.nearestKSearch(transformed[i], 1, index, squaredDistance) > 0 && squaredDistance[0] < inlierSquaredDistance){
+            inliers++;
+            sum += squaredDistance[0];
+        }
+    }
+
+    fitness = static_cast<double>(inliers) / transformed.size();
+    rmse = inliers > 0 ? std::sqrt(sum / inliers) : 0.0;
+}
+
+/*!
+ * \brief TDK_RegistrationBenchmark::mf_CompareWithBaseline
+ * \param report report of the current build
+ * \param baseline report of a previous build on the same dataset
+ * \param timeTolerance allowed relative increase of the mean time per pair
+ * \param regressions output description of every regression found
+ * \return true when no mode regressed
+ *
+ * Errors may grow by 0.1 degrees and 1 mm and fitness may drop by 0.02 before they count
+ * as a regression, registration results vary slightly between compilers.
+ */
+bool TDK_RegistrationBenchmark::mf_CompareWithBaseline(const QJsonObject &report, const QJsonObject &baseline,
+                                                       const double timeTolerance, QStringList &regressions)
+{
+    regressions.clear();
+
+    if(report["dataset"] != baseline["dataset"] || report["views"] != baseline["views"]){
+        regressions << QString("Baseline was measured on %1 (%2 views), not on %3 (%4 views)")
+                       .arg(baseline["dataset"].toString()).arg(baseline["views"].toInt())
+                       .arg(report["dataset"].toString()).arg(report["views"].toInt());
+        return false;
+    }
+
+    const QJsonArray modes = report["modes"].toArray();
+    const QJsonArray baselineModes = baseline["modes"].toArray();
+
+    for(int m = 0; m < modes.size(); m++){
+        const QString mode = modes[m].toObject()["mode"].toString();
+        const QJsonObject summary = modes[m].toObject()["summary"].toObject();
+
+        for(int b = 0; b < baselineModes.size(); b++){
+            if(baselineModes[b].toObject()["mode"].toString() != mode)
+                continue;
+            const QJsonObject baselineSummary = baselineModes[b].toObject()["summary"].toObject();
+
+            const double time = summary["meanTimeMs"].toDouble();
+            const double baselineTime = baselineSummary["meanTimeMs"].toDouble();
+            if(time > baselineTime * (1.0 + timeTolerance))
+                regressions << QString("%1: mean time %2 ms, baseline %3 ms").arg(mode).arg(time).arg(baselineTime);
+
+            const double fitness = summary["meanFitness"].toDouble();
+            const double baselineFitness = baselineSummary["meanFitness"].toDouble();
+            if(fitness < baselineFitness - 0.02)
+                regressions << QString("%1: mean fitness %2, baseline %3").arg(mode).arg(fitness).arg(baselineFitness);
+
+            if(summary["meanRotationErrorDeg"].isDouble() && baselineSummary["meanRotationErrorDeg"].isDouble()){
+                const double rotation = summary["meanRotationErrorDeg"].toDouble();
+                const double baselineRotation = baselineSummary["meanRotationErrorDeg"].toDouble();
+                if(rotation > baselineRotation + 0.1)
+                    regressions << QString("%1: mean rotation error %2 deg, baseline %3 deg").arg(mode).arg(rotation).arg(baselineRotation);
+
+                const double translation = summary["meanTranslationErrorM"].toDouble();
+                const double baselineTranslation = baselineSummary["meanTranslationErrorM"].toDouble();
+                if(translation > baselineTranslation + 0.001)
+                    regressions << QString("%1: mean translation error %2 m, baseline %3 m").arg(mode).arg(translation).arg(baselineTranslation);
+            }
+        }
+    }
+
+    return regressions.isEmpty();
+}
+
+/*!
+ * \brief TDK_RegistrationBenchmark::mf_PeakMemoryMB
+ * \return peak resident memory of the process in megabytes
+ */
+double TDK_RegistrationBenchmark::mf_PeakMemoryMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    return 0.0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+#endif
+}
@@ -0,0 +1,98 @@
+#ifndef TDK_REGISTRATIONBENCHMARK_H
+#define TDK_REGISTRATIONBENCHMARK_H
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <vector>
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+class TDK_ScanRegistration;
+
+/*!
+ * \brief The TDK_RegistrationBenchmark class
+ *
+ * Runs the pairwise registration modes of TDK_ScanRegistration over a multi-view dataset and
+ * reports wall time, iterations, peak memory, fitness and, when ground truth poses are known,
+ * rotation and translation errors. Every view is registered to the previous one, the same
+ * pairs the scan window registers while scanning.
+ *
+ * A dataset is either a directory of PLY/PCD views with an optional poses.txt, or a synthetic
+ * turntable scan generated with known poses. Each line of poses.txt holds a file name followed
+ * by the 16 row-major values of the view pose (view frame to model frame).
+ *
+ * Use example
+ * TDK_RegistrationBenchmark benchmark;
+ * benchmark.mf_GenerateSyntheticDataset(12, 30.0);
+ * QJsonObject report = benchmark.mf_Run();
+ */
+class TDK_RegistrationBenchmark
+{
+public:
+    TDK_RegistrationBenchmark();
+    ~TDK_RegistrationBenchmark();
+
+    static QStringList  mf_AvailableModes       ();
+
+    bool    mf_LoadDataset                      (const QString &directory);
+    void    mf_GenerateSyntheticDataset         (const int numberOfViews, const float stepAngle,
+                                                 const float noise = 0.001, const unsigned int seed = 1);
+
+    void    mf_SetModes                         (const QStringList &modes)     {   mv_Modes = modes;   }
+    void    mf_SetInitialPerturbation           (const float degrees, const float meters);
+    void    mf_SetInlierDistance                (const float meters)           {   mv_InlierDistance = meters; }
+
+    int     mf_GetNumberOfViews                 () const    {   return static_cast<int>(mv_Views.size());   }
+
+    QJsonObject mf_Run                          ();
+
+    static bool mf_CompareWithBaseline          (const QJsonObject &report, const QJsonObject &baseline,
+                                                 const double timeTolerance, QStringList &regressions);
+
+private:
+    //Registration outcome of one pair of views
+    struct PairResult
+    {
+        int     source;
+        int     target;
+        double  timeMs;
+        int     iterations;
+        double  fitness;                //ratio of source points with a target point closer than the inlier distance
+        double  rmse;                   //meters, over the inliers
+        bool    hasGroundTruth;
+        double  rotationError;          //degrees
+        double  translationError;       //meters
+    };
+
+    QString                                                                 mv_DatasetName;
+    std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr>                     mv_Views;
+    std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > mv_Poses;
+    bool                                                                    mv_HasGroundTruth;
+
+    QStringList         mv_Modes;
+    Eigen::Matrix4f     mv_Perturbation;
+    float               mv_PerturbationDegrees;
+    float               mv_PerturbationMeters;
+    float               mv_InlierDistance;
+    float               mv_VoxelGridLeafSize;
+
+    PairResult          mf_RunPair                  (TDK_ScanRegistration &registration, const QString &mode,
+                                                     const int source, const int target,
+                                                     const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &sourceCloud,
+                                                     const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &targetCloud);
+    void                mf_ComputeFitness           (const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &source,
+                                                     const pcl::PointCloud<pcl::PointXYZRGB>::Ptr &target,
+                                                     const Eigen::Matrix4f &transformation,
+                                                     double &fitness, double &rmse) const;
+    static double       mf_PeakMemoryMB             ();
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+#endif // TDK_REGISTRATIONBENCHMARK_H